@@ -43,7 +43,9 @@ namespace art {
         lhs.min_methods_to_save_ == rhs.min_methods_to_save_ &&
         lhs.min_classes_to_save_ == rhs.min_classes_to_save_ &&
         lhs.min_notification_before_wake_ == rhs.min_notification_before_wake_ &&
-        lhs.max_notification_before_wake_ == rhs.max_notification_before_wake_;
+        lhs.max_notification_before_wake_ == rhs.max_notification_before_wake_ &&
+        lhs.compile_profiled_methods_ == rhs.compile_profiled_methods_ &&
+        lhs.preverify_startup_classes_ == rhs.preverify_startup_classes_;
   }
 
   bool UsuallyEquals(double expected, double actual) {
@@ -482,7 +484,11 @@ TEST_F(CmdlineParserTest, TestJitOptions) {
 * -Xps-*
 */
 TEST_F(CmdlineParserTest, ProfileSaverOptions) {
-  ProfileSaverOptions opt = ProfileSaverOptions(true, 1, 2, 3, 4, 5, 6, 7, "abc", true);
+  ProfileSaverOptions opt = ProfileSaverOptions(true, 1, 2, 3, 4, 5, 6, 7, "abc", true,
+                                                /* profile_aot_code */ false,
+                                                /* wait_for_jit_notifications_to_save */ true,
+                                                /* compile_profiled_methods */ true,
+                                                /* preverify_startup_classes */ true);
 
   EXPECT_SINGLE_PARSE_VALUE(opt,
                             "-Xjitsaveprofilinginfo "
@@ -494,7 +500,9 @@ TEST_F(CmdlineParserTest, ProfileSaverOptions) {
                             "-Xps-min-notification-before-wake:6 "
                             "-Xps-max-notification-before-wake:7 "
                             "-Xps-profile-path:abc "
-                            "-Xps-profile-boot-class-path",
+                            "-Xps-profile-boot-class-path "
+                            "-Xps-compile-profiled-methods "
+                            "-Xps-preverify-startup-classes",
                             M::ProfileSaverOpts);
 }  // TEST_F
 
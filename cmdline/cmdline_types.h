@@ -657,6 +657,16 @@ struct CmdlineType<ProfileSaverOptions> : CmdlineTypeParser<ProfileSaverOptions>
       return Result::SuccessNoValue();
     }
 
+    if (option == "compile-profiled-methods") {
+      existing.compile_profiled_methods_ = true;
+      return Result::SuccessNoValue();
+    }
+
+    if (option == "preverify-startup-classes") {
+      existing.preverify_startup_classes_ = true;
+      return Result::SuccessNoValue();
+    }
+
     // The rest of these options are always the wildcard from '-Xps-*'
     std::string suffix = RemovePrefix(option);
 
@@ -24,7 +24,6 @@
 #include "base/utils.h"
 #include "compiled_method.h"
 #include "linker/linker_patch.h"
-#include "thread-current-inl.h"
 #include "utils/dedupe_set-inl.h"
 #include "utils/swap_space.h"
 
@@ -61,7 +60,7 @@ inline const LengthPrefixedArray<T>* CompiledMethodStorage::AllocateOrDeduplicat
   } else if (!DedupeEnabled()) {
     return CopyArray(swap_space_.get(), data);
   } else {
-    return dedupe_set->Add(Thread::Current(), data);
+    return dedupe_set->Add(data);
   }
 }
 
@@ -76,7 +75,7 @@ inline void CompiledMethodStorage::ReleaseArrayIfNotDeduplicated(
 template <typename ContentType>
 class CompiledMethodStorage::DedupeHashFunc {
  private:
-  static constexpr bool kUseMurmur3Hash = true;
+  static constexpr bool kUseXxHash = true;
 
  public:
   size_t operator()(const ArrayRef<ContentType>& array) const {
@@ -84,58 +83,9 @@ class CompiledMethodStorage::DedupeHashFunc {
     // TODO: More reasonable assertion.
     // static_assert(IsPowerOfTwo(sizeof(ContentType)),
     //    "ContentType is not power of two, don't know whether array layout is as assumed");
-    uint32_t len = sizeof(ContentType) * array.size();
-    if (kUseMurmur3Hash) {
-      static constexpr uint32_t c1 = 0xcc9e2d51;
-      static constexpr uint32_t c2 = 0x1b873593;
-      static constexpr uint32_t r1 = 15;
-      static constexpr uint32_t r2 = 13;
-      static constexpr uint32_t m = 5;
-      static constexpr uint32_t n = 0xe6546b64;
-
-      uint32_t hash = 0;
-
-      const int nblocks = len / 4;
-      typedef __attribute__((__aligned__(1))) uint32_t unaligned_uint32_t;
-      const unaligned_uint32_t *blocks = reinterpret_cast<const uint32_t*>(data);
-      int i;
-      for (i = 0; i < nblocks; i++) {
-        uint32_t k = blocks[i];
-        k *= c1;
-        k = (k << r1) | (k >> (32 - r1));
-        k *= c2;
-
-        hash ^= k;
-        hash = ((hash << r2) | (hash >> (32 - r2))) * m + n;
-      }
-
-      const uint8_t *tail = reinterpret_cast<const uint8_t*>(data + nblocks * 4);
-      uint32_t k1 = 0;
-
-      switch (len & 3) {
-        case 3:
-          k1 ^= tail[2] << 16;
-          FALLTHROUGH_INTENDED;
-        case 2:
-          k1 ^= tail[1] << 8;
-          FALLTHROUGH_INTENDED;
-        case 1:
-          k1 ^= tail[0];
-
-          k1 *= c1;
-          k1 = (k1 << r1) | (k1 >> (32 - r1));
-          k1 *= c2;
-          hash ^= k1;
-      }
-
-      hash ^= len;
-      hash ^= (hash >> 16);
-      hash *= 0x85ebca6b;
-      hash ^= (hash >> 13);
-      hash *= 0xc2b2ae35;
-      hash ^= (hash >> 16);
-
-      return hash;
+    size_t len = sizeof(ContentType) * array.size();
+    if (kUseXxHash) {
+      return static_cast<size_t>(XxHash64::Hash(data, len));
     } else {
       return HashBytes(data, len);
     }
@@ -164,14 +114,11 @@ class CompiledMethodStorage::LengthPrefixedArrayAlloc {
 CompiledMethodStorage::CompiledMethodStorage(int swap_fd)
     : swap_space_(swap_fd == -1 ? nullptr : new SwapSpace(swap_fd, 10 * MB)),
       dedupe_enabled_(true),
-      dedupe_code_("dedupe code", LengthPrefixedArrayAlloc<uint8_t>(swap_space_.get())),
-      dedupe_method_info_("dedupe method info",
-                          LengthPrefixedArrayAlloc<uint8_t>(swap_space_.get())),
-      dedupe_vmap_table_("dedupe vmap table",
-                         LengthPrefixedArrayAlloc<uint8_t>(swap_space_.get())),
-      dedupe_cfi_info_("dedupe cfi info", LengthPrefixedArrayAlloc<uint8_t>(swap_space_.get())),
-      dedupe_linker_patches_("dedupe cfi info",
-                             LengthPrefixedArrayAlloc<linker::LinkerPatch>(swap_space_.get())) {
+      dedupe_code_(LengthPrefixedArrayAlloc<uint8_t>(swap_space_.get())),
+      dedupe_method_info_(LengthPrefixedArrayAlloc<uint8_t>(swap_space_.get())),
+      dedupe_vmap_table_(LengthPrefixedArrayAlloc<uint8_t>(swap_space_.get())),
+      dedupe_cfi_info_(LengthPrefixedArrayAlloc<uint8_t>(swap_space_.get())),
+      dedupe_linker_patches_(LengthPrefixedArrayAlloc<linker::LinkerPatch>(swap_space_.get())) {
 }
 
 CompiledMethodStorage::~CompiledMethodStorage() {
@@ -181,13 +128,24 @@ CompiledMethodStorage::~CompiledMethodStorage() {
 void CompiledMethodStorage::DumpMemoryUsage(std::ostream& os, bool extended) const {
   if (swap_space_.get() != nullptr) {
     const size_t swap_size = swap_space_->GetSize();
+    const size_t swap_freed_size = swap_space_->GetFreedSize();
     os << " swap=" << PrettySize(swap_size) << " (" << swap_size << "B)";
+    os << " swap freed=" << PrettySize(swap_freed_size) << " (" << swap_freed_size << "B)";
+  }
+  if (DedupeEnabled()) {
+    const size_t deduped_size = dedupe_code_.GetDedupedBytes() +
+        dedupe_method_info_.GetDedupedBytes() +
+        dedupe_vmap_table_.GetDedupedBytes() +
+        dedupe_cfi_info_.GetDedupedBytes() +
+        dedupe_linker_patches_.GetDedupedBytes();
+    os << " deduped=" << PrettySize(deduped_size) << " (" << deduped_size << "B)";
   }
   if (extended) {
-    Thread* self = Thread::Current();
-    os << "\nCode dedupe: " << dedupe_code_.DumpStats(self);
-    os << "\nVmap table dedupe: " << dedupe_vmap_table_.DumpStats(self);
-    os << "\nCFI info dedupe: " << dedupe_cfi_info_.DumpStats(self);
+    os << "\nCode dedupe: " << dedupe_code_.DumpStats();
+    os << "\nMethod info dedupe: " << dedupe_method_info_.DumpStats();
+    os << "\nVmap table dedupe: " << dedupe_vmap_table_.DumpStats();
+    os << "\nCFI info dedupe: " << dedupe_cfi_info_.DumpStats();
+    os << "\nLinker patches dedupe: " << dedupe_linker_patches_.DumpStats();
   }
 }
 
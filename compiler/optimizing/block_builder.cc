@@ -20,10 +20,15 @@
 #include "dex/bytecode_utils.h"
 #include "dex/code_item_accessors-inl.h"
 #include "dex/dex_file_exception_helpers.h"
+#include "jit/profiling_info.h"
 #include "quicken_info.h"
 
 namespace art {
 
+// Number of executions of a conditional branch from which a successor it never went to
+// can be pruned.
+static constexpr uint32_t kMinSamplesToPruneBranch = 1000;
+
 HBasicBlockBuilder::HBasicBlockBuilder(HGraph* graph,
                                        const DexFile* const dex_file,
                                        const CodeItemDebugInfoAccessor& accessor,
@@ -42,7 +47,11 @@ HBasicBlockBuilder::HBasicBlockBuilder(HGraph* graph,
                        local_allocator->Adapter(kArenaAllocGraphBuilder)),
       number_of_branches_(0u),
       quicken_index_for_dex_pc_(std::less<uint32_t>(),
-                                local_allocator->Adapter(kArenaAllocGraphBuilder)) {}
+                                local_allocator->Adapter(kArenaAllocGraphBuilder)),
+      branch_profile_(nullptr),
+      pruned_successors_(std::less<uint32_t>(),
+                         local_allocator->Adapter(kArenaAllocGraphBuilder)),
+      code_units_per_block_(local_allocator->Adapter(kArenaAllocGraphBuilder)) {}
 
 HBasicBlock* HBasicBlockBuilder::MaybeCreateBlockAt(uint32_t dex_pc) {
   return MaybeCreateBlockAt(dex_pc, dex_pc);
@@ -179,15 +188,26 @@ void HBasicBlockBuilder::ConnectBasicBlocks() {
       continue;
     }
 
+    if (branch_profile_ != nullptr) {
+      if (code_units_per_block_.size() <= block->GetBlockId()) {
+        code_units_per_block_.resize(block->GetBlockId() + 1u, 0u);
+      }
+      code_units_per_block_[block->GetBlockId()] += instruction.SizeInCodeUnits();
+    }
+
     if (!is_throwing_block && IsThrowingDexInstruction(instruction)) {
       DCHECK(!ContainsElement(throwing_blocks_, block));
       is_throwing_block = true;
       throwing_blocks_.push_back(block);
     }
 
+    PrunedSuccessor pruned_successor = PrunedSuccessor::kNone;
     if (instruction.IsBranch()) {
-      uint32_t target_dex_pc = dex_pc + instruction.GetTargetOffset();
-      block->AddSuccessor(GetBlockAt(target_dex_pc));
+      pruned_successor = MaybePruneSuccessor(instruction, dex_pc);
+      if (pruned_successor != PrunedSuccessor::kTarget) {
+        uint32_t target_dex_pc = dex_pc + instruction.GetTargetOffset();
+        block->AddSuccessor(GetBlockAt(target_dex_pc));
+      }
     } else if (instruction.IsReturn() || (instruction.Opcode() == Instruction::THROW)) {
       block->AddSuccessor(graph_->GetExitBlock());
     } else if (instruction.IsSwitch()) {
@@ -210,7 +230,7 @@ void HBasicBlockBuilder::ConnectBasicBlocks() {
     }
 
     // Go to the next instruction in case we read dex PC below.
-    if (instruction.CanFlowThrough()) {
+    if (instruction.CanFlowThrough() && pruned_successor != PrunedSuccessor::kFallThrough) {
       block->AddSuccessor(GetBlockAt(std::next(DexInstructionIterator(pair)).DexPc()));
     }
 
@@ -221,6 +241,63 @@ void HBasicBlockBuilder::ConnectBasicBlocks() {
   graph_->AddBlock(graph_->GetExitBlock());
 }
 
+HBasicBlockBuilder::PrunedSuccessor HBasicBlockBuilder::MaybePruneSuccessor(
+    const Instruction& instruction,
+    uint32_t dex_pc) {
+  if (branch_profile_ == nullptr || instruction.IsUnconditional()) {
+    return PrunedSuccessor::kNone;
+  }
+  const BranchCache* cache = branch_profile_->GetBranchCache(dex_pc);
+  if (cache == nullptr) {
+    return PrunedSuccessor::kNone;
+  }
+  // The interpreter keeps updating the profile, read it once.
+  const uint32_t taken = cache->GetTaken();
+  const uint32_t not_taken = cache->GetNotTaken();
+  PrunedSuccessor pruned_successor;
+  if (taken == 0u && not_taken >= kMinSamplesToPruneBranch) {
+    pruned_successor = PrunedSuccessor::kTarget;
+  } else if (not_taken == 0u && taken >= kMinSamplesToPruneBranch) {
+    pruned_successor = PrunedSuccessor::kFallThrough;
+  } else {
+    return PrunedSuccessor::kNone;
+  }
+  pruned_successors_.Put(dex_pc, pruned_successor);
+  return pruned_successor;
+}
+
+HBasicBlockBuilder::PrunedSuccessor HBasicBlockBuilder::GetPrunedSuccessor(
+    uint32_t dex_pc) const {
+  auto it = pruned_successors_.find(dex_pc);
+  return (it == pruned_successors_.end()) ? PrunedSuccessor::kNone : it->second;
+}
+
+size_t HBasicBlockBuilder::GetNumberOfReachableCodeUnits() const {
+  DCHECK(branch_profile_ != nullptr);
+  ArenaBitVector visited(local_allocator_,
+                         graph_->GetBlocks().size(),
+                         /* expandable */ false,
+                         kArenaAllocGraphBuilder);
+  ScopedArenaVector<HBasicBlock*> worklist(local_allocator_->Adapter(kArenaAllocGraphBuilder));
+  visited.SetBit(graph_->GetEntryBlock()->GetBlockId());
+  worklist.push_back(graph_->GetEntryBlock());
+  size_t code_units = 0u;
+  while (!worklist.empty()) {
+    HBasicBlock* block = worklist.back();
+    worklist.pop_back();
+    if (block->GetBlockId() < code_units_per_block_.size()) {
+      code_units += code_units_per_block_[block->GetBlockId()];
+    }
+    for (HBasicBlock* successor : block->GetSuccessors()) {
+      if (!visited.IsBitSet(successor->GetBlockId())) {
+        visited.SetBit(successor->GetBlockId());
+        worklist.push_back(successor);
+      }
+    }
+  }
+  return code_units;
+}
+
 // Returns the TryItem stored for `block` or nullptr if there is no info for it.
 static const DexFile::TryItem* GetTryItem(
     HBasicBlock* block,
@@ -25,8 +25,17 @@
 
 namespace art {
 
+class ProfilingInfo;
+
 class HBasicBlockBuilder : public ValueObject {
  public:
+  // Successor of a conditional branch that is left out of the graph.
+  enum class PrunedSuccessor {
+    kNone,
+    kTarget,
+    kFallThrough,
+  };
+
   HBasicBlockBuilder(HGraph* graph,
                      const DexFile* const dex_file,
                      const CodeItemDebugInfoAccessor& accessor,
@@ -41,6 +50,23 @@ class HBasicBlockBuilder : public ValueObject {
   // Creates basic blocks in `graph_` for compiling an intrinsic.
   void BuildIntrinsic();
 
+  // Leave out of the graph the successors of conditional branches that `branch_profile`
+  // saw executed often but never go to the successor. Code only reachable through them
+  // is not built. Must be called before Build().
+  void PruneUntakenBranches(ProfilingInfo* branch_profile) {
+    branch_profile_ = branch_profile;
+  }
+
+  // Returns which successor of the conditional branch at `dex_pc` was left out of the graph.
+  PrunedSuccessor GetPrunedSuccessor(uint32_t dex_pc) const;
+
+  // Returns whether Build() left any branch successor out of the graph.
+  bool HasPrunedSuccessors() const { return !pruned_successors_.empty(); }
+
+  // Returns the number of code units in the blocks reachable from the entry block, which is
+  // what remains of the method after pruning. Only valid after Build() with a branch profile.
+  size_t GetNumberOfReachableCodeUnits() const;
+
   size_t GetNumberOfBranches() const { return number_of_branches_; }
   HBasicBlock* GetBlockAt(uint32_t dex_pc) const { return branch_targets_[dex_pc]; }
 
@@ -57,6 +83,7 @@ class HBasicBlockBuilder : public ValueObject {
 
   bool CreateBranchTargets();
   void ConnectBasicBlocks();
+  PrunedSuccessor MaybePruneSuccessor(const Instruction& instruction, uint32_t dex_pc);
   void InsertTryBoundaryBlocks();
 
   // Helper method which decides whether `catch_block` may have live normal
@@ -80,6 +107,13 @@ class HBasicBlockBuilder : public ValueObject {
   // A table to quickly find the quicken index for the first instruction of a basic block.
   ScopedArenaSafeMap<uint32_t, uint32_t> quicken_index_for_dex_pc_;
 
+  // Branch profile to prune untaken successors with, or null.
+  ProfilingInfo* branch_profile_;
+  // The conditional branches with a pruned successor.
+  ScopedArenaSafeMap<uint32_t, PrunedSuccessor> pruned_successors_;
+  // Number of code units in each block, indexed by block id. Only counted with a branch profile.
+  ScopedArenaVector<size_t> code_units_per_block_;
+
   static constexpr size_t kDefaultNumberOfThrowingBlocks = 2u;
 
   DISALLOW_COPY_AND_ASSIGN(HBasicBlockBuilder);
@@ -26,10 +26,12 @@
 #include "driver/compiler_options.h"
 #include "driver/dex_compilation_unit.h"
 #include "instruction_builder.h"
+#include "jit/profiling_info.h"
 #include "mirror/class_loader.h"
 #include "mirror/dex_cache.h"
 #include "nodes.h"
 #include "optimizing_compiler_stats.h"
+#include "scoped_thread_state_change-inl.h"
 #include "ssa_builder.h"
 #include "thread.h"
 #include "utils/dex_cache_arrays_layout-inl.h"
@@ -73,7 +75,8 @@ HGraphBuilder::HGraphBuilder(HGraph* graph,
       handles_(handles),
       return_type_(return_type) {}
 
-bool HGraphBuilder::SkipCompilation(size_t number_of_branches) {
+bool HGraphBuilder::SkipCompilation(size_t number_of_branches,
+                                    size_t number_of_built_code_units) {
   if (compiler_driver_ == nullptr) {
     // Note that the compiler driver is null when unit testing.
     return false;
@@ -86,10 +89,10 @@ bool HGraphBuilder::SkipCompilation(size_t number_of_branches) {
   }
 
   const uint32_t code_units = code_item_accessor_.InsnsSizeInCodeUnits();
-  if (compiler_options.IsHugeMethod(code_units)) {
+  if (compiler_options.IsHugeMethod(number_of_built_code_units)) {
     VLOG(compiler) << "Skip compilation of huge method "
                    << dex_file_->PrettyMethod(dex_compilation_unit_->GetDexMethodIndex())
-                   << ": " << code_units << " code units";
+                   << ": " << number_of_built_code_units << " code units";
     MaybeRecordStat(compilation_stats_, MethodCompilationStat::kNotCompiledHugeMethod);
     return true;
   }
@@ -106,6 +109,24 @@ bool HGraphBuilder::SkipCompilation(size_t number_of_branches) {
   return false;
 }
 
+ProfilingInfo* HGraphBuilder::GetBranchProfileForPruning() const {
+  // Only OSR compilations of huge methods prune: the method is entered at a hot loop, and
+  // the paths it never took are what would otherwise prevent compiling it.
+  if (compiler_driver_ == nullptr ||
+      !graph_->IsCompilingOsr() ||
+      graph_->IsDebuggable() ||
+      dex_compilation_unit_ != outer_compilation_unit_ ||
+      graph_->GetArtMethod() == nullptr ||
+      code_item_accessor_.TriesSize() != 0u ||
+      !compiler_driver_->GetCompilerOptions().IsHugeMethod(
+          code_item_accessor_.InsnsSizeInCodeUnits())) {
+    return nullptr;
+  }
+  // The code cache keeps the ProfilingInfo of the method being compiled alive.
+  ScopedObjectAccess soa(Thread::Current());
+  return graph_->GetArtMethod()->GetProfilingInfo(kRuntimePointerSize);
+}
+
 GraphAnalysisResult HGraphBuilder::BuildGraph() {
   DCHECK(code_item_accessor_.HasCodeItem());
   DCHECK(graph_->GetBlocks().empty());
@@ -140,13 +161,22 @@ GraphAnalysisResult HGraphBuilder::BuildGraph() {
 
   // 1) Create basic blocks and link them together. Basic blocks are left
   //    unpopulated with the exception of synthetic blocks, e.g. HTryBoundaries.
+  ProfilingInfo* branch_profile = GetBranchProfileForPruning();
+  if (branch_profile != nullptr) {
+    block_builder.PruneUntakenBranches(branch_profile);
+  }
   if (!block_builder.Build()) {
     return kAnalysisInvalidBytecode;
   }
 
   // 2) Decide whether to skip this method based on its code size and number
-  //    of branches.
-  if (SkipCompilation(block_builder.GetNumberOfBranches())) {
+  //    of branches. Pruning only lets a huge method through if what remains of
+  //    it is below the limit.
+  size_t number_of_built_code_units = code_item_accessor_.InsnsSizeInCodeUnits();
+  if (branch_profile != nullptr && block_builder.HasPrunedSuccessors()) {
+    number_of_built_code_units = block_builder.GetNumberOfReachableCodeUnits();
+  }
+  if (SkipCompilation(block_builder.GetNumberOfBranches(), number_of_built_code_units)) {
     return kAnalysisSkipped;
   }
 
@@ -31,6 +31,7 @@ class ArtMethod;
 class CodeGenerator;
 class DexCompilationUnit;
 class OptimizingCompilerStats;
+class ProfilingInfo;
 
 class HGraphBuilder : public ValueObject {
  public:
@@ -57,7 +58,13 @@ class HGraphBuilder : public ValueObject {
   static constexpr const char* kBuilderPassName = "builder";
 
  private:
-  bool SkipCompilation(size_t number_of_branches);
+  // `number_of_built_code_units` is the size of the code the graph is built for, which is
+  // less than the whole method when untaken branches are pruned.
+  bool SkipCompilation(size_t number_of_branches, size_t number_of_built_code_units);
+
+  // Returns the branch profile to prune the untaken branches of the graph with, or null
+  // if this compilation builds all of them.
+  ProfilingInfo* GetBranchProfileForPruning() const;
 
   HGraph* const graph_;
   const DexFile* const dex_file_;
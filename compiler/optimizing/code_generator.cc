@@ -860,6 +860,12 @@ CodeGenerator::CodeGenerator(HGraph* graph,
       is_leaf_(true),
       requires_current_method_(false),
       code_generation_data_() {
+  if (graph->IsCompilingBaseline()) {
+    // Baseline code calls into the runtime on entry to ask for an optimized
+    // compilation, which expects a frame holding the current method.
+    MarkNotLeaf();
+    SetRequiresCurrentMethod();
+  }
 }
 
 CodeGenerator::~CodeGenerator() {}
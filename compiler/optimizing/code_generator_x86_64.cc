@@ -25,6 +25,7 @@
 #include "heap_poisoning.h"
 #include "intrinsics.h"
 #include "intrinsics_x86_64.h"
+#include "jit/profiling_info.h"
 #include "linker/linker_patch.h"
 #include "lock_word.h"
 #include "mirror/array-inl.h"
@@ -176,6 +177,27 @@ class SuspendCheckSlowPathX86_64 : public SlowPathCode {
   DISALLOW_COPY_AND_ASSIGN(SuspendCheckSlowPathX86_64);
 };
 
+class CompileOptimizedSlowPathX86_64 : public SlowPathCode {
+ public:
+  CompileOptimizedSlowPathX86_64() : SlowPathCode(/* instruction */ nullptr) {}
+
+  void EmitNativeCode(CodeGenerator* codegen) OVERRIDE {
+    CodeGeneratorX86_64* x86_64_codegen = down_cast<CodeGeneratorX86_64*>(codegen);
+    __ Bind(GetEntryLabel());
+    // The entrypoint preserves all registers and does not suspend, so there is
+    // nothing to save and no stack map to record.
+    x86_64_codegen->GenerateInvokeRuntime(
+        GetThreadOffset<kX86_64PointerSize>(kQuickCompileOptimized).Int32Value());
+    CheckEntrypointTypes<kQuickCompileOptimized, void, ArtMethod*, Thread*>();
+    __ jmp(GetExitLabel());
+  }
+
+  const char* GetDescription() const OVERRIDE { return "CompileOptimizedSlowPathX86_64"; }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(CompileOptimizedSlowPathX86_64);
+};
+
 class BoundsCheckSlowPathX86_64 : public SlowPathCode {
  public:
   explicit BoundsCheckSlowPathX86_64(HBoundsCheck* instruction)
@@ -1371,6 +1393,33 @@ void CodeGeneratorX86_64::GenerateFrameEntry() {
     // Initialize should_deoptimize flag to 0.
     __ movl(Address(CpuRegister(RSP), GetStackOffsetOfShouldDeoptimizeFlag()), Immediate(0));
   }
+
+  if (GetGraph()->IsCompilingBaseline()) {
+    GenerateBaselineHotnessCheck();
+  }
+}
+
+void CodeGeneratorX86_64::GenerateBaselineHotnessCheck() {
+  DCHECK(!Runtime::Current()->IsAotCompiler());
+  DCHECK(!HasEmptyFrame());
+  DCHECK(RequiresCurrentMethod());
+  SlowPathCode* slow_path = new (GetScopedAllocator()) CompileOptimizedSlowPathX86_64();
+  AddSlowPath(slow_path);
+  // Load the ProfilingInfo through the ArtMethod rather than embedding its address:
+  // the code cache collection clears the ArtMethod's pointer before it frees an info,
+  // and this code may still run from a thread stack then. The sequence below has no
+  // suspend point, so the collection's checkpoint orders it against the free.
+  __ movq(CpuRegister(TMP),
+          Address(CpuRegister(kMethodRegisterArgument),
+                  ArtMethod::ProfilingInfoOffset().Int32Value()));
+  __ testq(CpuRegister(TMP), CpuRegister(TMP));
+  __ j(kEqual, slow_path->GetExitLabel());
+  // Count down the entries into this code. Racy updates from several threads only
+  // delay reaching zero.
+  __ addw(Address(CpuRegister(TMP), ProfilingInfo::BaselineHotnessCountOffset().Int32Value()),
+          Immediate(-1));
+  __ j(kEqual, slow_path->GetEntryLabel());
+  __ Bind(slow_path->GetExitLabel());
 }
 
 void CodeGeneratorX86_64::GenerateFrameExit() {
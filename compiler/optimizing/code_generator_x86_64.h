@@ -325,6 +325,10 @@ class CodeGeneratorX86_64 : public CodeGenerator {
 
   void GenerateInvokeRuntime(int32_t entry_point_offset);
 
+  // Emit the entry counter of baseline code, which asks the runtime for an
+  // optimized compilation of the method once the count runs out.
+  void GenerateBaselineHotnessCheck();
+
   size_t GetWordSize() const OVERRIDE {
     return kX86_64WordSize;
   }
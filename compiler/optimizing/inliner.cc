@@ -33,6 +33,7 @@
 #include "intrinsics.h"
 #include "jit/jit.h"
 #include "jit/jit_code_cache.h"
+#include "jit/profiling_info.h"
 #include "mirror/class_loader.h"
 #include "mirror/dex_cache.h"
 #include "nodes.h"
@@ -50,6 +51,10 @@ namespace art {
 // Instruction limit to control memory.
 static constexpr size_t kMaximumNumberOfTotalInstructions = 1024;
 
+// Instruction limit when inlining at a call site that the profile reports as hot.
+// Hot call sites are tried first, so they are the ones spending the extra budget.
+static constexpr size_t kMaximumNumberOfTotalInstructionsForHotCallSite = 2048;
+
 // Maximum number of instructions for considering a method small,
 // which we will always try to inline if the other non-instruction limits
 // are not reached.
@@ -113,17 +118,83 @@ static size_t CountNumberOfInstructions(HGraph* graph) {
   return number_of_instructions;
 }
 
+class ScopedProfilingInfoInlineUse {
+ public:
+  explicit ScopedProfilingInfoInlineUse(ArtMethod* method, Thread* self)
+      : method_(method),
+        self_(self),
+        // Fetch the profiling info ahead of using it. If it's null when fetching,
+        // we should not call JitCodeCache::DoneInlining.
+        profiling_info_(
+            Runtime::Current()->GetJit()->GetCodeCache()->NotifyCompilerUse(method, self)) {
+  }
+
+  ~ScopedProfilingInfoInlineUse() {
+    if (profiling_info_ != nullptr) {
+      PointerSize pointer_size = Runtime::Current()->GetClassLinker()->GetImagePointerSize();
+      DCHECK_EQ(profiling_info_, method_->GetProfilingInfo(pointer_size));
+      Runtime::Current()->GetJit()->GetCodeCache()->DoneCompilerUse(method_, self_);
+    }
+  }
+
+  ProfilingInfo* GetProfilingInfo() const { return profiling_info_; }
+
+ private:
+  ArtMethod* const method_;
+  Thread* const self_;
+  ProfilingInfo* const profiling_info_;
+};
+
 void HInliner::UpdateInliningBudget() {
-  if (total_number_of_instructions_ >= kMaximumNumberOfTotalInstructions) {
+  size_t maximum_number_of_total_instructions =
+      (call_site_hotness_ == CallSiteHotness::kHot)
+          ? kMaximumNumberOfTotalInstructionsForHotCallSite
+          : kMaximumNumberOfTotalInstructions;
+  if (call_site_hotness_ == CallSiteHotness::kCold ||
+      total_number_of_instructions_ >= maximum_number_of_total_instructions) {
     // Always try to inline small methods.
     inlining_budget_ = kMaximumNumberOfInstructionsForSmallMethod;
   } else {
     inlining_budget_ = std::max(
         kMaximumNumberOfInstructionsForSmallMethod,
-        kMaximumNumberOfTotalInstructions - total_number_of_instructions_);
+        maximum_number_of_total_instructions - total_number_of_instructions_);
   }
 }
 
+HInliner::CallSiteHotness HInliner::GetCallSiteHotness(HInvoke* invoke,
+                                                       ProfilingInfo* profiling_info,
+                                                       /*out*/ uint32_t* count) const {
+  *count = 0;
+  if (Runtime::Current()->UseJitCompilation()) {
+    // Only virtual and interface calls have an inline cache counting their executions.
+    InlineCache* cache =
+        (profiling_info == nullptr) ? nullptr : profiling_info->FindInlineCache(invoke->GetDexPc());
+    if (cache == nullptr) {
+      return CallSiteHotness::kUnknown;
+    }
+    *count = cache->GetInvokeCount();
+    if (*count == 0) {
+      // The call site was never executed while the caller was profiled.
+      return CallSiteHotness::kCold;
+    }
+    // The caller is profiled from the warm threshold on, and compiled when hot. A call
+    // site executed at least as often as the warm threshold ran on most calls.
+    return (*count >= Runtime::Current()->GetJit()->WarmMethodThreshold())
+        ? CallSiteHotness::kHot
+        : CallSiteHotness::kUnknown;
+  }
+
+  // The AOT profile has no per call site counts, use the hotness of the callee instead.
+  // Methods missing from the profile are not known to be cold.
+  const ProfileCompilationInfo* pci = compiler_driver_->GetProfileCompilationInfo();
+  if (pci != nullptr &&
+      pci->GetMethodHotness(MethodReference(caller_compilation_unit_.GetDexFile(),
+                                            invoke->GetDexMethodIndex())).IsHot()) {
+    return CallSiteHotness::kHot;
+  }
+  return CallSiteHotness::kUnknown;
+}
+
 void HInliner::Run() {
   if (graph_->IsDebuggable()) {
     // For simplicity, we currently never inline when the graph is debuggable. This avoids
@@ -152,35 +223,63 @@ void HInliner::Run() {
   const bool honor_inlining_directives =
       IsCompilingWithCoreImage() && Runtime::Current()->IsAotCompiler();
 
-  // Keep a copy of all blocks when starting the visit.
-  ArenaVector<HBasicBlock*> blocks = graph_->GetReversePostOrder();
-  DCHECK(!blocks.empty());
-  // Because we are changing the graph when inlining,
-  // we just iterate over the blocks of the outer method.
-  // This avoids doing the inlining work again on the inlined blocks.
-  for (HBasicBlock* block : blocks) {
-    for (HInstruction* instruction = block->GetFirstInstruction(); instruction != nullptr;) {
-      HInstruction* next = instruction->GetNext();
-      HInvoke* call = instruction->AsInvoke();
-      // As long as the call is not intrinsified, it is worth trying to inline.
-      if (call != nullptr && call->GetIntrinsic() == Intrinsics::kNone) {
-        if (honor_inlining_directives) {
-          // Debugging case: directives in method names control or assert on inlining.
-          std::string callee_name = outer_compilation_unit_.GetDexFile()->PrettyMethod(
-              call->GetDexMethodIndex(), /* with_signature */ false);
-          // Tests prevent inlining by having $noinline$ in their method names.
-          if (callee_name.find("$noinline$") == std::string::npos) {
-            if (!TryInline(call)) {
-              bool should_have_inlined = (callee_name.find("$inline$") != std::string::npos);
-              CHECK(!should_have_inlined) << "Could not inline " << callee_name;
-            }
-          }
-        } else {
-          // Normal case: try to inline.
-          TryInline(call);
+  // Collect the calls of the outer method first, so that the hottest ones get to
+  // spend the inlining budget before the others. Because we are changing the graph
+  // when inlining, this also avoids doing the inlining work again on the inlined blocks.
+  ArenaVector<CallSite> call_sites(graph_->GetAllocator()->Adapter(kArenaAllocOptimization));
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    std::unique_ptr<ScopedProfilingInfoInlineUse> spiis;
+    if (Runtime::Current()->UseJitCompilation()) {
+      // Under JIT, we should always know the caller.
+      DCHECK(graph_->GetArtMethod() != nullptr);
+      spiis.reset(new ScopedProfilingInfoInlineUse(graph_->GetArtMethod(), soa.Self()));
+    }
+    ProfilingInfo* profiling_info = (spiis == nullptr) ? nullptr : spiis->GetProfilingInfo();
+    for (HBasicBlock* block : graph_->GetReversePostOrder()) {
+      for (HInstructionIterator it(block->GetInstructions()); !it.Done(); it.Advance()) {
+        HInvoke* call = it.Current()->AsInvoke();
+        // As long as the call is not intrinsified, it is worth trying to inline.
+        if (call != nullptr && call->GetIntrinsic() == Intrinsics::kNone) {
+          uint32_t count;
+          CallSiteHotness hotness = GetCallSiteHotness(call, profiling_info, &count);
+          call_sites.push_back(CallSite { call, hotness, count });
+        }
+      }
+    }
+  }
+  // Without profile, this keeps the calls in reverse post order.
+  std::stable_sort(call_sites.begin(),
+                   call_sites.end(),
+                   [](const CallSite& lhs, const CallSite& rhs) {
+                     return (lhs.hotness != rhs.hotness)
+                         ? lhs.hotness > rhs.hotness
+                         : lhs.count > rhs.count;
+                   });
+
+  for (const CallSite& call_site : call_sites) {
+    HInvoke* call = call_site.invoke;
+    call_site_hotness_ = call_site.hotness;
+    UpdateInliningBudget();
+    bool inlined = false;
+    if (honor_inlining_directives) {
+      // Debugging case: directives in method names control or assert on inlining.
+      std::string callee_name = outer_compilation_unit_.GetDexFile()->PrettyMethod(
+          call->GetDexMethodIndex(), /* with_signature */ false);
+      // Tests prevent inlining by having $noinline$ in their method names.
+      if (callee_name.find("$noinline$") == std::string::npos) {
+        inlined = TryInline(call);
+        if (!inlined) {
+          bool should_have_inlined = (callee_name.find("$inline$") != std::string::npos);
+          CHECK(!should_have_inlined) << "Could not inline " << callee_name;
         }
       }
-      instruction = next;
+    } else {
+      // Normal case: try to inline.
+      inlined = TryInline(call);
+    }
+    if (inlined && call_site.hotness == CallSiteHotness::kHot) {
+      MaybeRecordStat(stats_, MethodCompilationStat::kInlinedHotCallSite);
     }
   }
 }
@@ -305,33 +404,6 @@ static dex::TypeIndex FindClassIndexIn(mirror::Class* cls,
   return index;
 }
 
-class ScopedProfilingInfoInlineUse {
- public:
-  explicit ScopedProfilingInfoInlineUse(ArtMethod* method, Thread* self)
-      : method_(method),
-        self_(self),
-        // Fetch the profiling info ahead of using it. If it's null when fetching,
-        // we should not call JitCodeCache::DoneInlining.
-        profiling_info_(
-            Runtime::Current()->GetJit()->GetCodeCache()->NotifyCompilerUse(method, self)) {
-  }
-
-  ~ScopedProfilingInfoInlineUse() {
-    if (profiling_info_ != nullptr) {
-      PointerSize pointer_size = Runtime::Current()->GetClassLinker()->GetImagePointerSize();
-      DCHECK_EQ(profiling_info_, method_->GetProfilingInfo(pointer_size));
-      Runtime::Current()->GetJit()->GetCodeCache()->DoneCompilerUse(method_, self_);
-    }
-  }
-
-  ProfilingInfo* GetProfilingInfo() const { return profiling_info_; }
-
- private:
-  ArtMethod* const method_;
-  Thread* const self_;
-  ProfilingInfo* const profiling_info_;
-};
-
 HInliner::InlineCacheType HInliner::GetInlineCacheType(
     const Handle<mirror::ObjectArray<mirror::Class>>& classes)
   REQUIRES_SHARED(Locks::mutator_lock_) {
@@ -562,6 +634,22 @@ bool HInliner::UseOnlyPolymorphicInliningWithNoDeopt() {
   //     We may come from the interpreter and it may have seen different receiver types.
   return Runtime::Current()->IsAotCompiler() || outermost_graph_->IsCompilingOsr();
 }
+
+bool HInliner::InlineCacheCausedDeoptimization(HInvoke* invoke_instruction) {
+  // Only the JIT speculates with deoptimizations. The AOT compiler never does, see
+  // UseOnlyPolymorphicInliningWithNoDeopt.
+  if (!Runtime::Current()->UseJitCompilation()) {
+    return false;
+  }
+  ScopedProfilingInfoInlineUse spiis(graph_->GetArtMethod(), Thread::Current());
+  ProfilingInfo* profiling_info = spiis.GetProfilingInfo();
+  if (profiling_info == nullptr) {
+    return false;
+  }
+  InlineCache* cache = profiling_info->FindInlineCache(invoke_instruction->GetDexPc());
+  return cache != nullptr && cache->GetDeoptimizationCount() != 0u;
+}
+
 bool HInliner::TryInlineFromInlineCache(const DexFile& caller_dex_file,
                                         HInvoke* invoke_instruction,
                                         ArtMethod* resolved_method)
@@ -595,7 +683,8 @@ bool HInliner::TryInlineFromInlineCache(const DexFile& caller_dex_file,
 
     case kInlineCacheMonomorphic: {
       MaybeRecordStat(stats_, MethodCompilationStat::kMonomorphicCall);
-      if (UseOnlyPolymorphicInliningWithNoDeopt()) {
+      if (UseOnlyPolymorphicInliningWithNoDeopt() ||
+          InlineCacheCausedDeoptimization(invoke_instruction)) {
         return TryInlinePolymorphicCall(invoke_instruction, resolved_method, inline_cache);
       } else {
         return TryInlineMonomorphicCall(invoke_instruction, resolved_method, inline_cache);
@@ -974,7 +1063,11 @@ bool HInliner::TryInlinePolymorphicCall(HInvoke* invoke_instruction,
   DCHECK(invoke_instruction->IsInvokeVirtual() || invoke_instruction->IsInvokeInterface())
       << invoke_instruction->DebugName();
 
-  if (TryInlinePolymorphicCallToSameTarget(invoke_instruction, resolved_method, classes)) {
+  // Do not speculate again with deoptimizations if a previous speculation failed.
+  const bool deoptimized_before = InlineCacheCausedDeoptimization(invoke_instruction);
+  if (deoptimized_before) {
+    MaybeRecordStat(stats_, MethodCompilationStat::kInlineCacheDeoptimizedBefore);
+  } else if (TryInlinePolymorphicCallToSameTarget(invoke_instruction, resolved_method, classes)) {
     return true;
   }
 
@@ -1022,6 +1115,7 @@ bool HInliner::TryInlinePolymorphicCall(HInvoke* invoke_instruction,
       // If we have inlined all targets before, and this receiver is the last seen,
       // we deoptimize instead of keeping the original invoke instruction.
       bool deoptimize = !UseOnlyPolymorphicInliningWithNoDeopt() &&
+          !deoptimized_before &&
           all_targets_inlined &&
           (i != InlineCache::kIndividualCacheSize - 1) &&
           (classes->Get(i + 1) == nullptr);
@@ -1755,6 +1849,7 @@ bool HInliner::TryBuildAndInlineHelper(HInvoke* invoke_instruction,
       invoke_type,
       graph_->IsDebuggable(),
       /* osr */ false,
+      graph_->IsCompilingBaseline(),
       caller_instruction_counter);
   callee_graph->SetArtMethod(resolved_method);
 
@@ -1913,10 +2008,16 @@ bool HInliner::TryBuildAndInlineHelper(HInvoke* invoke_instruction,
          !instr_it.Done();
          instr_it.Advance()) {
       if (++number_of_instructions >= inlining_budget_) {
-        LOG_FAIL(stats_, MethodCompilationStat::kNotInlinedInstructionBudget)
-            << "Method " << callee_dex_file.PrettyMethod(method_index)
-            << " is not inlined because the outer method has reached"
-            << " its instruction budget limit.";
+        if (call_site_hotness_ == CallSiteHotness::kCold) {
+          LOG_FAIL(stats_, MethodCompilationStat::kNotInlinedColdCallSite)
+              << "Method " << callee_dex_file.PrettyMethod(method_index)
+              << " is not inlined because the call site is cold and the method is not small.";
+        } else {
+          LOG_FAIL(stats_, MethodCompilationStat::kNotInlinedInstructionBudget)
+              << "Method " << callee_dex_file.PrettyMethod(method_index)
+              << " is not inlined because the outer method has reached"
+              << " its instruction budget limit.";
+        }
         return false;
       }
       HInstruction* current = instr_it.Current();
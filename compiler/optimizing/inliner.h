@@ -30,6 +30,7 @@ class DexCompilationUnit;
 class HGraph;
 class HInvoke;
 class OptimizingCompilerStats;
+class ProfilingInfo;
 
 class HInliner : public HOptimization {
  public:
@@ -57,6 +58,7 @@ class HInliner : public HOptimization {
         parent_(parent),
         depth_(depth),
         inlining_budget_(0),
+        call_site_hotness_(CallSiteHotness::kUnknown),
         handles_(handles),
         inline_stats_(nullptr) {}
 
@@ -65,6 +67,22 @@ class HInliner : public HOptimization {
   static constexpr const char* kInlinerPassName = "inliner";
 
  private:
+  // How often a call site runs according to the JIT or AOT profile. Hot call sites
+  // are tried first and get a larger instruction budget, cold ones only inline
+  // small methods. Ordered from coldest to hottest.
+  enum class CallSiteHotness {
+    kCold,
+    kUnknown,
+    kHot
+  };
+
+  struct CallSite {
+    HInvoke* invoke;
+    CallSiteHotness hotness;
+    // Number of times the call site was executed, or 0 if unknown.
+    uint32_t count;
+  };
+
   enum InlineCacheType {
     kInlineCacheNoData = 0,
     kInlineCacheUninitialized = 1,
@@ -184,6 +202,11 @@ class HInliner : public HOptimization {
   // Returns whether or not we should use only polymorphic inlining with no deoptimizations.
   bool UseOnlyPolymorphicInliningWithNoDeopt();
 
+  // Returns whether a speculation on the inline cache of `invoke_instruction` already failed
+  // and deoptimized. Inlining then only uses type guards with a fallback to the invoke.
+  bool InlineCacheCausedDeoptimization(HInvoke* invoke_instruction)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   // Try CHA-based devirtualization to change virtual method calls into
   // direct calls.
   // Returns the actual method that resolved_method can be devirtualized to.
@@ -267,9 +290,17 @@ class HInliner : public HOptimization {
                                                 HInstruction* return_replacement,
                                                 HInstruction* invoke_instruction);
 
-  // Update the inlining budget based on `total_number_of_instructions_`.
+  // Update the inlining budget based on `total_number_of_instructions_` and
+  // `call_site_hotness_`.
   void UpdateInliningBudget();
 
+  // Return the hotness of the call site `invoke`, and in `count` how many times it
+  // was executed according to `profiling_info`.
+  CallSiteHotness GetCallSiteHotness(HInvoke* invoke,
+                                     ProfilingInfo* profiling_info,
+                                     /*out*/ uint32_t* count) const
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   // Count the number of calls of `method` being inlined recursively.
   size_t CountRecursiveCallsOf(ArtMethod* method) const;
 
@@ -291,6 +322,10 @@ class HInliner : public HOptimization {
 
   // The budget left for inlining, in number of instructions.
   size_t inlining_budget_;
+
+  // The hotness of the call site currently being inlined.
+  CallSiteHotness call_site_hotness_;
+
   VariableSizedHandleScope* const handles_;
 
   // Used to record stats about optimizations on the inlined graph.
@@ -28,6 +28,7 @@
 #include "driver/dex_compilation_unit.h"
 #include "driver/compiler_options.h"
 #include "imtable-inl.h"
+#include "jit/profiling_info.h"
 #include "mirror/dex_cache.h"
 #include "oat_file.h"
 #include "optimizing_compiler_stats.h"
@@ -73,7 +74,8 @@ HInstructionBuilder::HInstructionBuilder(HGraph* graph,
       current_locals_(nullptr),
       latest_result_(nullptr),
       current_this_parameter_(nullptr),
-      loop_headers_(local_allocator->Adapter(kArenaAllocGraphBuilder)) {
+      loop_headers_(local_allocator->Adapter(kArenaAllocGraphBuilder)),
+      branch_profiling_info_(nullptr) {
   loop_headers_.reserve(kDefaultNumberOfLoops);
 }
 
@@ -326,6 +328,16 @@ bool HInstructionBuilder::Build() {
     native_debug_info_locations = FindNativeDebugInfoLocations();
   }
 
+  // Only read the branch profile of the method being JIT compiled. The code cache keeps its
+  // ProfilingInfo alive during the compilation, but not the ones of the inlined methods.
+  if (dex_compilation_unit_ == outer_compilation_unit_ &&
+      graph_->GetArtMethod() != nullptr &&
+      Runtime::Current() != nullptr &&
+      Runtime::Current()->UseJitCompilation()) {
+    ScopedObjectAccess soa(Thread::Current());
+    branch_profiling_info_ = graph_->GetArtMethod()->GetProfilingInfo(kRuntimePointerSize);
+  }
+
   for (HBasicBlock* block : graph_->GetReversePostOrder()) {
     current_block_ = block;
     uint32_t block_dex_pc = current_block_->GetDexPc();
@@ -615,8 +627,7 @@ void HInstructionBuilder::If_22t(const Instruction& instruction, uint32_t dex_pc
   HInstruction* second = LoadLocal(instruction.VRegB(), DataType::Type::kInt32);
   T* comparison = new (allocator_) T(first, second, dex_pc);
   AppendInstruction(comparison);
-  AppendInstruction(new (allocator_) HIf(comparison, dex_pc));
-  current_block_ = nullptr;
+  BuildIf(comparison, dex_pc);
 }
 
 template<typename T>
@@ -624,10 +635,59 @@ void HInstructionBuilder::If_21t(const Instruction& instruction, uint32_t dex_pc
   HInstruction* value = LoadLocal(instruction.VRegA(), DataType::Type::kInt32);
   T* comparison = new (allocator_) T(value, graph_->GetIntConstant(0, dex_pc), dex_pc);
   AppendInstruction(comparison);
-  AppendInstruction(new (allocator_) HIf(comparison, dex_pc));
+  BuildIf(comparison, dex_pc);
+}
+
+void HInstructionBuilder::BuildIf(HCondition* condition, uint32_t dex_pc) {
+  HBasicBlockBuilder::PrunedSuccessor pruned_successor =
+      block_builder_->GetPrunedSuccessor(dex_pc);
+  if (pruned_successor == HBasicBlockBuilder::PrunedSuccessor::kNone) {
+    HIf* if_instruction = new (allocator_) HIf(condition, dex_pc);
+    if_instruction->SetBranchBias(GetBranchBias(dex_pc));
+    AppendInstruction(if_instruction);
+  } else {
+    // The block only has the successor the profile saw taken. Deoptimize when going to the
+    // other one, the interpreter resumes at the branch.
+    HInstruction* deoptimize_condition = condition;
+    if (pruned_successor == HBasicBlockBuilder::PrunedSuccessor::kFallThrough) {
+      deoptimize_condition = new (allocator_) HBooleanNot(condition, dex_pc);
+      AppendInstruction(deoptimize_condition);
+    }
+    AppendInstruction(new (allocator_) HDeoptimize(
+        allocator_, deoptimize_condition, DeoptimizationKind::kUntakenBranch, dex_pc));
+    AppendInstruction(new (allocator_) HGoto(dex_pc));
+    MaybeRecordStat(compilation_stats_, MethodCompilationStat::kPrunedUntakenBranch);
+  }
   current_block_ = nullptr;
 }
 
+HIf::BranchBias HInstructionBuilder::GetBranchBias(uint32_t dex_pc) const {
+  // Number of executions below which the profile of a branch is not trusted.
+  static constexpr uint64_t kMinBranchSamples = 64;
+  // A successor taken at most once every kUnlikelyBranchRatio executions is considered cold.
+  static constexpr uint64_t kUnlikelyBranchRatio = 32;
+  if (branch_profiling_info_ == nullptr) {
+    return HIf::BranchBias::kNone;
+  }
+  const BranchCache* cache = branch_profiling_info_->GetBranchCache(dex_pc);
+  if (cache == nullptr) {
+    return HIf::BranchBias::kNone;
+  }
+  const uint64_t taken = cache->GetTaken();
+  const uint64_t not_taken = cache->GetNotTaken();
+  const uint64_t total = taken + not_taken;
+  if (total < kMinBranchSamples) {
+    return HIf::BranchBias::kNone;
+  }
+  // The true successor of the HIf is the branch target.
+  if (not_taken * kUnlikelyBranchRatio <= total) {
+    return HIf::BranchBias::kTrueLikely;
+  } else if (taken * kUnlikelyBranchRatio <= total) {
+    return HIf::BranchBias::kFalseLikely;
+  }
+  return HIf::BranchBias::kNone;
+}
+
 template<typename T>
 void HInstructionBuilder::Unop_12x(const Instruction& instruction,
                                    DataType::Type type,
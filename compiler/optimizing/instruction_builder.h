@@ -39,6 +39,7 @@ class DexCompilationUnit;
 class HBasicBlockBuilder;
 class Instruction;
 class OptimizingCompilerStats;
+class ProfilingInfo;
 class SsaBuilder;
 class VariableSizedHandleScope;
 
@@ -129,6 +130,13 @@ class HInstructionBuilder : public ValueObject {
   template<typename T> void If_21t(const Instruction& instruction, uint32_t dex_pc);
   template<typename T> void If_22t(const Instruction& instruction, uint32_t dex_pc);
 
+  // Ends the current block with the conditional branch at `dex_pc` on `condition`, or with
+  // a deoptimization if the block builder pruned one of its successors.
+  void BuildIf(HCondition* condition, uint32_t dex_pc);
+
+  // Returns the bias of the conditional branch at `dex_pc` according to the JIT branch profile.
+  HIf::BranchBias GetBranchBias(uint32_t dex_pc) const;
+
   void Conversion_12x(const Instruction& instruction,
                       DataType::Type input_type,
                       DataType::Type result_type,
@@ -347,6 +355,9 @@ class HInstructionBuilder : public ValueObject {
 
   ScopedArenaVector<HBasicBlock*> loop_headers_;
 
+  // The JIT profile of the method, if it has one and is not being inlined.
+  ProfilingInfo* branch_profiling_info_;
+
   static constexpr int kDefaultNumberOfLoops = 2;
 
   DISALLOW_COPY_AND_ASSIGN(HInstructionBuilder);
@@ -54,6 +54,19 @@ static void AddToListForLinearization(ScopedArenaVector<HBasicBlock*>* worklist,
   worklist->insert(insert_pos.base(), block);
 }
 
+// Helper method to update work list for linear order, for a successor the branch profile says
+// is almost never taken. Outside of loops, the block is sunk to the bottom of the work list so
+// that it is laid out after the hot code. Within loops, it is added like other blocks to keep the
+// loop contiguous.
+static void AddColdBlockToListForLinearization(ScopedArenaVector<HBasicBlock*>* worklist,
+                                               HBasicBlock* block) {
+  if (IsLoop(block->GetLoopInformation())) {
+    AddToListForLinearization(worklist, block);
+  } else {
+    worklist->insert(worklist->begin(), block);
+  }
+}
+
 // Helper method to validate linear order.
 static bool IsLinearOrderWellFormed(const HGraph* graph, ArrayRef<HBasicBlock*> linear_order) {
   for (HBasicBlock* header : graph->GetBlocks()) {
@@ -108,7 +121,22 @@ void LinearizeGraphInternal(const HGraph* graph, ArrayRef<HBasicBlock*> linear_o
   //      iterate over the successors. When all non-back edge predecessors of a
   //      successor block are visited, the successor block is added in the worklist
   //      following an order that satisfies the requirements to build our linear graph.
+  //      When the JIT branch profile says an HIf successor is almost never taken, the
+  //      other successor is added last so that it becomes the fall-through, and the cold
+  //      successor is sunk (see AddColdBlockToListForLinearization).
   ScopedArenaVector<HBasicBlock*> worklist(allocator.Adapter(kArenaAllocLinearOrder));
+  auto AddSuccessorForLinearization = [&](HBasicBlock* successor, bool is_cold) {
+    int block_id = successor->GetBlockId();
+    size_t number_of_remaining_predecessors = forward_predecessors[block_id];
+    if (number_of_remaining_predecessors == 1) {
+      if (is_cold) {
+        AddColdBlockToListForLinearization(&worklist, successor);
+      } else {
+        AddToListForLinearization(&worklist, successor);
+      }
+    }
+    forward_predecessors[block_id] = number_of_remaining_predecessors - 1;
+  };
   worklist.push_back(graph->GetEntryBlock());
   size_t num_added = 0u;
   do {
@@ -116,13 +144,20 @@ void LinearizeGraphInternal(const HGraph* graph, ArrayRef<HBasicBlock*> linear_o
     worklist.pop_back();
     linear_order[num_added] = current;
     ++num_added;
-    for (HBasicBlock* successor : current->GetSuccessors()) {
-      int block_id = successor->GetBlockId();
-      size_t number_of_remaining_predecessors = forward_predecessors[block_id];
-      if (number_of_remaining_predecessors == 1) {
-        AddToListForLinearization(&worklist, successor);
+    HInstruction* last = current->GetLastInstruction();
+    HBasicBlock* cold_successor = (last != nullptr && last->IsIf())
+        ? last->AsIf()->GetUnlikelySuccessor()
+        : nullptr;
+    if (cold_successor != nullptr && cold_successor == last->AsIf()->IfFalseSuccessor()) {
+      // Visit the cold false successor first so that the hot true successor ends up on top of
+      // the work list.
+      for (HBasicBlock* successor : ReverseRange(current->GetSuccessors())) {
+        AddSuccessorForLinearization(successor, successor == cold_successor);
+      }
+    } else {
+      for (HBasicBlock* successor : current->GetSuccessors()) {
+        AddSuccessorForLinearization(successor, successor == cold_successor);
       }
-      forward_predecessors[block_id] = number_of_remaining_predecessors - 1;
     }
   } while (!worklist.empty());
   DCHECK_EQ(num_added, linear_order.size());
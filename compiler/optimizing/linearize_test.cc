@@ -246,4 +246,43 @@ TEST_F(LinearizeTest, CFG7) {
   TestCode(data, blocks);
 }
 
+TEST_F(LinearizeTest, BranchBias) {
+  // The successor the branch profile says is hot must be laid out right after the HIf,
+  // whichever of the two successors it is.
+  const std::vector<uint16_t> data = ONE_REGISTER_CODE_ITEM(
+    Instruction::CONST_4 | 0 | 0,
+    Instruction::IF_EQ, 3,
+    Instruction::RETURN_VOID,
+    Instruction::RETURN_VOID);
+
+  for (HIf::BranchBias bias : { HIf::BranchBias::kTrueLikely, HIf::BranchBias::kFalseLikely }) {
+    HGraph* graph = CreateCFG(data);
+    HIf* if_instruction = nullptr;
+    for (HBasicBlock* block : graph->GetBlocks()) {
+      if (block != nullptr && block->GetLastInstruction()->IsIf()) {
+        if_instruction = block->GetLastInstruction()->AsIf();
+      }
+    }
+    ASSERT_TRUE(if_instruction != nullptr);
+    if_instruction->SetBranchBias(bias);
+    HBasicBlock* cold = if_instruction->GetUnlikelySuccessor();
+    HBasicBlock* hot = (cold == if_instruction->IfTrueSuccessor())
+        ? if_instruction->IfFalseSuccessor()
+        : if_instruction->IfTrueSuccessor();
+
+    std::unique_ptr<const X86InstructionSetFeatures> features_x86(
+        X86InstructionSetFeatures::FromCppDefines());
+    x86::CodeGeneratorX86 codegen(graph, *features_x86.get(), CompilerOptions());
+    SsaLivenessAnalysis liveness(graph, &codegen, GetScopedAllocator());
+    liveness.Analyze();
+
+    const ArenaVector<HBasicBlock*>& linear_order = graph->GetLinearOrder();
+    auto position = [&](HBasicBlock* block) {
+      return std::find(linear_order.begin(), linear_order.end(), block) - linear_order.begin();
+    };
+    ASSERT_EQ(position(if_instruction->GetBlock()) + 1, position(hot));
+    ASSERT_LT(position(hot), position(cold));
+  }
+}
+
 }  // namespace art
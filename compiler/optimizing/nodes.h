@@ -315,6 +315,7 @@ class HGraph : public ArenaObject<kArenaAllocGraph> {
          InvokeType invoke_type = kInvalidInvokeType,
          bool debuggable = false,
          bool osr = false,
+         bool baseline = false,
          int start_instruction_id = 0)
       : allocator_(allocator),
         arena_stack_(arena_stack),
@@ -350,6 +351,7 @@ class HGraph : public ArenaObject<kArenaAllocGraph> {
         art_method_(nullptr),
         inexact_object_rti_(ReferenceTypeInfo::CreateInvalid()),
         osr_(osr),
+        baseline_(baseline),
         cha_single_implementation_list_(allocator->Adapter(kArenaAllocCHA)) {
     blocks_.reserve(kDefaultNumberOfBlocks);
   }
@@ -574,6 +576,8 @@ class HGraph : public ArenaObject<kArenaAllocGraph> {
 
   bool IsCompilingOsr() const { return osr_; }
 
+  bool IsCompilingBaseline() const { return baseline_; }
+
   ArenaSet<ArtMethod*>& GetCHASingleImplementationList() {
     return cha_single_implementation_list_;
   }
@@ -758,6 +762,10 @@ class HGraph : public ArenaObject<kArenaAllocGraph> {
   // compiled code entries which the interpreter can directly jump to.
   const bool osr_;
 
+  // Whether we are compiling baseline code: only a minimal set of optimizations
+  // is run, and the generated code asks for an optimized compilation once hot.
+  const bool baseline_;
+
   // List of methods that are assumed to have single implementation.
   ArenaSet<ArtMethod*> cha_single_implementation_list_;
 
@@ -3113,9 +3121,19 @@ class HDoubleConstant FINAL : public HConstant {
 // two successors.
 class HIf FINAL : public HTemplateInstruction<1> {
  public:
+  // Which successor the JIT branch profile says is taken almost always. Only used for the
+  // block layout.
+  enum class BranchBias {
+    kNone,
+    kTrueLikely,
+    kFalseLikely,
+    kLast = kFalseLikely
+  };
+
   explicit HIf(HInstruction* input, uint32_t dex_pc = kNoDexPc)
       : HTemplateInstruction(kIf, SideEffects::None(), dex_pc) {
     SetRawInputAt(0, input);
+    SetPackedField<BranchBiasField>(BranchBias::kNone);
   }
 
   bool IsClonable() const OVERRIDE { return true; }
@@ -3129,10 +3147,49 @@ class HIf FINAL : public HTemplateInstruction<1> {
     return GetBlock()->GetSuccessors()[1];
   }
 
+  BranchBias GetBranchBias() const { return GetPackedField<BranchBiasField>(); }
+  void SetBranchBias(BranchBias bias) { SetPackedField<BranchBiasField>(bias); }
+
+  // Must be called when the successors are swapped.
+  void FlipBranchBias() {
+    switch (GetBranchBias()) {
+      case BranchBias::kTrueLikely:
+        SetBranchBias(BranchBias::kFalseLikely);
+        break;
+      case BranchBias::kFalseLikely:
+        SetBranchBias(BranchBias::kTrueLikely);
+        break;
+      case BranchBias::kNone:
+        break;
+    }
+  }
+
+  // Returns the successor which is almost never taken, or null if there is no profile bias.
+  HBasicBlock* GetUnlikelySuccessor() const {
+    switch (GetBranchBias()) {
+      case BranchBias::kTrueLikely:
+        return IfFalseSuccessor();
+      case BranchBias::kFalseLikely:
+        return IfTrueSuccessor();
+      case BranchBias::kNone:
+        return nullptr;
+    }
+    LOG(FATAL) << "Unreachable";
+    UNREACHABLE();
+  }
+
   DECLARE_INSTRUCTION(If);
 
  protected:
   DEFAULT_COPY_CONSTRUCTOR(If);
+
+ private:
+  static constexpr size_t kFieldBranchBias = kNumberOfGenericPackedBits;
+  static constexpr size_t kFieldBranchBiasSize =
+      MinimumBitsToStore(static_cast<size_t>(BranchBias::kLast));
+  static constexpr size_t kNumberOfIfPackedBits = kFieldBranchBias + kFieldBranchBiasSize;
+  static_assert(kNumberOfIfPackedBits <= kMaxNumberOfPackedBits, "Too many packed fields.");
+  using BranchBiasField = BitField<BranchBias, kFieldBranchBias, kFieldBranchBiasSize>;
 };
 
 
@@ -299,6 +299,7 @@ class OptimizingCompiler FINAL : public Compiler {
                   jit::JitCodeCache* code_cache,
                   ArtMethod* method,
                   bool osr,
+                  bool baseline,
                   jit::JitLogger* jit_logger)
       OVERRIDE
       REQUIRES_SHARED(Locks::mutator_lock_);
@@ -347,6 +348,14 @@ class OptimizingCompiler FINAL : public Compiler {
                         PassObserver* pass_observer,
                         VariableSizedHandleScope* handles) const;
 
+  // Run the few passes baseline compilation needs: the code generator relies on
+  // the instruction simplifier, and the remaining passes are cheap but pay off.
+  void RunBaselineOptimizations(HGraph* graph,
+                                CodeGenerator* codegen,
+                                const DexCompilationUnit& dex_compilation_unit,
+                                PassObserver* pass_observer,
+                                VariableSizedHandleScope* handles) const;
+
  private:
   // Create a 'CompiledMethod' for an optimized graph.
   CompiledMethod* Emit(ArenaAllocator* allocator,
@@ -359,7 +368,8 @@ class OptimizingCompiler FINAL : public Compiler {
   // This method:
   // 1) Builds the graph. Returns null if it failed to build it.
   // 2) Transforms the graph to SSA. Returns null if it failed.
-  // 3) Runs optimizations on the graph, including register allocator.
+  // 3) Runs optimizations on the graph, including register allocator. Only
+  //    a minimal set of passes is run for `baseline` compilation.
   // 4) Generates code with the `code_allocator` provided.
   CodeGenerator* TryCompile(ArenaAllocator* allocator,
                             ArenaStack* arena_stack,
@@ -367,6 +377,7 @@ class OptimizingCompiler FINAL : public Compiler {
                             const DexCompilationUnit& dex_compilation_unit,
                             ArtMethod* method,
                             bool osr,
+                            bool baseline,
                             VariableSizedHandleScope* handles) const;
 
   CodeGenerator* TryCompileIntrinsic(ArenaAllocator* allocator,
@@ -696,6 +707,26 @@ void OptimizingCompiler::RunOptimizations(HGraph* graph,
   RunArchOptimizations(graph, codegen, dex_compilation_unit, pass_observer, handles);
 }
 
+void OptimizingCompiler::RunBaselineOptimizations(HGraph* graph,
+                                                  CodeGenerator* codegen,
+                                                  const DexCompilationUnit& dex_compilation_unit,
+                                                  PassObserver* pass_observer,
+                                                  VariableSizedHandleScope* handles) const {
+  OptimizationDef optimizations[] = {
+    OptDef(OptimizationPass::kIntrinsicsRecognizer),
+    OptDef(OptimizationPass::kSharpening),
+    OptDef(OptimizationPass::kInstructionSimplifier, "instruction_simplifier$baseline"),
+  };
+  RunOptimizations(graph,
+                   codegen,
+                   dex_compilation_unit,
+                   pass_observer,
+                   handles,
+                   optimizations);
+
+  RunArchOptimizations(graph, codegen, dex_compilation_unit, pass_observer, handles);
+}
+
 static ArenaVector<linker::LinkerPatch> EmitAndSortLinkerPatches(CodeGenerator* codegen) {
   ArenaVector<linker::LinkerPatch> linker_patches(codegen->GetGraph()->GetAllocator()->Adapter());
   codegen->EmitLinkerPatches(&linker_patches);
@@ -749,6 +780,7 @@ CodeGenerator* OptimizingCompiler::TryCompile(ArenaAllocator* allocator,
                                               const DexCompilationUnit& dex_compilation_unit,
                                               ArtMethod* method,
                                               bool osr,
+                                              bool baseline,
                                               VariableSizedHandleScope* handles) const {
   MaybeRecordStat(compilation_stats_.get(), MethodCompilationStat::kAttemptBytecodeCompilation);
   CompilerDriver* compiler_driver = GetCompilerDriver();
@@ -793,7 +825,8 @@ CodeGenerator* OptimizingCompiler::TryCompile(ArenaAllocator* allocator,
       compiler_driver->GetInstructionSet(),
       kInvalidInvokeType,
       compiler_driver->GetCompilerOptions().GetDebuggable(),
-      osr);
+      osr,
+      baseline);
 
   ArrayRef<const uint8_t> interpreter_metadata;
   // For AOT compilation, we may not get a method, for example if its class is erroneous.
@@ -867,11 +900,19 @@ CodeGenerator* OptimizingCompiler::TryCompile(ArenaAllocator* allocator,
     }
   }
 
-  RunOptimizations(graph,
-                   codegen.get(),
-                   dex_compilation_unit,
-                   &pass_observer,
-                   handles);
+  if (baseline) {
+    RunBaselineOptimizations(graph,
+                             codegen.get(),
+                             dex_compilation_unit,
+                             &pass_observer,
+                             handles);
+  } else {
+    RunOptimizations(graph,
+                     codegen.get(),
+                     dex_compilation_unit,
+                     &pass_observer,
+                     handles);
+  }
 
   RegisterAllocator::Strategy regalloc_strategy =
     compiler_options.GetRegisterAllocationStrategy();
@@ -1052,6 +1093,7 @@ CompiledMethod* OptimizingCompiler::Compile(const DexFile::CodeItem* code_item,
                        dex_compilation_unit,
                        method,
                        /* osr */ false,
+                       /* baseline */ false,
                        &handles));
       }
     }
@@ -1215,6 +1257,7 @@ bool OptimizingCompiler::JitCompile(Thread* self,
                                     jit::JitCodeCache* code_cache,
                                     ArtMethod* method,
                                     bool osr,
+                                    bool baseline,
                                     jit::JitLogger* jit_logger) {
   StackHandleScope<3> hs(self);
   Handle<mirror::ClassLoader> class_loader(hs.NewHandle(
@@ -1313,6 +1356,7 @@ bool OptimizingCompiler::JitCompile(Thread* self,
                    dex_compilation_unit,
                    method,
                    osr,
+                   baseline,
                    &handles));
     if (codegen.get() == nullptr) {
       return false;
@@ -82,6 +82,7 @@ enum class MethodCompilationStat {
   kNotInlinedStackMaps,
   kNotInlinedEnvironmentBudget,
   kNotInlinedInstructionBudget,
+  kNotInlinedColdCallSite,
   kNotInlinedLoopWithoutExit,
   kNotInlinedIrreducibleLoop,
   kNotInlinedAlwaysThrows,
@@ -100,6 +101,9 @@ enum class MethodCompilationStat {
   kConstructorFenceRemovedPFRA,
   kConstructorFenceRemovedCFRE,
   kJitOutOfMemoryForCommit,
+  kInlinedHotCallSite,
+  kInlineCacheDeoptimizedBefore,
+  kPrunedUntakenBranch,
   kLastStat
 };
 std::ostream& operator<<(std::ostream& os, const MethodCompilationStat& rhs);
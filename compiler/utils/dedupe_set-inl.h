@@ -20,19 +20,105 @@
 #include "dedupe_set.h"
 
 #include <inttypes.h>
+#include <sched.h>
+#include <string.h>
 
 #include <algorithm>
-#include <unordered_map>
 
 #include "android-base/stringprintf.h"
 
-#include "base/hash_set.h"
-#include "base/mutex.h"
-#include "base/stl_util.h"
+#include "base/bit_utils.h"
+#include "base/globals.h"
 #include "base/time_utils.h"
 
 namespace art {
 
+// XXH64 with a seed of 0. The four independent accumulators consume 32 bytes per iteration, so
+// the loop is not bound by the latency of a single multiply chain.
+class XxHash64 {
+ public:
+  static uint64_t Hash(const uint8_t* data, size_t len) {
+    const uint8_t* const end = data + len;
+    uint64_t hash;
+    if (len >= 32u) {
+      uint64_t acc1 = kPrime1 + kPrime2;
+      uint64_t acc2 = kPrime2;
+      uint64_t acc3 = 0u;
+      uint64_t acc4 = 0u - kPrime1;
+      for (const uint8_t* limit = end - 32u; data <= limit; data += 32u) {
+        acc1 = Round(acc1, Read64(data));
+        acc2 = Round(acc2, Read64(data + 8u));
+        acc3 = Round(acc3, Read64(data + 16u));
+        acc4 = Round(acc4, Read64(data + 24u));
+      }
+      hash = RotateLeft(acc1, 1) + RotateLeft(acc2, 7) + RotateLeft(acc3, 12) +
+          RotateLeft(acc4, 18);
+      hash = MergeRound(hash, acc1);
+      hash = MergeRound(hash, acc2);
+      hash = MergeRound(hash, acc3);
+      hash = MergeRound(hash, acc4);
+    } else {
+      hash = kPrime5;
+    }
+    hash += len;
+
+    for (; data + 8u <= end; data += 8u) {
+      hash ^= Round(0u, Read64(data));
+      hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (data + 4u <= end) {
+      hash ^= static_cast<uint64_t>(Read32(data)) * kPrime1;
+      hash = RotateLeft(hash, 23) * kPrime2 + kPrime3;
+      data += 4u;
+    }
+    for (; data != end; ++data) {
+      hash ^= *data * kPrime5;
+      hash = RotateLeft(hash, 11) * kPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+  }
+
+ private:
+  static constexpr uint64_t kPrime1 = UINT64_C(0x9e3779b185ebca87);
+  static constexpr uint64_t kPrime2 = UINT64_C(0xc2b2ae3d27d4eb4f);
+  static constexpr uint64_t kPrime3 = UINT64_C(0x165667b19e3779f9);
+  static constexpr uint64_t kPrime4 = UINT64_C(0x85ebca77c2b2ae63);
+  static constexpr uint64_t kPrime5 = UINT64_C(0x27d4eb2f165667c5);
+
+  static uint64_t RotateLeft(uint64_t value, int shift) {
+    return (value << shift) | (value >> (64 - shift));
+  }
+
+  static uint64_t Read64(const uint8_t* data) {
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+  }
+
+  static uint32_t Read32(const uint8_t* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+  }
+
+  static uint64_t Round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    acc = RotateLeft(acc, 31);
+    return acc * kPrime1;
+  }
+
+  static uint64_t MergeRound(uint64_t hash, uint64_t acc) {
+    hash ^= Round(0u, acc);
+    return hash * kPrime1 + kPrime4;
+  }
+};
+
 template <typename InKey,
           typename StoreKey,
           typename Alloc,
@@ -40,10 +126,12 @@ template <typename InKey,
           typename HashFunc,
           HashType kShard>
 struct DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::Stats {
-  size_t collision_sum = 0u;
-  size_t collision_max = 0u;
-  size_t total_probe_distance = 0u;
   size_t total_size = 0u;
+  size_t total_buckets = 0u;
+  size_t collision_sum = 0u;
+  size_t chain_max = 0u;
+  size_t deduped_keys = 0u;
+  size_t deduped_bytes = 0u;
 };
 
 template <typename InKey,
@@ -54,130 +142,223 @@ template <typename InKey,
           HashType kShard>
 class DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::Shard {
  public:
-  Shard(const Alloc& alloc, const std::string& lock_name)
+  explicit Shard(const Alloc& alloc)
       : alloc_(alloc),
-        lock_name_(lock_name),
-        lock_(lock_name_.c_str()),
-        keys_() {
+        table_(new Table(kInitialBuckets, /* previous */ nullptr)),
+        size_(0u),
+        growing_(false),
+        deduped_keys_(0u),
+        deduped_bytes_(0u) {
   }
 
   ~Shard() {
-    for (const HashedKey<StoreKey>& key : keys_) {
-      DCHECK(key.Key() != nullptr);
-      alloc_.Destroy(key.Key());
-    }
-  }
-
-  const StoreKey* Add(Thread* self, size_t hash, const InKey& in_key) REQUIRES(!lock_) {
-    MutexLock lock(self, lock_);
-    HashedKey<InKey> hashed_in_key(hash, &in_key);
-    auto it = keys_.Find(hashed_in_key);
-    if (it != keys_.end()) {
-      DCHECK(it->Key() != nullptr);
-      return it->Key();
-    }
-    const StoreKey* store_key = alloc_.Copy(in_key);
-    keys_.Insert(HashedKey<StoreKey> { hash, store_key });
-    return store_key;
-  }
-
-  void UpdateStats(Thread* self, Stats* global_stats) REQUIRES(!lock_) {
-    // HashSet<> doesn't keep entries ordered by hash, so we actually allocate memory
-    // for bookkeeping while collecting the stats.
-    std::unordered_map<HashType, size_t> stats;
-    {
-      MutexLock lock(self, lock_);
-      // Note: The total_probe_distance will be updated with the current state.
-      // It may have been higher before a re-hash.
-      global_stats->total_probe_distance += keys_.TotalProbeDistance();
-      global_stats->total_size += keys_.Size();
-      for (const HashedKey<StoreKey>& key : keys_) {
-        auto it = stats.find(key.Hash());
-        if (it == stats.end()) {
-          stats.insert({key.Hash(), 1u});
-        } else {
-          ++it->second;
+    // Every key is in the current table exactly once. Older tables only share its keys.
+    Table* table = table_.LoadRelaxed();
+    for (size_t i = 0; i != table->NumBuckets(); ++i) {
+      for (const Node* node = table->Head(i); node != nullptr; node = node->next.LoadRelaxed()) {
+        alloc_.Destroy(node->key);
+      }
+    }
+    while (table != nullptr) {
+      Table* previous = table->Previous();
+      delete table;
+      table = previous;
+    }
+  }
+
+  const StoreKey* Add(size_t hash, const InKey& in_key) {
+    Node* new_node = nullptr;
+    while (true) {
+      Table* table = table_.LoadAcquire();
+      Atomic<Node*>* bucket = table->Bucket(hash);
+      Node* head = bucket->LoadAcquire();
+      if (IsFrozen(head)) {
+        // The table is being replaced by a bigger one, insert there once it is published.
+        while (table_.LoadAcquire() == table) {
+          sched_yield();
+        }
+        continue;
+      }
+      const StoreKey* store_key = Find(head, hash, in_key);
+      if (store_key != nullptr) {
+        if (new_node != nullptr) {
+          // Another thread inserted the same key after our previous attempt.
+          alloc_.Destroy(new_node->key);
+          delete new_node;
         }
+        deduped_keys_.FetchAndAddRelaxed(1u);
+        deduped_bytes_.FetchAndAddRelaxed(in_key.size() * sizeof(typename InKey::value_type));
+        return store_key;
+      }
+      if (new_node == nullptr) {
+        new_node = new Node(hash, alloc_.Copy(in_key));
+      }
+      new_node->next.StoreRelaxed(head);
+      // The bucket still starting with `head` means that nobody inserted the key since we looked.
+      if (bucket->CompareAndSetStrongRelease(head, new_node)) {
+        size_t size = size_.FetchAndAddRelaxed(1u) + 1u;
+        if (size > table->NumBuckets() * kMaxLoadFactor) {
+          Grow(table);
+        }
+        return new_node->key;
       }
     }
-    for (const auto& entry : stats) {
-      size_t number_of_entries = entry.second;
-      if (number_of_entries > 1u) {
-        global_stats->collision_sum += number_of_entries - 1u;
-        global_stats->collision_max = std::max(global_stats->collision_max, number_of_entries);
+  }
+
+  void UpdateStats(Stats* global_stats) const {
+    const Table* table = table_.LoadAcquire();
+    global_stats->total_size += size_.LoadRelaxed();
+    global_stats->total_buckets += table->NumBuckets();
+    global_stats->deduped_keys += deduped_keys_.LoadRelaxed();
+    global_stats->deduped_bytes += deduped_bytes_.LoadRelaxed();
+    for (size_t i = 0; i != table->NumBuckets(); ++i) {
+      size_t chain_length = 0u;
+      for (const Node* node = table->Head(i); node != nullptr; node = node->next.LoadAcquire()) {
+        ++chain_length;
+        // Keys with equal hashes are in the same chain. Count all but one of them.
+        for (const Node* other = node->next.LoadAcquire();
+             other != nullptr;
+             other = other->next.LoadAcquire()) {
+          if (other->hash == node->hash) {
+            ++global_stats->collision_sum;
+            break;
+          }
+        }
       }
+      global_stats->chain_max = std::max(global_stats->chain_max, chain_length);
     }
   }
 
+  size_t GetDedupedBytes() const {
+    return deduped_bytes_.LoadRelaxed();
+  }
+
  private:
-  template <typename T>
-  class HashedKey {
-   public:
-    HashedKey() : hash_(0u), key_(nullptr) { }
-    HashedKey(size_t hash, const T* key) : hash_(hash), key_(key) { }
+  // Grow when the chains get longer than this on average.
+  static constexpr size_t kMaxLoadFactor = 2u;
+  static constexpr size_t kInitialBuckets = 64u;
+  static constexpr size_t kGrowthFactor = 4u;
 
-    size_t Hash() const {
-      return hash_;
-    }
+  struct Node {
+    Node(size_t h, const StoreKey* k) : hash(h), key(k), next(nullptr) { }
+
+    const size_t hash;
+    const StoreKey* const key;
+    Atomic<Node*> next;
+  };
+
+  // A frozen bucket has the low bit of its head set. Nothing can be inserted into it anymore.
+  static constexpr uintptr_t kFrozenBit = 1u;
+
+  static bool IsFrozen(Node* head) {
+    return (reinterpret_cast<uintptr_t>(head) & kFrozenBit) != 0u;
+  }
 
-    const T* Key() const {
-      return key_;
+  static Node* Freeze(Node* head) {
+    return reinterpret_cast<Node*>(reinterpret_cast<uintptr_t>(head) | kFrozenBit);
+  }
+
+  static Node* Unfreeze(Node* head) {
+    return reinterpret_cast<Node*>(reinterpret_cast<uintptr_t>(head) & ~kFrozenBit);
+  }
+
+  // Buckets of insert-only hash chains. Replaced tables are kept until the shard is destroyed,
+  // as other threads may still be reading them.
+  class Table {
+   public:
+    Table(size_t num_buckets, Table* previous)
+        : mask_(num_buckets - 1u),
+          buckets_(new Atomic<Node*>[num_buckets]),
+          previous_(previous) {
+      DCHECK(IsPowerOfTwo(num_buckets));
     }
 
-    bool IsEmpty() const {
-      return Key() == nullptr;
+    ~Table() {
+      for (size_t i = 0; i != NumBuckets(); ++i) {
+        Node* node = Head(i);
+        while (node != nullptr) {
+          Node* next = node->next.LoadRelaxed();
+          delete node;
+          node = next;
+        }
+      }
     }
 
-    void MakeEmpty() {
-      key_ = nullptr;
+    size_t NumBuckets() const {
+      return mask_ + 1u;
     }
 
-   private:
-    size_t hash_;
-    const T* key_;
-  };
+    Atomic<Node*>* Bucket(size_t hash) {
+      return &buckets_[hash & mask_];
+    }
 
-  class ShardEmptyFn {
-   public:
-    bool IsEmpty(const HashedKey<StoreKey>& key) const {
-      return key.IsEmpty();
+    Atomic<Node*>* BucketAt(size_t index) {
+      return &buckets_[index];
     }
 
-    void MakeEmpty(HashedKey<StoreKey>& key) {
-      key.MakeEmpty();
+    // The first node of the chain, whether or not the bucket is frozen.
+    Node* Head(size_t index) const {
+      return Unfreeze(buckets_[index].LoadAcquire());
     }
-  };
 
-  struct ShardHashFn {
-    template <typename T>
-    size_t operator()(const HashedKey<T>& key) const {
-      return key.Hash();
+    Table* Previous() const {
+      return previous_;
     }
+
+   private:
+    const size_t mask_;
+    const std::unique_ptr<Atomic<Node*>[]> buckets_;
+    Table* const previous_;
+
+    DISALLOW_COPY_AND_ASSIGN(Table);
   };
 
-  struct ShardPred {
-    typename std::enable_if<!std::is_same<StoreKey, InKey>::value, bool>::type
-    operator()(const HashedKey<StoreKey>& lhs, const HashedKey<StoreKey>& rhs) const {
-      DCHECK(lhs.Key() != nullptr);
-      DCHECK(rhs.Key() != nullptr);
-      // Rehashing: stored keys are already deduplicated, so we can simply compare key pointers.
-      return lhs.Key() == rhs.Key();
+  static const StoreKey* Find(const Node* head, size_t hash, const InKey& in_key) {
+    for (const Node* node = head; node != nullptr; node = node->next.LoadAcquire()) {
+      if (node->hash == hash &&
+          node->key->size() == in_key.size() &&
+          std::equal(in_key.begin(), in_key.end(), node->key->begin())) {
+        return node->key;
+      }
     }
+    return nullptr;
+  }
 
-    template <typename LeftT, typename RightT>
-    bool operator()(const HashedKey<LeftT>& lhs, const HashedKey<RightT>& rhs) const {
-      DCHECK(lhs.Key() != nullptr);
-      DCHECK(rhs.Key() != nullptr);
-      return lhs.Hash() == rhs.Hash() &&
-          lhs.Key()->size() == rhs.Key()->size() &&
-          std::equal(lhs.Key()->begin(), lhs.Key()->end(), rhs.Key()->begin());
+  // Replace `table` with a bigger copy. Freezing each bucket before copying its chain makes
+  // concurrent inserts into it fail and retry in the new table, so no key is ever lost or
+  // inserted twice.
+  void Grow(Table* table) {
+    if (!growing_.CompareAndSetStrongSequentiallyConsistent(false, true)) {
+      return;  // Another thread is growing the shard.
     }
-  };
+    if (table_.LoadRelaxed() == table) {
+      Table* new_table = new Table(table->NumBuckets() * kGrowthFactor, table);
+      for (size_t i = 0; i != table->NumBuckets(); ++i) {
+        Atomic<Node*>* bucket = table->BucketAt(i);
+        Node* head;
+        do {
+          head = bucket->LoadRelaxed();
+        } while (!bucket->CompareAndSetWeakAcquire(head, Freeze(head)));
+        for (const Node* node = head; node != nullptr; node = node->next.LoadRelaxed()) {
+          Atomic<Node*>* new_bucket = new_table->Bucket(node->hash);
+          Node* new_node = new Node(node->hash, node->key);
+          new_node->next.StoreRelaxed(new_bucket->LoadRelaxed());
+          new_bucket->StoreRelaxed(new_node);
+        }
+      }
+      table_.StoreRelease(new_table);
+    }
+    growing_.StoreRelease(false);
+  }
 
   Alloc alloc_;
-  const std::string lock_name_;
-  Mutex lock_;
-  HashSet<HashedKey<StoreKey>, ShardEmptyFn, ShardHashFn, ShardPred> keys_ GUARDED_BY(lock_);
+  Atomic<Table*> table_;
+  Atomic<size_t> size_;
+  Atomic<bool> growing_;
+  Atomic<size_t> deduped_keys_;
+  Atomic<size_t> deduped_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(Shard);
 };
 
 template <typename InKey,
@@ -187,7 +368,7 @@ template <typename InKey,
           typename HashFunc,
           HashType kShard>
 const StoreKey* DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::Add(
-    Thread* self, const InKey& key) {
+    const InKey& key) {
   uint64_t hash_start;
   if (kIsDebugBuild) {
     hash_start = NanoTime();
@@ -195,11 +376,11 @@ const StoreKey* DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::A
   HashType raw_hash = HashFunc()(key);
   if (kIsDebugBuild) {
     uint64_t hash_end = NanoTime();
-    hash_time_ += hash_end - hash_start;
+    hash_time_.FetchAndAddRelaxed(hash_end - hash_start);
   }
   HashType shard_hash = raw_hash / kShard;
   HashType shard_bin = raw_hash % kShard;
-  return shards_[shard_bin]->Add(self, shard_hash, key);
+  return shards_[shard_bin]->Add(shard_hash, key);
 }
 
 template <typename InKey,
@@ -208,13 +389,10 @@ template <typename InKey,
           typename HashType,
           typename HashFunc,
           HashType kShard>
-DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::DedupeSet(const char* set_name,
-                                                                         const Alloc& alloc)
-    : hash_time_(0) {
+DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::DedupeSet(const Alloc& alloc)
+    : hash_time_(0u) {
   for (HashType i = 0; i < kShard; ++i) {
-    std::ostringstream oss;
-    oss << set_name << " lock " << i;
-    shards_[i].reset(new Shard(alloc, oss.str()));
+    shards_[i].reset(new Shard(alloc));
   }
 }
 
@@ -234,19 +412,35 @@ template <typename InKey,
           typename HashType,
           typename HashFunc,
           HashType kShard>
-std::string DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::DumpStats(
-    Thread* self) const {
+size_t DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::GetDedupedBytes() const {
+  size_t deduped_bytes = 0u;
+  for (HashType shard = 0; shard < kShard; ++shard) {
+    deduped_bytes += shards_[shard]->GetDedupedBytes();
+  }
+  return deduped_bytes;
+}
+
+template <typename InKey,
+          typename StoreKey,
+          typename Alloc,
+          typename HashType,
+          typename HashFunc,
+          HashType kShard>
+std::string DedupeSet<InKey, StoreKey, Alloc, HashType, HashFunc, kShard>::DumpStats() const {
   Stats stats;
   for (HashType shard = 0; shard < kShard; ++shard) {
-    shards_[shard]->UpdateStats(self, &stats);
+    shards_[shard]->UpdateStats(&stats);
   }
-  return android::base::StringPrintf("%zu collisions, %zu max hash collisions, "
-                                     "%zu/%zu probe distance, %" PRIu64 " ns hash time",
-                                     stats.collision_sum,
-                                     stats.collision_max,
-                                     stats.total_probe_distance,
+  return android::base::StringPrintf("%zu entries, %zu deduplicated (%zu bytes), "
+                                     "%zu collisions, %zu max chain length, %zu buckets, "
+                                     "%" PRIu64 " ns hash time",
                                      stats.total_size,
-                                     hash_time_);
+                                     stats.deduped_keys,
+                                     stats.deduped_bytes,
+                                     stats.collision_sum,
+                                     stats.chain_max,
+                                     stats.total_buckets,
+                                     hash_time_.LoadRelaxed());
 }
 
 
@@ -21,15 +21,15 @@
 #include <memory>
 #include <string>
 
+#include "base/atomic.h"
 #include "base/macros.h"
 
 namespace art {
 
-class Thread;
-
 // A set of Keys that support a HashFunc returning HashType. Used to find duplicates of Key in the
-// Add method. The data-structure is thread-safe through the use of internal locks, it also
-// supports the lock being sharded.
+// Add method. The data-structure is thread-safe without locks: keys are inserted into hash chains
+// with a compare-and-swap of the bucket head. Only a shard that is growing makes concurrent Adds
+// to it wait. Keys are sharded by hash so that shards grow independently.
 template <typename InKey,
           typename StoreKey,
           typename Alloc,
@@ -39,20 +39,23 @@ template <typename InKey,
 class DedupeSet {
  public:
   // Add a new key to the dedupe set if not present. Return the equivalent deduplicated stored key.
-  const StoreKey* Add(Thread* self, const InKey& key);
+  const StoreKey* Add(const InKey& key);
 
-  DedupeSet(const char* set_name, const Alloc& alloc);
+  explicit DedupeSet(const Alloc& alloc);
 
   ~DedupeSet();
 
-  std::string DumpStats(Thread* self) const;
+  // The number of bytes that Add() calls found already stored.
+  size_t GetDedupedBytes() const;
+
+  std::string DumpStats() const;
 
  private:
   struct Stats;
   class Shard;
 
   std::unique_ptr<Shard> shards_[kShard];
-  uint64_t hash_time_;
+  Atomic<uint64_t> hash_time_;
 
   DISALLOW_COPY_AND_ASSIGN(DedupeSet);
 };
@@ -16,14 +16,17 @@
 
 #include "dedupe_set.h"
 
+#include <pthread.h>
+#include <string.h>
+
 #include <algorithm>
 #include <cstdio>
+#include <set>
 #include <vector>
 
 #include "base/array_ref.h"
 #include "dedupe_set-inl.h"
 #include "gtest/gtest.h"
-#include "thread-current-inl.h"
 
 namespace art {
 
@@ -52,18 +55,17 @@ class DedupeSetTestAlloc {
 };
 
 TEST(DedupeSetTest, Test) {
-  Thread* self = Thread::Current();
   DedupeSetTestAlloc alloc;
   DedupeSet<ArrayRef<const uint8_t>,
             std::vector<uint8_t>,
             DedupeSetTestAlloc,
             size_t,
-            DedupeSetTestHashFunc> deduplicator("test", alloc);
+            DedupeSetTestHashFunc> deduplicator(alloc);
   const std::vector<uint8_t>* array1;
   {
     uint8_t raw_test1[] = { 10u, 20u, 30u, 45u };
     ArrayRef<const uint8_t> test1(raw_test1);
-    array1 = deduplicator.Add(self, test1);
+    array1 = deduplicator.Add(test1);
     ASSERT_NE(array1, nullptr);
     ASSERT_TRUE(std::equal(test1.begin(), test1.end(), array1->begin()));
   }
@@ -72,7 +74,7 @@ TEST(DedupeSetTest, Test) {
   {
     uint8_t raw_test2[] = { 10u, 20u, 30u, 45u };
     ArrayRef<const uint8_t> test2(raw_test2);
-    array2 = deduplicator.Add(self, test2);
+    array2 = deduplicator.Add(test2);
     ASSERT_EQ(array2, array1);
     ASSERT_TRUE(std::equal(test2.begin(), test2.end(), array2->begin()));
   }
@@ -81,11 +83,112 @@ TEST(DedupeSetTest, Test) {
   {
     uint8_t raw_test3[] = { 10u, 22u, 30u, 47u };
     ArrayRef<const uint8_t> test3(raw_test3);
-    array3 = deduplicator.Add(self, test3);
+    array3 = deduplicator.Add(test3);
     ASSERT_NE(array3, nullptr);
     ASSERT_NE(array3, array1);
     ASSERT_TRUE(std::equal(test3.begin(), test3.end(), array3->begin()));
   }
 }
 
+TEST(DedupeSetTest, Grow) {
+  DedupeSetTestAlloc alloc;
+  DedupeSet<ArrayRef<const uint8_t>,
+            std::vector<uint8_t>,
+            DedupeSetTestAlloc,
+            size_t,
+            DedupeSetTestHashFunc,
+            4> deduplicator(alloc);
+  // Enough keys to grow every shard several times.
+  static constexpr size_t kNumKeys = 10000u;
+  std::vector<const std::vector<uint8_t>*> stored;
+  for (size_t i = 0; i != kNumKeys; ++i) {
+    uint8_t raw_key[] = { static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8), 1u, 2u };
+    stored.push_back(deduplicator.Add(ArrayRef<const uint8_t>(raw_key)));
+  }
+  EXPECT_EQ(0u, deduplicator.GetDedupedBytes());
+  // Keys added before the shards grew are still found.
+  for (size_t i = 0; i != kNumKeys; ++i) {
+    uint8_t raw_key[] = { static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8), 1u, 2u };
+    ASSERT_EQ(stored[i], deduplicator.Add(ArrayRef<const uint8_t>(raw_key)));
+  }
+  EXPECT_EQ(kNumKeys * 4u, deduplicator.GetDedupedBytes());
+}
+
+using ConcurrentDedupeSet = DedupeSet<ArrayRef<const uint8_t>,
+                                      std::vector<uint8_t>,
+                                      DedupeSetTestAlloc,
+                                      size_t,
+                                      DedupeSetTestHashFunc,
+                                      4>;
+
+static constexpr size_t kConcurrentKeys = 20000u;
+static constexpr size_t kConcurrentKeySize = 4u;
+
+struct ConcurrentAddArgs {
+  ConcurrentDedupeSet* deduplicator;
+  size_t first_key;
+  std::vector<const std::vector<uint8_t>*> stored;
+};
+
+static void* ConcurrentAddCallback(void* arg) {
+  ConcurrentAddArgs* args = reinterpret_cast<ConcurrentAddArgs*>(arg);
+  args->stored.resize(kConcurrentKeys);
+  for (size_t n = 0; n != kConcurrentKeys; ++n) {
+    size_t i = (args->first_key + n) % kConcurrentKeys;
+    uint8_t raw_key[kConcurrentKeySize] = {
+        static_cast<uint8_t>(i), static_cast<uint8_t>(i >> 8), static_cast<uint8_t>(i >> 16), 3u };
+    args->stored[i] = args->deduplicator->Add(ArrayRef<const uint8_t>(raw_key));
+  }
+  return nullptr;
+}
+
+TEST(DedupeSetTest, ConcurrentAdd) {
+  DedupeSetTestAlloc alloc;
+  ConcurrentDedupeSet deduplicator(alloc);
+  // Every thread adds all keys while the shards grow. Threads starting at the same key race to
+  // insert the same keys, the two groups meet in the middle.
+  static constexpr size_t kNumThreads = 8u;
+  ConcurrentAddArgs args[kNumThreads];
+  pthread_t threads[kNumThreads];
+  for (size_t t = 0; t != kNumThreads; ++t) {
+    args[t].deduplicator = &deduplicator;
+    args[t].first_key = (t % 2u) * (kConcurrentKeys / 2u);
+    ASSERT_EQ(0, pthread_create(&threads[t], nullptr, ConcurrentAddCallback, &args[t]));
+  }
+  for (size_t t = 0; t != kNumThreads; ++t) {
+    ASSERT_EQ(0, pthread_join(threads[t], nullptr));
+  }
+
+  // Equal keys map to one stored key, different keys to different ones.
+  std::set<const std::vector<uint8_t>*> unique_stored;
+  for (size_t i = 0; i != kConcurrentKeys; ++i) {
+    const std::vector<uint8_t>* stored = args[0].stored[i];
+    ASSERT_NE(stored, nullptr);
+    ASSERT_EQ(kConcurrentKeySize, stored->size());
+    EXPECT_EQ(static_cast<uint8_t>(i), (*stored)[0]);
+    EXPECT_EQ(static_cast<uint8_t>(i >> 8), (*stored)[1]);
+    EXPECT_EQ(static_cast<uint8_t>(i >> 16), (*stored)[2]);
+    for (size_t t = 1; t != kNumThreads; ++t) {
+      ASSERT_EQ(stored, args[t].stored[i]) << "key " << i << " thread " << t;
+    }
+    unique_stored.insert(stored);
+  }
+  EXPECT_EQ(kConcurrentKeys, unique_stored.size());
+  // Only the first Add of each key stores it, all the others are deduplicated.
+  EXPECT_EQ((kNumThreads - 1u) * kConcurrentKeys * kConcurrentKeySize,
+            deduplicator.GetDedupedBytes());
+}
+
+TEST(DedupeSetTest, XxHash64) {
+  // Reference values of XXH64 with a seed of 0.
+  auto hash = [](const char* data) {
+    return XxHash64::Hash(reinterpret_cast<const uint8_t*>(data), strlen(data));
+  };
+  EXPECT_EQ(UINT64_C(0xef46db3751d8e999), hash(""));
+  EXPECT_EQ(UINT64_C(0xd24ec4f1a98c6e5b), hash("a"));
+  EXPECT_EQ(UINT64_C(0x44bc2cf5ad770999), hash("abc"));
+  // Long enough for the 32 byte loop, followed by the 4 and 1 byte tails.
+  EXPECT_EQ(UINT64_C(0xfbcea83c8a378bf1), hash("Nobody inspects the spammish repetition"));
+}
+
 }  // namespace art
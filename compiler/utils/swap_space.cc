@@ -19,7 +19,6 @@
 #include <sys/mman.h>
 
 #include <algorithm>
-#include <numeric>
 
 #include "base/bit_utils.h"
 #include "base/macros.h"
@@ -31,154 +30,121 @@ namespace art {
 // The chunk size by which the swap file is increased and mapped.
 static constexpr size_t kMininumMapSize = 16 * MB;
 
-static constexpr bool kCheckFreeMaps = false;
-
-template <typename FreeBySizeSet>
-static void DumpFreeMap(const FreeBySizeSet& free_by_size) {
-  size_t last_size = static_cast<size_t>(-1);
-  for (const auto& entry : free_by_size) {
-    if (last_size != entry.size) {
-      last_size = entry.size;
-      LOG(INFO) << "Size " << last_size;
-    }
-    LOG(INFO) << "  0x" << std::hex << entry.free_by_start_entry->Start()
-        << " size=" << std::dec << entry.free_by_start_entry->size;
-  }
-}
-
-void SwapSpace::RemoveChunk(FreeBySizeSet::const_iterator free_by_size_pos) {
-  auto free_by_start_pos = free_by_size_pos->free_by_start_entry;
-  free_by_size_.erase(free_by_size_pos);
-  free_by_start_.erase(free_by_start_pos);
-}
-
-inline void SwapSpace::InsertChunk(const SpaceChunk& chunk) {
-  DCHECK_NE(chunk.size, 0u);
-  auto insert_result = free_by_start_.insert(chunk);
-  DCHECK(insert_result.second);
-  free_by_size_.emplace(chunk.size, insert_result.first);
-}
-
 SwapSpace::SwapSpace(int fd, size_t initial_size)
     : fd_(fd),
-      size_(0),
+      size_(0u),
+      freed_size_(0u),
+      chunk_pos_(nullptr),
+      chunk_end_(nullptr),
       lock_("SwapSpace lock", static_cast<LockLevel>(LockLevel::kDefaultMutexLevel - 1)) {
   // Assume that the file is unlinked.
 
-  InsertChunk(NewFileChunk(initial_size));
+  MutexLock lock(Thread::Current(), lock_);
+  MapFileChunk(initial_size);
 }
 
 SwapSpace::~SwapSpace() {
-  // Unmap all mmapped chunks. Nothing should be allocated anymore at
-  // this point, so there should be only full size chunks in free_by_start_.
-  for (const SpaceChunk& chunk : free_by_start_) {
-    if (munmap(chunk.ptr, chunk.size) != 0) {
+  // Unmap all mmapped chunks. Nothing should be used anymore at this point.
+  for (const std::pair<uint8_t*, size_t>& chunk : chunks_) {
+    if (munmap(chunk.first, chunk.second) != 0) {
       PLOG(ERROR) << "Failed to unmap swap space chunk at "
-          << static_cast<const void*>(chunk.ptr) << " size=" << chunk.size;
+          << static_cast<const void*>(chunk.first) << " size=" << chunk.second;
     }
   }
   // All arenas are backed by the same file. Just close the descriptor.
   close(fd_);
 }
 
-template <typename FreeByStartSet, typename FreeBySizeSet>
-static size_t CollectFree(const FreeByStartSet& free_by_start, const FreeBySizeSet& free_by_size) {
-  if (free_by_start.size() != free_by_size.size()) {
-    LOG(FATAL) << "Size: " << free_by_start.size() << " vs " << free_by_size.size();
-  }
-
-  // Calculate over free_by_size.
-  size_t sum1 = 0;
-  for (const auto& entry : free_by_size) {
-    sum1 += entry.free_by_start_entry->size;
-  }
-
-  // Calculate over free_by_start.
-  size_t sum2 = 0;
-  for (const auto& entry : free_by_start) {
-    sum2 += entry.size;
-  }
+inline Atomic<SwapSpace::Segment*>& SwapSpace::GetSegmentSlot() {
+  // Compiler threads have consecutive tids, so they rarely share a slot. Threads that are
+  // not attached to the runtime all use the first one.
+  Thread* self = Thread::Current();
+  size_t index = (self != nullptr) ? static_cast<size_t>(self->GetTid()) % kNumSegmentSlots : 0u;
+  return segments_[index];
+}
 
-  if (sum1 != sum2) {
-    LOG(FATAL) << "Sum: " << sum1 << " vs " << sum2;
+inline void* SwapSpace::AllocFromSegment(Segment* segment, size_t size) {
+  size_t used = segment->used.LoadRelaxed();
+  while (size <= segment->size - used) {
+    if (segment->used.CompareAndSetWeakRelaxed(used, used + size)) {
+      return segment->begin + used;
+    }
+    used = segment->used.LoadRelaxed();
   }
-  return sum1;
+  return nullptr;
 }
 
 void* SwapSpace::Alloc(size_t size) {
-  MutexLock lock(Thread::Current(), lock_);
+  return Alloc(size, GetSegmentSlot());
+}
+
+void* SwapSpace::Alloc(size_t size, Atomic<Segment*>& slot) {
   size = RoundUp(size, 8U);
 
-  // Check the free list for something that fits.
-  // TODO: Smarter implementation. Global biggest chunk, ...
-  auto it = free_by_start_.empty()
-      ? free_by_size_.end()
-      : free_by_size_.lower_bound(FreeBySizeEntry { size, free_by_start_.begin() });
-  if (it != free_by_size_.end()) {
-    auto entry = it->free_by_start_entry;
-    SpaceChunk old_chunk = *entry;
-    if (old_chunk.size == size) {
-      RemoveChunk(it);
-    } else {
-      // Try to avoid deallocating and allocating the std::set<> nodes.
-      // This would be much simpler if we could use replace() from Boost.Bimap.
-
-      // The free_by_start_ map contains disjoint intervals ordered by the `ptr`.
-      // Shrinking the interval does not affect the ordering.
-      it->free_by_start_entry->ptr += size;
-      it->free_by_start_entry->size -= size;
-
-      // The free_by_size_ map is ordered by the `size` and then `free_by_start_entry->ptr`.
-      // Adjusting the `ptr` above does not change that ordering but decreasing `size` can
-      // push the node before the previous node(s).
-      if (it == free_by_size_.begin()) {
-        it->size -= size;
-      } else {
-        auto prev = it;
-        --prev;
-        FreeBySizeEntry new_value(old_chunk.size - size, entry);
-        if (free_by_size_.key_comp()(*prev, new_value)) {
-          it->size -= size;
-        } else {
-          // Changing in place would break the std::set<> ordering, we need to remove and insert.
-          free_by_size_.erase(it);
-          free_by_size_.insert(new_value);
+  if (size <= kMaxSegmentAllocationSize) {
+    while (true) {
+      Segment* segment = slot.LoadAcquire();
+      if (segment != nullptr) {
+        void* result = AllocFromSegment(segment, size);
+        if (result != nullptr) {
+          return result;
         }
       }
+      MutexLock lock(Thread::Current(), lock_);
+      // Another thread sharing the slot may have replaced the exhausted segment already.
+      if (slot.LoadRelaxed() == segment) {
+        all_segments_.emplace_back(new Segment(AllocRegion(kSegmentSize), kSegmentSize));
+        slot.StoreRelease(all_segments_.back().get());
+      }
     }
-    return old_chunk.ptr;
-  } else {
-    // Not a big enough free chunk, need to increase file size.
-    SpaceChunk new_chunk = NewFileChunk(size);
-    if (new_chunk.size != size) {
-      // Insert the remainder.
-      SpaceChunk remainder = { new_chunk.ptr + size, new_chunk.size - size };
-      InsertChunk(remainder);
+  }
+
+  MutexLock lock(Thread::Current(), lock_);
+  return AllocRegion(size);
+}
+
+uint8_t* SwapSpace::AllocRegion(size_t size) {
+  if (static_cast<size_t>(chunk_end_ - chunk_pos_) < size) {
+    if (size >= kMininumMapSize / 4) {
+      // Map a chunk just for this allocation rather than abandon the rest of the current one.
+      uint8_t* saved_pos = chunk_pos_;
+      uint8_t* saved_end = chunk_end_;
+      MapFileChunk(RoundUp(size, kPageSize));
+      uint8_t* result = chunk_pos_;
+      chunk_pos_ = saved_pos;
+      chunk_end_ = saved_end;
+      return result;
     }
-    return new_chunk.ptr;
+    MapFileChunk(size);
   }
+  uint8_t* result = chunk_pos_;
+  chunk_pos_ += size;
+  return result;
 }
 
-SwapSpace::SpaceChunk SwapSpace::NewFileChunk(size_t min_size) {
+void SwapSpace::MapFileChunk(size_t min_size) {
 #if !defined(__APPLE__)
-  size_t next_part = std::max(RoundUp(min_size, kPageSize), RoundUp(kMininumMapSize, kPageSize));
-  int result = TEMP_FAILURE_RETRY(ftruncate64(fd_, size_ + next_part));
+  size_t current_size = size_.LoadRelaxed();
+  size_t next_part = (min_size >= kMininumMapSize / 4)
+      ? RoundUp(min_size, kPageSize)
+      : RoundUp(kMininumMapSize, kPageSize);
+  int result = TEMP_FAILURE_RETRY(ftruncate64(fd_, current_size + next_part));
   if (result != 0) {
     PLOG(FATAL) << "Unable to increase swap file.";
   }
   uint8_t* ptr = reinterpret_cast<uint8_t*>(
-      mmap(nullptr, next_part, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, size_));
+      mmap(nullptr, next_part, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, current_size));
   if (ptr == MAP_FAILED) {
     LOG(ERROR) << "Unable to mmap new swap file chunk.";
-    LOG(ERROR) << "Current size: " << size_ << " requested: " << next_part << "/" << min_size;
-    LOG(ERROR) << "Free list:";
-    DumpFreeMap(free_by_size_);
-    LOG(ERROR) << "In free list: " << CollectFree(free_by_start_, free_by_size_);
+    LOG(ERROR) << "Current size: " << current_size << " requested: " << next_part << "/"
+        << min_size;
+    LOG(ERROR) << "Freed: " << freed_size_.LoadRelaxed();
     LOG(FATAL) << "Aborting...";
   }
-  size_ += next_part;
-  SpaceChunk new_chunk = {ptr, next_part};
-  return new_chunk;
+  size_.StoreRelaxed(current_size + next_part);
+  chunks_.emplace_back(ptr, next_part);
+  chunk_pos_ = ptr;
+  chunk_end_ = ptr + next_part;
 #else
   UNUSED(min_size, kMininumMapSize);
   LOG(FATAL) << "No swap file support on the Mac.";
@@ -186,53 +152,26 @@ SwapSpace::SpaceChunk SwapSpace::NewFileChunk(size_t min_size) {
 #endif
 }
 
-// TODO: Full coalescing.
 void SwapSpace::Free(void* ptr, size_t size) {
-  MutexLock lock(Thread::Current(), lock_);
-  size = RoundUp(size, 8U);
-
-  size_t free_before = 0;
-  if (kCheckFreeMaps) {
-    free_before = CollectFree(free_by_start_, free_by_size_);
-  }
-
-  SpaceChunk chunk = { reinterpret_cast<uint8_t*>(ptr), size };
-  auto it = free_by_start_.lower_bound(chunk);
-  if (it != free_by_start_.begin()) {
-    auto prev = it;
-    --prev;
-    CHECK_LE(prev->End(), chunk.Start());
-    if (prev->End() == chunk.Start()) {
-      // Merge *prev with this chunk.
-      chunk.size += prev->size;
-      chunk.ptr -= prev->size;
-      auto erase_pos = free_by_size_.find(FreeBySizeEntry { prev->size, prev });
-      DCHECK(erase_pos != free_by_size_.end());
-      RemoveChunk(erase_pos);
-      // "prev" is invalidated but "it" remains valid.
-    }
-  }
-  if (it != free_by_start_.end()) {
-    CHECK_LE(chunk.End(), it->Start());
-    if (chunk.End() == it->Start()) {
-      // Merge *it with this chunk.
-      chunk.size += it->size;
-      auto erase_pos = free_by_size_.find(FreeBySizeEntry { it->size, it });
-      DCHECK(erase_pos != free_by_size_.end());
-      RemoveChunk(erase_pos);
-      // "it" is invalidated but we don't need it anymore.
-    }
-  }
-  InsertChunk(chunk);
+  Free(ptr, size, GetSegmentSlot());
+}
 
-  if (kCheckFreeMaps) {
-    size_t free_after = CollectFree(free_by_start_, free_by_size_);
+void SwapSpace::Free(void* ptr, size_t size, Atomic<Segment*>& slot) {
+  size = RoundUp(size, 8U);
 
-    if (free_after != free_before + size) {
-      DumpFreeMap(free_by_size_);
-      CHECK_EQ(free_after, free_before + size) << "Should be " << size << " difference from " << free_before;
+  // Reclaim the memory if this is the last allocation of the thread's segment, such as
+  // a copy that is discarded right after it was made. Anything else is kept until the
+  // whole space is released.
+  Segment* segment = slot.LoadAcquire();
+  if (segment != nullptr) {
+    size_t used = segment->used.LoadRelaxed();
+    if (used >= size &&
+        reinterpret_cast<uint8_t*>(ptr) + size == segment->begin + used &&
+        segment->used.CompareAndSetStrongRelaxed(used, used - size)) {
+      return;
     }
   }
+  freed_size_.FetchAndAddRelaxed(size);
 }
 
 }  // namespace art
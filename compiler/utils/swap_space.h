@@ -20,18 +20,27 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <cstdlib>
-#include <list>
+#include <memory>
 #include <set>
+#include <utility>
 #include <vector>
 
 #include <android-base/logging.h>
 
+#include "base/atomic.h"
+#include "base/globals.h"
 #include "base/macros.h"
 #include "base/mutex.h"
 
 namespace art {
 
-// An arena pool that creates arenas backed by an mmaped file.
+// A bump pointer arena backed by an mmaped file.
+//
+// The file is grown and mapped in large chunks. Each thread allocates from its own segment
+// of the current chunk without taking a lock; `lock_` is only held to carve a new segment
+// or a dedicated region for a large allocation. Freed memory is not recycled, except when it
+// is the last allocation in the thread's segment. Everything is released in bulk when the
+// space is destroyed.
 class SwapSpace {
  public:
   SwapSpace(int fd, size_t initial_size);
@@ -39,72 +48,61 @@ class SwapSpace {
   void* Alloc(size_t size) REQUIRES(!lock_);
   void Free(void* ptr, size_t size) REQUIRES(!lock_);
 
-  size_t GetSize() {
-    return size_;
+  // Returns the size of the swap file.
+  size_t GetSize() const {
+    return size_.LoadRelaxed();
+  }
+
+  // Returns the number of bytes freed but not reclaimed before the bulk release.
+  size_t GetFreedSize() const {
+    return freed_size_.LoadRelaxed();
   }
 
  private:
-  // Chunk of space.
-  struct SpaceChunk {
-    // We need mutable members as we keep these objects in a std::set<> (providing only const
-    // access) but we modify these members while carefully preserving the std::set<> ordering.
-    mutable uint8_t* ptr;
-    mutable size_t size;
-
-    uintptr_t Start() const {
-      return reinterpret_cast<uintptr_t>(ptr);
-    }
-    uintptr_t End() const {
-      return reinterpret_cast<uintptr_t>(ptr) + size;
-    }
-  };
+  // Part of a mapped chunk that allocations are bumped from.
+  struct Segment {
+    Segment(uint8_t* b, size_t s) : begin(b), size(s), used(0u) {}
 
-  class SortChunkByPtr {
-   public:
-    bool operator()(const SpaceChunk& a, const SpaceChunk& b) const {
-      return reinterpret_cast<uintptr_t>(a.ptr) < reinterpret_cast<uintptr_t>(b.ptr);
-    }
+    uint8_t* const begin;
+    const size_t size;
+    Atomic<size_t> used;
   };
 
-  typedef std::set<SpaceChunk, SortChunkByPtr> FreeByStartSet;
+  // Number of segments that threads are spread over.
+  static constexpr size_t kNumSegmentSlots = 16u;
 
-  // Map size to an iterator to free_by_start_'s entry.
-  struct FreeBySizeEntry {
-    FreeBySizeEntry(size_t sz, FreeByStartSet::const_iterator entry)
-        : size(sz), free_by_start_entry(entry) { }
+  // The size of the per-thread segments carved from the mapped chunks.
+  static constexpr size_t kSegmentSize = 256 * KB;
 
-    // We need mutable members as we keep these objects in a std::set<> (providing only const
-    // access) but we modify these members while carefully preserving the std::set<> ordering.
-    mutable size_t size;
-    mutable FreeByStartSet::const_iterator free_by_start_entry;
-  };
-  struct FreeBySizeComparator {
-    bool operator()(const FreeBySizeEntry& lhs, const FreeBySizeEntry& rhs) const {
-      if (lhs.size != rhs.size) {
-        return lhs.size < rhs.size;
-      } else {
-        return lhs.free_by_start_entry->Start() < rhs.free_by_start_entry->Start();
-      }
-    }
-  };
-  typedef std::set<FreeBySizeEntry, FreeBySizeComparator> FreeBySizeSet;
+  // Bigger allocations get their own region of a chunk, so that they do not waste segments.
+  static constexpr size_t kMaxSegmentAllocationSize = kSegmentSize / 8;
 
-  SpaceChunk NewFileChunk(size_t min_size) REQUIRES(lock_);
+  // Alloc() and Free() for the thread using `slot`.
+  void* Alloc(size_t size, Atomic<Segment*>& slot) REQUIRES(!lock_);
+  void Free(void* ptr, size_t size, Atomic<Segment*>& slot);
 
-  void RemoveChunk(FreeBySizeSet::const_iterator free_by_size_pos) REQUIRES(lock_);
-  void InsertChunk(const SpaceChunk& chunk) REQUIRES(lock_);
+  void* AllocFromSegment(Segment* segment, size_t size);
+  Atomic<Segment*>& GetSegmentSlot();
+  uint8_t* AllocRegion(size_t size) REQUIRES(lock_);
+  void MapFileChunk(size_t min_size) REQUIRES(lock_);
 
   int fd_;
-  size_t size_;
+  Atomic<size_t> size_;
+  Atomic<size_t> freed_size_;
 
-  // NOTE: Boost.Bimap would be useful for the two following members.
+  // The current segment of each slot, replaced under `lock_` when exhausted.
+  Atomic<Segment*> segments_[kNumSegmentSlots];
 
-  // Map start of a free chunk to its size.
-  FreeByStartSet free_by_start_ GUARDED_BY(lock_);
-  // Free chunks ordered by size.
-  FreeBySizeSet free_by_size_ GUARDED_BY(lock_);
+  // Unused part of the most recently mapped chunk.
+  uint8_t* chunk_pos_ GUARDED_BY(lock_);
+  uint8_t* chunk_end_ GUARDED_BY(lock_);
+  // All mapped chunks and segments, released when the space is destroyed.
+  std::vector<std::pair<uint8_t*, size_t>> chunks_ GUARDED_BY(lock_);
+  std::vector<std::unique_ptr<Segment>> all_segments_ GUARDED_BY(lock_);
 
   mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+
+  friend class SwapSpaceTest;
   DISALLOW_COPY_AND_ASSIGN(SwapSpace);
 };
 
@@ -17,20 +17,80 @@
 #include "utils/swap_space.h"
 
 #include <fcntl.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <cstdio>
+#include <numeric>
+#include <vector>
 
 #include "gtest/gtest.h"
 
 #include "base/os.h"
 #include "base/unix_file/fd_file.h"
 #include "common_runtime_test.h"
+#include "thread_pool.h"
 
 namespace art {
 
 class SwapSpaceTest : public CommonRuntimeTest {
+ protected:
+  // Alloc() and Free() through the first segment slot, so that threads which would normally
+  // be spread over the slots compete for the same segment.
+  static void* AllocShared(SwapSpace* pool, size_t size) {
+    return pool->Alloc(size, pool->segments_[0]);
+  }
+  static void FreeShared(SwapSpace* pool, void* ptr, size_t size) {
+    pool->Free(ptr, size, pool->segments_[0]);
+  }
+
+  static size_t SegmentSize() {
+    return SwapSpace::kSegmentSize;
+  }
+  static size_t MaxSegmentAllocationSize() {
+    return SwapSpace::kMaxSegmentAllocationSize;
+  }
+
+  static size_t NumSegments(SwapSpace* pool) {
+    MutexLock mu(Thread::Current(), pool->lock_);
+    return pool->all_segments_.size();
+  }
+
+  // Returns the bytes bumped in all segments, which does not include reclaimed allocations.
+  static size_t UsedInSegments(SwapSpace* pool) {
+    MutexLock mu(Thread::Current(), pool->lock_);
+    size_t used = 0u;
+    for (const std::unique_ptr<SwapSpace::Segment>& segment : pool->all_segments_) {
+      used += segment->used.LoadRelaxed();
+    }
+    return used;
+  }
+
+  // Run `function(self, task_index)` for `num_tasks` tasks concurrently on a thread pool.
+  template <typename Function>
+  static void RunConcurrently(size_t num_tasks, const Function& function) {
+    class FunctionTask : public SelfDeletingTask {
+     public:
+      FunctionTask(const Function& function, size_t index) : function_(function), index_(index) {}
+      void Run(Thread* self) OVERRIDE {
+        function_(self, index_);
+      }
+
+     private:
+      const Function& function_;
+      const size_t index_;
+    };
+
+    Thread* self = Thread::Current();
+    ThreadPool thread_pool("Swap space test thread pool", num_tasks);
+    for (size_t i = 0; i != num_tasks; ++i) {
+      thread_pool.AddTask(self, new FunctionTask(function, i));
+    }
+    thread_pool.StartWorkers(self);
+    thread_pool.Wait(self, /* do_work */ false, /* may_hold_locks */ false);
+  }
 };
 
 static void SwapTest(bool use_file) {
@@ -80,4 +140,130 @@ TEST_F(SwapSpaceTest, Swap) {
   SwapTest(true);
 }
 
+TEST_F(SwapSpaceTest, FreeLastAllocation) {
+  ScratchFile scratch;
+  int fd = scratch.GetFd();
+  unlink(scratch.GetFilename().c_str());
+
+  SwapSpace pool(fd, 1 * MB);
+  void* first = pool.Alloc(24u);
+  void* second = pool.Alloc(40u);
+  EXPECT_EQ(reinterpret_cast<uint8_t*>(first) + 24u, second);
+
+  // Freeing the last allocation makes its memory available again.
+  pool.Free(second, 40u);
+  EXPECT_EQ(0u, pool.GetFreedSize());
+  EXPECT_EQ(second, pool.Alloc(40u));
+
+  // Anything else is only released with the whole space.
+  pool.Free(first, 24u);
+  EXPECT_EQ(24u, pool.GetFreedSize());
+
+  // Large allocations do not come from the segment.
+  void* large = pool.Alloc(1 * MB);
+  memset(large, 0xff, 1 * MB);
+  EXPECT_EQ(reinterpret_cast<uint8_t*>(second) + 40u, pool.Alloc(8u));
+
+  scratch.Close();
+}
+
+TEST_F(SwapSpaceTest, SharedSlotSegmentExhaustion) {
+  ScratchFile scratch;
+  int fd = scratch.GetFd();
+  unlink(scratch.GetFilename().c_str());
+
+  // Allocations of the largest size that still comes from segments fill each segment exactly,
+  // so the threads keep running out of the shared segment at the same time.
+  static constexpr size_t kNumTasks = 4u;
+  static constexpr size_t kSegmentsPerTask = 16u;
+  const size_t size = MaxSegmentAllocationSize();
+  const size_t allocations_per_task = kSegmentsPerTask * SegmentSize() / size;
+  SwapSpace pool(fd, 1 * MB);
+  std::vector<std::vector<uint8_t*>> allocations(kNumTasks);
+  RunConcurrently(kNumTasks, [&](Thread* self ATTRIBUTE_UNUSED, size_t index) {
+    for (size_t i = 0; i != allocations_per_task; ++i) {
+      uint8_t* data = reinterpret_cast<uint8_t*>(AllocShared(&pool, size));
+      memset(data, static_cast<int>(index), size);
+      allocations[index].push_back(data);
+    }
+  });
+
+  // Only one of the threads which found the segment exhausted replaced it, the others
+  // allocated from the new one. No segment was given up before it was full.
+  EXPECT_EQ(kNumTasks * kSegmentsPerTask, NumSegments(&pool));
+  EXPECT_EQ(kNumTasks * kSegmentsPerTask * SegmentSize(), UsedInSegments(&pool));
+
+  // No memory was handed out twice.
+  std::vector<std::pair<uint8_t*, size_t>> sorted;
+  for (size_t index = 0; index != kNumTasks; ++index) {
+    for (uint8_t* data : allocations[index]) {
+      ASSERT_TRUE(std::all_of(data, data + size, [=](uint8_t b) { return b == index; }));
+      sorted.emplace_back(data, index);
+    }
+  }
+  std::sort(sorted.begin(), sorted.end());
+  for (size_t i = 1; i < sorted.size(); ++i) {
+    ASSERT_LE(sorted[i - 1].first + size, sorted[i].first);
+  }
+
+  scratch.Close();
+}
+
+TEST_F(SwapSpaceTest, SharedSlotRollback) {
+  ScratchFile scratch;
+  int fd = scratch.GetFd();
+  unlink(scratch.GetFilename().c_str());
+
+  // Each thread keeps some allocations and frees a temporary one right away. The free rolls
+  // the shared segment back unless another thread has allocated from it in the meantime, in
+  // which case the memory must stay allocated and only be counted as freed.
+  static constexpr size_t kNumTasks = 4u;
+  static constexpr size_t kNumIterations = 20000u;
+  SwapSpace pool(fd, 1 * MB);
+  std::vector<std::vector<std::pair<uint64_t*, size_t>>> kept(kNumTasks);
+  std::vector<size_t> kept_bytes(kNumTasks, 0u);
+  std::vector<size_t> temporary_bytes(kNumTasks, 0u);
+  RunConcurrently(kNumTasks, [&](Thread* self ATTRIBUTE_UNUSED, size_t index) {
+    for (size_t i = 0; i != kNumIterations; ++i) {
+      size_t count = 1u + (i + index) % 8u;
+      uint64_t* data = reinterpret_cast<uint64_t*>(AllocShared(&pool, count * sizeof(uint64_t)));
+      std::fill_n(data, count, (index << 32) | i);
+      kept[index].emplace_back(data, count);
+      kept_bytes[index] += count * sizeof(uint64_t);
+
+      size_t temporary_count = 1u + i % 16u;
+      uint64_t* temporary =
+          reinterpret_cast<uint64_t*>(AllocShared(&pool, temporary_count * sizeof(uint64_t)));
+      std::fill_n(temporary, temporary_count, ~((index << 32) | i));
+      // A wrong rollback by another thread would have handed out this memory again.
+      for (size_t j = 0; j != temporary_count; ++j) {
+        ASSERT_EQ(~((index << 32) | i), temporary[j]);
+      }
+      FreeShared(&pool, temporary, temporary_count * sizeof(uint64_t));
+      temporary_bytes[index] += temporary_count * sizeof(uint64_t);
+    }
+  });
+
+  // The kept allocations were not overwritten by allocations reusing rolled back memory.
+  for (size_t index = 0; index != kNumTasks; ++index) {
+    for (size_t i = 0; i != kNumIterations; ++i) {
+      uint64_t* data = kept[index][i].first;
+      size_t count = kept[index][i].second;
+      for (size_t j = 0; j != count; ++j) {
+        ASSERT_EQ((index << 32) | i, data[j]);
+      }
+    }
+  }
+  // Every temporary allocation was either rolled back or counted as freed, and not all of them
+  // were counted as freed.
+  size_t total_kept_bytes =
+      std::accumulate(kept_bytes.begin(), kept_bytes.end(), static_cast<size_t>(0u));
+  size_t total_temporary_bytes =
+      std::accumulate(temporary_bytes.begin(), temporary_bytes.end(), static_cast<size_t>(0u));
+  EXPECT_EQ(UsedInSegments(&pool), total_kept_bytes + pool.GetFreedSize());
+  EXPECT_LT(pool.GetFreedSize(), total_temporary_bytes);
+
+  scratch.Close();
+}
+
 }  // namespace art
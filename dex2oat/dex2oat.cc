@@ -15,6 +15,10 @@
  */
 
 #include <inttypes.h>
+#ifndef __APPLE__
+#include <link.h>  // for dl_iterate_phdr.
+#endif
+#include <openssl/sha.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
@@ -193,6 +197,97 @@ static std::string StrippedCommandLine() {
   return android::base::Join(command, ' ');
 }
 
+// Whether the argument only names an input or output of the compilation, or otherwise cannot
+// change the generated code. Such arguments are left out of the recorded compilation arguments;
+// the dex files, class path, profile and compilation reason are compared on their own.
+static bool IsFingerprintNeutralArgument(const char* arg) {
+  static const char* const kNeutralPrefixes[] = {
+      "--zip-",
+      "--dex-",
+      "--oat-",
+      "--input-vdex",
+      "--output-vdex",
+      "--dm-",
+      "--swap-",
+      "--profile-file",
+      "--previous-oat=",
+      "--class-loader-context=",
+      "--stored-class-loader-context=",
+      "--classpath-dir=",
+      "--compilation-reason=",
+      "--avoid-storing-invocation",
+      "--watchdog",
+      "--no-watchdog",
+      "--dump-",
+      "-j",
+  };
+  for (const char* prefix : kNeutralPrefixes) {
+    if (android::base::StartsWith(arg, prefix)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static std::string ToHexString(const uint8_t* data, size_t size) {
+  std::string result;
+  for (size_t i = 0; i != size; ++i) {
+    result += StringPrintf("%02x", data[i]);
+  }
+  return result;
+}
+
+#ifndef __APPLE__
+// ELF note header, the same for 32-bit and 64-bit files.
+struct ElfNoteHeader {
+  uint32_t n_namesz;
+  uint32_t n_descsz;
+  uint32_t n_type;
+};
+static constexpr uint32_t kNoteTypeGnuBuildId = 3u;  // NT_GNU_BUILD_ID
+
+// Appends the GNU build ID of the dex2oat executable and of the ART libraries it loaded, which
+// make up the compiler. The code they generate can change between builds of the same oat version.
+// If one of them was linked without a build ID, nothing reliably identifies the build and the
+// result is left empty.
+static int AppendCompilerBuildId(struct dl_phdr_info* info, size_t size ATTRIBUTE_UNUSED,
+                                 void* data) {
+  // Depending on the libc, the executable is reported with an empty name or with its path.
+  const char* name = (info->dlpi_name != nullptr) ? info->dlpi_name : "";
+  if (name[0] != '\0' && strstr(name, "dex2oat") == nullptr && strstr(name, "libart") == nullptr) {
+    return 0;
+  }
+  std::string* build_id = reinterpret_cast<std::string*>(data);
+  if (!build_id->empty()) {
+    build_id->push_back('-');
+  }
+  size_t old_length = build_id->size();
+  for (size_t i = 0; i != info->dlpi_phnum; ++i) {
+    const ElfW(Phdr)& phdr = info->dlpi_phdr[i];
+    if (phdr.p_type != PT_NOTE) {
+      continue;
+    }
+    const uint8_t* note = reinterpret_cast<const uint8_t*>(info->dlpi_addr + phdr.p_vaddr);
+    const uint8_t* end = note + phdr.p_memsz;
+    while (note + sizeof(ElfNoteHeader) <= end) {
+      const ElfNoteHeader* nhdr = reinterpret_cast<const ElfNoteHeader*>(note);
+      const uint8_t* desc = note + sizeof(ElfNoteHeader) + RoundUp(nhdr->n_namesz, 4u);
+      if (nhdr->n_type == kNoteTypeGnuBuildId &&
+          nhdr->n_namesz == sizeof("GNU") &&
+          memcmp(note + sizeof(ElfNoteHeader), "GNU", sizeof("GNU")) == 0) {
+        build_id->append(ToHexString(desc, nhdr->n_descsz));
+      }
+      note = desc + RoundUp(nhdr->n_descsz, 4u);
+    }
+  }
+  if (build_id->size() == old_length) {
+    build_id->clear();
+    return 1;  // Stop iterating.
+  }
+  return 0;
+}
+#endif
+
 static void UsageErrorV(const char* fmt, va_list ap) {
   std::string error;
   StringAppendV(&error, fmt, ap);
@@ -250,6 +345,14 @@ NO_RETURN static void Usage(const char* fmt, ...) {
   UsageError("      descriptor.");
   UsageError("      Example: --output-vdex-fd=6");
   UsageError("");
+  UsageError("  --previous-oat=<file.oat>: specifies the oat file of a previous compilation.");
+  UsageError("      If the same build of dex2oat compiled it from the same dex files, boot image,");
+  UsageError("      class path, profile and options, its oat and vdex files are copied instead");
+  UsageError("      of compiling again. Only compilations given --previous-oat, even if the file");
+  UsageError("      does not exist yet, record what a later one compares against, so their");
+  UsageError("      output can be reused. Not compatible with --avoid-storing-invocation.");
+  UsageError("      Example: --previous-oat=/data/local/tmp/base.odex");
+  UsageError("");
   UsageError("  --oat-location=<oat-name>: specifies a symbolic name for the file corresponding");
   UsageError("      to the file descriptor specified by --oat-fd.");
   UsageError("      Example: --oat-location=/data/dalvik-cache/system@app@Calculator.apk.oat");
@@ -751,6 +854,10 @@ class Dex2Oat FINAL {
       Usage("Can't have both --output-vdex-fd and --output-vdex");
     }
 
+    if (!previous_oat_.empty() && IsImage()) {
+      Usage("--previous-oat should not be used with --image or --app-image-file/fd");
+    }
+
     if (!oat_filenames_.empty() && oat_fd_ != -1) {
       Usage("--oat-file should not be used with --oat-fd");
     }
@@ -1128,6 +1235,27 @@ class Dex2Oat FINAL {
         CompilerFilter::NameOfFilter(compiler_options_->GetCompilerFilter()));
     key_value_store_->Put(OatHeader::kConcurrentCopying,
                           kUseReadBarrier ? OatHeader::kTrueValue : OatHeader::kFalseValue);
+
+    // Record what a later compilation with --previous-oat must match to reuse this one: the
+    // arguments that can change the generated code, and the build of the compiler. The inputs
+    // and outputs the arguments leave out are compared separately.
+    if (StoresReuseInputs()) {
+      std::vector<std::string> compilation_args;
+      for (int i = 1; i < argc; ++i) {
+        if (!IsFingerprintNeutralArgument(argv[i])) {
+          compilation_args.push_back(argv[i]);
+        }
+      }
+      key_value_store_->Put(OatHeader::kCompilationArgsKey,
+                            android::base::Join(compilation_args, ' '));
+      std::string compiler_build_id;
+#ifndef __APPLE__
+      dl_iterate_phdr(AppendCompilerBuildId, &compiler_build_id);
+#endif
+      if (!compiler_build_id.empty()) {
+        key_value_store_->Put(OatHeader::kCompilerBuildIdKey, compiler_build_id);
+      }
+    }
   }
 
   // This simple forward is here so the string specializations below don't look out of place.
@@ -1203,6 +1331,7 @@ class Dex2Oat FINAL {
     AssignIfExists(args, M::OutputVdexFd, &output_vdex_fd_);
     AssignIfExists(args, M::InputVdex, &input_vdex_);
     AssignIfExists(args, M::OutputVdex, &output_vdex_);
+    AssignIfExists(args, M::PreviousOat, &previous_oat_);
     AssignIfExists(args, M::DmFd, &dm_fd_);
     AssignIfExists(args, M::DmFile, &dm_file_location_);
     AssignIfExists(args, M::OatFd, &oat_fd_);
@@ -1637,6 +1766,17 @@ class Dex2Oat FINAL {
           class_loader_context_->EncodeContextForOatFile(classpath_dir_,
                                                          stored_class_loader_context_.get());
       key_value_store_->Put(OatHeader::kClassPathKey, class_path_key);
+
+      if (UseProfile() && StoresReuseInputs()) {
+        key_value_store_->Put(OatHeader::kProfileChecksumKey, profile_sha256_);
+      }
+
+      // The key-value store is now final and the dex file sources are known, which is all
+      // the previous compilation is compared against.
+      if (!previous_oat_.empty() && CanReusePreviousOat()) {
+        reuse_previous_oat_ = true;
+        return dex2oat::ReturnCode::kNoFailure;
+      }
     }
 
     // Now that we have finalized key_value_store_, start writing the oat file.
@@ -2369,10 +2509,171 @@ class Dex2Oat FINAL {
       return false;
     }
 
+    // The profile decides what gets compiled, so a previous compilation is only reused with
+    // the same profile. Its checksum is not needed otherwise.
+    if (!StoresReuseInputs()) {
+      return true;
+    }
+    int64_t profile_length = profile_file->GetLength();
+    if (profile_length < 0) {
+      PLOG(ERROR) << "Failed to get the length of the profile file";
+      profile_compilation_info_.reset(nullptr);
+      return false;
+    }
+    std::vector<uint8_t> profile_data(static_cast<size_t>(profile_length));
+    if (!profile_file->PreadFully(profile_data.data(), profile_data.size(), /* offset */ 0)) {
+      PLOG(ERROR) << "Failed to read the profile file";
+      profile_compilation_info_.reset(nullptr);
+      return false;
+    }
+    uint8_t profile_sha256[SHA256_DIGEST_LENGTH];
+    SHA256(profile_data.data(), profile_data.size(), profile_sha256);
+    profile_sha256_ = ToHexString(profile_sha256, sizeof(profile_sha256));
+
     return true;
   }
 
+  bool ReusesPreviousOat() const {
+    return reuse_previous_oat_;
+  }
+
+  // Replace the contents of the output oat and vdex files with the previous compilation's.
+  bool CopyPreviousOat() {
+    TimingLogger::ScopedTiming t("dex2oat Copy previous oat", timings_);
+    DCHECK(reuse_previous_oat_);
+    DCHECK_EQ(oat_files_.size(), 1u);
+    DCHECK_EQ(vdex_files_.size(), 1u);
+    // Destroy the writers first, so that the data they buffered in Start() does not get flushed
+    // over the copied oat file.
+    oat_writers_.clear();
+    elf_writers_.clear();
+    return CopyFileContents(previous_oat_, oat_files_[0].get()) &&
+           CopyFileContents(ReplaceFileExtension(previous_oat_, "vdex"), vdex_files_[0].get());
+  }
+
  private:
+  // Whether the key-value store records what a later compilation with --previous-oat compares
+  // against. Only compilations that are given a previous oat file store it, as it includes the
+  // compilation arguments, and never with --avoid-storing-invocation.
+  bool StoresReuseInputs() const {
+    return !previous_oat_.empty() && !avoid_storing_invocation_;
+  }
+
+  bool CanReusePreviousOat() {
+    TimingLogger::ScopedTiming t("dex2oat Check previous oat", timings_);
+    DCHECK(!IsImage());
+    DCHECK_EQ(oat_writers_.size(), 1u);
+    if (!StoresReuseInputs()) {
+      LOG(INFO) << "Not reusing previous oat file " << previous_oat_
+                << ": --avoid-storing-invocation leaves out the compilation arguments";
+      return false;
+    }
+    std::string error_msg;
+    std::unique_ptr<OatFile> previous_oat(OatFile::Open(/* zip_fd */ -1,
+                                                        previous_oat_,
+                                                        previous_oat_,
+                                                        /* requested_base */ nullptr,
+                                                        /* oat_file_begin */ nullptr,
+                                                        /* executable */ false,
+                                                        /* low_4gb */ false,
+                                                        /* abs_dex_location */ nullptr,
+                                                        &error_msg));
+    if (previous_oat == nullptr) {
+      LOG(INFO) << "Not reusing previous oat file " << previous_oat_ << ": " << error_msg;
+      return false;
+    }
+    const char* mismatch = FindPreviousOatMismatch(*previous_oat);
+    if (mismatch != nullptr) {
+      LOG(INFO) << "Not reusing previous oat file " << previous_oat_ << ": " << mismatch
+                << " changed";
+      return false;
+    }
+    LOG(INFO) << "Reusing previous oat file " << previous_oat_;
+    return true;
+  }
+
+  // Returns what differs between the previous compilation and this one, or null if the previous
+  // oat file is what this compilation would produce.
+  const char* FindPreviousOatMismatch(const OatFile& previous_oat) const {
+    // The oat file name is recorded as the ELF soname.
+    auto file_name = [](const std::string& path) {
+      size_t last_slash = path.rfind('/');
+      return (last_slash == std::string::npos) ? path : path.substr(last_slash + 1);
+    };
+    if (file_name(previous_oat_) != file_name(oat_filenames_[0])) {
+      return "oat file name";
+    }
+
+    // Without build IDs, code from a different build of the compiler can not be told apart.
+    if (key_value_store_->find(OatHeader::kCompilerBuildIdKey) == key_value_store_->end()) {
+      return "compiler build";
+    }
+
+    const OatHeader& header = previous_oat.GetOatHeader();
+    if (header.GetInstructionSet() != instruction_set_ ||
+        header.GetInstructionSetFeaturesBitmap() != instruction_set_features_->AsBitmap()) {
+      return "instruction set";
+    }
+    if (header.GetImageFileLocationOatChecksum() != image_file_location_oat_checksum_ ||
+        header.GetImageFileLocationOatDataBegin() != image_file_location_oat_data_begin_ ||
+        header.GetImagePatchDelta() != image_patch_delta_) {
+      return "boot image";
+    }
+
+    // Apart from the invocation, which names different files each time, the key-value stores
+    // must be identical. They hold the class path, compiler filter, compilation arguments,
+    // compiler build ID and profile checksum.
+    size_t num_previous_keys = 0u;
+    const char* key;
+    const char* value;
+    for (size_t i = 0; header.GetStoreKeyValuePairByIndex(i, &key, &value); ++i) {
+      if (strcmp(key, OatHeader::kDex2OatCmdLineKey) == 0) {
+        continue;
+      }
+      auto it = key_value_store_->find(key);
+      if (it == key_value_store_->end() || it->second != value) {
+        return key;
+      }
+      ++num_previous_keys;
+    }
+    if (num_previous_keys !=
+            key_value_store_->size() - key_value_store_->count(OatHeader::kDex2OatCmdLineKey)) {
+      return "key-value store";
+    }
+
+    dchecked_vector<std::string> locations = oat_writers_[0]->GetSourceLocations();
+    dchecked_vector<uint32_t> checksums = oat_writers_[0]->GetSourceChecksums();
+    const std::vector<const OatFile::OatDexFile*>& oat_dex_files = previous_oat.GetOatDexFiles();
+    if (oat_dex_files.size() != locations.size()) {
+      return "dex files";
+    }
+    for (size_t i = 0; i != oat_dex_files.size(); ++i) {
+      if (oat_dex_files[i]->GetDexFileLocation() != locations[i] ||
+          oat_dex_files[i]->GetDexFileLocationChecksum() != checksums[i]) {
+        return "dex files";
+      }
+    }
+    return nullptr;
+  }
+
+  static bool CopyFileContents(const std::string& filename, File* out) {
+    std::unique_ptr<File> in(OS::OpenFileForReading(filename.c_str()));
+    if (in == nullptr) {
+      PLOG(ERROR) << "Failed to open file: " << filename;
+      return false;
+    }
+    int64_t in_length = in->GetLength();
+    if (in_length < 0) {
+      PLOG(ERROR) << "Failed to get the length of file: " << filename;
+      return false;
+    }
+    if (out->SetLength(0) != 0 || !out->ResetOffset() || !out->Copy(in.get(), 0, in_length)) {
+      PLOG(ERROR) << "Failed to copy " << filename << " to file: " << out->GetPath();
+      return false;
+    }
+    return true;
+  }
+
   bool UseSwap(bool is_image, const std::vector<const DexFile*>& dex_files) {
     if (is_image) {
       // Don't use swap, we know generation should succeed, and we don't want to slow it down.
@@ -2975,6 +3276,13 @@ class Dex2Oat FINAL {
   // The reason for invoking the compiler.
   std::string compilation_reason_;
 
+  // SHA-256 of the profile contents, see kProfileChecksumKey.
+  std::string profile_sha256_;
+
+  // The oat file of a previous compilation, and whether it is reused as our output.
+  std::string previous_oat_;
+  bool reuse_previous_oat_ = false;
+
   DISALLOW_IMPLICIT_CONSTRUCTORS(Dex2Oat);
 };
 
@@ -3101,6 +3409,25 @@ static dex2oat::ReturnCode CompileApp(Dex2Oat& dex2oat) {
   return dex2oat::ReturnCode::kNoFailure;
 }
 
+static dex2oat::ReturnCode ReusePreviousOat(Dex2Oat& dex2oat) {
+  if (!dex2oat.CopyPreviousOat()) {
+    dex2oat.EraseOutputFiles();
+    return dex2oat::ReturnCode::kOther;
+  }
+
+  // The previous oat file is already stripped or not, the same way ours would be.
+  if (!dex2oat.IsHost() && !dex2oat.CopyStrippedToUnstripped()) {
+    return dex2oat::ReturnCode::kOther;
+  }
+
+  if (!dex2oat.FlushCloseOutputFiles()) {
+    return dex2oat::ReturnCode::kOther;
+  }
+
+  dex2oat.DumpTiming();
+  return dex2oat::ReturnCode::kNoFailure;
+}
+
 static dex2oat::ReturnCode Dex2oat(int argc, char** argv) {
   b13564922();
 
@@ -3149,6 +3476,11 @@ static dex2oat::ReturnCode Dex2oat(int argc, char** argv) {
     return setup_code;
   }
 
+  // Nothing changed since the previous compilation, take its outputs.
+  if (dex2oat->ReusesPreviousOat()) {
+    return ReusePreviousOat(*dex2oat);
+  }
+
   // TODO: Due to the cyclic dependencies, profile loading and verifying are
   // being done separately. Refactor and place the two next to each other.
   // If verification fails, we don't abort the compilation and instead log an
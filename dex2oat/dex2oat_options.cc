@@ -86,6 +86,9 @@ static void AddGeneratedArtifactMappings(Builder& builder) {
       .Define("--output-vdex=_")
           .WithType<std::string>()
           .IntoKey(M::OutputVdex)
+      .Define("--previous-oat=_")
+          .WithType<std::string>()
+          .IntoKey(M::PreviousOat)
       .Define("--dm-fd=_")
           .WithType<int>()
           .IntoKey(M::DmFd)
@@ -1848,6 +1848,173 @@ TEST_F(Dex2oatTest, VerifyNoCompilationReason) {
   ASSERT_EQ(nullptr, odex_file->GetCompilationReason());
 }
 
+// Whether the oat file was compiled by the dex2oat invocation that wrote `location`, rather than
+// reused from a previous compilation. A reused oat file records the invocation that produced it.
+static bool CompiledTo(const OatFile& oat_file, const std::string& location) {
+  const char* cmdline = oat_file.GetOatHeader().GetStoreValueByKey(OatHeader::kDex2OatCmdLineKey);
+  return cmdline != nullptr &&
+      std::string(cmdline).find("--oat-file=" + location) != std::string::npos;
+}
+
+// Whether the oat file records what a compilation with --previous-oat compares against.
+static bool StoresReuseInputs(const OatFile& oat_file) {
+  const OatHeader& header = oat_file.GetOatHeader();
+  return header.GetStoreValueByKey(OatHeader::kCompilationArgsKey) != nullptr ||
+      header.GetStoreValueByKey(OatHeader::kCompilerBuildIdKey) != nullptr;
+}
+
+TEST_F(Dex2oatTest, ReusePreviousOat) {
+  std::string dex_location = GetScratchDir() + "/Dex2OatReusePreviousOat.jar";
+  // The previous oat file must have the same file name as the output.
+  std::string previous_odex_location = GetScratchDir() + "/Dex2OatReusePreviousOat.odex";
+  std::string odex_location = GetOdexDir() + "/Dex2OatReusePreviousOat.odex";
+  std::string missing_odex_location = GetScratchDir() + "/missing/Dex2OatReusePreviousOat.odex";
+  Copy(GetDexSrc1(), dex_location);
+
+  // Compilations that are not given a previous oat file do not record what reusing their output
+  // would compare against, and their output is not reused.
+  GenerateOdexForTest(dex_location,
+                      previous_odex_location,
+                      CompilerFilter::kQuicken,
+                      { },
+                      true,  // expect_success
+                      false,  // use_fd
+                      [](const OatFile& oat_file) {
+    EXPECT_FALSE(StoresReuseInputs(oat_file));
+  });
+  GenerateOdexForTest(dex_location,
+                      odex_location,
+                      CompilerFilter::kQuicken,
+                      { "--previous-oat=" + previous_odex_location },
+                      true,  // expect_success
+                      false,  // use_fd
+                      [&](const OatFile& oat_file) {
+    EXPECT_TRUE(CompiledTo(oat_file, odex_location));
+  });
+
+  // Neither do compilations that must not store their invocation.
+  GenerateOdexForTest(dex_location,
+                      previous_odex_location,
+                      CompilerFilter::kQuicken,
+                      { "--previous-oat=" + missing_odex_location, "--avoid-storing-invocation" },
+                      true,  // expect_success
+                      false,  // use_fd
+                      [](const OatFile& oat_file) {
+    EXPECT_FALSE(StoresReuseInputs(oat_file));
+  });
+
+  // A previous oat file that does not exist yet is compiled from scratch.
+  GenerateOdexForTest(dex_location,
+                      previous_odex_location,
+                      CompilerFilter::kQuicken,
+                      { "--previous-oat=" + missing_odex_location },
+                      true,  // expect_success
+                      false,  // use_fd
+                      [&](const OatFile& oat_file) {
+    EXPECT_TRUE(StoresReuseInputs(oat_file));
+    EXPECT_TRUE(CompiledTo(oat_file, previous_odex_location));
+  });
+
+  // Nothing changed: the previous oat file is reused.
+  GenerateOdexForTest(dex_location,
+                      odex_location,
+                      CompilerFilter::kQuicken,
+                      { "--previous-oat=" + previous_odex_location },
+                      true,  // expect_success
+                      false,  // use_fd
+                      [&](const OatFile& oat_file) {
+    EXPECT_TRUE(CompiledTo(oat_file, previous_odex_location));
+  });
+
+  // A different compiler filter requires compiling again.
+  GenerateOdexForTest(dex_location,
+                      odex_location,
+                      CompilerFilter::kSpeed,
+                      { "--previous-oat=" + previous_odex_location },
+                      true,  // expect_success
+                      false,  // use_fd
+                      [&](const OatFile& oat_file) {
+    EXPECT_TRUE(CompiledTo(oat_file, odex_location));
+  });
+
+  // So do different code generation options.
+  GenerateOdexForTest(dex_location,
+                      odex_location,
+                      CompilerFilter::kQuicken,
+                      { "--previous-oat=" + previous_odex_location, "--debuggable" },
+                      true,  // expect_success
+                      false,  // use_fd
+                      [&](const OatFile& oat_file) {
+    EXPECT_TRUE(CompiledTo(oat_file, odex_location));
+  });
+
+  // So does a different dex file.
+  Copy(GetDexSrc2(), dex_location);
+  GenerateOdexForTest(dex_location,
+                      odex_location,
+                      CompilerFilter::kQuicken,
+                      { "--previous-oat=" + previous_odex_location },
+                      true,  // expect_success
+                      false,  // use_fd
+                      [&](const OatFile& oat_file) {
+    EXPECT_TRUE(CompiledTo(oat_file, odex_location));
+  });
+}
+
+TEST_F(Dex2oatLayoutTest, ReusePreviousOatWithProfile) {
+  std::string dex_location = GetScratchDir() + "/Dex2OatReusePreviousOatWithProfile.jar";
+  std::string previous_odex_location =
+      GetScratchDir() + "/Dex2OatReusePreviousOatWithProfile.odex";
+  std::string odex_location = GetOdexDir() + "/Dex2OatReusePreviousOatWithProfile.odex";
+  std::string profile_location = GetScratchDir() + "/primary.prof";
+  Copy(GetDexSrc2(), dex_location);
+  std::string error_msg;
+  std::vector<std::unique_ptr<const DexFile>> dex_files;
+  const ArtDexFileLoader dex_file_loader;
+  ASSERT_TRUE(dex_file_loader.Open(dex_location.c_str(),
+                                   dex_location.c_str(),
+                                   /* verify */ true,
+                                   /* verify_checksum */ true,
+                                   &error_msg,
+                                   &dex_files)) << error_msg;
+  ASSERT_EQ(dex_files.size(), 1u);
+  uint32_t checksum = dex_files[0]->GetLocationChecksum();
+  std::vector<std::string> args = {
+      "--profile-file=" + profile_location,
+      "--previous-oat=" + previous_odex_location,
+  };
+
+  GenerateProfile(profile_location, dex_location, /* num_classes */ 1, checksum);
+  GenerateOdexForTest(dex_location,
+                      previous_odex_location,
+                      CompilerFilter::kSpeedProfile,
+                      { "--profile-file=" + profile_location,
+                        "--previous-oat=" + GetScratchDir() + "/missing/primary.odex" });
+
+  // Same profile: the previous oat file is reused.
+  GenerateOdexForTest(dex_location,
+                      odex_location,
+                      CompilerFilter::kSpeedProfile,
+                      args,
+                      true,  // expect_success
+                      false,  // use_fd
+                      [&](const OatFile& oat_file) {
+    EXPECT_TRUE(CompiledTo(oat_file, previous_odex_location));
+  });
+
+  // A different profile requires compiling again.
+  GenerateProfile(profile_location, dex_location, /* num_classes */ 2, checksum);
+  GenerateOdexForTest(dex_location,
+                      odex_location,
+                      CompilerFilter::kSpeedProfile,
+                      args,
+                      true,  // expect_success
+                      false,  // use_fd
+                      [&](const OatFile& oat_file) {
+    EXPECT_TRUE(CompiledTo(oat_file, odex_location));
+  });
+}
+
 TEST_F(Dex2oatTest, DontExtract) {
   std::unique_ptr<const DexFile> dex(OpenTestDexFile("ManyMethods"));
   std::string error_msg;
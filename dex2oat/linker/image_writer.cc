@@ -87,6 +87,10 @@ namespace linker {
 // Separate objects into multiple bins to optimize dirty memory use.
 static constexpr bool kBinObjects = true;
 
+// Size of the independently compressed blocks of compressed images. Smaller blocks decompress
+// with more parallelism but compress less well.
+static constexpr size_t kImageBlockSize = 256 * KB;
+
 // Return true if an object is already in an image space.
 bool ImageWriter::IsInBootImage(const void* obj) const {
   gc::Heap* const heap = Runtime::Current()->GetHeap();
@@ -237,17 +241,39 @@ bool ImageWriter::Write(int image_fd,
     const uint64_t compress_start_time = NanoTime();
 
     CHECK_EQ(image_header->storage_mode_, image_storage_mode_);
+    std::vector<ImageHeader::Block> blocks;
     switch (image_storage_mode_) {
       case ImageHeader::kStorageModeLZ4HC:  // Fall-through.
       case ImageHeader::kStorageModeLZ4: {
-        const size_t compressed_max_size = LZ4_compressBound(image_data_size);
-        compressed_data.reset(new char[compressed_max_size]);
-        data_size = LZ4_compress_default(
-            reinterpret_cast<char*>(image_info.image_->Begin()) + sizeof(ImageHeader),
-            &compressed_data[0],
-            image_data_size,
-            compressed_max_size);
-
+        // Compress the data in blocks, so that the runtime can decompress them in parallel, and
+        // append the block table.
+        const size_t num_blocks = RoundUp(image_data_size, kImageBlockSize) / kImageBlockSize;
+        const size_t compressed_max_size =
+            num_blocks * (LZ4_compressBound(kImageBlockSize) + sizeof(ImageHeader::Block)) +
+            alignof(ImageHeader::Block);
+        // Zero-initialize so that the alignment padding is deterministic.
+        compressed_data.reset(new char[compressed_max_size]());
+        data_size = 0u;
+        for (size_t offset = 0; offset < image_data_size; offset += kImageBlockSize) {
+          const size_t block_size = std::min(kImageBlockSize, image_data_size - offset);
+          const int compressed_size = LZ4_compress_default(image_data + offset,
+                                                           &compressed_data[data_size],
+                                                           block_size,
+                                                           LZ4_compressBound(block_size));
+          CHECK_GT(compressed_size, 0);
+          blocks.emplace_back(sizeof(ImageHeader) + data_size,
+                              compressed_size,
+                              sizeof(ImageHeader) + offset,
+                              block_size);
+          data_size += compressed_size;
+        }
+        data_size = RoundUp(sizeof(ImageHeader) + data_size, alignof(ImageHeader::Block)) -
+            sizeof(ImageHeader);
+        image_header->blocks_offset_ = sizeof(ImageHeader) + data_size;
+        image_header->blocks_count_ = blocks.size();
+        memcpy(&compressed_data[data_size], blocks.data(), blocks.size() * sizeof(blocks[0]));
+        data_size += blocks.size() * sizeof(blocks[0]);
+        DCHECK_LE(data_size, compressed_max_size);
         break;
       }
       /*
@@ -277,15 +303,19 @@ bool ImageWriter::Write(int image_fd,
     if (compressed_data != nullptr) {
       image_data_to_write = &compressed_data[0];
       VLOG(compiler) << "Compressed from " << image_data_size << " to " << data_size << " in "
+                     << blocks.size() << " blocks in "
                      << PrettyDuration(NanoTime() - compress_start_time);
       if (kIsDebugBuild) {
         std::unique_ptr<uint8_t[]> temp(new uint8_t[image_data_size]);
-        const size_t decompressed_size = LZ4_decompress_safe(
-            reinterpret_cast<char*>(&compressed_data[0]),
-            reinterpret_cast<char*>(&temp[0]),
-            data_size,
-            image_data_size);
-        CHECK_EQ(decompressed_size, image_data_size);
+        for (const ImageHeader::Block& block : blocks) {
+          const size_t image_offset = block.GetImageOffset() - sizeof(ImageHeader);
+          const int decompressed_size = LZ4_decompress_safe(
+              &compressed_data[block.GetDataOffset() - sizeof(ImageHeader)],
+              reinterpret_cast<char*>(&temp[image_offset]),
+              block.GetDataSize(),
+              block.GetImageSize());
+          CHECK_EQ(static_cast<size_t>(decompressed_size), block.GetImageSize());
+        }
         CHECK_EQ(memcmp(image_data, &temp[0], image_data_size), 0) << image_storage_mode_;
       }
     }
@@ -24,6 +24,7 @@
 #include "art_method-inl.h"
 #include "base/allocator.h"
 #include "base/bit_vector-inl.h"
+#include "base/call_chain_clustering.h"
 #include "base/enums.h"
 #include "base/file_magic.h"
 #include "base/logging.h"  // For VLOG
@@ -63,6 +64,7 @@
 #include "oat_quick_method_header.h"
 #include "quicken_info.h"
 #include "scoped_thread_state_change-inl.h"
+#include "thread_pool.h"
 #include "type_lookup_table.h"
 #include "utils/dex_cache_arrays_layout-inl.h"
 #include "vdex_file.h"
@@ -89,6 +91,13 @@ static constexpr bool kOatWriterForceOatCodeLayout = false;
 
 static constexpr bool kOatWriterDebugOatCodeLayout = false;
 
+// Maximum size of the code of a call-chain cluster of profiled methods. Merging callers and
+// callees beyond a page does not reduce the number of pages and i-TLB entries they touch.
+static constexpr size_t kMaxCallChainClusterSize = kPageSize;
+
+// Number of slices of the patched methods per thread, for load balancing.
+static constexpr size_t kPatchTargetSlicesPerThread = 4u;
+
 typedef DexFile::Header __attribute__((aligned(1))) UnalignedDexFileHeader;
 
 const UnalignedDexFileHeader* AsUnalignedDexFileHeader(const uint8_t* raw_data) {
@@ -458,7 +467,8 @@ OatWriter::OatWriter(bool compiling_boot_image,
     relative_patcher_(nullptr),
     absolute_patch_locations_(),
     profile_compilation_info_(info),
-    compact_dex_level_(compact_dex_level) {
+    compact_dex_level_(compact_dex_level),
+    min_parallel_patch_targets_(kDefaultMinParallelPatchTargets) {
   // If we have a profile, always use at least the default compact dex level. The reason behind
   // this is that CompactDex conversion is not more expensive than normal dexlayout.
   if (info != nullptr && compact_dex_level_ == CompactDexLevel::kCompactDexLevelNone) {
@@ -655,6 +665,15 @@ dchecked_vector<std::string> OatWriter::GetSourceLocations() const {
   return locations;
 }
 
+dchecked_vector<uint32_t> OatWriter::GetSourceChecksums() const {
+  dchecked_vector<uint32_t> checksums;
+  checksums.reserve(oat_dex_files_.size());
+  for (const OatDexFile& oat_dex_file : oat_dex_files_) {
+    checksums.push_back(oat_dex_file.dex_file_location_checksum_);
+  }
+  return checksums;
+}
+
 bool OatWriter::MayHaveCompiledMethods() const {
   return CompilerFilter::IsAnyCompilationEnabled(
       GetCompilerDriver()->GetCompilerOptions().GetCompilerFilter());
@@ -1029,7 +1048,6 @@ struct OatWriter::OrderedMethodData {
   // Bin each method according to the profile flags.
   //
   // Groups by e.g.
-  //  -- not hot at all
   //  -- hot
   //  -- hot and startup
   //  -- hot and post-startup
@@ -1037,6 +1055,7 @@ struct OatWriter::OrderedMethodData {
   //  -- startup
   //  -- startup and post-startup
   //  -- post-startup
+  //  -- not hot at all
   //
   // (See MethodHotness enum definition for up-to-date binning order.)
   bool operator<(const OrderedMethodData& other) const {
@@ -1070,7 +1089,8 @@ struct OatWriter::OrderedMethodData {
 
     // Note: Bin-to-bin order does not matter. If the kernel does or does not read-ahead
     // any memory, it only goes into the buffer cache and does not grow the PSS until the first
-    // time that memory is referenced in the process.
+    // time that memory is referenced in the process. Methods not in the profile go last, so
+    // that the profiled methods are contiguous at the start of the code.
 
     size_t hotness_bits = 0;
     for (size_t i = 0; i < arraysize(hotness); ++i) {
@@ -1078,6 +1098,9 @@ struct OatWriter::OrderedMethodData {
         hotness_bits |= (1 << i);
       }
     }
+    if (hotness_bits == 0u) {
+      return kColdMethodOrder;
+    }
 
     if (kIsDebugBuild) {
       // Check for bins that are always-empty given a real profile.
@@ -1092,6 +1115,8 @@ struct OatWriter::OrderedMethodData {
 
     return hotness_bits;
   }
+
+  static constexpr size_t kColdMethodOrder = 1u << 3;
 };
 
 // Given a queue of CompiledMethod in some total order,
@@ -1226,6 +1251,15 @@ class OatWriter::LayoutCodeMethodVisitor : public OatDexMethodVisitor {
       // Since most methods will have the same ordering criteria,
       // we preserve the original insertion order within the same sort order.
       std::stable_sort(ordered_methods_.begin(), ordered_methods_.end());
+      if (!kOatWriterForceOatCodeLayout) {
+        // Place the callers and callees among the profiled methods of each bin close together.
+        auto bin_begin = ordered_methods_.begin();
+        while (bin_begin != ordered_methods_.end() && bin_begin->method_hotness.IsInProfile()) {
+          auto bin_end = std::upper_bound(bin_begin, ordered_methods_.end(), *bin_begin);
+          ClusterCallChains(bin_begin, bin_end);
+          bin_begin = bin_end;
+        }
+      }
     } else {
       // The profile-less behavior is as if every method had 0 hotness
       // associated with it.
@@ -1239,6 +1273,48 @@ class OatWriter::LayoutCodeMethodVisitor : public OatDexMethodVisitor {
   }
 
  private:
+  // Reorder methods with the call-chain clustering (C3) heuristic, see ClusterCallChains() in
+  // libartbase. Call sites are the linker patches that target methods in the range.
+  static void ClusterCallChains(OrderedMethodList::iterator begin,
+                                OrderedMethodList::iterator end) {
+    const size_t num_methods = std::distance(begin, end);
+    if (num_methods < 2u) {
+      return;
+    }
+    SafeMap<MethodReference, size_t> method_indexes;
+    std::vector<size_t> sizes;
+    sizes.reserve(num_methods);
+    for (size_t i = 0; i != num_methods; ++i) {
+      // Duplicate methods share the first index.
+      if (method_indexes.find(begin[i].method_reference) == method_indexes.end()) {
+        method_indexes.Put(begin[i].method_reference, i);
+      }
+      sizes.push_back(
+          sizeof(OatQuickMethodHeader) + begin[i].compiled_method->GetQuickCode().size());
+    }
+    std::vector<std::pair<size_t, size_t>> calls;
+    for (size_t caller = 0; caller != num_methods; ++caller) {
+      for (const LinkerPatch& patch : begin[caller].compiled_method->GetPatches()) {
+        if (patch.GetType() == LinkerPatch::Type::kCallRelative ||
+            patch.GetType() == LinkerPatch::Type::kCall ||
+            patch.GetType() == LinkerPatch::Type::kMethodRelative ||
+            patch.GetType() == LinkerPatch::Type::kMethodBssEntry) {
+          auto it = method_indexes.find(patch.TargetMethod());
+          if (it != method_indexes.end()) {
+            calls.emplace_back(caller, it->second);
+          }
+        }
+      }
+    }
+
+    OrderedMethodList clustered_methods;
+    clustered_methods.reserve(num_methods);
+    for (size_t method : art::ClusterCallChains(sizes, calls, kMaxCallChainClusterSize)) {
+      clustered_methods.push_back(begin[method]);
+    }
+    std::copy(clustered_methods.begin(), clustered_methods.end(), begin);
+  }
+
   // List of compiled methods, later to be sorted by order defined in OrderedMethodData.
   // Methods can be inserted more than once in case of duplicated methods.
   OrderedMethodList ordered_methods_;
@@ -1258,6 +1334,9 @@ class OatWriter::LayoutReserveOffsetCodeMethodVisitor : public OrderedMethodVisi
 
   virtual bool VisitComplete() OVERRIDE {
     offset_ = writer_->relative_patcher_->ReserveSpaceEnd(offset_);
+    if (hot_code_end_ != 0u) {
+      writer_->oat_header_->SetHotCode(hot_code_begin_, hot_code_end_ - hot_code_begin_);
+    }
     if (generate_debug_info_) {
       std::vector<debug::MethodDebugInfo> thunk_infos =
           relative_patcher_->GenerateThunkDebugInfo(executable_offset_);
@@ -1363,6 +1442,13 @@ class OatWriter::LayoutReserveOffsetCodeMethodVisitor : public OrderedMethodVisi
           }
         }
       }
+      // The profiled methods are laid out first, so their code is contiguous.
+      if (method_data.method_hotness.IsInProfile()) {
+        if (hot_code_end_ == 0u) {
+          hot_code_begin_ = code_offset - sizeof(*method_header);
+        }
+        hot_code_end_ = offset_;
+      }
     }
 
     // Exclude quickened dex methods (code_size == 0) since they have no native code.
@@ -1412,6 +1498,8 @@ class OatWriter::LayoutReserveOffsetCodeMethodVisitor : public OrderedMethodVisi
       : OrderedMethodVisitor(std::move(ordered_methods)),
         writer_(writer),
         offset_(offset),
+        hot_code_begin_(0u),
+        hot_code_end_(0u),
         relative_patcher_(writer->relative_patcher_),
         executable_offset_(writer->oat_header_->GetExecutableOffset()),
         debuggable_(compiler_options.GetDebuggable()),
@@ -1459,6 +1547,10 @@ class OatWriter::LayoutReserveOffsetCodeMethodVisitor : public OrderedMethodVisi
   // Offset of the code of the compiled methods.
   size_t offset_;
 
+  // Start and end of the code of the profiled methods, including the method headers.
+  size_t hot_code_begin_;
+  size_t hot_code_end_;
+
   // Deduplication is already done on a pointer basis by the compiler driver,
   // so we can simply compare the pointers to find out if things are duplicated.
   SafeMap<const CompiledMethod*, uint32_t, CodeOffsetsKeyComparator> dedupe_map_;
@@ -1695,23 +1787,260 @@ class OatWriter::InitImageMethodVisitor : public OatDexMethodVisitor {
   std::vector<std::pair<ArtMethod*, ArtMethod*>> methods_to_process_;
 };
 
+// Look up the target offsets of the linker patches of compiled methods. The targets depend only on
+// the code layout, so they can be looked up on several threads before the code is written.
+class OatWriter::PatchTargetResolver {
+ public:
+  explicit PatchTargetResolver(OatWriter* writer)
+      : writer_(writer),
+        pointer_size_(GetInstructionSetPointerSize(writer_->compiler_driver_->GetInstructionSet())),
+        class_loader_(writer->HasImage() ? writer->image_writer_->GetClassLoader() : nullptr),
+        class_linker_(Runtime::Current()->GetClassLinker()),
+        dex_file_(nullptr),
+        dex_cache_(nullptr) {}
+
+  void UpdateDexFileAndDexCache(const DexFile* dex_file)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    dex_file_ = dex_file;
+
+    // Ordered method visiting is only for compiled methods.
+    DCHECK(writer_->MayHaveCompiledMethods());
+
+    if (writer_->GetCompilerDriver()->GetCompilerOptions().IsAotCompilationEnabled()) {
+      // Only need to set the dex cache if we have compilation. Other modes might have unloaded it.
+      if (dex_cache_ == nullptr || dex_cache_->GetDexFile() != dex_file) {
+        dex_cache_ = class_linker_->FindDexCache(Thread::Current(), *dex_file);
+        DCHECK(dex_cache_ != nullptr);
+      }
+    }
+  }
+
+  ObjPtr<mirror::DexCache> GetCurrentDexCache() const {
+    return dex_cache_;
+  }
+
+  // Return the offset a patch of a method from the current dex file refers to,
+  // or 0 for patches without a target.
+  uint32_t GetPatchTargetOffset(const LinkerPatch& patch) REQUIRES_SHARED(Locks::mutator_lock_) {
+    switch (patch.GetType()) {
+      case LinkerPatch::Type::kMethodBssEntry:
+        return writer_->bss_start_ + writer_->bss_method_entries_.Get(patch.TargetMethod());
+      case LinkerPatch::Type::kCallRelative:
+        // NOTE: Relative calls across oat files are not supported.
+      case LinkerPatch::Type::kCall:
+        return GetTargetOffset(patch);
+      case LinkerPatch::Type::kStringRelative:
+        return GetTargetObjectOffset(GetTargetString(patch));
+      case LinkerPatch::Type::kStringInternTable:
+        return GetInternTableEntryOffset(patch);
+      case LinkerPatch::Type::kStringBssEntry: {
+        StringReference ref(patch.TargetStringDexFile(), patch.TargetStringIndex());
+        return writer_->bss_start_ + writer_->bss_string_entries_.Get(ref);
+      }
+      case LinkerPatch::Type::kTypeRelative:
+        return GetTargetObjectOffset(GetTargetType(patch));
+      case LinkerPatch::Type::kTypeClassTable:
+        return GetClassTableEntryOffset(patch);
+      case LinkerPatch::Type::kTypeBssEntry: {
+        TypeReference ref(patch.TargetTypeDexFile(), patch.TargetTypeIndex());
+        return writer_->bss_start_ + writer_->bss_type_entries_.Get(ref);
+      }
+      case LinkerPatch::Type::kMethodRelative:
+        return GetTargetMethodOffset(GetTargetMethod(patch));
+      case LinkerPatch::Type::kBakerReadBarrierBranch:
+        return 0u;
+      default: {
+        DCHECK(false) << "Unexpected linker patch type: " << patch.GetType();
+        return 0u;
+      }
+    }
+  }
+
+ private:
+  OatWriter* const writer_;
+
+  // Pointer size we are compiling to.
+  const PointerSize pointer_size_;
+  // The image writer's classloader, if there is one, else null.
+  ObjPtr<mirror::ClassLoader> class_loader_;
+  ClassLinker* const class_linker_;
+
+  // Potentially varies with every different method.
+  // Used to determine which DexCache to use when finding ArtMethods.
+  const DexFile* dex_file_;
+  ObjPtr<mirror::DexCache> dex_cache_;
+
+  ArtMethod* GetTargetMethod(const LinkerPatch& patch)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    MethodReference ref = patch.TargetMethod();
+    ObjPtr<mirror::DexCache> dex_cache =
+        (dex_file_ == ref.dex_file) ? dex_cache_ : class_linker_->FindDexCache(
+            Thread::Current(), *ref.dex_file);
+    ArtMethod* method =
+        class_linker_->LookupResolvedMethod(ref.index, dex_cache, class_loader_);
+    CHECK(method != nullptr);
+    return method;
+  }
+
+  uint32_t GetTargetOffset(const LinkerPatch& patch) REQUIRES_SHARED(Locks::mutator_lock_) {
+    uint32_t target_offset = writer_->relative_patcher_->GetOffset(patch.TargetMethod());
+    // If there's no new compiled code, either we're compiling an app and the target method
+    // is in the boot image, or we need to point to the correct trampoline.
+    if (UNLIKELY(target_offset == 0)) {
+      ArtMethod* target = GetTargetMethod(patch);
+      DCHECK(target != nullptr);
+      const void* oat_code_offset =
+          target->GetEntryPointFromQuickCompiledCodePtrSize(pointer_size_);
+      if (oat_code_offset != 0) {
+        DCHECK(!writer_->HasBootImage());
+        DCHECK(!Runtime::Current()->GetClassLinker()->IsQuickResolutionStub(oat_code_offset));
+        DCHECK(!Runtime::Current()->GetClassLinker()->IsQuickToInterpreterBridge(oat_code_offset));
+        DCHECK(!Runtime::Current()->GetClassLinker()->IsQuickGenericJniStub(oat_code_offset));
+        target_offset = PointerToLowMemUInt32(oat_code_offset);
+      } else {
+        target_offset = target->IsNative()
+            ? writer_->oat_header_->GetQuickGenericJniTrampolineOffset()
+            : writer_->oat_header_->GetQuickToInterpreterBridgeOffset();
+      }
+    }
+    return target_offset;
+  }
+
+  ObjPtr<mirror::DexCache> GetDexCache(const DexFile* target_dex_file)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    return (target_dex_file == dex_file_)
+        ? dex_cache_
+        : class_linker_->FindDexCache(Thread::Current(), *target_dex_file);
+  }
+
+  ObjPtr<mirror::Class> GetTargetType(const LinkerPatch& patch)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    DCHECK(writer_->HasImage());
+    ObjPtr<mirror::DexCache> dex_cache = GetDexCache(patch.TargetTypeDexFile());
+    ObjPtr<mirror::Class> type =
+        class_linker_->LookupResolvedType(patch.TargetTypeIndex(), dex_cache, class_loader_);
+    CHECK(type != nullptr);
+    return type;
+  }
+
+  ObjPtr<mirror::String> GetTargetString(const LinkerPatch& patch)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    ClassLinker* linker = Runtime::Current()->GetClassLinker();
+    ObjPtr<mirror::String> string =
+        linker->LookupString(patch.TargetStringIndex(), GetDexCache(patch.TargetStringDexFile()));
+    DCHECK(string != nullptr);
+    DCHECK(writer_->HasBootImage() ||
+           Runtime::Current()->GetHeap()->ObjectIsInBootImageSpace(string));
+    return string;
+  }
+
+  uint32_t GetTargetMethodOffset(ArtMethod* method) REQUIRES_SHARED(Locks::mutator_lock_) {
+    DCHECK(writer_->HasBootImage());
+    method = writer_->image_writer_->GetImageMethodAddress(method);
+    size_t oat_index = writer_->image_writer_->GetOatIndexForDexFile(dex_file_);
+    uintptr_t oat_data_begin = writer_->image_writer_->GetOatDataBegin(oat_index);
+    // TODO: Clean up offset types. The target offset must be treated as signed.
+    return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(method) - oat_data_begin);
+  }
+
+  uint32_t GetTargetObjectOffset(ObjPtr<mirror::Object> object)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    DCHECK(writer_->HasBootImage());
+    object = writer_->image_writer_->GetImageAddress(object.Ptr());
+    size_t oat_index = writer_->image_writer_->GetOatIndexForDexFile(dex_file_);
+    uintptr_t oat_data_begin = writer_->image_writer_->GetOatDataBegin(oat_index);
+    // TODO: Clean up offset types. The target offset must be treated as signed.
+    return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(object.Ptr()) - oat_data_begin);
+  }
+
+  // Calculate the offset of the InternTable slot (GcRoot<String>) when mmapped to the .bss.
+  uint32_t GetInternTableEntryOffset(const LinkerPatch& patch)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    DCHECK(!writer_->HasBootImage());
+    const uint8_t* string_root = writer_->LookupBootImageInternTableSlot(
+        *patch.TargetStringDexFile(), patch.TargetStringIndex());
+    DCHECK(string_root != nullptr);
+    return GetBootImageTableEntryOffset(string_root);
+  }
+
+  // Calculate the offset of the ClassTable::TableSlot when mmapped to the .bss.
+  uint32_t GetClassTableEntryOffset(const LinkerPatch& patch)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    DCHECK(!writer_->HasBootImage());
+    const uint8_t* table_slot =
+        writer_->LookupBootImageClassTableSlot(*patch.TargetTypeDexFile(), patch.TargetTypeIndex());
+    DCHECK(table_slot != nullptr);
+    return GetBootImageTableEntryOffset(table_slot);
+  }
+
+  uint32_t GetBootImageTableEntryOffset(const uint8_t* raw_root) {
+    uint32_t base_offset = writer_->bss_start_;
+    for (gc::space::ImageSpace* space : Runtime::Current()->GetHeap()->GetBootImageSpaces()) {
+      const uint8_t* const_tables_begin =
+          space->Begin() + space->GetImageHeader().GetBootImageConstantTablesOffset();
+      size_t offset = static_cast<size_t>(raw_root - const_tables_begin);
+      if (offset < space->GetImageHeader().GetBootImageConstantTablesSize()) {
+        DCHECK_LE(base_offset + offset, writer_->bss_start_ + writer_->bss_methods_offset_);
+        return base_offset + offset;
+      }
+      base_offset += space->GetImageHeader().GetBootImageConstantTablesSize();
+    }
+    LOG(FATAL) << "Didn't find boot image string in boot image intern tables!";
+    UNREACHABLE();
+  }
+};
+
+// Look up the targets of the patches of a slice of the methods to write.
+class OatWriter::ResolvePatchTargetsTask FINAL : public Task {
+ public:
+  ResolvePatchTargetsTask(OatWriter* writer,
+                          ArrayRef<const OrderedMethodData* const> methods,
+                          uint32_t* patch_targets)
+      : writer_(writer),
+        methods_(methods),
+        patch_targets_(patch_targets) {}
+
+  void Run(Thread* self) OVERRIDE {
+    ScopedObjectAccess soa(self);
+    PatchTargetResolver resolver(writer_);
+    uint32_t* patch_target = patch_targets_;
+    for (const OrderedMethodData* method_data : methods_) {
+      resolver.UpdateDexFileAndDexCache(method_data->method_reference.dex_file);
+      for (const LinkerPatch& patch : method_data->compiled_method->GetPatches()) {
+        *patch_target = resolver.GetPatchTargetOffset(patch);
+        ++patch_target;
+      }
+    }
+  }
+
+  void Finalize() OVERRIDE {
+    delete this;
+  }
+
+ private:
+  OatWriter* const writer_;
+  const ArrayRef<const OrderedMethodData* const> methods_;
+  uint32_t* const patch_targets_;
+
+  DISALLOW_COPY_AND_ASSIGN(ResolvePatchTargetsTask);
+};
+
 class OatWriter::WriteCodeMethodVisitor : public OrderedMethodVisitor {
  public:
   WriteCodeMethodVisitor(OatWriter* writer,
                          OutputStream* out,
                          const size_t file_offset,
                          size_t relative_offset,
-                         OrderedMethodList ordered_methods)
+                         OrderedMethodList ordered_methods,
+                         const std::vector<uint32_t>* patch_targets)
       : OrderedMethodVisitor(std::move(ordered_methods)),
         writer_(writer),
         offset_(relative_offset),
-        dex_file_(nullptr),
-        pointer_size_(GetInstructionSetPointerSize(writer_->compiler_driver_->GetInstructionSet())),
-        class_loader_(writer->HasImage() ? writer->image_writer_->GetClassLoader() : nullptr),
         out_(out),
         file_offset_(file_offset),
-        class_linker_(Runtime::Current()->GetClassLinker()),
-        dex_cache_(nullptr),
+        resolver_(writer),
+        patch_targets_(patch_targets),
+        next_patch_target_(0u),
         no_thread_suspension_("OatWriter patching") {
     patched_code_.reserve(16 * KB);
     if (writer_->HasBootImage()) {
@@ -1724,23 +2053,8 @@ class OatWriter::WriteCodeMethodVisitor : public OrderedMethodVisitor {
     return true;
   }
 
-  void UpdateDexFileAndDexCache(const DexFile* dex_file)
-      REQUIRES_SHARED(Locks::mutator_lock_) {
-    dex_file_ = dex_file;
-
-    // Ordered method visiting is only for compiled methods.
-    DCHECK(writer_->MayHaveCompiledMethods());
-
-    if (writer_->GetCompilerDriver()->GetCompilerOptions().IsAotCompilationEnabled()) {
-      // Only need to set the dex cache if we have compilation. Other modes might have unloaded it.
-      if (dex_cache_ == nullptr || dex_cache_->GetDexFile() != dex_file) {
-        dex_cache_ = class_linker_->FindDexCache(Thread::Current(), *dex_file);
-        DCHECK(dex_cache_ != nullptr);
-      }
-    }
-  }
-
   virtual bool VisitComplete() {
+    DCHECK(patch_targets_ == nullptr || next_patch_target_ == patch_targets_->size());
     offset_ = writer_->relative_patcher_->WriteThunks(out_, offset_);
     if (UNLIKELY(offset_ == 0u)) {
       PLOG(ERROR) << "Failed to write final relative call thunks";
@@ -1752,7 +2066,7 @@ class OatWriter::WriteCodeMethodVisitor : public OrderedMethodVisitor {
   virtual bool VisitMethod(const OrderedMethodData& method_data) OVERRIDE
       REQUIRES_SHARED(Locks::mutator_lock_) {
     const MethodReference& method_ref = method_data.method_reference;
-    UpdateDexFileAndDexCache(method_ref.dex_file);
+    resolver_.UpdateDexFileAndDexCache(method_ref.dex_file);
 
     OatClass* oat_class = method_data.oat_class;
     CompiledMethod* compiled_method = method_data.compiled_method;
@@ -1790,7 +2104,7 @@ class OatWriter::WriteCodeMethodVisitor : public OrderedMethodVisitor {
                            GetInstructionSetAlignment(compiled_method->GetInstructionSet()));
       DCHECK_EQ(method_offsets.code_offset_,
                 offset_ + sizeof(OatQuickMethodHeader) + compiled_method->CodeDelta())
-          << dex_file_->PrettyMethod(method_ref.index);
+          << method_ref.PrettyMethod();
       const OatQuickMethodHeader& method_header =
           oat_class->method_headers_[method_offsets_index];
       if (!out->WriteFully(&method_header, sizeof(method_header))) {
@@ -1806,70 +2120,24 @@ class OatWriter::WriteCodeMethodVisitor : public OrderedMethodVisitor {
         quick_code = ArrayRef<const uint8_t>(patched_code_);
         for (const LinkerPatch& patch : compiled_method->GetPatches()) {
           uint32_t literal_offset = patch.LiteralOffset();
+          uint32_t target_offset = GetPatchTargetOffset(patch);
           switch (patch.GetType()) {
-            case LinkerPatch::Type::kMethodBssEntry: {
-              uint32_t target_offset =
-                  writer_->bss_start_ + writer_->bss_method_entries_.Get(patch.TargetMethod());
-              writer_->relative_patcher_->PatchPcRelativeReference(&patched_code_,
-                                                                   patch,
-                                                                   offset_ + literal_offset,
-                                                                   target_offset);
-              break;
-            }
             case LinkerPatch::Type::kCallRelative: {
               // NOTE: Relative calls across oat files are not supported.
-              uint32_t target_offset = GetTargetOffset(patch);
               writer_->relative_patcher_->PatchCall(&patched_code_,
                                                     literal_offset,
                                                     offset_ + literal_offset,
                                                     target_offset);
               break;
             }
-            case LinkerPatch::Type::kStringRelative: {
-              uint32_t target_offset = GetTargetObjectOffset(GetTargetString(patch));
-              writer_->relative_patcher_->PatchPcRelativeReference(&patched_code_,
-                                                                   patch,
-                                                                   offset_ + literal_offset,
-                                                                   target_offset);
-              break;
-            }
-            case LinkerPatch::Type::kStringInternTable: {
-              uint32_t target_offset = GetInternTableEntryOffset(patch);
-              writer_->relative_patcher_->PatchPcRelativeReference(&patched_code_,
-                                                                   patch,
-                                                                   offset_ + literal_offset,
-                                                                   target_offset);
-              break;
-            }
-            case LinkerPatch::Type::kStringBssEntry: {
-              StringReference ref(patch.TargetStringDexFile(), patch.TargetStringIndex());
-              uint32_t target_offset =
-                  writer_->bss_start_ + writer_->bss_string_entries_.Get(ref);
-              writer_->relative_patcher_->PatchPcRelativeReference(&patched_code_,
-                                                                   patch,
-                                                                   offset_ + literal_offset,
-                                                                   target_offset);
-              break;
-            }
-            case LinkerPatch::Type::kTypeRelative: {
-              uint32_t target_offset = GetTargetObjectOffset(GetTargetType(patch));
-              writer_->relative_patcher_->PatchPcRelativeReference(&patched_code_,
-                                                                   patch,
-                                                                   offset_ + literal_offset,
-                                                                   target_offset);
-              break;
-            }
-            case LinkerPatch::Type::kTypeClassTable: {
-              uint32_t target_offset = GetClassTableEntryOffset(patch);
-              writer_->relative_patcher_->PatchPcRelativeReference(&patched_code_,
-                                                                   patch,
-                                                                   offset_ + literal_offset,
-                                                                   target_offset);
-              break;
-            }
-            case LinkerPatch::Type::kTypeBssEntry: {
-              TypeReference ref(patch.TargetTypeDexFile(), patch.TargetTypeIndex());
-              uint32_t target_offset = writer_->bss_start_ + writer_->bss_type_entries_.Get(ref);
+            case LinkerPatch::Type::kMethodBssEntry:
+            case LinkerPatch::Type::kStringRelative:
+            case LinkerPatch::Type::kStringInternTable:
+            case LinkerPatch::Type::kStringBssEntry:
+            case LinkerPatch::Type::kTypeRelative:
+            case LinkerPatch::Type::kTypeClassTable:
+            case LinkerPatch::Type::kTypeBssEntry:
+            case LinkerPatch::Type::kMethodRelative: {
               writer_->relative_patcher_->PatchPcRelativeReference(&patched_code_,
                                                                    patch,
                                                                    offset_ + literal_offset,
@@ -1877,18 +2145,9 @@ class OatWriter::WriteCodeMethodVisitor : public OrderedMethodVisitor {
               break;
             }
             case LinkerPatch::Type::kCall: {
-              uint32_t target_offset = GetTargetOffset(patch);
               PatchCodeAddress(&patched_code_, literal_offset, target_offset);
               break;
             }
-            case LinkerPatch::Type::kMethodRelative: {
-              uint32_t target_offset = GetTargetMethodOffset(GetTargetMethod(patch));
-              writer_->relative_patcher_->PatchPcRelativeReference(&patched_code_,
-                                                                   patch,
-                                                                   offset_ + literal_offset,
-                                                                   target_offset);
-              break;
-            }
             case LinkerPatch::Type::kBakerReadBarrierBranch: {
               writer_->relative_patcher_->PatchBakerReadBarrierBranch(&patched_code_,
                                                                       patch,
@@ -1925,19 +2184,14 @@ class OatWriter::WriteCodeMethodVisitor : public OrderedMethodVisitor {
   // Updated in VisitMethod as methods are written out.
   size_t offset_;
 
-  // Potentially varies with every different VisitMethod.
-  // Used to determine which DexCache to use when finding ArtMethods.
-  const DexFile* dex_file_;
-
-  // Pointer size we are compiling to.
-  const PointerSize pointer_size_;
-  // The image writer's classloader, if there is one, else null.
-  ObjPtr<mirror::ClassLoader> class_loader_;
   // Stream to output file, where the OAT code will be written to.
   OutputStream* const out_;
   const size_t file_offset_;
-  ClassLinker* const class_linker_;
-  ObjPtr<mirror::DexCache> dex_cache_;
+  PatchTargetResolver resolver_;
+  // Targets of the patches of the written methods in writing order, if they were looked up
+  // before writing, else null.
+  const std::vector<uint32_t>* const patch_targets_;
+  size_t next_patch_target_;
   std::vector<uint8_t> patched_code_;
   const ScopedAssertNoThreadSuspension no_thread_suspension_;
 
@@ -1946,87 +2200,15 @@ class OatWriter::WriteCodeMethodVisitor : public OrderedMethodVisitor {
         << method_ref.PrettyMethod() << " to " << out_->GetLocation();
   }
 
-  ArtMethod* GetTargetMethod(const LinkerPatch& patch)
-      REQUIRES_SHARED(Locks::mutator_lock_) {
-    MethodReference ref = patch.TargetMethod();
-    ObjPtr<mirror::DexCache> dex_cache =
-        (dex_file_ == ref.dex_file) ? dex_cache_ : class_linker_->FindDexCache(
-            Thread::Current(), *ref.dex_file);
-    ArtMethod* method =
-        class_linker_->LookupResolvedMethod(ref.index, dex_cache, class_loader_);
-    CHECK(method != nullptr);
-    return method;
-  }
-
-  uint32_t GetTargetOffset(const LinkerPatch& patch) REQUIRES_SHARED(Locks::mutator_lock_) {
-    uint32_t target_offset = writer_->relative_patcher_->GetOffset(patch.TargetMethod());
-    // If there's no new compiled code, either we're compiling an app and the target method
-    // is in the boot image, or we need to point to the correct trampoline.
-    if (UNLIKELY(target_offset == 0)) {
-      ArtMethod* target = GetTargetMethod(patch);
-      DCHECK(target != nullptr);
-      const void* oat_code_offset =
-          target->GetEntryPointFromQuickCompiledCodePtrSize(pointer_size_);
-      if (oat_code_offset != 0) {
-        DCHECK(!writer_->HasBootImage());
-        DCHECK(!Runtime::Current()->GetClassLinker()->IsQuickResolutionStub(oat_code_offset));
-        DCHECK(!Runtime::Current()->GetClassLinker()->IsQuickToInterpreterBridge(oat_code_offset));
-        DCHECK(!Runtime::Current()->GetClassLinker()->IsQuickGenericJniStub(oat_code_offset));
-        target_offset = PointerToLowMemUInt32(oat_code_offset);
-      } else {
-        target_offset = target->IsNative()
-            ? writer_->oat_header_->GetQuickGenericJniTrampolineOffset()
-            : writer_->oat_header_->GetQuickToInterpreterBridgeOffset();
-      }
+  uint32_t GetPatchTargetOffset(const LinkerPatch& patch) REQUIRES_SHARED(Locks::mutator_lock_) {
+    if (patch_targets_ != nullptr) {
+      DCHECK_LT(next_patch_target_, patch_targets_->size());
+      uint32_t target_offset = (*patch_targets_)[next_patch_target_];
+      ++next_patch_target_;
+      DCHECK_EQ(target_offset, resolver_.GetPatchTargetOffset(patch));
+      return target_offset;
     }
-    return target_offset;
-  }
-
-  ObjPtr<mirror::DexCache> GetDexCache(const DexFile* target_dex_file)
-      REQUIRES_SHARED(Locks::mutator_lock_) {
-    return (target_dex_file == dex_file_)
-        ? dex_cache_
-        : class_linker_->FindDexCache(Thread::Current(), *target_dex_file);
-  }
-
-  ObjPtr<mirror::Class> GetTargetType(const LinkerPatch& patch)
-      REQUIRES_SHARED(Locks::mutator_lock_) {
-    DCHECK(writer_->HasImage());
-    ObjPtr<mirror::DexCache> dex_cache = GetDexCache(patch.TargetTypeDexFile());
-    ObjPtr<mirror::Class> type =
-        class_linker_->LookupResolvedType(patch.TargetTypeIndex(), dex_cache, class_loader_);
-    CHECK(type != nullptr);
-    return type;
-  }
-
-  ObjPtr<mirror::String> GetTargetString(const LinkerPatch& patch)
-      REQUIRES_SHARED(Locks::mutator_lock_) {
-    ClassLinker* linker = Runtime::Current()->GetClassLinker();
-    ObjPtr<mirror::String> string =
-        linker->LookupString(patch.TargetStringIndex(), GetDexCache(patch.TargetStringDexFile()));
-    DCHECK(string != nullptr);
-    DCHECK(writer_->HasBootImage() ||
-           Runtime::Current()->GetHeap()->ObjectIsInBootImageSpace(string));
-    return string;
-  }
-
-  uint32_t GetTargetMethodOffset(ArtMethod* method) REQUIRES_SHARED(Locks::mutator_lock_) {
-    DCHECK(writer_->HasBootImage());
-    method = writer_->image_writer_->GetImageMethodAddress(method);
-    size_t oat_index = writer_->image_writer_->GetOatIndexForDexFile(dex_file_);
-    uintptr_t oat_data_begin = writer_->image_writer_->GetOatDataBegin(oat_index);
-    // TODO: Clean up offset types. The target offset must be treated as signed.
-    return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(method) - oat_data_begin);
-  }
-
-  uint32_t GetTargetObjectOffset(ObjPtr<mirror::Object> object)
-      REQUIRES_SHARED(Locks::mutator_lock_) {
-    DCHECK(writer_->HasBootImage());
-    object = writer_->image_writer_->GetImageAddress(object.Ptr());
-    size_t oat_index = writer_->image_writer_->GetOatIndexForDexFile(dex_file_);
-    uintptr_t oat_data_begin = writer_->image_writer_->GetOatDataBegin(oat_index);
-    // TODO: Clean up offset types. The target offset must be treated as signed.
-    return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(object.Ptr()) - oat_data_begin);
+    return resolver_.GetPatchTargetOffset(patch);
   }
 
   void PatchObjectAddress(std::vector<uint8_t>* code, uint32_t offset, mirror::Object* object)
@@ -2053,7 +2235,8 @@ class OatWriter::WriteCodeMethodVisitor : public OrderedMethodVisitor {
       REQUIRES_SHARED(Locks::mutator_lock_) {
     uint32_t address = target_offset;
     if (writer_->HasBootImage()) {
-      size_t oat_index = writer_->image_writer_->GetOatIndexForDexCache(dex_cache_);
+      size_t oat_index =
+          writer_->image_writer_->GetOatIndexForDexCache(resolver_.GetCurrentDexCache());
       // TODO: Clean up offset types.
       // The target_offset must be treated as signed for cross-oat patching.
       const void* target = reinterpret_cast<const void*>(
@@ -2069,41 +2252,6 @@ class OatWriter::WriteCodeMethodVisitor : public OrderedMethodVisitor {
     data[3] = (address >> 24) & 0xffu;
   }
 
-  // Calculate the offset of the InternTable slot (GcRoot<String>) when mmapped to the .bss.
-  uint32_t GetInternTableEntryOffset(const LinkerPatch& patch)
-      REQUIRES_SHARED(Locks::mutator_lock_) {
-    DCHECK(!writer_->HasBootImage());
-    const uint8_t* string_root = writer_->LookupBootImageInternTableSlot(
-        *patch.TargetStringDexFile(), patch.TargetStringIndex());
-    DCHECK(string_root != nullptr);
-    return GetBootImageTableEntryOffset(string_root);
-  }
-
-  // Calculate the offset of the ClassTable::TableSlot when mmapped to the .bss.
-  uint32_t GetClassTableEntryOffset(const LinkerPatch& patch)
-      REQUIRES_SHARED(Locks::mutator_lock_) {
-    DCHECK(!writer_->HasBootImage());
-    const uint8_t* table_slot =
-        writer_->LookupBootImageClassTableSlot(*patch.TargetTypeDexFile(), patch.TargetTypeIndex());
-    DCHECK(table_slot != nullptr);
-    return GetBootImageTableEntryOffset(table_slot);
-  }
-
-  uint32_t GetBootImageTableEntryOffset(const uint8_t* raw_root) {
-    uint32_t base_offset = writer_->bss_start_;
-    for (gc::space::ImageSpace* space : Runtime::Current()->GetHeap()->GetBootImageSpaces()) {
-      const uint8_t* const_tables_begin =
-          space->Begin() + space->GetImageHeader().GetBootImageConstantTablesOffset();
-      size_t offset = static_cast<size_t>(raw_root - const_tables_begin);
-      if (offset < space->GetImageHeader().GetBootImageConstantTablesSize()) {
-        DCHECK_LE(base_offset + offset, writer_->bss_start_ + writer_->bss_methods_offset_);
-        return base_offset + offset;
-      }
-      base_offset += space->GetImageHeader().GetBootImageConstantTablesSize();
-    }
-    LOG(FATAL) << "Didn't find boot image string in boot image intern tables!";
-    UNREACHABLE();
-  }
 };
 
 class OatWriter::WriteMapMethodVisitor : public OatDexMethodVisitor {
@@ -2498,10 +2646,12 @@ size_t OatWriter::InitOatCodeDexFiles(size_t offset) {
   {
     ScopedObjectAccess soa(Thread::Current());
 
+    TimingLogger::ScopedTiming split("LayoutCode", timings_);
     LayoutCodeMethodVisitor layout_code_visitor(this, offset);
     success = VisitDexMethods(&layout_code_visitor);
     DCHECK(success);
 
+    split.NewTiming("ReserveCodeOffsets");
     LayoutReserveOffsetCodeMethodVisitor layout_reserve_code_visitor(
         this,
         offset,
@@ -2531,6 +2681,7 @@ size_t OatWriter::InitOatCodeDexFiles(size_t offset) {
   }
 
   if (HasImage()) {
+    TimingLogger::ScopedTiming split("InitImageMethods", timings_);
     InitImageMethodVisitor image_visitor(this, offset, dex_files_);
     success = VisitDexMethods(&image_visitor);
     image_visitor.Postprocess();
@@ -3313,6 +3464,59 @@ size_t OatWriter::WriteCode(OutputStream* out, size_t file_offset, size_t relati
   return relative_offset;
 }
 
+void OatWriter::ResolvePatchTargets(const OrderedMethodList& ordered_methods,
+                                    /*out*/ std::vector<uint32_t>* patch_targets) {
+  DCHECK(patch_targets->empty());
+  // Collect the methods with patches that WriteCodeMethodVisitor writes, in the same order.
+  // Duplicate methods share the code of the first method with the same code offset.
+  std::vector<const OrderedMethodData*> patched_methods;
+  size_t num_patches = 0u;
+  uint32_t last_code_offset = 0u;
+  for (const OrderedMethodData& method_data : ordered_methods) {
+    const OatMethodOffsets& method_offsets =
+        method_data.oat_class->method_offsets_[method_data.method_offsets_index];
+    if (method_offsets.code_offset_ > last_code_offset) {
+      last_code_offset = method_offsets.code_offset_;
+      size_t method_patches = method_data.compiled_method->GetPatches().size();
+      if (method_patches != 0u) {
+        patched_methods.push_back(&method_data);
+        num_patches += method_patches;
+      }
+    }
+  }
+  const size_t num_threads = compiler_driver_->GetThreadCount();
+  if (num_threads <= 1u || num_patches < min_parallel_patch_targets_) {
+    // WriteCodeMethodVisitor looks up the targets while writing.
+    return;
+  }
+
+  // Split the methods into slices with similar numbers of patches. The targets of a slice
+  // start after the targets of all the patches of the previous slices.
+  patch_targets->resize(num_patches);
+  Thread* const self = Thread::Current();
+  ThreadPool thread_pool("Oat writer thread pool", num_threads - 1u);
+  const size_t num_slices = num_threads * kPatchTargetSlicesPerThread;
+  const size_t slice_patches = RoundUp(num_patches, num_slices) / num_slices;
+  size_t slice_begin = 0u;
+  size_t slice_patches_begin = 0u;
+  size_t patches_end = 0u;
+  for (size_t i = 0; i != patched_methods.size(); ++i) {
+    patches_end += patched_methods[i]->compiled_method->GetPatches().size();
+    if (patches_end - slice_patches_begin >= slice_patches || i + 1u == patched_methods.size()) {
+      ArrayRef<const OrderedMethodData* const> slice(patched_methods.data() + slice_begin,
+                                                     i + 1u - slice_begin);
+      thread_pool.AddTask(self, new ResolvePatchTargetsTask(
+          this, slice, patch_targets->data() + slice_patches_begin));
+      slice_begin = i + 1u;
+      slice_patches_begin = patches_end;
+    }
+  }
+  DCHECK_EQ(patches_end, num_patches);
+  thread_pool.StartWorkers(self);
+  // The calling thread looks up targets too.
+  thread_pool.Wait(self, /* do_work */ true, /* may_hold_locks */ false);
+}
+
 size_t OatWriter::WriteCodeDexFiles(OutputStream* out,
                                     size_t file_offset,
                                     size_t relative_offset) {
@@ -3327,15 +3531,22 @@ size_t OatWriter::WriteCodeDexFiles(OutputStream* out,
 
     return relative_offset;
   }
-  ScopedObjectAccess soa(Thread::Current());
   DCHECK(ordered_methods_ != nullptr);
   std::unique_ptr<OrderedMethodList> ordered_methods_ptr =
       std::move(ordered_methods_);
+  std::vector<uint32_t> patch_targets;
+  {
+    TimingLogger::ScopedTiming split("ResolvePatchTargets", timings_);
+    ResolvePatchTargets(*ordered_methods_ptr, &patch_targets);
+  }
+  TimingLogger::ScopedTiming split("WriteCodeMethods", timings_);
+  ScopedObjectAccess soa(Thread::Current());
   WriteCodeMethodVisitor visitor(this,
                                  out,
                                  file_offset,
                                  relative_offset,
-                                 std::move(*ordered_methods_ptr));
+                                 std::move(*ordered_methods_ptr),
+                                 patch_targets.empty() ? nullptr : &patch_targets);
   if (UNLIKELY(!visitor.Visit())) {
     return 0;
   }
@@ -4421,7 +4632,7 @@ bool OatWriter::OatClass::Write(OatWriter* oat_writer, OutputStream* out) const
 
 const uint8_t* OatWriter::LookupBootImageInternTableSlot(const DexFile& dex_file,
                                                          dex::StringIndex string_idx)
-    NO_THREAD_SAFETY_ANALYSIS {  // Single-threaded OatWriter can avoid locking.
+    NO_THREAD_SAFETY_ANALYSIS {  // The tables do not change while writing, so no locking.
   uint32_t utf16_length;
   const char* utf8_data = dex_file.StringDataAndUtf16LengthByIdx(string_idx, &utf16_length);
   DCHECK_EQ(utf16_length, CountModifiedUtf8Chars(utf8_data));
@@ -4441,7 +4652,7 @@ const uint8_t* OatWriter::LookupBootImageInternTableSlot(const DexFile& dex_file
 
 const uint8_t* OatWriter::LookupBootImageClassTableSlot(const DexFile& dex_file,
                                                         dex::TypeIndex type_idx)
-    NO_THREAD_SAFETY_ANALYSIS {  // Single-threaded OatWriter can avoid locking.
+    NO_THREAD_SAFETY_ANALYSIS {  // The tables do not change while writing, so no locking.
   const char* descriptor = dex_file.StringByTypeIdx(type_idx);
   ClassTable::DescriptorHashPair pair(descriptor, ComputeModifiedUtf8Hash(descriptor));
   ClassTable* table = Runtime::Current()->GetClassLinker()->boot_class_table_.get();
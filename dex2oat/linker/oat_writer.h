@@ -162,6 +162,7 @@ class OatWriter {
       const char* location,
       CreateTypeLookupTable create_type_lookup_table = CreateTypeLookupTable::kDefault);
   dchecked_vector<std::string> GetSourceLocations() const;
+  dchecked_vector<uint32_t> GetSourceChecksums() const;
 
   // Write raw dex files to the vdex file, mmap the file and open the dex files from it.
   // Supporting data structures are written into the .rodata section of the oat file.
@@ -250,6 +251,16 @@ class OatWriter {
     return compiler_driver_;
   }
 
+  // By default, look up the targets of the linker patches on several threads
+  // only if there are at least this many patches to write.
+  static constexpr size_t kDefaultMinParallelPatchTargets = 4096u;
+
+  // Set the minimum number of patches to look up on several threads. Tests use a low
+  // value to exercise the parallel lookup with small dex files.
+  void SetMinParallelPatchTargets(size_t min_parallel_patch_targets) {
+    min_parallel_patch_targets_ = min_parallel_patch_targets;
+  }
+
  private:
   class DexFileSource;
   class OatClassHeader;
@@ -273,6 +284,8 @@ class OatWriter {
   class InitMapMethodVisitor;
   class InitMethodInfoVisitor;
   class InitImageMethodVisitor;
+  class PatchTargetResolver;
+  class ResolvePatchTargetsTask;
   class WriteCodeMethodVisitor;
   class WriteMapMethodVisitor;
   class WriteMethodInfoVisitor;
@@ -332,6 +345,10 @@ class OatWriter {
   size_t WriteOatDexFiles(OutputStream* out, size_t file_offset, size_t relative_offset);
   size_t WriteCode(OutputStream* out, size_t file_offset, size_t relative_offset);
   size_t WriteCodeDexFiles(OutputStream* out, size_t file_offset, size_t relative_offset);
+  // Look up the targets of the linker patches of the methods to write on several threads,
+  // if that is worthwhile, or leave `patch_targets` empty.
+  void ResolvePatchTargets(const std::vector<OrderedMethodData>& ordered_methods,
+                           /*out*/ std::vector<uint32_t>* patch_targets);
 
   bool RecordOatDataOffset(OutputStream* out);
   bool WriteTypeLookupTables(OutputStream* oat_rodata,
@@ -525,6 +542,9 @@ class OatWriter {
   // Compact dex level that is generated.
   CompactDexLevel compact_dex_level_;
 
+  // Minimum number of patches to look up on several threads in ResolvePatchTargets().
+  size_t min_parallel_patch_targets_;
+
   using OrderedMethodList = std::vector<OrderedMethodData>;
 
   // List of compiled methods, sorted by the order defined in OrderedMethodData.
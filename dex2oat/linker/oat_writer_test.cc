@@ -19,6 +19,7 @@
 #include "arch/instruction_set_features.h"
 #include "art_method-inl.h"
 #include "base/enums.h"
+#include "base/file_utils.h"
 #include "base/stl_util.h"
 #include "base/unix_file/fd_file.h"
 #include "class_linker.h"
@@ -121,12 +122,15 @@ class OatTest : public CommonCompilerTest {
                 File* oat_file,
                 const std::vector<const DexFile*>& dex_files,
                 SafeMap<std::string, std::string>& key_value_store,
-                bool verify) {
+                bool verify,
+                ProfileCompilationInfo* profile_compilation_info = nullptr,
+                size_t min_parallel_patch_targets = OatWriter::kDefaultMinParallelPatchTargets) {
     TimingLogger timings("WriteElf", false, false);
     OatWriter oat_writer(/*compiling_boot_image*/false,
                          &timings,
-                         /*profile_compilation_info*/nullptr,
+                         profile_compilation_info,
                          CompactDexLevel::kCompactDexLevelNone);
+    oat_writer.SetMinParallelPatchTargets(min_parallel_patch_targets);
     for (const DexFile* dex_file : dex_files) {
       ArrayRef<const uint8_t> raw_dex_file(
           reinterpret_cast<const uint8_t*>(&dex_file->GetHeader()),
@@ -137,7 +141,9 @@ class OatTest : public CommonCompilerTest {
         return false;
       }
     }
-    return DoWriteElf(vdex_file, oat_file, oat_writer, key_value_store, verify);
+    // The compiled methods, if any, belong to `dex_files` rather than to the dex files
+    // opened from the vdex file.
+    return DoWriteElf(vdex_file, oat_file, oat_writer, key_value_store, verify, &dex_files);
   }
 
   bool WriteElf(File* vdex_file,
@@ -180,7 +186,8 @@ class OatTest : public CommonCompilerTest {
                   File* oat_file,
                   OatWriter& oat_writer,
                   SafeMap<std::string, std::string>& key_value_store,
-                  bool verify) {
+                  bool verify,
+                  const std::vector<const DexFile*>* compiled_dex_files = nullptr) {
     std::unique_ptr<ElfWriter> elf_writer = CreateElfWriterQuick(
         compiler_driver_->GetInstructionSet(),
         compiler_driver_->GetInstructionSetFeatures(),
@@ -214,7 +221,9 @@ class OatTest : public CommonCompilerTest {
     }
     MultiOatRelativePatcher patcher(compiler_driver_->GetInstructionSet(),
                                     instruction_set_features_.get());
-    oat_writer.Initialize(compiler_driver_.get(), nullptr, dex_files);
+    oat_writer.Initialize(compiler_driver_.get(),
+                          nullptr,
+                          (compiled_dex_files != nullptr) ? *compiled_dex_files : dex_files);
     oat_writer.PrepareLayout(&patcher);
     size_t rodata_size = oat_writer.GetOatHeader().GetExecutableOffset();
     size_t text_size = oat_writer.GetOatSize() - rodata_size;
@@ -488,7 +497,7 @@ TEST_F(OatTest, WriteRead) {
 TEST_F(OatTest, OatHeaderSizeCheck) {
   // If this test is failing and you have to update these constants,
   // it is time to update OatHeader::kOatVersion
-  EXPECT_EQ(76U, sizeof(OatHeader));
+  EXPECT_EQ(84U, sizeof(OatHeader));
   EXPECT_EQ(4U, sizeof(OatMethodOffsets));
   EXPECT_EQ(24U, sizeof(OatQuickMethodHeader));
   EXPECT_EQ(162 * static_cast<size_t>(GetInstructionSetPointerSize(kRuntimeISA)),
@@ -569,6 +578,233 @@ TEST_F(OatTest, EmptyTextSection) {
             static_cast<size_t>(tmp_oat.GetFile()->GetLength()));
 }
 
+TEST_F(OatTest, ParallelPatchTargets) {
+  TimingLogger timings("OatTest::ParallelPatchTargets", false, false);
+
+  InstructionSet insn_set = kRuntimeISA;
+  if (insn_set == InstructionSet::kArm) insn_set = InstructionSet::kThumb2;
+  std::string error_msg;
+  SetupCompiler(Compiler::kOptimizing, insn_set, std::vector<std::string>(), /*out*/ &error_msg);
+  // The calling thread and a pool worker look up the patch targets.
+  ASSERT_GT(compiler_driver_->GetThreadCount(), 1u);
+
+  jobject class_loader;
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    class_loader = LoadDex("ManyMethods");
+  }
+  ASSERT_TRUE(class_loader != nullptr);
+  std::vector<const DexFile*> dex_files = GetDexFiles(class_loader);
+  ASSERT_TRUE(!dex_files.empty());
+
+  ClassLinker* const class_linker = Runtime::Current()->GetClassLinker();
+  for (const DexFile* dex_file : dex_files) {
+    ScopedObjectAccess soa(Thread::Current());
+    class_linker->RegisterDexFile(*dex_file,
+                                  soa.Decode<mirror::ClassLoader>(class_loader).Ptr());
+  }
+  compiler_driver_->SetDexFilesForOatFile(dex_files);
+  compiler_driver_->CompileAll(class_loader, dex_files, &timings);
+
+  // The dex file is too small for the default threshold, so by default the writer
+  // looks up the patch targets while writing the code.
+  size_t num_patches = 0u;
+  for (const DexFile* dex_file : dex_files) {
+    for (uint32_t method_idx = 0; method_idx != dex_file->NumMethodIds(); ++method_idx) {
+      const CompiledMethod* compiled_method =
+          compiler_driver_->GetCompiledMethod(MethodReference(dex_file, method_idx));
+      if (compiled_method != nullptr) {
+        num_patches += compiled_method->GetPatches().size();
+      }
+    }
+  }
+  ASSERT_NE(0u, num_patches);
+  ASSERT_LT(num_patches, OatWriter::kDefaultMinParallelPatchTargets);
+
+  SafeMap<std::string, std::string> key_value_store;
+  key_value_store.Put(OatHeader::kImageLocationKey, "test.art");
+  ScratchFile serial_base, serial_oat(serial_base, ".oat"), serial_vdex(serial_base, ".vdex");
+  bool success = WriteElf(serial_vdex.GetFile(),
+                          serial_oat.GetFile(),
+                          dex_files,
+                          key_value_store,
+                          /* verify */ false);
+  ASSERT_TRUE(success);
+  ScratchFile parallel_base,
+              parallel_oat(parallel_base, ".oat"),
+              parallel_vdex(parallel_base, ".vdex");
+  success = WriteElf(parallel_vdex.GetFile(),
+                     parallel_oat.GetFile(),
+                     dex_files,
+                     key_value_store,
+                     /* verify */ false,
+                     /* profile_compilation_info */ nullptr,
+                     /* min_parallel_patch_targets */ 1u);
+  ASSERT_TRUE(success);
+
+  // Looking up the patch targets on several threads must not change the oat file.
+  std::string serial_contents;
+  ASSERT_TRUE(ReadFileToString(serial_oat.GetFilename(), &serial_contents));
+  std::string parallel_contents;
+  ASSERT_TRUE(ReadFileToString(parallel_oat.GetFilename(), &parallel_contents));
+  ASSERT_FALSE(serial_contents.empty());
+  EXPECT_TRUE(serial_contents == parallel_contents);
+
+  std::unique_ptr<OatFile> oat_file(OatFile::Open(/* zip_fd */ -1,
+                                                  parallel_oat.GetFilename(),
+                                                  parallel_oat.GetFilename(),
+                                                  nullptr,
+                                                  nullptr,
+                                                  false,
+                                                  /*low_4gb*/false,
+                                                  nullptr,
+                                                  &error_msg));
+  ASSERT_TRUE(oat_file != nullptr) << error_msg;
+}
+
+TEST_F(OatTest, CallChainsLayout) {
+  TimingLogger timings("OatTest::CallChainsLayout", false, false);
+
+  InstructionSet insn_set = kRuntimeISA;
+  if (insn_set == InstructionSet::kArm) insn_set = InstructionSet::kThumb2;
+  std::string error_msg;
+  // Do not inline, so that the caller's code calls the callee.
+  std::vector<std::string> compiler_options;
+  compiler_options.push_back("--inline-max-code-units=0");
+  SetupCompiler(Compiler::kOptimizing, insn_set, compiler_options, /*out*/ &error_msg);
+
+  jobject class_loader;
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    class_loader = LoadDex("CallChains");
+  }
+  ASSERT_TRUE(class_loader != nullptr);
+  std::vector<const DexFile*> dex_files = GetDexFiles(class_loader);
+  ASSERT_EQ(1u, dex_files.size());
+  const DexFile* dex_file = dex_files[0];
+
+  ClassLinker* const class_linker = Runtime::Current()->GetClassLinker();
+  {
+    ScopedObjectAccess soa(Thread::Current());
+    class_linker->RegisterDexFile(*dex_file,
+                                  soa.Decode<mirror::ClassLoader>(class_loader).Ptr());
+  }
+  compiler_driver_->SetDexFilesForOatFile(dex_files);
+  compiler_driver_->CompileAll(class_loader, dex_files, &timings);
+
+  auto find_method_index = [dex_file](const char* descriptor, const char* name) {
+    for (uint32_t i = 0; i != dex_file->NumMethodIds(); ++i) {
+      const DexFile::MethodId& method_id = dex_file->GetMethodId(i);
+      if (strcmp(dex_file->GetMethodDeclaringClassDescriptor(method_id), descriptor) == 0 &&
+          strcmp(dex_file->GetMethodName(method_id), name) == 0) {
+        return i;
+      }
+    }
+    return dex::kDexNoIndex;
+  };
+  const uint32_t callee = find_method_index("LCallChains;", "callee");
+  const uint32_t caller = find_method_index("LCallChains;", "caller");
+  const uint32_t first_value = find_method_index("LFirst;", "value");
+  ASSERT_NE(dex::kDexNoIndex, callee);
+  ASSERT_NE(dex::kDexNoIndex, caller);
+  ASSERT_NE(dex::kDexNoIndex, first_value);
+  // Without the call, the callee would be laid out before its caller.
+  ASSERT_LT(callee, caller);
+
+  // The caller and the callee share a bin, First.value() is in another one.
+  using Hotness = ProfileCompilationInfo::MethodHotness;
+  ProfileCompilationInfo profile;
+  for (uint32_t method_idx : { callee, caller }) {
+    ASSERT_TRUE(profile.AddMethodIndex(
+        static_cast<Hotness::Flag>(Hotness::kFlagHot | Hotness::kFlagStartup),
+        MethodReference(dex_file, method_idx)));
+  }
+  ASSERT_TRUE(profile.AddMethodIndex(Hotness::kFlagStartup,
+                                     MethodReference(dex_file, first_value)));
+  const std::vector<uint32_t> profiled_methods = { callee, caller, first_value };
+
+  ScratchFile tmp_base, tmp_oat(tmp_base, ".oat"), tmp_vdex(tmp_base, ".vdex");
+  SafeMap<std::string, std::string> key_value_store;
+  key_value_store.Put(OatHeader::kImageLocationKey, "test.art");
+  bool success = WriteElf(tmp_vdex.GetFile(),
+                          tmp_oat.GetFile(),
+                          dex_files,
+                          key_value_store,
+                          /* verify */ false,
+                          &profile);
+  ASSERT_TRUE(success);
+
+  std::unique_ptr<OatFile> oat_file(OatFile::Open(/* zip_fd */ -1,
+                                                  tmp_oat.GetFilename(),
+                                                  tmp_oat.GetFilename(),
+                                                  nullptr,
+                                                  nullptr,
+                                                  false,
+                                                  /*low_4gb*/false,
+                                                  nullptr,
+                                                  &error_msg));
+  ASSERT_TRUE(oat_file != nullptr) << error_msg;
+  ASSERT_EQ(1u, oat_file->GetOatDexFiles().size());
+  const OatFile::OatDexFile* oat_dex_file = oat_file->GetOatDexFiles()[0];
+
+  // Collect the method header and code of each compiled method, by method index.
+  // The offsets are relative to the oat data, like the hot code region.
+  SafeMap<uint32_t, std::pair<uint32_t, uint32_t>> code_ranges;
+  for (uint16_t class_def_index = 0; class_def_index != dex_file->NumClassDefs();
+       ++class_def_index) {
+    const uint8_t* class_data = dex_file->GetClassData(dex_file->GetClassDef(class_def_index));
+    if (class_data == nullptr) {
+      continue;
+    }
+    const OatFile::OatClass oat_class = oat_dex_file->GetOatClass(class_def_index);
+    ClassDataItemIterator it(*dex_file, class_data);
+    it.SkipAllFields();
+    for (size_t method_index = 0; it.HasNextMethod(); it.Next(), ++method_index) {
+      const OatFile::OatMethod oat_method = oat_class.GetOatMethod(method_index);
+      if (oat_method.GetCodeOffset() != 0u) {
+        uint32_t begin = oat_method.GetOatQuickMethodHeaderOffset();
+        uint32_t end = begin + sizeof(OatQuickMethodHeader) + oat_method.GetQuickCodeSize();
+        code_ranges.Put(it.GetMemberIndex(), std::make_pair(begin, end));
+      }
+    }
+  }
+  for (uint32_t method_idx : profiled_methods) {
+    ASSERT_TRUE(code_ranges.find(method_idx) != code_ranges.end())
+        << dex_file->PrettyMethod(method_idx);
+  }
+
+  // The callee follows its caller, with no other code in between.
+  std::vector<uint32_t> code_begins;
+  for (const auto& entry : code_ranges) {
+    code_begins.push_back(entry.second.first);
+  }
+  std::sort(code_begins.begin(), code_begins.end());
+  auto code_position = [&](uint32_t method_idx) {
+    return std::lower_bound(code_begins.begin(),
+                            code_begins.end(),
+                            code_ranges.Get(method_idx).first) - code_begins.begin();
+  };
+  EXPECT_EQ(code_position(caller) + 1, code_position(callee));
+
+  // The hot code region covers the code of the profiled methods and nothing else.
+  const OatHeader& oat_header = oat_file->GetOatHeader();
+  const uint32_t hot_code_begin = oat_header.GetHotCodeOffset();
+  const uint32_t hot_code_end = hot_code_begin + oat_header.GetHotCodeSize();
+  uint32_t profiled_code_begin = std::numeric_limits<uint32_t>::max();
+  uint32_t profiled_code_end = 0u;
+  for (uint32_t method_idx : profiled_methods) {
+    profiled_code_begin = std::min(profiled_code_begin, code_ranges.Get(method_idx).first);
+    profiled_code_end = std::max(profiled_code_end, code_ranges.Get(method_idx).second);
+  }
+  EXPECT_EQ(profiled_code_begin, hot_code_begin);
+  EXPECT_EQ(profiled_code_end, hot_code_end);
+  for (const auto& entry : code_ranges) {
+    if (!ContainsElement(profiled_methods, entry.first)) {
+      EXPECT_GE(entry.second.first, hot_code_end) << dex_file->PrettyMethod(entry.first);
+    }
+  }
+}
+
 static void MaybeModifyDexFileToFail(bool verify, std::unique_ptr<const DexFile>& data) {
   // If in verify mode (= fail the verifier mode), make sure we fail early. We'll fail already
   // because of the missing map, but that may lead to out of bounds reads.
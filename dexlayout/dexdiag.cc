@@ -15,13 +15,17 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <iostream>
+#include <map>
 #include <memory>
+#include <set>
+#include <unordered_set>
 #include <vector>
 
 #include "android-base/stringprintf.h"
@@ -31,9 +35,12 @@
 #include "base/stringpiece.h"
 
 #include "dexlayout.h"
+#include "dex/art_dex_file_loader.h"
 #include "dex/dex_file.h"
+#include "dex/modifiers.h"
 #include "dex_ir.h"
 #include "dex_ir_builder.h"
+#include "jit/profile_compilation_info.h"
 #ifdef ART_TARGET_ANDROID
 #include "pagemap/pagemap.h"
 #endif
@@ -142,6 +149,42 @@ class Printer {
               << std::endl;
   }
 
+  void PrintSimulationHeader() const {
+    std::cout << StringPrintf("%-*s %*s %*s %*s",
+                              section_header_width_,
+                              kSectionHeader,
+                              kPageCountWidth,
+                              "original",
+                              kPageCountWidth,
+                              "layout",
+                              kPageCountWidth,
+                              "saved")
+              << std::endl;
+    std::cout << StringPrintf("%-*s %*s %*s %*s",
+                              section_header_width_,
+                              "",
+                              kPageCountWidth,
+                              "pages",
+                              kPageCountWidth,
+                              "pages",
+                              kPageCountWidth,
+                              "pages")
+              << std::endl;
+  }
+
+  void PrintSimulationOne(const char* name, size_t original, size_t layout) const {
+    std::cout << StringPrintf("%-*s %*zd %*zd %*zd",
+                              section_header_width_,
+                              name,
+                              kPageCountWidth,
+                              original,
+                              kPageCountWidth,
+                              layout,
+                              kPageCountWidth,
+                              static_cast<ssize_t>(original) - static_cast<ssize_t>(layout))
+              << std::endl;
+  }
+
   void PrintSkipLine() const { std::cout << std::endl; }
 
   // Computes the width of the section header column in the table (for fixed formatting).
@@ -438,10 +481,186 @@ static bool FilterByNameContains(const std::string& mapped_file_name,
 }
 #endif
 
+// The methods and classes of a dex file that a profile says are executed. Method and type
+// indexes do not change with the layout, so the same uses apply to the laid out dex file.
+struct ProfileUses {
+  std::unordered_set<uint32_t> methods;
+  std::unordered_set<uint32_t> classes;
+};
+
+static ProfileUses GetProfileUses(const DexFile* dex_file, const ProfileCompilationInfo& profile) {
+  ProfileUses uses;
+  for (uint32_t i = 0; i != dex_file->NumMethodIds(); ++i) {
+    if (profile.GetMethodHotness(MethodReference(dex_file, i)).IsInProfile()) {
+      uses.methods.insert(i);
+    }
+  }
+  for (uint32_t i = 0; i != dex_file->NumClassDefs(); ++i) {
+    const dex::TypeIndex type_idx = dex_file->GetClassDef(i).class_idx_;
+    if (profile.ContainsClass(*dex_file, type_idx)) {
+      uses.classes.insert(type_idx.index_);
+    }
+  }
+  return uses;
+}
+
+// Simulates running the profiled methods and returns the pages they touch in the code item,
+// string data and class data sections, keyed by section type. These are the items that dexlayout
+// moves based on the profile.
+static std::map<uint16_t, std::set<uint32_t>> SimulatePageTouches(const DexFile& dex_file,
+                                                                  const ProfileUses& uses) {
+  std::map<uint16_t, std::set<uint32_t>> touched_pages;
+  auto touch = [&touched_pages](uint16_t type, const dex_ir::Item* item) {
+    const uint32_t begin = item->GetOffset();
+    const uint32_t end = begin + std::max(item->GetSize(), 1u);
+    for (uint32_t page = begin / kPageSize; page <= (end - 1u) / kPageSize; ++page) {
+      touched_pages[type].insert(page);
+    }
+  };
+  Options options;
+  std::unique_ptr<dex_ir::Header> header(dex_ir::DexIrBuilder(dex_file,
+                                                              /*eagerly_assign_offsets*/ true,
+                                                              options));
+  for (std::unique_ptr<dex_ir::ClassDef>& class_def : header->GetCollections().ClassDefs()) {
+    const bool is_profile_class = uses.classes.count(class_def->ClassType()->GetIndex()) != 0u;
+    if (is_profile_class) {
+      touch(DexFile::kDexTypeStringDataItem, class_def->ClassType()->GetStringId()->DataItem());
+    }
+    dex_ir::ClassData* class_data = class_def->GetClassData();
+    if (class_data == nullptr) {
+      continue;
+    }
+    bool class_used = is_profile_class;
+    for (size_t i = 0; i < 2; ++i) {
+      for (auto& method : *(i == 0 ? class_data->DirectMethods() : class_data->VirtualMethods())) {
+        const dex_ir::MethodId* method_id = method->GetMethodId();
+        dex_ir::CodeItem* code_item = method->GetCodeItem();
+        if (code_item == nullptr) {
+          continue;
+        }
+        const bool is_clinit = (method->GetAccessFlags() & kAccConstructor) != 0 &&
+            (method->GetAccessFlags() & kAccStatic) != 0;
+        if (uses.methods.count(method_id->GetIndex()) == 0u &&
+            !(is_profile_class && is_clinit)) {
+          continue;
+        }
+        class_used = true;
+        touch(DexFile::kDexTypeCodeItem, code_item);
+        touch(DexFile::kDexTypeStringDataItem, method_id->Proto()->Shorty()->DataItem());
+        dex_ir::CodeFixups* fixups = code_item->GetCodeFixups();
+        if (fixups == nullptr) {
+          continue;
+        }
+        for (dex_ir::StringId* id : fixups->StringIds()) {
+          touch(DexFile::kDexTypeStringDataItem, id->DataItem());
+        }
+        for (dex_ir::FieldId* id : fixups->FieldIds()) {
+          touch(DexFile::kDexTypeStringDataItem, id->Class()->GetStringId()->DataItem());
+          touch(DexFile::kDexTypeStringDataItem, id->Name()->DataItem());
+          touch(DexFile::kDexTypeStringDataItem, id->Type()->GetStringId()->DataItem());
+        }
+      }
+    }
+    if (class_used) {
+      touch(DexFile::kDexTypeClassDataItem, class_data);
+    }
+  }
+  return touched_pages;
+}
+
+// Reports how many pages of each dex file in `file_name` the methods of the profile touch before
+// and after dexlayout reorders the dex file with that profile.
+static bool SimulateLayout(const std::string& file_name,
+                           const std::string& profile_file_name,
+                           Printer* printer) {
+  std::string error_msg;
+  const ArtDexFileLoader dex_file_loader;
+  std::vector<std::unique_ptr<const DexFile>> dex_files;
+  if (!dex_file_loader.Open(file_name.c_str(),
+                            file_name,
+                            /*verify*/ true,
+                            /*verify_checksum*/ true,
+                            &error_msg,
+                            &dex_files)) {
+    std::cerr << "Could not open " << file_name << ": " << error_msg << std::endl;
+    return false;
+  }
+  int profile_fd = open(profile_file_name.c_str(), O_RDONLY);
+  if (profile_fd < 0) {
+    std::cerr << "Could not open " << profile_file_name << ": " << strerror(errno) << std::endl;
+    return false;
+  }
+  ProfileCompilationInfo profile;
+  const bool loaded = profile.Load(profile_fd);
+  close(profile_fd);
+  if (!loaded) {
+    std::cerr << "Could not read profile " << profile_file_name << std::endl;
+    return false;
+  }
+
+  for (size_t i = 0; i != dex_files.size(); ++i) {
+    const DexFile* dex_file = dex_files[i].get();
+    Options options;
+    DexLayout dex_layout(options, &profile, /*out_file*/ nullptr, /*header*/ nullptr);
+    std::unique_ptr<DexContainer> dex_container;
+    if (!dex_layout.ProcessDexFile(file_name.c_str(), dex_file, i, &dex_container, &error_msg)) {
+      std::cerr << "Could not lay out " << dex_file->GetLocation() << ": " << error_msg
+                << std::endl;
+      return false;
+    }
+    DexContainer::Section* const main_section = dex_container->GetMainSection();
+    std::unique_ptr<const DexFile> layout_dex_file(
+        dex_file_loader.Open(main_section->Begin(),
+                             main_section->Size(),
+                             dex_file->GetLocation(),
+                             dex_file->GetLocationChecksum(),
+                             /*oat_dex_file*/ nullptr,
+                             /*verify*/ false,
+                             /*verify_checksum*/ false,
+                             &error_msg));
+    if (layout_dex_file == nullptr) {
+      std::cerr << "Could not open laid out " << dex_file->GetLocation() << ": " << error_msg
+                << std::endl;
+      return false;
+    }
+
+    const ProfileUses uses = GetProfileUses(dex_file, profile);
+    std::map<uint16_t, std::set<uint32_t>> original_pages = SimulatePageTouches(*dex_file, uses);
+    std::map<uint16_t, std::set<uint32_t>> layout_pages =
+        SimulatePageTouches(*layout_dex_file, uses);
+    std::cout << "SIMULATED DEX " << dex_file->GetLocation() << ": "
+              << uses.methods.size() << " profile methods, "
+              << uses.classes.size() << " profile classes" << std::endl;
+    printer->PrintSimulationHeader();
+    size_t total_original = 0u;
+    size_t total_layout = 0u;
+    for (uint16_t type : { DexFile::kDexTypeClassDataItem,
+                           DexFile::kDexTypeCodeItem,
+                           DexFile::kDexTypeStringDataItem }) {
+      const size_t original = original_pages[type].size();
+      const size_t layout = layout_pages[type].size();
+      printer->PrintSimulationOne(kDexSectionInfoMap.find(type)->second.name.c_str(),
+                                  original,
+                                  layout);
+      total_original += original;
+      total_layout += layout;
+    }
+    printer->PrintSimulationOne("GRAND TOTAL", total_original, total_layout);
+    printer->PrintSkipLine();
+  }
+  return true;
+}
+
 static void Usage(const char* cmd) {
   std::cout << "Usage: " << cmd << " [options] pid" << std::endl
+            << "       " << cmd << " --simulate-profile=<file> dex-or-apk" << std::endl
             << "    --contains=<string>:  Display sections containing string." << std::endl
             << "    --help:               Shows this message." << std::endl
+            << "    --simulate-profile=<file>:" << std::endl
+            << "                          Count the pages that the profile's methods touch in"
+            << std::endl
+            << "                          a dex or apk file, with and without dexlayout."
+            << std::endl
             << "    --verbose:            Makes displays verbose." << std::endl;
   PrintLetterKey();
 }
@@ -453,6 +672,7 @@ static int DexDiagMain(int argc, char* argv[]) {
   }
 
   std::vector<std::string> name_filters;
+  std::string simulate_profile;
   // TODO: add option to track usage by class name, etc.
   for (int i = 1; i < argc - 1; ++i) {
     const StringPiece option(argv[i]);
@@ -464,6 +684,8 @@ static int DexDiagMain(int argc, char* argv[]) {
     } else if (option.starts_with("--contains=")) {
       std::string contains(option.substr(strlen("--contains=")).data());
       name_filters.push_back(contains);
+    } else if (option.starts_with("--simulate-profile=")) {
+      simulate_profile = option.substr(strlen("--simulate-profile=")).data();
     } else {
       Usage(argv[0]);
       return EXIT_FAILURE;
@@ -475,6 +697,11 @@ static int DexDiagMain(int argc, char* argv[]) {
   InitLogging(argv, Runtime::Abort);
   MemMap::Init();
 
+  if (!simulate_profile.empty()) {
+    Printer printer;
+    return SimulateLayout(argv[argc - 1], simulate_profile, &printer) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
 #ifdef ART_TARGET_ANDROID
   pid_t pid;
   char* endptr;
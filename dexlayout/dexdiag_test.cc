@@ -22,6 +22,7 @@
 #include "base/file_utils.h"
 #include "base/os.h"
 #include "exec_utils.h"
+#include "jit/profile_compilation_info.h"
 #include "oat_file.h"
 
 namespace art {
@@ -86,9 +87,14 @@ class DexDiagTest : public CommonRuntimeTest {
     // Invoke 'dexdiag' against the current process.
     // This should succeed because we have a runtime and so it should
     // be able to map in the boot.art and do a diff for it.
-    std::vector<std::string> exec_argv;
-
     // Build the command line "dexdiag <args> this_pid".
+    std::vector<std::string> args_and_pid(args);
+    args_and_pid.push_back(std::to_string(this_pid));
+    return Exec(args_and_pid, error_msg);
+  }
+
+  bool Exec(const std::vector<std::string>& args, std::string* error_msg) {
+    std::vector<std::string> exec_argv;
     std::string executable_path = GetDexDiagFilePath();
     EXPECT_TRUE(OS::FileExists(executable_path.c_str())) << executable_path
                                                          << " should be a valid file path";
@@ -96,8 +102,6 @@ class DexDiagTest : public CommonRuntimeTest {
     for (const auto& arg : args) {
       exec_argv.push_back(arg);
     }
-    exec_argv.push_back(std::to_string(this_pid));
-
     return ::art::Exec(exec_argv, error_msg);
   }
 };
@@ -151,4 +155,28 @@ TEST_F(DexDiagTest, DISABLED_DexDiagVerboseTest) {
                                                                << error_msg;
 }
 
+// The layout simulation does not need /proc/pid/pagemap, so it also runs on the host.
+TEST_F(DexDiagTest, DexDiagSimulateProfileTest) {
+  const std::string dex_location = GetTestDexFileName("ManyMethods");
+  std::vector<std::unique_ptr<const DexFile>> dex_files = OpenTestDexFiles("ManyMethods");
+  ASSERT_FALSE(dex_files.empty());
+  ProfileCompilationInfo profile;
+  for (const std::unique_ptr<const DexFile>& dex_file : dex_files) {
+    for (uint32_t i = 0; i < dex_file->NumMethodIds(); i += 3) {
+      profile.AddMethodIndex(ProfileCompilationInfo::MethodHotness::kFlagStartup,
+                             dex_file->GetLocation(),
+                             dex_file->GetLocationChecksum(),
+                             /*dex_method_idx*/ i,
+                             dex_file->NumMethodIds());
+    }
+  }
+  ScratchFile profile_file;
+  ASSERT_TRUE(profile.Save(profile_file.GetFd()));
+  ASSERT_EQ(0, profile_file.GetFile()->Flush());
+
+  std::string error_msg;
+  ASSERT_TRUE(Exec({ "--simulate-profile=" + profile_file.GetFilename(), dex_location },
+                   &error_msg)) << "Failed to execute -- because: " << error_msg;
+}
+
 }  // namespace art
@@ -26,13 +26,16 @@
 #include <stdio.h>
 #include <sys/mman.h>  // For the PROT_* and MAP_* constants.
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <sstream>
 #include <vector>
 
 #include "android-base/stringprintf.h"
 
+#include "base/call_chain_clustering.h"
 #include "base/logging.h"  // For VLOG_IS_ON.
 #include "base/os.h"
 #include "base/utils.h"
@@ -55,6 +58,10 @@ namespace art {
 
 using android::base::StringPrintf;
 
+// Maximum size of a cluster of calling and called code items. Clustering beyond a page does not
+// reduce the number of pages touched by the methods.
+static constexpr size_t kMaxCodeItemClusterSize = kPageSize;
+
 /*
  * Flags for use with createAccessFlagStr().
  */
@@ -1612,29 +1619,28 @@ void DexLayout::LayoutStringData(const DexFile* dex_file) {
   const size_t num_strings = header_->GetCollections().StringIds().size();
   std::vector<bool> is_shorty(num_strings, false);
   std::vector<bool> from_hot_method(num_strings, false);
+  // Position of the first code item in the new layout that uses each string. Strings touched by
+  // the same methods are clustered together, in the order of the code.
+  std::vector<size_t> first_use(num_strings, std::numeric_limits<size_t>::max());
+  std::unordered_map<const dex_ir::CodeItem*, size_t> code_item_positions;
+  for (const std::unique_ptr<dex_ir::CodeItem>& code_item : header_->GetCollections().CodeItems()) {
+    code_item_positions.emplace(code_item.get(), code_item_positions.size());
+  }
+  auto mark_hot = [&](const dex_ir::StringId* string_id, size_t position) {
+    from_hot_method[string_id->GetIndex()] = true;
+    first_use[string_id->GetIndex()] = std::min(first_use[string_id->GetIndex()], position);
+  };
+  auto mark_shorty = [&](const dex_ir::StringId* string_id, size_t position) {
+    is_shorty[string_id->GetIndex()] = true;
+    first_use[string_id->GetIndex()] = std::min(first_use[string_id->GetIndex()], position);
+  };
   for (std::unique_ptr<dex_ir::ClassDef>& class_def : header_->GetCollections().ClassDefs()) {
-    // A name of a profile class is probably going to get looked up by ClassTable::Lookup, mark it
-    // as hot. Add its super class and interfaces as well, which can be used during initialization.
     const bool is_profile_class =
         info_->ContainsClass(*dex_file, dex::TypeIndex(class_def->ClassType()->GetIndex()));
-    if (is_profile_class) {
-      from_hot_method[class_def->ClassType()->GetStringId()->GetIndex()] = true;
-      const dex_ir::TypeId* superclass = class_def->Superclass();
-      if (superclass != nullptr) {
-        from_hot_method[superclass->GetStringId()->GetIndex()] = true;
-      }
-      const dex_ir::TypeList* interfaces = class_def->Interfaces();
-      if (interfaces != nullptr) {
-        for (const dex_ir::TypeId* interface_type : *interfaces->GetTypeList()) {
-          from_hot_method[interface_type->GetStringId()->GetIndex()] = true;
-        }
-      }
-    }
+    // Position of the first executed code item of the class.
+    size_t class_position = std::numeric_limits<size_t>::max();
     dex_ir::ClassData* data = class_def->GetClassData();
-    if (data == nullptr) {
-      continue;
-    }
-    for (size_t i = 0; i < 2; ++i) {
+    for (size_t i = 0; data != nullptr && i < 2; ++i) {
       for (auto& method : *(i == 0 ? data->DirectMethods() : data->VirtualMethods())) {
         const dex_ir::MethodId* method_id = method->GetMethodId();
         dex_ir::CodeItem* code_item = method->GetCodeItem();
@@ -1649,32 +1655,49 @@ void DexLayout::LayoutStringData(const DexFile* dex_file) {
         if (!method_executed) {
           continue;
         }
-        is_shorty[method_id->Proto()->Shorty()->GetIndex()] = true;
+        const size_t position = code_item_positions.find(code_item)->second;
+        class_position = std::min(class_position, position);
+        mark_shorty(method_id->Proto()->Shorty(), position);
         dex_ir::CodeFixups* fixups = code_item->GetCodeFixups();
         if (fixups == nullptr) {
           continue;
         }
         // Add const-strings.
         for (dex_ir::StringId* id : fixups->StringIds()) {
-          from_hot_method[id->GetIndex()] = true;
+          mark_hot(id, position);
         }
         // Add field classes, names, and types.
         for (dex_ir::FieldId* id : fixups->FieldIds()) {
           // TODO: Only visit field ids from static getters and setters.
-          from_hot_method[id->Class()->GetStringId()->GetIndex()] = true;
-          from_hot_method[id->Name()->GetIndex()] = true;
-          from_hot_method[id->Type()->GetStringId()->GetIndex()] = true;
+          mark_hot(id->Class()->GetStringId(), position);
+          mark_hot(id->Name(), position);
+          mark_hot(id->Type()->GetStringId(), position);
         }
         // For clinits, add referenced method classes, names, and protos.
         if (is_clinit) {
           for (dex_ir::MethodId* id : fixups->MethodIds()) {
-            from_hot_method[id->Class()->GetStringId()->GetIndex()] = true;
-            from_hot_method[id->Name()->GetIndex()] = true;
-            is_shorty[id->Proto()->Shorty()->GetIndex()] = true;
+            mark_hot(id->Class()->GetStringId(), position);
+            mark_hot(id->Name(), position);
+            mark_shorty(id->Proto()->Shorty(), position);
           }
         }
       }
     }
+    // A name of a profile class is probably going to get looked up by ClassTable::Lookup, mark it
+    // as hot. Add its super class and interfaces as well, which can be used during initialization.
+    if (is_profile_class) {
+      mark_hot(class_def->ClassType()->GetStringId(), class_position);
+      const dex_ir::TypeId* superclass = class_def->Superclass();
+      if (superclass != nullptr) {
+        mark_hot(superclass->GetStringId(), class_position);
+      }
+      const dex_ir::TypeList* interfaces = class_def->Interfaces();
+      if (interfaces != nullptr) {
+        for (const dex_ir::TypeId* interface_type : *interfaces->GetTypeList()) {
+          mark_hot(interface_type->GetStringId(), class_position);
+        }
+      }
+    }
   }
   // Sort string data by specified order.
   std::vector<dex_ir::StringId*> string_ids;
@@ -1683,8 +1706,8 @@ void DexLayout::LayoutStringData(const DexFile* dex_file) {
   }
   std::sort(string_ids.begin(),
             string_ids.end(),
-            [&is_shorty, &from_hot_method](const dex_ir::StringId* a,
-                                           const dex_ir::StringId* b) {
+            [&is_shorty, &from_hot_method, &first_use](const dex_ir::StringId* a,
+                                                       const dex_ir::StringId* b) {
     const bool a_is_hot = from_hot_method[a->GetIndex()];
     const bool b_is_hot = from_hot_method[b->GetIndex()];
     if (a_is_hot != b_is_hot) {
@@ -1696,6 +1719,14 @@ void DexLayout::LayoutStringData(const DexFile* dex_file) {
     if (a_is_shorty != b_is_shorty) {
       return a_is_shorty < b_is_shorty;
     }
+    // Cluster the strings of hot methods by the code that uses them first.
+    if (a_is_hot || a_is_shorty) {
+      const size_t a_first_use = first_use[a->GetIndex()];
+      const size_t b_first_use = first_use[b->GetIndex()];
+      if (a_first_use != b_first_use) {
+        return a_first_use < b_first_use;
+      }
+    }
     // Order by index by default.
     return a->GetIndex() < b->GetIndex();
   });
@@ -1806,12 +1837,186 @@ void DexLayout::LayoutCodeItems(const DexFile* dex_file) {
     const LayoutType layout_type_b = it_b->second;
     return layout_type_a < layout_type_b;
   });
+
+  ClusterCodeItems(dex_file);
+}
+
+// Reorders the executed code items of each layout type with the call-chain clustering (C3)
+// heuristic, see ClusterCallChains() in libartbase. Calls are the invokes of methods defined in
+// this dex file and, for hot methods, the receiver classes that the profile recorded in their
+// inline caches.
+//
+// Code items start out in the order of their lowest method index, so that laying out the output
+// again gives the same order.
+void DexLayout::ClusterCodeItems(const DexFile* dex_file) {
+  dex_ir::Collections& collections = header_->GetCollections();
+  const std::unordered_map<dex_ir::CodeItem*, LayoutType>& code_item_layout =
+      layout_hotness_info_.code_item_layout_;
+
+  std::unordered_map<uint32_t, dex_ir::ClassDef*> class_defs_by_type;
+  std::unordered_map<uint32_t, dex_ir::CodeItem*> code_items_by_method;
+  std::unordered_map<const dex_ir::CodeItem*, uint32_t> lowest_method_index;
+  for (std::unique_ptr<dex_ir::ClassDef>& class_def : collections.ClassDefs()) {
+    class_defs_by_type.emplace(class_def->ClassType()->GetIndex(), class_def.get());
+    dex_ir::ClassData* class_data = class_def->GetClassData();
+    if (class_data == nullptr) {
+      continue;
+    }
+    for (size_t i = 0; i < 2; ++i) {
+      for (auto& method : *(i == 0 ? class_data->DirectMethods() : class_data->VirtualMethods())) {
+        dex_ir::CodeItem* code_item = method->GetCodeItem();
+        if (code_item != nullptr) {
+          const uint32_t method_idx = method->GetMethodId()->GetIndex();
+          code_items_by_method.emplace(method_idx, code_item);
+          auto it = lowest_method_index.emplace(code_item, method_idx);
+          it.first->second = std::min(it.first->second, method_idx);
+        }
+      }
+    }
+  }
+
+  // Returns the code item of the implementation of `method_id` for receivers of `class_def`,
+  // looking through the superclasses defined in this dex file.
+  auto find_implementation = [&](dex_ir::ClassDef* class_def,
+                                 const dex_ir::MethodId* method_id) -> dex_ir::CodeItem* {
+    // Bound the walk, the class hierarchy has not been checked for cycles.
+    for (size_t depth = 0; class_def != nullptr && depth != class_defs_by_type.size(); ++depth) {
+      dex_ir::ClassData* class_data = class_def->GetClassData();
+      if (class_data != nullptr) {
+        for (auto& method : *class_data->VirtualMethods()) {
+          const dex_ir::MethodId* id = method->GetMethodId();
+          if (id->Name() == method_id->Name() && id->Proto() == method_id->Proto()) {
+            return method->GetCodeItem();
+          }
+        }
+      }
+      const dex_ir::TypeId* superclass = class_def->Superclass();
+      auto it = (superclass != nullptr)
+          ? class_defs_by_type.find(superclass->GetIndex())
+          : class_defs_by_type.end();
+      class_def = (it != class_defs_by_type.end()) ? it->second : nullptr;
+    }
+    return nullptr;
+  };
+
+  // Collect the calls of the executed methods as (caller, callee) pairs.
+  std::vector<std::pair<const dex_ir::CodeItem*, const dex_ir::CodeItem*>> calls;
+  for (std::unique_ptr<dex_ir::ClassDef>& class_def : collections.ClassDefs()) {
+    dex_ir::ClassData* class_data = class_def->GetClassData();
+    if (class_data == nullptr) {
+      continue;
+    }
+    for (size_t i = 0; i < 2; ++i) {
+      for (auto& method : *(i == 0 ? class_data->DirectMethods() : class_data->VirtualMethods())) {
+        dex_ir::CodeItem* code_item = method->GetCodeItem();
+        if (code_item == nullptr ||
+            code_item_layout.find(code_item)->second == LayoutType::kLayoutTypeUnused) {
+          continue;
+        }
+        dex_ir::CodeFixups* fixups = code_item->GetCodeFixups();
+        if (fixups != nullptr) {
+          for (dex_ir::MethodId* id : fixups->MethodIds()) {
+            auto it = code_items_by_method.find(id->GetIndex());
+            if (it != code_items_by_method.end()) {
+              calls.emplace_back(code_item, it->second);
+            }
+          }
+        }
+        // Inline caches are only recorded for hot methods.
+        std::unique_ptr<ProfileCompilationInfo::OfflineProfileMethodInfo> profile_method =
+            info_->GetMethod(dex_file->GetLocation(),
+                             dex_file->GetLocationChecksum(),
+                             method->GetMethodId()->GetIndex());
+        if (profile_method == nullptr) {
+          continue;
+        }
+        for (const auto& inline_cache : *profile_method->inline_caches) {
+          const uint32_t dex_pc = inline_cache.first;
+          if (dex_pc >= code_item->InsnsSize()) {
+            continue;
+          }
+          const Instruction* inst = Instruction::At(code_item->Insns() + dex_pc);
+          const Instruction::Code opcode = inst->Opcode();
+          if ((opcode != Instruction::INVOKE_VIRTUAL &&
+               opcode != Instruction::INVOKE_VIRTUAL_RANGE &&
+               opcode != Instruction::INVOKE_INTERFACE &&
+               opcode != Instruction::INVOKE_INTERFACE_RANGE) ||
+              dex_pc + inst->SizeInCodeUnits() > code_item->InsnsSize() ||
+              inst->VRegB() >= collections.MethodIdsSize()) {
+            continue;
+          }
+          const dex_ir::MethodId* method_id = collections.GetMethodId(inst->VRegB());
+          for (const ProfileCompilationInfo::ClassReference& class_ref :
+               inline_cache.second.classes) {
+            if (!profile_method->dex_references[class_ref.dex_profile_index].MatchesDex(
+                    dex_file)) {
+              continue;
+            }
+            auto it = class_defs_by_type.find(class_ref.type_index.index_);
+            if (it == class_defs_by_type.end()) {
+              continue;
+            }
+            dex_ir::CodeItem* callee = find_implementation(it->second, method_id);
+            if (callee != nullptr) {
+              calls.emplace_back(code_item, callee);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  dex_ir::CollectionVector<dex_ir::CodeItem>::Vector& code_items = collections.CodeItems();
+  auto bin_begin = code_items.begin();
+  while (bin_begin != code_items.end()) {
+    const LayoutType layout_type = code_item_layout.find(bin_begin->get())->second;
+    auto bin_end = std::find_if(bin_begin,
+                                code_items.end(),
+                                [&](const std::unique_ptr<dex_ir::CodeItem>& code_item) {
+      return code_item_layout.find(code_item.get())->second != layout_type;
+    });
+    const size_t num_code_items = std::distance(bin_begin, bin_end);
+    if (layout_type == LayoutType::kLayoutTypeUnused || num_code_items < 2u) {
+      bin_begin = bin_end;
+      continue;
+    }
+    std::sort(bin_begin,
+              bin_end,
+              [&](const std::unique_ptr<dex_ir::CodeItem>& a,
+                  const std::unique_ptr<dex_ir::CodeItem>& b) {
+      return lowest_method_index.find(a.get())->second < lowest_method_index.find(b.get())->second;
+    });
+    std::unordered_map<const dex_ir::CodeItem*, size_t> indexes;
+    std::vector<size_t> sizes;
+    sizes.reserve(num_code_items);
+    for (size_t i = 0; i != num_code_items; ++i) {
+      indexes.emplace(bin_begin[i].get(), i);
+      sizes.push_back(bin_begin[i]->GetSize());
+    }
+    std::vector<std::pair<size_t, size_t>> bin_calls;
+    for (const auto& call : calls) {
+      auto caller_it = indexes.find(call.first);
+      auto callee_it = indexes.find(call.second);
+      if (caller_it != indexes.end() && callee_it != indexes.end()) {
+        bin_calls.emplace_back(caller_it->second, callee_it->second);
+      }
+    }
+
+    std::vector<std::unique_ptr<dex_ir::CodeItem>> clustered_code_items;
+    clustered_code_items.reserve(num_code_items);
+    for (size_t code_item : ClusterCallChains(sizes, bin_calls, kMaxCodeItemClusterSize)) {
+      clustered_code_items.push_back(std::move(bin_begin[code_item]));
+    }
+    std::move(clustered_code_items.begin(), clustered_code_items.end(), bin_begin);
+    bin_begin = bin_end;
+  }
 }
 
 void DexLayout::LayoutOutputFile(const DexFile* dex_file) {
-  LayoutStringData(dex_file);
   LayoutClassDefsAndClassData(dex_file);
   LayoutCodeItems(dex_file);
+  // Strings are clustered by the code items that use them, lay them out last.
+  LayoutStringData(dex_file);
 }
 
 bool DexLayout::OutputDexFile(const DexFile* input_dex_file,
@@ -163,10 +163,11 @@ class DexLayout {
 
   void LayoutClassDefsAndClassData(const DexFile* dex_file);
   void LayoutCodeItems(const DexFile* dex_file);
+  void ClusterCodeItems(const DexFile* dex_file);
   void LayoutStringData(const DexFile* dex_file);
 
   // Creates a new layout for the dex file based on profile info.
-  // Currently reorders ClassDefs, ClassDataItems, and CodeItems.
+  // Currently reorders ClassDefs, ClassDataItems, CodeItems, and StringDatas.
   void LayoutOutputFile(const DexFile* dex_file);
   bool OutputDexFile(const DexFile* input_dex_file,
                      bool compute_offsets,
@@ -29,6 +29,7 @@
 #include "dex/code_item_accessors-inl.h"
 #include "dex/dex_file-inl.h"
 #include "dex/dex_file_loader.h"
+#include "dex/standard_dex_file.h"
 #include "dexlayout.h"
 #include "exec_utils.h"
 #include "jit/profile_compilation_info.h"
@@ -840,4 +841,135 @@ TEST_F(DexLayoutTest, ClassFilter) {
   }
 }
 
+
+static uint32_t FindMethodIndex(const DexFile& dex_file, const char* descriptor, const char* name) {
+  for (uint32_t i = 0; i < dex_file.NumMethodIds(); ++i) {
+    const DexFile::MethodId& method_id = dex_file.GetMethodId(i);
+    if (strcmp(dex_file.GetMethodDeclaringClassDescriptor(method_id), descriptor) == 0 &&
+        strcmp(dex_file.GetMethodName(method_id), name) == 0) {
+      return i;
+    }
+  }
+  return dex::kDexNoIndex;
+}
+
+static uint32_t FindCodeItemOffset(const DexFile& dex_file, uint32_t method_idx) {
+  for (uint32_t i = 0; i < dex_file.NumClassDefs(); ++i) {
+    const uint8_t* class_data = dex_file.GetClassData(dex_file.GetClassDef(i));
+    if (class_data == nullptr) {
+      continue;
+    }
+    for (ClassDataItemIterator it(dex_file, class_data); it.HasNext(); it.Next()) {
+      if (it.IsAtMethod() && it.GetMemberIndex() == method_idx) {
+        return it.GetMethodCodeItemOffset();
+      }
+    }
+  }
+  return 0u;
+}
+
+static uint32_t FindStringDataOffset(const DexFile& dex_file, const char* string) {
+  const DexFile::StringId* string_id = dex_file.FindStringId(string);
+  return (string_id != nullptr) ? string_id->string_data_off_ : 0u;
+}
+
+// Test that callees are laid out right after their callers, both for direct calls and for the
+// receivers recorded in inline caches, and that hot strings are ordered by first use.
+TEST_F(DexLayoutTest, CallChains) {
+  std::vector<std::unique_ptr<const DexFile>> dex_files;
+  std::string error_msg;
+  const ArtDexFileLoader dex_file_loader;
+  const std::string input_jar = GetTestDexFileName("CallChains");
+  ASSERT_TRUE(dex_file_loader.Open(input_jar.c_str(),
+                                   input_jar.c_str(),
+                                   /*verify*/ true,
+                                   /*verify_checksum*/ true,
+                                   &error_msg,
+                                   &dex_files)) << error_msg;
+  ASSERT_EQ(dex_files.size(), 1u);
+  const DexFile* dex_file = dex_files[0].get();
+
+  const uint32_t callee = FindMethodIndex(*dex_file, "LCallChains;", "callee");
+  const uint32_t caller = FindMethodIndex(*dex_file, "LCallChains;", "caller");
+  const uint32_t dispatch = FindMethodIndex(*dex_file, "LCallChains;", "dispatch");
+  const uint32_t first_value = FindMethodIndex(*dex_file, "LFirst;", "value");
+  const uint32_t second_value = FindMethodIndex(*dex_file, "LSecond;", "value");
+  const std::vector<uint32_t> hot_methods = { callee, caller, dispatch, first_value, second_value };
+  for (uint32_t method_idx : hot_methods) {
+    ASSERT_NE(method_idx, dex::kDexNoIndex);
+  }
+  // Without the call edges, the input order would already put the callees after their callers.
+  ASSERT_LT(callee, caller);
+  ASSERT_LT(first_value, second_value);
+
+  uint32_t dispatch_pc = dex::kDexNoIndex;
+  CodeItemInstructionAccessor instructions(
+      *dex_file, dex_file->GetCodeItem(FindCodeItemOffset(*dex_file, dispatch)));
+  for (const DexInstructionPcPair& inst : instructions) {
+    if (inst->Opcode() == Instruction::INVOKE_VIRTUAL) {
+      dispatch_pc = inst.DexPc();
+    }
+  }
+  ASSERT_NE(dispatch_pc, dex::kDexNoIndex);
+  const DexFile::TypeId* second_type = dex_file->FindTypeId("LSecond;");
+  ASSERT_TRUE(second_type != nullptr);
+
+  ProfileCompilationInfo profile;
+  for (uint32_t method_idx : hot_methods) {
+    ASSERT_TRUE(profile.AddMethodIndex(ProfileCompilationInfo::MethodHotness::kFlagHot,
+                                       dex_file->GetLocation(),
+                                       dex_file->GetLocationChecksum(),
+                                       method_idx,
+                                       dex_file->NumMethodIds()));
+  }
+  std::vector<ProfileMethodInfo::ProfileInlineCache> inline_caches;
+  const std::vector<TypeReference> receivers =
+      { TypeReference(dex_file, dex_file->GetIndexForTypeId(*second_type)) };
+  inline_caches.emplace_back(dispatch_pc, /*missing_types*/ false, receivers);
+  ASSERT_TRUE(profile.AddMethod(
+      ProfileMethodInfo(MethodReference(dex_file, dispatch), inline_caches),
+      ProfileCompilationInfo::MethodHotness::kFlagHot));
+
+  Options options;
+  DexLayout dexlayout(options, &profile, /*out_file*/ nullptr, /*header*/ nullptr);
+  std::unique_ptr<DexContainer> out;
+  ASSERT_TRUE(dexlayout.ProcessDexFile(dex_file->GetLocation().c_str(),
+                                       dex_file,
+                                       /*dex_file_index*/ 0,
+                                       &out,
+                                       &error_msg)) << "Failed to run dexlayout " << error_msg;
+  std::unique_ptr<const DexFile> output_dex_file(
+      dex_file_loader.OpenWithDataSection(
+          out->GetMainSection()->Begin(),
+          out->GetMainSection()->Size(),
+          out->GetDataSection()->Begin(),
+          out->GetDataSection()->Size(),
+          dex_file->GetLocation().c_str(),
+          /* checksum */ 0,
+          /*oat_dex_file*/ nullptr,
+          /* verify */ true,
+          /*verify_checksum*/ false,
+          &error_msg));
+  ASSERT_TRUE(output_dex_file != nullptr) << error_msg;
+
+  // Returns the offset just past the code item of `method_idx` in the output.
+  auto code_item_end = [&](uint32_t method_idx) {
+    const uint32_t offset = FindCodeItemOffset(*output_dex_file, method_idx);
+    CHECK_NE(offset, 0u);
+    const DexFile::CodeItem* code_item = output_dex_file->GetCodeItem(offset);
+    return RoundUp(offset + output_dex_file->GetCodeItemSize(*code_item),
+                   StandardDexFile::CodeItem::kAlignment);
+  };
+  EXPECT_EQ(code_item_end(caller), FindCodeItemOffset(*output_dex_file, callee));
+  EXPECT_EQ(code_item_end(dispatch), FindCodeItemOffset(*output_dex_file, second_value));
+
+  // The caller comes first in the layout, so its string comes before the string of the callee
+  // even though it has a higher index.
+  const uint32_t alpha_offset = FindStringDataOffset(*output_dex_file, "alpha");
+  const uint32_t zeta_offset = FindStringDataOffset(*output_dex_file, "zeta");
+  ASSERT_NE(alpha_offset, 0u);
+  ASSERT_NE(zeta_offset, 0u);
+  EXPECT_LT(zeta_offset, alpha_offset);
+}
+
 }  // namespace art
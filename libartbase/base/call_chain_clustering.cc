@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "call_chain_clustering.h"
+
+#include <stdint.h>
+
+#include <map>
+
+#include <android-base/logging.h>
+
+namespace art {
+
+std::vector<size_t> ClusterCallChains(const std::vector<size_t>& sizes,
+                                      const std::vector<std::pair<size_t, size_t>>& calls,
+                                      size_t max_cluster_size) {
+  const size_t num_functions = sizes.size();
+  // Count the calls from each caller to each callee, keyed by (callee, caller).
+  std::map<std::pair<size_t, size_t>, uint32_t> call_counts;
+  for (const std::pair<size_t, size_t>& call : calls) {
+    DCHECK_LT(call.first, num_functions);
+    DCHECK_LT(call.second, num_functions);
+    if (call.first != call.second) {
+      ++call_counts[std::make_pair(call.second, call.first)];
+    }
+  }
+
+  std::vector<size_t> cluster_of(num_functions);
+  std::vector<std::vector<size_t>> clusters(num_functions);
+  std::vector<size_t> cluster_sizes(sizes);
+  for (size_t i = 0; i != num_functions; ++i) {
+    cluster_of[i] = i;
+    clusters[i].push_back(i);
+  }
+  for (auto it = call_counts.begin(); it != call_counts.end(); ) {
+    // Find the caller with the most calls to the callee, the first one on ties.
+    const size_t callee = it->first.first;
+    size_t caller = it->first.second;
+    uint32_t max_count = it->second;
+    for (++it; it != call_counts.end() && it->first.first == callee; ++it) {
+      if (it->second > max_count) {
+        caller = it->first.second;
+        max_count = it->second;
+      }
+    }
+    const size_t caller_cluster = cluster_of[caller];
+    const size_t callee_cluster = cluster_of[callee];
+    if (caller_cluster == callee_cluster ||
+        cluster_sizes[caller_cluster] + cluster_sizes[callee_cluster] > max_cluster_size) {
+      continue;
+    }
+    for (size_t function : clusters[callee_cluster]) {
+      cluster_of[function] = caller_cluster;
+      clusters[caller_cluster].push_back(function);
+    }
+    cluster_sizes[caller_cluster] += cluster_sizes[callee_cluster];
+    clusters[callee_cluster].clear();
+  }
+
+  std::vector<size_t> order;
+  order.reserve(num_functions);
+  std::vector<bool> cluster_placed(num_functions, false);
+  for (size_t i = 0; i != num_functions; ++i) {
+    const size_t cluster = cluster_of[i];
+    if (!cluster_placed[cluster]) {
+      cluster_placed[cluster] = true;
+      order.insert(order.end(), clusters[cluster].begin(), clusters[cluster].end());
+    }
+  }
+  DCHECK_EQ(order.size(), num_functions);
+  return order;
+}
+
+}  // namespace art
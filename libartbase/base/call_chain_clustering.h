@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_LIBARTBASE_BASE_CALL_CHAIN_CLUSTERING_H_
+#define ART_LIBARTBASE_BASE_CALL_CHAIN_CLUSTERING_H_
+
+#include <stddef.h>
+
+#include <utility>
+#include <vector>
+
+namespace art {
+
+// Orders functions with the call-chain clustering (C3) heuristic, placing callers and callees
+// close together. Each function starts in its own cluster. Going through the callees in order,
+// the cluster of a callee is appended to the cluster of the caller with the most calls to it,
+// the first such caller on ties, unless the merged cluster would exceed `max_cluster_size`.
+// Clusters are placed in the order of their first function, so the result only depends on the
+// initial order.
+//
+// `sizes[i]` is the size of function `i` and `calls` holds one (caller, callee) pair for each
+// call site. Calls of a function to itself are ignored. Returns the new order of the functions
+// as indexes into `sizes`.
+std::vector<size_t> ClusterCallChains(const std::vector<size_t>& sizes,
+                                      const std::vector<std::pair<size_t, size_t>>& calls,
+                                      size_t max_cluster_size);
+
+}  // namespace art
+
+#endif  // ART_LIBARTBASE_BASE_CALL_CHAIN_CLUSTERING_H_
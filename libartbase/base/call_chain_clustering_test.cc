@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "call_chain_clustering.h"
+
+#include "gtest/gtest.h"
+
+namespace art {
+
+TEST(CallChainClustering, NoCalls) {
+  EXPECT_EQ((std::vector<size_t>{}), ClusterCallChains({}, {}, 100u));
+  EXPECT_EQ((std::vector<size_t>{0, 1, 2}), ClusterCallChains({10, 10, 10}, {}, 100u));
+}
+
+TEST(CallChainClustering, Chain) {
+  // 0 -> 2 -> 3, function 1 is not called.
+  EXPECT_EQ((std::vector<size_t>{0, 2, 3, 1}),
+            ClusterCallChains({10, 10, 10, 10}, {{0, 2}, {2, 3}}, 100u));
+  // Calls of a function to itself do not merge anything.
+  EXPECT_EQ((std::vector<size_t>{0, 1}), ClusterCallChains({10, 10}, {{1, 1}, {0, 0}}, 100u));
+}
+
+TEST(CallChainClustering, MostFrequentCaller) {
+  // Function 2 follows the caller with most calls to it.
+  EXPECT_EQ((std::vector<size_t>{0, 1, 2}),
+            ClusterCallChains({10, 10, 10}, {{0, 2}, {1, 2}, {1, 2}}, 100u));
+  // The first caller wins ties.
+  EXPECT_EQ((std::vector<size_t>{0, 2, 1}),
+            ClusterCallChains({10, 10, 10}, {{1, 2}, {0, 2}}, 100u));
+}
+
+TEST(CallChainClustering, MaxClusterSize) {
+  // Merging 2 into the cluster of 0 would exceed the limit, it stays on its own.
+  EXPECT_EQ((std::vector<size_t>{0, 1, 2}),
+            ClusterCallChains({60, 40, 10}, {{0, 1}, {0, 2}}, 100u));
+  // A cluster of exactly the limit is allowed.
+  EXPECT_EQ((std::vector<size_t>{0, 2, 1}),
+            ClusterCallChains({60, 50, 40}, {{0, 2}}, 100u));
+}
+
+}  // namespace art
@@ -17,12 +17,16 @@
 #include "dex_file_verifier.h"
 
 #include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
 
+#include <algorithm>
 #include <limits>
 #include <memory>
 
 #include "android-base/stringprintf.h"
 
+#include "base/atomic.h"
 #include "base/leb128.h"
 #include "code_item_accessors-inl.h"
 #include "descriptors_names.h"
@@ -99,6 +103,20 @@ static bool IsDataSectionType(DexFile::MapItemType map_item_type) {
   return true;
 }
 
+// Whether the inter-section checks of other sections rely on the items of the section.
+static bool IsIndexSectionType(DexFile::MapItemType map_item_type) {
+  switch (map_item_type) {
+    case DexFile::kDexTypeStringIdItem:
+    case DexFile::kDexTypeTypeIdItem:
+    case DexFile::kDexTypeProtoIdItem:
+    case DexFile::kDexTypeFieldIdItem:
+    case DexFile::kDexTypeMethodIdItem:
+      return true;
+    default:
+      return false;
+  }
+}
+
 const char* DexFileVerifier::CheckLoadStringByIdx(dex::StringIndex idx, const char* error_string) {
   if (UNLIKELY(!CheckIndex(idx.index_, dex_file_->NumStringIds(), error_string))) {
     return nullptr;
@@ -229,8 +247,23 @@ bool DexFileVerifier::Verify(const DexFile* dex_file,
                              const char* location,
                              bool verify_checksum,
                              std::string* error_msg) {
-  std::unique_ptr<DexFileVerifier> verifier(
-      new DexFileVerifier(dex_file, begin, size, location, verify_checksum));
+  size_t max_threads = 1u;
+  if (size >= kMinParallelVerificationSize) {
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    max_threads = std::min<size_t>(std::max(num_cpus, 1L), kMaxDefaultVerificationThreads);
+  }
+  return Verify(dex_file, begin, size, location, verify_checksum, max_threads, error_msg);
+}
+
+bool DexFileVerifier::Verify(const DexFile* dex_file,
+                             const uint8_t* begin,
+                             size_t size,
+                             const char* location,
+                             bool verify_checksum,
+                             size_t max_threads,
+                             std::string* error_msg) {
+  std::unique_ptr<DexFileVerifier> verifier(new DexFileVerifier(
+      dex_file, begin, size, location, verify_checksum, std::max<size_t>(max_threads, 1u)));
   if (!verifier->Verify()) {
     *error_msg = verifier->FailureReason();
     return false;
@@ -1867,18 +1900,108 @@ bool DexFileVerifier::CheckIntraDataSection(size_t offset,
   return true;
 }
 
+bool DexFileVerifier::CheckIntraMapSection(const DexFile::MapItem* item, size_t* end_offset) {
+  uint32_t section_offset = item->offset_;
+  uint32_t section_count = item->size_;
+  DexFile::MapItemType type = static_cast<DexFile::MapItemType>(item->type_);
+
+  // Check each item based on its type.
+  switch (type) {
+    case DexFile::kDexTypeHeaderItem:
+      if (UNLIKELY(section_count != 1)) {
+        ErrorStringPrintf("Multiple header items");
+        return false;
+      }
+      if (UNLIKELY(section_offset != 0)) {
+        ErrorStringPrintf("Header at %x, not at start of file", section_offset);
+        return false;
+      }
+      ptr_ = begin_ + header_->header_size_;
+      *end_offset = header_->header_size_;
+      break;
+    case DexFile::kDexTypeStringIdItem:
+    case DexFile::kDexTypeTypeIdItem:
+    case DexFile::kDexTypeProtoIdItem:
+    case DexFile::kDexTypeFieldIdItem:
+    case DexFile::kDexTypeMethodIdItem:
+    case DexFile::kDexTypeClassDefItem:
+      if (!CheckIntraIdSection(section_offset, section_count, type)) {
+        return false;
+      }
+      *end_offset = ptr_ - begin_;
+      break;
+    case DexFile::kDexTypeMapList: {
+      const DexFile::MapList* map =
+          reinterpret_cast<const DexFile::MapList*>(begin_ + header_->map_off_);
+      if (UNLIKELY(section_count != 1)) {
+        ErrorStringPrintf("Multiple map list items");
+        return false;
+      }
+      if (UNLIKELY(section_offset != header_->map_off_)) {
+        ErrorStringPrintf("Map not at header-defined offset: %x, expected %x",
+                          section_offset, header_->map_off_);
+        return false;
+      }
+      ptr_ += sizeof(uint32_t) + (map->size_ * sizeof(DexFile::MapItem));
+      *end_offset = section_offset + sizeof(uint32_t) + (map->size_ * sizeof(DexFile::MapItem));
+      break;
+    }
+    case DexFile::kDexTypeMethodHandleItem:
+    case DexFile::kDexTypeCallSiteIdItem:
+      CheckIntraSectionIterate(section_offset, section_count, type);
+      *end_offset = ptr_ - begin_;
+      break;
+    case DexFile::kDexTypeTypeList:
+    case DexFile::kDexTypeAnnotationSetRefList:
+    case DexFile::kDexTypeAnnotationSetItem:
+    case DexFile::kDexTypeClassDataItem:
+    case DexFile::kDexTypeCodeItem:
+    case DexFile::kDexTypeStringDataItem:
+    case DexFile::kDexTypeDebugInfoItem:
+    case DexFile::kDexTypeAnnotationItem:
+    case DexFile::kDexTypeEncodedArrayItem:
+    case DexFile::kDexTypeAnnotationsDirectoryItem:
+      if (!CheckIntraDataSection(section_offset, section_count, type)) {
+        return false;
+      }
+      *end_offset = ptr_ - begin_;
+      break;
+  }
+
+  return true;
+}
+
 bool DexFileVerifier::CheckIntraSection() {
   const DexFile::MapList* map = reinterpret_cast<const DexFile::MapList*>(begin_ + header_->map_off_);
-  const DexFile::MapItem* item = map->list_;
+  const uint32_t count = map->size_;
+
+  // The items of a section can only be found by parsing the section from its start, but the
+  // sections themselves can be checked independently of each other. The results are then
+  // merged below in map order, so that the first failure is the one a sequential walk finds.
+  std::vector<SectionResult> results;
+  std::vector<std::unique_ptr<DexFileVerifier>> workers;
+  if (num_threads_ > 1u && count > 1u) {
+    results.resize(count);
+    CheckSectionsInParallel(
+        count,
+        [map, &results](DexFileVerifier* worker, size_t index) {
+          const DexFile::MapItem* item = &map->list_[index];
+          SectionResult* result = &results[index];
+          worker->ptr_ = worker->begin_ + item->offset_;
+          result->success = worker->CheckIntraMapSection(item, &result->end_offset);
+          result->failure_reason.swap(worker->failure_reason_);
+        },
+        &workers);
+  }
+
   size_t offset = 0;
-  uint32_t count = map->size_;
   ptr_ = begin_;
 
   // Check the items listed in the map.
-  while (count--) {
+  for (uint32_t i = 0; i < count; ++i) {
+    const DexFile::MapItem* item = &map->list_[i];
     const size_t current_offset = offset;
     uint32_t section_offset = item->offset_;
-    uint32_t section_count = item->size_;
     DexFile::MapItemType type = static_cast<DexFile::MapItemType>(item->type_);
 
     // Check for padding and overlap between items.
@@ -1889,72 +2012,34 @@ bool DexFileVerifier::CheckIntraSection() {
       return false;
     }
 
-    // Check each item based on its type.
-    switch (type) {
-      case DexFile::kDexTypeHeaderItem:
-        if (UNLIKELY(section_count != 1)) {
-          ErrorStringPrintf("Multiple header items");
-          return false;
-        }
-        if (UNLIKELY(section_offset != 0)) {
-          ErrorStringPrintf("Header at %x, not at start of file", section_offset);
-          return false;
-        }
-        ptr_ = begin_ + header_->header_size_;
-        offset = header_->header_size_;
-        break;
-      case DexFile::kDexTypeStringIdItem:
-      case DexFile::kDexTypeTypeIdItem:
-      case DexFile::kDexTypeProtoIdItem:
-      case DexFile::kDexTypeFieldIdItem:
-      case DexFile::kDexTypeMethodIdItem:
-      case DexFile::kDexTypeClassDefItem:
-        if (!CheckIntraIdSection(section_offset, section_count, type)) {
-          return false;
-        }
-        offset = ptr_ - begin_;
-        break;
-      case DexFile::kDexTypeMapList:
-        if (UNLIKELY(section_count != 1)) {
-          ErrorStringPrintf("Multiple map list items");
-          return false;
-        }
-        if (UNLIKELY(section_offset != header_->map_off_)) {
-          ErrorStringPrintf("Map not at header-defined offset: %x, expected %x",
-                            section_offset, header_->map_off_);
-          return false;
-        }
-        ptr_ += sizeof(uint32_t) + (map->size_ * sizeof(DexFile::MapItem));
-        offset = section_offset + sizeof(uint32_t) + (map->size_ * sizeof(DexFile::MapItem));
-        break;
-      case DexFile::kDexTypeMethodHandleItem:
-      case DexFile::kDexTypeCallSiteIdItem:
-        CheckIntraSectionIterate(section_offset, section_count, type);
-        offset = ptr_ - begin_;
-        break;
-      case DexFile::kDexTypeTypeList:
-      case DexFile::kDexTypeAnnotationSetRefList:
-      case DexFile::kDexTypeAnnotationSetItem:
-      case DexFile::kDexTypeClassDataItem:
-      case DexFile::kDexTypeCodeItem:
-      case DexFile::kDexTypeStringDataItem:
-      case DexFile::kDexTypeDebugInfoItem:
-      case DexFile::kDexTypeAnnotationItem:
-      case DexFile::kDexTypeEncodedArrayItem:
-      case DexFile::kDexTypeAnnotationsDirectoryItem:
-        if (!CheckIntraDataSection(section_offset, section_count, type)) {
-          return false;
-        }
-        offset = ptr_ - begin_;
-        break;
+    if (results.empty()) {
+      if (!CheckIntraMapSection(item, &offset)) {
+        return false;
+      }
+    } else {
+      SectionResult* result = &results[i];
+      if (!result->success) {
+        failure_reason_ = std::move(result->failure_reason);
+        return false;
+      }
+      if (MapTypeToBitMask(type) != 0) {
+        offset = result->end_offset;
+      }
+      ptr_ = begin_ + offset;
     }
 
     if (offset == current_offset) {
         ErrorStringPrintf("Unknown map item type %x", type);
         return false;
     }
+  }
 
-    item++;
+  // Collect the data section items found by the workers.
+  for (const std::unique_ptr<DexFileVerifier>& worker : workers) {
+    for (const std::pair<uint32_t, uint16_t>& entry : worker->offset_to_type_map_) {
+      DCHECK(offset_to_type_map_.Find(entry.first) == offset_to_type_map_.end());
+      offset_to_type_map_.Insert(entry);
+    }
   }
 
   return true;
@@ -1962,8 +2047,10 @@ bool DexFileVerifier::CheckIntraSection() {
 
 bool DexFileVerifier::CheckOffsetToTypeMap(size_t offset, uint16_t type) {
   DCHECK_NE(offset, 0u);
-  auto it = offset_to_type_map_.Find(offset);
-  if (UNLIKELY(it == offset_to_type_map_.end())) {
+  const auto& offset_to_type_map =
+      (parent_ != nullptr) ? parent_->offset_to_type_map_ : offset_to_type_map_;
+  auto it = offset_to_type_map.Find(offset);
+  if (UNLIKELY(it == offset_to_type_map.end())) {
     ErrorStringPrintf("No data map entry found @ %zx; expected %x", offset, type);
     return false;
   }
@@ -2801,60 +2888,165 @@ bool DexFileVerifier::CheckInterSectionIterate(size_t offset,
   return true;
 }
 
+bool DexFileVerifier::CheckInterMapSection(const DexFile::MapItem* item) {
+  uint32_t section_offset = item->offset_;
+  uint32_t section_count = item->size_;
+  DexFile::MapItemType type = static_cast<DexFile::MapItemType>(item->type_);
+  bool found = false;
+
+  switch (type) {
+    case DexFile::kDexTypeHeaderItem:
+    case DexFile::kDexTypeMapList:
+    case DexFile::kDexTypeTypeList:
+    case DexFile::kDexTypeCodeItem:
+    case DexFile::kDexTypeStringDataItem:
+    case DexFile::kDexTypeDebugInfoItem:
+    case DexFile::kDexTypeAnnotationItem:
+    case DexFile::kDexTypeEncodedArrayItem:
+      found = true;
+      break;
+    case DexFile::kDexTypeStringIdItem:
+    case DexFile::kDexTypeTypeIdItem:
+    case DexFile::kDexTypeProtoIdItem:
+    case DexFile::kDexTypeFieldIdItem:
+    case DexFile::kDexTypeMethodIdItem:
+    case DexFile::kDexTypeClassDefItem:
+    case DexFile::kDexTypeCallSiteIdItem:
+    case DexFile::kDexTypeMethodHandleItem:
+    case DexFile::kDexTypeAnnotationSetRefList:
+    case DexFile::kDexTypeAnnotationSetItem:
+    case DexFile::kDexTypeClassDataItem:
+    case DexFile::kDexTypeAnnotationsDirectoryItem: {
+      if (!CheckInterSectionIterate(section_offset, section_count, type)) {
+        return false;
+      }
+      found = true;
+      break;
+    }
+  }
+
+  if (!found) {
+    ErrorStringPrintf("Unknown map item type %x", item->type_);
+    return false;
+  }
+
+  return true;
+}
+
 bool DexFileVerifier::CheckInterSection() {
   const DexFile::MapList* map = reinterpret_cast<const DexFile::MapList*>(begin_ + header_->map_off_);
-  const DexFile::MapItem* item = map->list_;
-  uint32_t count = map->size_;
+  const uint32_t count = map->size_;
 
-  // Cross check the items listed in the map.
-  while (count--) {
-    uint32_t section_offset = item->offset_;
-    uint32_t section_count = item->size_;
-    DexFile::MapItemType type = static_cast<DexFile::MapItemType>(item->type_);
-    bool found = false;
-
-    switch (type) {
-      case DexFile::kDexTypeHeaderItem:
-      case DexFile::kDexTypeMapList:
-      case DexFile::kDexTypeTypeList:
-      case DexFile::kDexTypeCodeItem:
-      case DexFile::kDexTypeStringDataItem:
-      case DexFile::kDexTypeDebugInfoItem:
-      case DexFile::kDexTypeAnnotationItem:
-      case DexFile::kDexTypeEncodedArrayItem:
-        found = true;
-        break;
-      case DexFile::kDexTypeStringIdItem:
-      case DexFile::kDexTypeTypeIdItem:
-      case DexFile::kDexTypeProtoIdItem:
-      case DexFile::kDexTypeFieldIdItem:
-      case DexFile::kDexTypeMethodIdItem:
-      case DexFile::kDexTypeClassDefItem:
-      case DexFile::kDexTypeCallSiteIdItem:
-      case DexFile::kDexTypeMethodHandleItem:
-      case DexFile::kDexTypeAnnotationSetRefList:
-      case DexFile::kDexTypeAnnotationSetItem:
-      case DexFile::kDexTypeClassDataItem:
-      case DexFile::kDexTypeAnnotationsDirectoryItem: {
-        if (!CheckInterSectionIterate(section_offset, section_count, type)) {
-          return false;
-        }
-        found = true;
-        break;
+  // The checks of the other sections look up strings, types and members through the index
+  // sections, so everything up to the last index section is cross checked in order.
+  uint32_t sequential_count = count;
+  if (num_threads_ > 1u) {
+    sequential_count = 0u;
+    for (uint32_t i = 0; i < count; ++i) {
+      if (IsIndexSectionType(static_cast<DexFile::MapItemType>(map->list_[i].type_))) {
+        sequential_count = i + 1u;
       }
     }
+  }
 
-    if (!found) {
-      ErrorStringPrintf("Unknown map item type %x", item->type_);
-      return false;
+  // Cross check the items listed in the map.
+  for (uint32_t i = 0; i < sequential_count; ++i) {
+    if (!CheckInterMapSection(&map->list_[i])) {
+      return false;
+    }
+  }
+
+  // The remaining sections only depend on the index sections and on the offsets collected by
+  // the intra-section checks, so they can be cross checked concurrently.
+  if (sequential_count < count) {
+    const DexFile::MapItem* items = &map->list_[sequential_count];
+    std::vector<SectionResult> results(count - sequential_count);
+    std::vector<std::unique_ptr<DexFileVerifier>> workers;
+    CheckSectionsInParallel(
+        results.size(),
+        [items, &results](DexFileVerifier* worker, size_t index) {
+          SectionResult* result = &results[index];
+          result->success = worker->CheckInterMapSection(&items[index]);
+          result->failure_reason.swap(worker->failure_reason_);
+        },
+        &workers);
+    for (SectionResult& result : results) {
+      if (!result.success) {
+        failure_reason_ = std::move(result.failure_reason);
+        return false;
+      }
     }
-
-    item++;
   }
 
   return true;
 }
 
+namespace {
+
+template <typename RunFn>
+struct VerifierThreadArgs {
+  const RunFn* run;
+  DexFileVerifier* worker;
+  size_t id;
+};
+
+template <typename RunFn>
+void* RunVerifierThread(void* arg) {
+  VerifierThreadArgs<RunFn>* args = reinterpret_cast<VerifierThreadArgs<RunFn>*>(arg);
+  // Name the thread, so that it can be told apart in traces and stack dumps.
+  std::string name = StringPrintf("dex-verifier-%zu", args->id);
+#if defined(__APPLE__)
+  pthread_setname_np(name.c_str());
+#else
+  pthread_setname_np(pthread_self(), name.c_str());
+#endif
+  (*args->run)(args->worker);
+  return nullptr;
+}
+
+}  // namespace
+
+template <typename CheckSectionFn>
+void DexFileVerifier::CheckSectionsInParallel(
+    size_t count,
+    const CheckSectionFn& check_section,
+    std::vector<std::unique_ptr<DexFileVerifier>>* workers) {
+  DCHECK(workers->empty());
+  Atomic<size_t> next_index(0u);
+  auto run = [&next_index, count, &check_section](DexFileVerifier* worker) {
+    for (size_t index = next_index.FetchAndAddRelaxed(1u);
+         index < count;
+         index = next_index.FetchAndAddRelaxed(1u)) {
+      check_section(worker, index);
+    }
+  };
+
+  size_t num_workers = std::min(num_threads_, count);
+  for (size_t i = 0; i != num_workers; ++i) {
+    workers->emplace_back(new DexFileVerifier(this));
+  }
+  using RunFn = decltype(run);
+  std::vector<VerifierThreadArgs<RunFn>> thread_args(num_workers);
+  std::vector<pthread_t> threads;
+  threads.reserve(num_workers - 1u);
+  for (size_t i = 1; i < num_workers; ++i) {
+    thread_args[i] = { &run, (*workers)[i].get(), i };
+    pthread_t thread;
+    if (pthread_create(&thread, nullptr, RunVerifierThread<RunFn>, &thread_args[i]) != 0) {
+      // The sections are handed out on demand, so the threads already started and the calling
+      // thread do the work of those that could not be started.
+      break;
+    }
+    threads.push_back(thread);
+  }
+  // The calling thread takes part in the work.
+  run((*workers)[0].get());
+  for (pthread_t thread : threads) {
+    int result = pthread_join(thread, nullptr);
+    CHECK_EQ(result, 0);
+  }
+}
+
 bool DexFileVerifier::Verify() {
   // Check the header.
   if (!CheckHeader()) {
@@ -17,8 +17,11 @@
 #ifndef ART_LIBDEXFILE_DEX_DEX_FILE_VERIFIER_H_
 #define ART_LIBDEXFILE_DEX_DEX_FILE_VERIFIER_H_
 
+#include <memory>
 #include <unordered_set>
+#include <vector>
 
+#include "base/globals.h"
 #include "base/hash_map.h"
 #include "base/safe_map.h"
 #include "dex_file.h"
@@ -35,26 +38,65 @@ class DexFileVerifier {
                      bool verify_checksum,
                      std::string* error_msg);
 
+  // As above, but checks the map sections of the file on up to `max_threads` threads. The result
+  // and the failure reason do not depend on the number of threads.
+  static bool Verify(const DexFile* dex_file,
+                     const uint8_t* begin,
+                     size_t size,
+                     const char* location,
+                     bool verify_checksum,
+                     size_t max_threads,
+                     std::string* error_msg);
+
   const std::string& FailureReason() const {
     return failure_reason_;
   }
 
  private:
+  // Files smaller than this are verified on the calling thread only.
+  static constexpr size_t kMinParallelVerificationSize = 1 * MB;
+  // Maximum number of threads used by default for verifying a large file.
+  static constexpr size_t kMaxDefaultVerificationThreads = 4;
+
   DexFileVerifier(const DexFile* dex_file,
                   const uint8_t* begin,
                   size_t size,
                   const char* location,
-                  bool verify_checksum)
+                  bool verify_checksum,
+                  size_t num_threads)
       : dex_file_(dex_file),
         begin_(begin),
         size_(size),
         location_(location),
         verify_checksum_(verify_checksum),
         header_(&dex_file->GetHeader()),
+        num_threads_(num_threads),
+        parent_(nullptr),
         ptr_(nullptr),
         previous_item_(nullptr)  {
   }
 
+  // Creates a verifier checking map sections on behalf of `parent`.
+  explicit DexFileVerifier(const DexFileVerifier* parent)
+      : dex_file_(parent->dex_file_),
+        begin_(parent->begin_),
+        size_(parent->size_),
+        location_(parent->location_),
+        verify_checksum_(parent->verify_checksum_),
+        header_(parent->header_),
+        num_threads_(1u),
+        parent_(parent),
+        ptr_(nullptr),
+        previous_item_(nullptr)  {
+  }
+
+  // Outcome of checking a single map section on a worker verifier.
+  struct SectionResult {
+    bool success = false;
+    size_t end_offset = 0u;
+    std::string failure_reason;
+  };
+
   bool Verify();
 
   bool CheckShortyDescriptorMatch(char shorty_char, const char* descriptor, bool is_return_type);
@@ -127,6 +169,9 @@ class DexFileVerifier {
   bool CheckIntraSectionIterate(size_t offset, uint32_t count, DexFile::MapItemType type);
   bool CheckIntraIdSection(size_t offset, uint32_t count, DexFile::MapItemType type);
   bool CheckIntraDataSection(size_t offset, uint32_t count, DexFile::MapItemType type);
+  // Check the section described by `item`, with ptr_ at the start of the section. The offset of
+  // the end of the section is stored in `end_offset`, which is left alone for unknown types.
+  bool CheckIntraMapSection(const DexFile::MapItem* item, size_t* end_offset);
   bool CheckIntraSection();
 
   bool CheckOffsetToTypeMap(size_t offset, uint16_t type);
@@ -150,8 +195,16 @@ class DexFileVerifier {
   bool CheckInterAnnotationsDirectoryItem();
 
   bool CheckInterSectionIterate(size_t offset, uint32_t count, DexFile::MapItemType type);
+  bool CheckInterMapSection(const DexFile::MapItem* item);
   bool CheckInterSection();
 
+  // Call `check_section(worker, i)` for each i in [0, count) on num_threads_ threads, with one
+  // worker verifier per thread. The workers are returned in `workers`.
+  template <typename CheckSectionFn>
+  void CheckSectionsInParallel(size_t count,
+                               const CheckSectionFn& check_section,
+                               std::vector<std::unique_ptr<DexFileVerifier>>* workers);
+
   // Load a string by (type) index. Checks whether the index is in bounds, printing the error if
   // not. If there is an error, null is returned.
   const char* CheckLoadStringByIdx(dex::StringIndex idx, const char* error_fmt);
@@ -203,6 +256,10 @@ class DexFileVerifier {
   const char* const location_;
   const bool verify_checksum_;
   const DexFile::Header* const header_;
+  // Number of threads used for checking the map sections.
+  const size_t num_threads_;
+  // The verifier whose offset_to_type_map_ is used for cross-section checks, or null for this one.
+  const DexFileVerifier* const parent_;
 
   struct OffsetTypeMapEmptyFn {
     // Make a hash map slot empty by making the offset 0. Offset 0 is a valid dex file offset that
@@ -2082,6 +2082,48 @@ TEST_F(DexFileVerifierTest, InvokeCustomDexSamples) {
   }
 }
 
+TEST_F(DexFileVerifierTest, ParallelVerificationMatchesSequential) {
+  static constexpr size_t kNumThreads = 4;
+  auto verify = [](const DexFile* dex_file, size_t max_threads, std::string* error_msg) {
+    return DexFileVerifier::Verify(dex_file,
+                                   dex_file->Begin(),
+                                   dex_file->Size(),
+                                   kLocationString,
+                                   /*verify_checksum*/ true,
+                                   max_threads,
+                                   error_msg);
+  };
+
+  for (size_t i = 0; i < arraysize(kInvokeCustomDexFiles); ++i) {
+    size_t length;
+    std::unique_ptr<uint8_t[]> dex_bytes(DecodeBase64(kInvokeCustomDexFiles[i], &length));
+    CHECK(dex_bytes != nullptr);
+    // Note: `dex_file` will be destroyed before `dex_bytes`.
+    std::unique_ptr<DexFile> dex_file(GetDexFile(dex_bytes.get(), length));
+    std::string error_msg;
+    EXPECT_TRUE(verify(dex_file.get(), kNumThreads, &error_msg)) << error_msg;
+  }
+
+  // Corrupt each byte after the header in turn. Whichever section fails first in map order must
+  // be the one reported, no matter which thread checked it.
+  size_t length;
+  std::unique_ptr<uint8_t[]> dex_bytes(DecodeBase64(kGoodTestDex, &length));
+  CHECK(dex_bytes != nullptr);
+  for (size_t offset = sizeof(DexFile::Header); offset < length; ++offset) {
+    std::unique_ptr<uint8_t[]> bytes(new uint8_t[length]);
+    memcpy(bytes.get(), dex_bytes.get(), length);
+    bytes[offset] ^= 0xffu;
+    FixUpChecksum(bytes.get());
+    std::unique_ptr<DexFile> dex_file(GetDexFile(bytes.get(), length));
+    std::string sequential_error_msg;
+    bool sequential_success = verify(dex_file.get(), 1u, &sequential_error_msg);
+    std::string parallel_error_msg;
+    bool parallel_success = verify(dex_file.get(), kNumThreads, &parallel_error_msg);
+    EXPECT_EQ(sequential_success, parallel_success) << "offset " << offset;
+    EXPECT_EQ(sequential_error_msg, parallel_error_msg) << "offset " << offset;
+  }
+}
+
 TEST_F(DexFileVerifierTest, BadStaticFieldInitialValuesArray) {
   // Generated DEX file version (037) from:
   //
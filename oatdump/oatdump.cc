@@ -469,6 +469,11 @@ class OatDumper {
                            GetQuickToInterpreterBridgeOffset);
 #undef DUMP_OAT_HEADER_OFFSET
 
+    os << "HOT CODE:\n";
+    os << StringPrintf("0x%08x size %u\n\n",
+                       oat_header.GetHotCodeOffset(),
+                       oat_header.GetHotCodeSize());
+
     os << "IMAGE PATCH DELTA:\n";
     os << StringPrintf("%d (0x%08x)\n\n",
                        oat_header.GetImagePatchDelta(),
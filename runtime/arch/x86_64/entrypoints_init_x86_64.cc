@@ -32,6 +32,9 @@ namespace art {
 // Cast entrypoints.
 extern "C" size_t art_quick_instance_of(mirror::Object* obj, mirror::Class* ref_class);
 
+// Tiered JIT entrypoint. Only the x86-64 code generator emits baseline code.
+extern "C" void art_quick_compile_optimized(ArtMethod* method, Thread* self);
+
 // Read barrier entrypoints.
 // art_quick_read_barrier_mark_regX uses an non-standard calling
 // convention: it expects its input in register X and returns its
@@ -84,6 +87,9 @@ void InitEntryPoints(JniEntryPoints* jpoints, QuickEntryPoints* qpoints) {
   qpoints->pInstanceofNonTrivial = art_quick_instance_of;
   qpoints->pCheckInstanceOf = art_quick_check_instance_of;
 
+  // Thread
+  qpoints->pCompileOptimized = art_quick_compile_optimized;
+
   // More math.
   qpoints->pCos = cos;
   qpoints->pSin = sin;
@@ -79,6 +79,7 @@
 #include "imtable-inl.h"
 #include "intern_table.h"
 #include "interpreter/interpreter.h"
+#include "interpreter/interpreter_cache.h"
 #include "java_vm_ext.h"
 #include "jit/debugger_interface.h"
 #include "jit/jit.h"
@@ -2210,6 +2211,9 @@ void ClassLinker::DeleteClassLoader(Thread* self, const ClassLoaderData& data, b
     data.class_table->Visit<CHAOnDeleteUpdateClassVisitor, kWithoutReadBarrier>(visitor);
   }
 
+  // The interpreter caches may hold fields and methods of the unloaded classes.
+  InterpreterCache::InvalidateAll();
+
   delete data.allocator;
   delete data.class_table;
 }
@@ -231,10 +231,12 @@ class CommonRuntimeTestImpl {
   std::string CreateClassPathWithChecksums(
       const std::vector<std::unique_ptr<const DexFile>>& dex_files);
 
+  // Dex files that class loaders created by the test refer to. They are kept open until the
+  // runtime goes away.
+  std::vector<std::unique_ptr<const DexFile>> loaded_dex_files_;
+
  private:
   static std::string GetCoreFileLocation(const char* suffix);
-
-  std::vector<std::unique_ptr<const DexFile>> loaded_dex_files_;
 };
 
 template <typename TestType>
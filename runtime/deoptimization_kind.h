@@ -28,7 +28,8 @@ enum class DeoptimizationKind {
   kBlockBCE,
   kCHA,
   kFullFrame,
-  kLast = kFullFrame
+  kUntakenBranch,
+  kLast = kUntakenBranch
 };
 
 inline const char* GetDeoptimizationKindName(DeoptimizationKind kind) {
@@ -41,6 +42,7 @@ inline const char* GetDeoptimizationKindName(DeoptimizationKind kind) {
     case DeoptimizationKind::kBlockBCE: return "block bounds check elimination";
     case DeoptimizationKind::kCHA: return "class hierarchy analysis";
     case DeoptimizationKind::kFullFrame: return "full frame";
+    case DeoptimizationKind::kUntakenBranch: return "untaken branch";
   }
   LOG(FATAL) << "Unexpected kind " << static_cast<size_t>(kind);
   UNREACHABLE();
@@ -450,7 +450,18 @@ inline ArtMethod* FindMethodFromCode(uint32_t method_idx,
     DCHECK(self->IsExceptionPending());  // Throw exception and unwind.
     return nullptr;  // Failure.
   }
-  // Next, null pointer check.
+  return FindMethodToCall<type, access_check>(
+      method_idx, resolved_method, this_object, referrer, self);
+}
+
+template<InvokeType type, bool access_check>
+inline ArtMethod* FindMethodToCall(uint32_t method_idx,
+                                   ArtMethod* resolved_method,
+                                   ObjPtr<mirror::Object>* this_object,
+                                   ArtMethod* referrer,
+                                   Thread* self) {
+  ClassLinker* const class_linker = Runtime::Current()->GetClassLinker();
+  // Null pointer check.
   if (UNLIKELY(*this_object == nullptr && type != kStatic)) {
     if (UNLIKELY(resolved_method->GetDeclaringClass()->IsStringClass() &&
                  resolved_method->IsConstructor())) {
@@ -129,6 +129,17 @@ inline ArtMethod* FindMethodFromCode(uint32_t method_idx,
     REQUIRES_SHARED(Locks::mutator_lock_)
     REQUIRES(!Roles::uninterruptible_);
 
+// Second half of FindMethodFromCode: given the `resolved_method` that `method_idx` refers to,
+// checks `this_object` for null and dispatches the call.
+template<InvokeType type, bool access_check>
+inline ArtMethod* FindMethodToCall(uint32_t method_idx,
+                                   ArtMethod* resolved_method,
+                                   ObjPtr<mirror::Object>* this_object,
+                                   ArtMethod* referrer,
+                                   Thread* self)
+    REQUIRES_SHARED(Locks::mutator_lock_)
+    REQUIRES(!Roles::uninterruptible_);
+
 // Fast path field resolution that can't initialize classes or throw exceptions.
 inline ArtField* FindFieldFast(uint32_t field_idx,
                                ArtMethod* referrer,
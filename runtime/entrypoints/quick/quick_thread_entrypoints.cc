@@ -15,6 +15,8 @@
  */
 
 #include "callee_save_frame.h"
+#include "jit/jit.h"
+#include "runtime.h"
 #include "thread-inl.h"
 
 namespace art {
@@ -25,4 +27,18 @@ extern "C" void artTestSuspendFromCode(Thread* self) REQUIRES_SHARED(Locks::muta
   self->CheckSuspend();
 }
 
+extern "C" void artCompileOptimized(ArtMethod* method, Thread* self)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  // Called from the frame entry of baseline compiled code.
+  ScopedQuickEntrypointChecks sqec(self);
+  // The caller has no stack map at this point, so we must not suspend. Also, async
+  // deoptimization does not expect runtime methods other than the suspend check
+  // before the first instruction of a compiled method.
+  ScopedAssertNoThreadSuspension sants("Enqueuing optimized compilation");
+  jit::Jit* jit = Runtime::Current()->GetJit();
+  if (jit != nullptr) {
+    jit->EnqueueOptimizedCompilation(method, self);
+  }
+}
+
 }  // namespace art
@@ -63,11 +63,13 @@ CardTable* CardTable::Create(const uint8_t* heap_begin, size_t heap_capacity) {
   /* Set up the card table */
   size_t capacity = heap_capacity / kCardSize;
   /* Allocate an extra 256 bytes to allow fixed low-byte of base */
+  const size_t alignment = MemMap::GetHugePageAlignment();
   std::string error_msg;
   std::unique_ptr<MemMap> mem_map(
-      MemMap::MapAnonymous("card table", nullptr, capacity + 256, PROT_READ | PROT_WRITE,
-                           false, false, &error_msg));
+      MemMap::MapAnonymousAligned("card table", nullptr, RoundUp(capacity + 256, alignment),
+                                  alignment, PROT_READ | PROT_WRITE, false, &error_msg));
   CHECK(mem_map.get() != nullptr) << "couldn't allocate card table: " << error_msg;
+  mem_map->MadviseHugePages();
   // All zeros is the correct initial value; all clean. Anonymous mmaps are initialized to zero, we
   // don't clear the card table to avoid unnecessary pages being allocated
   static_assert(kCardClean == 0, "kCardClean must be 0");
@@ -16,6 +16,7 @@
 
 #include "rosalloc.h"
 
+#include <limits>
 #include <list>
 #include <map>
 #include <sstream>
@@ -59,6 +60,7 @@ RosAlloc::RosAlloc(void* base, size_t capacity, size_t max_capacity,
     : base_(reinterpret_cast<uint8_t*>(base)), footprint_(capacity),
       capacity_(capacity), max_capacity_(max_capacity),
       lock_("rosalloc global lock", kRosAllocGlobalLock),
+      refaulted_bytes_(0u),
       bulk_free_lock_("rosalloc bulk free lock", kRosAllocBulkFreeLock),
       page_release_mode_(page_release_mode),
       page_release_size_threshold_(page_release_size_threshold),
@@ -99,6 +101,7 @@ RosAlloc::RosAlloc(void* base, size_t capacity, size_t max_capacity,
   page_map_size_ = num_of_pages;
   max_page_map_size_ = max_num_of_pages;
   free_page_run_size_map_.resize(num_of_pages);
+  trimmed_pages_.resize(num_of_pages);
   FreePageRun* free_pages = reinterpret_cast<FreePageRun*>(base_);
   if (kIsDebugBuild) {
     free_pages->magic_num_ = kMagicNumFree;
@@ -197,6 +200,7 @@ void* RosAlloc::AllocPages(Thread* self, size_t num_pages, uint8_t page_map_type
       page_map_size_ = new_num_of_pages;
       DCHECK_LE(page_map_size_, max_page_map_size_);
       free_page_run_size_map_.resize(new_num_of_pages);
+      trimmed_pages_.resize(new_num_of_pages);
       ArtRosAllocMoreCore(this, increment);
       if (last_free_page_run_size > 0) {
         // There was a free page run at the end. Expand its size.
@@ -268,6 +272,10 @@ void* RosAlloc::AllocPages(Thread* self, size_t num_pages, uint8_t page_map_type
     size_t page_map_idx = ToPageMapIndex(res);
     for (size_t i = 0; i < num_pages; i++) {
       DCHECK(IsFreePage(page_map_idx + i));
+      if (trimmed_pages_[page_map_idx + i]) {
+        refaulted_bytes_ += kPageSize;
+        trimmed_pages_[page_map_idx + i] = false;
+      }
     }
     switch (page_map_type) {
     case kPageMapRun:
@@ -1405,6 +1413,7 @@ bool RosAlloc::Trim() {
     page_map_size_ = new_num_of_pages;
     free_page_run_size_map_.resize(new_num_of_pages);
     DCHECK_EQ(free_page_run_size_map_.size(), new_num_of_pages);
+    trimmed_pages_.resize(new_num_of_pages);
     ArtRosAllocMoreCore(this, -(static_cast<intptr_t>(decrement)));
     if (kTraceRosAlloc) {
       LOG(INFO) << "RosAlloc::Trim() : decreased the footprint from "
@@ -2004,13 +2013,35 @@ void RosAlloc::Run::Verify(Thread* self, RosAlloc* rosalloc, bool running_on_mem
 }
 
 size_t RosAlloc::ReleasePages() {
+  size_t page_idx = 0;
+  return ReleasePages(std::numeric_limits<size_t>::max(), &page_idx);
+}
+
+size_t RosAlloc::GetAndResetRefaultedBytes() {
+  MutexLock mu(Thread::Current(), lock_);
+  size_t refaulted_bytes = refaulted_bytes_;
+  refaulted_bytes_ = 0u;
+  return refaulted_bytes;
+}
+
+size_t RosAlloc::ReleasePages(size_t max_bytes, size_t* page_idx) {
   VLOG(heap) << "RosAlloc::ReleasePages()";
   DCHECK(!DoesReleaseAllPages());
+  // Pages are released in units of huge pages when those are in use, see ReleasePageRange().
+  const size_t release_unit = MemMap::GetHugePageAlignment();
+  DCHECK_GE(max_bytes, release_unit);
   Thread* self = Thread::Current();
   size_t reclaimed_bytes = 0;
-  size_t i = 0;
+  size_t i = *page_idx;
   // Check the page map size which might have changed due to grow/shrink.
   while (i < page_map_size_) {
+    DCHECK_LE(reclaimed_bytes, max_bytes);
+    const size_t budget = RoundDown(max_bytes - reclaimed_bytes, release_unit);
+    if (budget == 0u) {
+      // Resume from here next time, which may be in the middle of a free page run.
+      *page_idx = i;
+      return reclaimed_bytes;
+    }
     // Reading the page map without a lock is racy but the race is benign since it should only
     // result in occasionally not releasing pages which we could release.
     uint8_t pm = page_map_[i];
@@ -2018,7 +2049,6 @@ size_t RosAlloc::ReleasePages() {
       case kPageMapReleased:
         // Fall through.
       case kPageMapEmpty: {
-        // This is currently the start of a free page run.
         // Acquire the lock to prevent other threads racing in and modifying the page map.
         MutexLock mu(self, lock_);
         // Check that it's still empty after we acquired the lock since another thread could have
@@ -2026,21 +2056,37 @@ size_t RosAlloc::ReleasePages() {
         if (IsFreePage(i)) {
           // Free page runs can start with a released page if we coalesced a released page free
           // page run with an empty page run.
-          FreePageRun* fpr = reinterpret_cast<FreePageRun*>(base_ + i * kPageSize);
-          // There is a race condition where FreePage can coalesce fpr with the previous
-          // free page run before we acquire lock_. In that case free_page_runs_.find will not find
-          // a run starting at fpr. To handle this race, we skip reclaiming the page range and go
-          // to the next page.
-          if (free_page_runs_.find(fpr) != free_page_runs_.end()) {
-            size_t fpr_size = fpr->ByteSize(this);
-            DCHECK_ALIGNED(fpr_size, kPageSize);
-            uint8_t* start = reinterpret_cast<uint8_t*>(fpr);
-            reclaimed_bytes += ReleasePageRange(start, start + fpr_size);
-            size_t pages = fpr_size / kPageSize;
-            CHECK_GT(pages, 0U) << "Infinite loop probable";
-            i += pages;
-            DCHECK_LE(i, page_map_size_);
-            break;
+          uint8_t* start = base_ + i * kPageSize;
+          // The page is not necessarily the start of its free page run: the previous step may
+          // have stopped in the middle of the run, or FreePages() may have coalesced the run with
+          // the previous one before we acquired lock_. Look up the run containing the page.
+          auto it = free_page_runs_.upper_bound(reinterpret_cast<FreePageRun*>(start));
+          if (it != free_page_runs_.begin()) {
+            FreePageRun* fpr = *--it;
+            uint8_t* fpr_end = reinterpret_cast<uint8_t*>(fpr->End(this));
+            if (start < fpr_end) {
+              uint8_t* release_begin = start;
+              if (kIsDebugBuild && release_begin == reinterpret_cast<uint8_t*>(fpr)) {
+                // In the debug build, the first page of a free page run
+                // contains a magic number for debugging. Exclude it.
+                release_begin += kPageSize;
+              }
+              // Only release whole huge pages, releasing part of one would split it into small
+              // pages. The end is clamped to the budget, the next step resumes from there.
+              release_begin = AlignUp(release_begin, release_unit);
+              uint8_t* release_end = AlignDown(fpr_end, release_unit);
+              if (release_begin < release_end) {
+                release_end = std::min(release_end, release_begin + budget);
+                reclaimed_bytes +=
+                    ReleaseAlignedPageRange(release_begin, release_end, /* trimming */ true);
+                fpr_end = release_end;
+              }
+              size_t next_idx = (fpr_end - base_) / kPageSize;
+              CHECK_GT(next_idx, i) << "Infinite loop probable";
+              i = next_idx;
+              DCHECK_LE(i, page_map_size_);
+              break;
+            }
           }
         }
         FALLTHROUGH_INTENDED;
@@ -2056,10 +2102,11 @@ size_t RosAlloc::ReleasePages() {
         break;
     }
   }
+  *page_idx = 0u;
   return reclaimed_bytes;
 }
 
-size_t RosAlloc::ReleasePageRange(uint8_t* start, uint8_t* end) {
+size_t RosAlloc::ReleasePageRange(uint8_t* start, uint8_t* end, bool trimming) {
   DCHECK_ALIGNED(start, kPageSize);
   DCHECK_ALIGNED(end, kPageSize);
   DCHECK_LT(start, end);
@@ -2073,6 +2120,18 @@ size_t RosAlloc::ReleasePageRange(uint8_t* start, uint8_t* end) {
       return 0;
     }
   }
+  // Only release whole huge pages, releasing part of one would split it into small pages.
+  // This comes after excluding the magic page, so that the released range stays aligned.
+  if (MemMap::UseHugePages() && !MemMap::AlignToHugePages(&start, &end)) {
+    return 0;
+  }
+  return ReleaseAlignedPageRange(start, end, trimming);
+}
+
+size_t RosAlloc::ReleaseAlignedPageRange(uint8_t* start, uint8_t* end, bool trimming) {
+  DCHECK_ALIGNED_PARAM(start, MemMap::GetHugePageAlignment());
+  DCHECK_ALIGNED_PARAM(end, MemMap::GetHugePageAlignment());
+  DCHECK_LT(start, end);
   if (!kMadviseZeroes) {
     // TODO: Do this when we resurrect the page instead.
     memset(start, 0, end - start);
@@ -2088,6 +2147,9 @@ size_t RosAlloc::ReleasePageRange(uint8_t* start, uint8_t* end) {
       // Mark the page as released and update how many bytes we released.
       reclaimed_bytes += kPageSize;
       page_map_[pm_idx] = kPageMapReleased;
+      if (trimming) {
+        trimmed_pages_[pm_idx] = true;
+      }
     }
   }
   return reclaimed_bytes;
@@ -105,7 +105,7 @@ class RosAlloc {
       size_t byte_size = ByteSize(rosalloc);
       DCHECK_EQ(byte_size % kPageSize, static_cast<size_t>(0));
       if (ShouldReleasePages(rosalloc)) {
-        rosalloc->ReleasePageRange(start, start + byte_size);
+        rosalloc->ReleasePageRange(start, start + byte_size, /* trimming */ false);
       }
     }
 
@@ -755,9 +755,15 @@ class RosAlloc {
   // release backing pages.
   std::vector<size_t, TrackingAllocator<size_t, kAllocatorTagRosAlloc>> free_page_run_size_map_
       GUARDED_BY(lock_);
+  // The pages released by ReleasePages() which have not been allocated again since. Pages
+  // released when they are freed, or which were never used, are not included.
+  std::vector<bool, TrackingAllocator<bool, kAllocatorTagRosAlloc>> trimmed_pages_
+      GUARDED_BY(lock_);
   // The global lock. Used to guard the page map, the free page set,
   // and the footprint.
   Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  // Bytes of pages released by ReleasePages() that were handed out again by AllocPages().
+  size_t refaulted_bytes_ GUARDED_BY(lock_);
   // The reader-writer lock to allow one bulk free at a time while
   // allowing multiple individual frees at the same time.
   // Currently RosAlloc is using bulk free(BulkFree) to free garbages
@@ -822,8 +828,12 @@ class RosAlloc {
   // Revoke the current runs which share an index with the thread local runs.
   void RevokeThreadUnsafeCurrentRuns() REQUIRES(!lock_);
 
-  // Release a range of pages.
-  size_t ReleasePageRange(uint8_t* start, uint8_t* end) REQUIRES(lock_);
+  // Release a range of pages. `trimming` is set when called from ReleasePages(), whose released
+  // pages count as refaulted when they are allocated again.
+  size_t ReleasePageRange(uint8_t* start, uint8_t* end, bool trimming) REQUIRES(lock_);
+  // Release a range of free pages which does not include the magic page of a free page run and
+  // is aligned to MemMap::GetHugePageAlignment().
+  size_t ReleaseAlignedPageRange(uint8_t* start, uint8_t* end, bool trimming) REQUIRES(lock_);
 
   // Dumps the page map for debugging.
   std::string DumpPageMap() REQUIRES(lock_);
@@ -893,6 +903,14 @@ class RosAlloc {
 
   // Release empty pages.
   size_t ReleasePages() REQUIRES(!lock_);
+  // Release empty pages starting at page map index `*page_idx`, at most `max_bytes` of them, which
+  // must be at least MemMap::GetHugePageAlignment(). Updates `*page_idx` to where the next call
+  // should resume, possibly in the middle of a free page run, which is 0 once the end of the page
+  // map has been reached.
+  size_t ReleasePages(size_t max_bytes, size_t* page_idx) REQUIRES(!lock_);
+  // Returns the number of bytes of pages released by ReleasePages() that have been allocated
+  // again since the last call, and resets the count.
+  size_t GetAndResetRefaultedBytes() REQUIRES(!lock_);
   // Returns the current footprint.
   size_t Footprint() REQUIRES(!lock_);
   // Returns the current capacity, maximum footprint.
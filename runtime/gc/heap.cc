@@ -199,7 +199,8 @@ Heap::Heap(size_t initial_size,
            size_t bump_space_capacity,
            bool measure_gc_performance,
            bool use_homogeneous_space_compaction_for_oom,
-           uint64_t min_interval_homogeneous_space_compaction_by_oom)
+           uint64_t min_interval_homogeneous_space_compaction_by_oom,
+           size_t heap_trim_step_size)
     : non_moving_space_(nullptr),
       rosalloc_space_(nullptr),
       dlmalloc_space_(nullptr),
@@ -280,6 +281,7 @@ Heap::Heap(size_t initial_size,
       last_time_homogeneous_space_compaction_by_oom_(NanoTime()),
       pending_collector_transition_(nullptr),
       pending_heap_trim_(nullptr),
+      heap_trim_step_size_(heap_trim_step_size),
       use_homogeneous_space_compaction_for_oom_(use_homogeneous_space_compaction_for_oom),
       running_collection_is_blocking_(false),
       blocking_gc_count_(0U),
@@ -701,7 +703,12 @@ MemMap* Heap::MapAnonymousPreferredAddress(const char* name,
   while (true) {
     MemMap* map = MemMap::MapAnonymous(name, request_begin, capacity,
                                        PROT_READ | PROT_WRITE, true, false, out_error_str);
-    if (map != nullptr || request_begin == nullptr) {
+    if (map != nullptr) {
+      // The main spaces must stay adjacent to the image, so they are advised but not aligned.
+      map->MadviseHugePages();
+      return map;
+    }
+    if (request_begin == nullptr) {
       return map;
     }
     // Retry a  second time with no specified request begin.
@@ -1120,6 +1127,10 @@ void Heap::DumpGcPerformanceInfo(std::ostream& os) {
     rosalloc_space_->DumpStats(os);
   }
 
+  if (large_object_space_ != nullptr) {
+    large_object_space_->DumpStats(os);
+  }
+
   os << "Registered native bytes allocated: "
      << old_native_bytes_allocated_.LoadRelaxed() + new_native_bytes_allocated_.LoadRelaxed()
      << "\n";
@@ -1338,6 +1349,24 @@ void Heap::DoPendingCollectorTransition() {
 }
 
 void Heap::Trim(Thread* self) {
+  TrimRuntimeStructures(self);
+  TrimSpaces(self, 0u, /* first_step */ true);
+}
+
+bool Heap::TrimStep(Thread* self, bool first_step) {
+  if (heap_trim_step_size_ == 0u) {
+    Trim(self);
+    return false;
+  }
+  // Release the pages in bounded steps so that the app does not take a burst of page faults if
+  // it starts allocating again right after the trim.
+  if (first_step) {
+    TrimRuntimeStructures(self);
+  }
+  return TrimSpaces(self, heap_trim_step_size_, first_step);
+}
+
+void Heap::TrimRuntimeStructures(Thread* self) {
   Runtime* const runtime = Runtime::Current();
   if (!CareAboutPauseTimes()) {
     // Deflate the monitors, this can cause a pause but shouldn't matter since we don't care
@@ -1352,7 +1381,6 @@ void Heap::Trim(Thread* self) {
         << PrettyDuration(NanoTime() - start_time);
   }
   TrimIndirectReferenceTables(self);
-  TrimSpaces(self);
   // Trim arenas that may have been used by JIT or verifier.
   runtime->GetArenaPool()->TrimMaps();
 }
@@ -1408,7 +1436,7 @@ void Heap::UnblockGC(Thread* self) {
   FinishGC(self, collector::kGcTypeNone);
 }
 
-void Heap::TrimSpaces(Thread* self) {
+bool Heap::TrimSpaces(Thread* self, size_t max_step_bytes, bool first_step) {
   // Pretend we are doing a GC to prevent background compaction from deleting the space we are
   // trimming.
   StartGC(self, kGcCauseTrim, kCollectorTypeHeapTrim);
@@ -1418,6 +1446,7 @@ void Heap::TrimSpaces(Thread* self) {
   uint64_t total_alloc_space_allocated = 0;
   uint64_t total_alloc_space_size = 0;
   uint64_t managed_reclaimed = 0;
+  bool more_to_trim = false;
   {
     ScopedObjectAccess soa(self);
     for (const auto& space : continuous_spaces_) {
@@ -1426,7 +1455,13 @@ void Heap::TrimSpaces(Thread* self) {
         if (malloc_space->IsRosAllocSpace() || !CareAboutPauseTimes()) {
           // Don't trim dlmalloc spaces if we care about pauses since this can hold the space lock
           // for a long period of time.
-          managed_reclaimed += malloc_space->Trim();
+          if (max_step_bytes == 0u) {
+            managed_reclaimed += malloc_space->Trim();
+          } else {
+            bool done = false;
+            managed_reclaimed += malloc_space->TrimStep(max_step_bytes, first_step, &done);
+            more_to_trim = more_to_trim || !done;
+          }
         }
         total_alloc_space_size += malloc_space->Size();
       }
@@ -1451,6 +1486,7 @@ void Heap::TrimSpaces(Thread* self) {
   VLOG(heap) << "Heap trim of managed (duration=" << PrettyDuration(gc_heap_end_ns - start_ns)
       << ", advised=" << PrettySize(managed_reclaimed) << ") heap. Managed heap utilization of "
       << static_cast<int>(100 * managed_utilization) << "%.";
+  return more_to_trim;
 }
 
 bool Heap::IsValidObjectAddress(const void* addr) const {
@@ -3979,12 +4015,19 @@ void Heap::RequestCollectorTransition(CollectorType desired_collector_type, uint
 
 class Heap::HeapTrimTask : public HeapTask {
  public:
-  explicit HeapTrimTask(uint64_t delta_time) : HeapTask(NanoTime() + delta_time) { }
+  HeapTrimTask(uint64_t delta_time, bool first_step)
+      : HeapTask(NanoTime() + delta_time), first_step_(first_step) { }
   virtual void Run(Thread* self) OVERRIDE {
     gc::Heap* heap = Runtime::Current()->GetHeap();
-    heap->Trim(self);
+    const bool more_to_trim = heap->TrimStep(self, first_step_);
     heap->ClearPendingTrim(self);
+    if (more_to_trim && CanAddHeapTask(self)) {
+      heap->AddHeapTrimTask(self, kHeapTrimStepWait, /* first_step */ false);
+    }
   }
+
+ private:
+  const bool first_step_;
 };
 
 void Heap::ClearPendingTrim(Thread* self) {
@@ -4008,6 +4051,10 @@ void Heap::RequestTrim(Thread* self) {
   // to utilization (which is probably inversely proportional to how much benefit we can expect).
   // We could try mincore(2) but that's only a measure of how many pages we haven't given away,
   // not how much use we're making of those pages.
+  AddHeapTrimTask(self, kHeapTrimWait, /* first_step */ true);
+}
+
+void Heap::AddHeapTrimTask(Thread* self, uint64_t delta_time, bool first_step) {
   HeapTrimTask* added_task = nullptr;
   {
     MutexLock mu(self, *pending_task_lock_);
@@ -4015,7 +4062,7 @@ void Heap::RequestTrim(Thread* self) {
       // Already have a heap trim request in task processor, ignore this request.
       return;
     }
-    added_task = new HeapTrimTask(kHeapTrimWait);
+    added_task = new HeapTrimTask(delta_time, first_step);
     pending_heap_trim_ = added_task;
   }
   task_processor_->AddTask(self, added_task);
@@ -149,6 +149,8 @@ class Heap {
   // Primitive arrays larger than this size are put in the large object space.
   static constexpr size_t kMinLargeObjectThreshold = 3 * kPageSize;
   static constexpr size_t kDefaultLargeObjectThreshold = kMinLargeObjectThreshold;
+  // Default number of bytes a heap trim step releases per space, 0 trims everything at once.
+  static constexpr size_t kDefaultHeapTrimStepSize = 4 * MB;
   // Whether or not parallel GC is enabled. If not, then we never create the thread pool.
   static constexpr bool kDefaultEnableParallelGC = false;
   static uint8_t* const kPreferredAllocSpaceBegin;
@@ -165,6 +167,8 @@ class Heap {
 
   // How often we allow heap trimming to happen (nanoseconds).
   static constexpr uint64_t kHeapTrimWait = MsToNs(5000);
+  // How long we wait between the steps of an incremental heap trim (nanoseconds).
+  static constexpr uint64_t kHeapTrimStepWait = MsToNs(100);
   // How long we wait after a transition request to perform a collector transition (nanoseconds).
   static constexpr uint64_t kCollectorTransitionWait = MsToNs(5000);
   // Whether the transition-wait applies or not. Zero wait will stress the
@@ -208,7 +212,8 @@ class Heap {
        size_t bump_space_capacity,
        bool measure_gc_performance,
        bool use_homogeneous_space_compaction,
-       uint64_t min_interval_homogeneous_space_compaction_by_oom);
+       uint64_t min_interval_homogeneous_space_compaction_by_oom,
+       size_t heap_trim_step_size);
 
   ~Heap();
 
@@ -1095,8 +1100,21 @@ class Heap {
         collector_type_ == kCollectorTypeGenCopying;
   }
 
-  // Trim the managed and native spaces by releasing unused memory back to the OS.
-  void TrimSpaces(Thread* self) REQUIRES(!*gc_complete_lock_);
+  // Trim the managed and native spaces by releasing unused memory back to the OS. If
+  // `max_step_bytes` is not 0, at most that many bytes are released per space and the
+  // return value tells whether there is more to release. `first_step` starts a new pass.
+  bool TrimSpaces(Thread* self, size_t max_step_bytes, bool first_step)
+      REQUIRES(!*gc_complete_lock_);
+
+  // Deflate monitors, trim the reference tables and the arena pool.
+  void TrimRuntimeStructures(Thread* self) REQUIRES(!*gc_complete_lock_);
+
+  // Perform one step of an incremental trim. Returns true if more steps are needed.
+  bool TrimStep(Thread* self, bool first_step) REQUIRES(!*gc_complete_lock_);
+
+  // Queue a heap trim task unless one is already pending.
+  void AddHeapTrimTask(Thread* self, uint64_t delta_time, bool first_step)
+      REQUIRES(!*pending_task_lock_);
 
   // Trim 0 pages at the end of reference tables.
   void TrimIndirectReferenceTables(Thread* self);
@@ -1436,6 +1454,8 @@ class Heap {
   // Active tasks which we can modify (change target time, desired collector type, etc..).
   CollectorTransitionTask* pending_collector_transition_ GUARDED_BY(pending_task_lock_);
   HeapTrimTask* pending_heap_trim_ GUARDED_BY(pending_task_lock_);
+  // Bytes released per space in each step of a background heap trim, 0 to trim all at once.
+  const size_t heap_trim_step_size_;
 
   // Threshold for promoting old enough objects to old generation space.
   // This is for Generational Copying collector.
@@ -19,6 +19,7 @@
 #include "base/time_utils.h"
 #include "base/utils.h"
 #include "collector/garbage_collector.h"
+#include "heap.h"
 #include "java_vm_ext.h"
 #include "mirror/class-inl.h"
 #include "mirror/object-inl.h"
@@ -124,6 +125,25 @@ void ReferenceProcessor::StopPreservingReferences(Thread* self) {
   condition_.Broadcast(self);
 }
 
+void ReferenceProcessor::ClearWhiteReferences(ReferenceQueue* queue,
+                                              const char* name,
+                                              TimingLogger* timings,
+                                              collector::GarbageCollector* collector) {
+  TimingLogger::ScopedTiming t(name, timings);
+  Heap* heap = Runtime::Current()->GetHeap();
+  ThreadPool* thread_pool = heap->GetThreadPool();
+  if (thread_pool == nullptr || collector->IsTransactionActive()) {
+    queue->ClearWhiteReferences(&cleared_references_, collector);
+  } else {
+    // The clearing of independent references does not touch the mark stack, so unlike finalizer
+    // references it can be spread over the GC threads.
+    queue->ClearWhiteReferencesParallel(&cleared_references_,
+                                        collector,
+                                        thread_pool,
+                                        heap->GetParallelGCThreadCount() + 1);
+  }
+}
+
 // Process reference class instances and schedule finalizations.
 void ReferenceProcessor::ProcessReferences(bool concurrent,
                                            TimingLogger* timings,
@@ -165,8 +185,14 @@ void ReferenceProcessor::ProcessReferences(bool concurrent,
     }
   }
   // Clear all remaining soft and weak references with white referents.
-  soft_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
-  weak_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
+  ClearWhiteReferences(&soft_reference_queue_,
+                       concurrent ? "ClearSoftReferences" : "(Paused)ClearSoftReferences",
+                       timings,
+                       collector);
+  ClearWhiteReferences(&weak_reference_queue_,
+                       concurrent ? "ClearWeakReferences" : "(Paused)ClearWeakReferences",
+                       timings,
+                       collector);
   {
     TimingLogger::ScopedTiming t2(concurrent ? "EnqueueFinalizerReferences" :
         "(Paused)EnqueueFinalizerReferences", timings);
@@ -181,10 +207,21 @@ void ReferenceProcessor::ProcessReferences(bool concurrent,
     }
   }
   // Clear all finalizer referent reachable soft and weak references with white referents.
-  soft_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
-  weak_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
+  ClearWhiteReferences(&soft_reference_queue_,
+                       concurrent ? "ClearFinalizerReachableSoftReferences" :
+                           "(Paused)ClearFinalizerReachableSoftReferences",
+                       timings,
+                       collector);
+  ClearWhiteReferences(&weak_reference_queue_,
+                       concurrent ? "ClearFinalizerReachableWeakReferences" :
+                           "(Paused)ClearFinalizerReachableWeakReferences",
+                       timings,
+                       collector);
   // Clear all phantom references with white referents.
-  phantom_reference_queue_.ClearWhiteReferences(&cleared_references_, collector);
+  ClearWhiteReferences(&phantom_reference_queue_,
+                       concurrent ? "ClearPhantomReferences" : "(Paused)ClearPhantomReferences",
+                       timings,
+                       collector);
   // At this point all reference queues other than the cleared references should be empty.
   DCHECK(soft_reference_queue_.IsEmpty());
   DCHECK(weak_reference_queue_.IsEmpty());
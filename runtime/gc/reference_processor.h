@@ -87,6 +87,13 @@ class ReferenceProcessor {
   // referents.
   void StartPreservingReferences(Thread* self) REQUIRES(!Locks::reference_processor_lock_);
   void StopPreservingReferences(Thread* self) REQUIRES(!Locks::reference_processor_lock_);
+  // Clear the white referents of `queue` into cleared_references_, using the GC thread pool when
+  // there is one.
+  void ClearWhiteReferences(ReferenceQueue* queue,
+                            const char* name,
+                            TimingLogger* timings,
+                            collector::GarbageCollector* collector)
+      REQUIRES_SHARED(Locks::mutator_lock_);
   // Wait until reference processing is done.
   void WaitUntilDoneProcessingReferences(Thread* self)
       REQUIRES_SHARED(Locks::mutator_lock_)
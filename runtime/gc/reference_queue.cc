@@ -23,6 +23,7 @@
 #include "mirror/object-inl.h"
 #include "mirror/reference-inl.h"
 #include "object_callbacks.h"
+#include "runtime.h"
 
 namespace art {
 namespace gc {
@@ -55,6 +56,21 @@ void ReferenceQueue::EnqueueReference(ObjPtr<mirror::Reference> ref) {
   list_->SetPendingNext(ref);
 }
 
+void ReferenceQueue::EnqueueAll(ReferenceQueue* other) {
+  if (other->IsEmpty()) {
+    return;
+  }
+  if (IsEmpty()) {
+    list_ = other->list_;
+  } else {
+    // Both lists are cyclic, swap the successors of the two list_ entries to join the cycles.
+    ObjPtr<mirror::Reference> head = list_->GetPendingNext<kWithoutReadBarrier>();
+    list_->SetPendingNext(other->list_->GetPendingNext<kWithoutReadBarrier>());
+    other->list_->SetPendingNext(head);
+  }
+  other->Clear();
+}
+
 ObjPtr<mirror::Reference> ReferenceQueue::DequeuePendingReference() {
   DCHECK(!IsEmpty());
   ObjPtr<mirror::Reference> ref = list_->GetPendingNext<kWithoutReadBarrier>();
@@ -129,25 +145,100 @@ size_t ReferenceQueue::GetLength() const {
   return count;
 }
 
+void ReferenceQueue::ClearWhiteReference(ObjPtr<mirror::Reference> ref,
+                                         ReferenceQueue* cleared_references,
+                                         collector::GarbageCollector* collector) {
+  mirror::HeapReference<mirror::Object>* referent_addr = ref->GetReferentReferenceAddr();
+  // do_atomic_update is false because this happens during the reference processing phase where
+  // Reference.clear() would block.
+  if (!collector->IsNullOrMarkedHeapReference(referent_addr, /*do_atomic_update*/false)) {
+    // Referent is white, clear it.
+    if (Runtime::Current()->IsActiveTransaction()) {
+      ref->ClearReferent<true>();
+    } else {
+      ref->ClearReferent<false>();
+    }
+    cleared_references->EnqueueReference(ref);
+  }
+  // Delay disabling the read barrier until here so that the ClearReferent call above in
+  // transaction mode will trigger the read barrier.
+  DisableReadBarrierForReference(ref);
+}
+
 void ReferenceQueue::ClearWhiteReferences(ReferenceQueue* cleared_references,
                                           collector::GarbageCollector* collector) {
   while (!IsEmpty()) {
-    ObjPtr<mirror::Reference> ref = DequeuePendingReference();
-    mirror::HeapReference<mirror::Object>* referent_addr = ref->GetReferentReferenceAddr();
-    // do_atomic_update is false because this happens during the reference processing phase where
-    // Reference.clear() would block.
-    if (!collector->IsNullOrMarkedHeapReference(referent_addr, /*do_atomic_update*/false)) {
-      // Referent is white, clear it.
-      if (Runtime::Current()->IsActiveTransaction()) {
-        ref->ClearReferent<true>();
-      } else {
-        ref->ClearReferent<false>();
-      }
-      cleared_references->EnqueueReference(ref);
+    ClearWhiteReference(DequeuePendingReference(), cleared_references, collector);
+  }
+}
+
+// Clears the white referents of a shard of references into a shard local queue.
+class ClearWhiteReferencesTask : public SelfDeletingTask {
+ public:
+  ClearWhiteReferencesTask(ReferenceQueue* queue,
+                           ReferenceQueue* cleared_references,
+                           collector::GarbageCollector* collector,
+                           mirror::Reference* const* begin,
+                           mirror::Reference* const* end)
+      : queue_(queue),
+        cleared_references_(cleared_references),
+        collector_(collector),
+        begin_(begin),
+        end_(end) {}
+
+  void Run(Thread* self ATTRIBUTE_UNUSED) OVERRIDE NO_THREAD_SAFETY_ANALYSIS {
+    for (mirror::Reference* const* it = begin_; it != end_; ++it) {
+      queue_->ClearWhiteReference(*it, cleared_references_, collector_);
     }
-    // Delay disabling the read barrier until here so that the ClearReferent call above in
-    // transaction mode will trigger the read barrier.
-    DisableReadBarrierForReference(ref);
+  }
+
+ private:
+  ReferenceQueue* const queue_;
+  ReferenceQueue* const cleared_references_;
+  collector::GarbageCollector* const collector_;
+  mirror::Reference* const* const begin_;
+  mirror::Reference* const* const end_;
+};
+
+void ReferenceQueue::ClearWhiteReferencesParallel(ReferenceQueue* cleared_references,
+                                                  collector::GarbageCollector* collector,
+                                                  ThreadPool* thread_pool,
+                                                  size_t thread_count) {
+  // Below this, the cost of starting the workers outweighs the parallel speedup.
+  static constexpr size_t kMinReferencesPerShard = 1024;
+  DCHECK(!Runtime::Current()->IsActiveTransaction());
+  std::vector<mirror::Reference*> refs;
+  while (!IsEmpty()) {
+    refs.push_back(DequeuePendingReference().Ptr());
+  }
+  const size_t num_shards =
+      std::min(thread_count, std::max<size_t>(refs.size() / kMinReferencesPerShard, 1u));
+  if (thread_pool == nullptr || num_shards <= 1u) {
+    for (mirror::Reference* ref : refs) {
+      ClearWhiteReference(ref, cleared_references, collector);
+    }
+    return;
+  }
+  // Each shard enqueues into its own list, the lists are joined in shard order afterwards so that
+  // the result does not depend on the scheduling of the workers.
+  std::vector<std::unique_ptr<ReferenceQueue>> shard_cleared_references;
+  Thread* self = Thread::Current();
+  thread_pool->SetMaxActiveWorkers(num_shards - 1);
+  thread_pool->StartWorkers(self);
+  const size_t shard_size = RoundUp(refs.size(), num_shards) / num_shards;
+  for (size_t begin = 0; begin < refs.size(); begin += shard_size) {
+    const size_t end = std::min(begin + shard_size, refs.size());
+    shard_cleared_references.emplace_back(new ReferenceQueue(lock_));
+    thread_pool->AddTask(self, new ClearWhiteReferencesTask(this,
+                                                            shard_cleared_references.back().get(),
+                                                            collector,
+                                                            refs.data() + begin,
+                                                            refs.data() + end));
+  }
+  thread_pool->Wait(self, /* do_work */ true, /* may_hold_locks */ true);
+  thread_pool->StopWorkers(self);
+  for (const std::unique_ptr<ReferenceQueue>& shard_queue : shard_cleared_references) {
+    cleared_references->EnqueueAll(shard_queue.get());
   }
 }
 
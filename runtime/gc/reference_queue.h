@@ -44,6 +44,7 @@ namespace collector {
 class GarbageCollector;
 }  // namespace collector
 
+class ClearWhiteReferencesTask;
 class Heap;
 
 // Used to temporarily store java.lang.ref.Reference(s) during GC and prior to queueing on the
@@ -64,6 +65,9 @@ class ReferenceQueue {
   // Not thread safe, used when mutators are paused to minimize lock overhead.
   void EnqueueReference(ObjPtr<mirror::Reference> ref) REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Move all the references of `other` to this queue, leaving `other` empty. Not thread safe.
+  void EnqueueAll(ReferenceQueue* other) REQUIRES_SHARED(Locks::mutator_lock_);
+
   // Dequeue a reference from the queue and return that dequeued reference.
   // Call DisableReadBarrierForReference for the reference that's returned from this function.
   ObjPtr<mirror::Reference> DequeuePendingReference() REQUIRES_SHARED(Locks::mutator_lock_);
@@ -92,6 +96,15 @@ class ReferenceQueue {
                             collector::GarbageCollector* collector)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Same as ClearWhiteReferences, but the references are split into shards which are processed
+  // by up to `thread_count` threads: the workers of `thread_pool` and the calling thread. Must not
+  // be used in transaction mode.
+  void ClearWhiteReferencesParallel(ReferenceQueue* cleared_references,
+                                    collector::GarbageCollector* collector,
+                                    ThreadPool* thread_pool,
+                                    size_t thread_count)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   void Dump(std::ostream& os) const REQUIRES_SHARED(Locks::mutator_lock_);
   size_t GetLength() const REQUIRES_SHARED(Locks::mutator_lock_);
 
@@ -110,6 +123,12 @@ class ReferenceQueue {
       REQUIRES_SHARED(Locks::mutator_lock_);
 
  private:
+  // Clear the referent of a dequeued reference if it is white and add it to `cleared_references`.
+  void ClearWhiteReference(ObjPtr<mirror::Reference> ref,
+                           ReferenceQueue* cleared_references,
+                           collector::GarbageCollector* collector)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   // Lock, used for parallel GC reference enqueuing. It allows for multiple threads simultaneously
   // calling AtomicEnqueueIfNotEnqueued.
   Mutex* const lock_;
@@ -117,6 +136,8 @@ class ReferenceQueue {
   // GC types. Not an ObjPtr since it is accessed from multiple threads.
   mirror::Reference* list_;
 
+  friend class ClearWhiteReferencesTask;
+
   DISALLOW_IMPLICIT_CONSTRUCTORS(ReferenceQueue);
 };
 
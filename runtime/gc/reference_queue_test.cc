@@ -16,17 +16,81 @@
 
 #include <sstream>
 
+#include "collector/garbage_collector.h"
 #include "common_runtime_test.h"
 #include "handle_scope-inl.h"
 #include "mirror/class-inl.h"
+#include "mirror/object_array-inl.h"
 #include "reference_queue.h"
+#include "scoped_gc_critical_section.h"
 #include "scoped_thread_state_change-inl.h"
+#include "thread_pool.h"
 
 namespace art {
 namespace gc {
 
 class ReferenceQueueTest : public CommonRuntimeTest {};
 
+// Collector that only considers the objects of a given set to be marked.
+class MarkedSetCollector : public collector::GarbageCollector {
+ public:
+  explicit MarkedSetCollector(const std::set<mirror::Object*>& marked)
+      : GarbageCollector(Runtime::Current()->GetHeap(), "marked set collector"),
+        marked_(marked) {}
+
+  collector::GcType GetGcType() const OVERRIDE {
+    return collector::kGcTypeNone;
+  }
+  CollectorType GetCollectorType() const OVERRIDE {
+    return kCollectorTypeNone;
+  }
+  mirror::Object* IsMarked(mirror::Object* obj) OVERRIDE {
+    return (marked_.find(obj) != marked_.end()) ? obj : nullptr;
+  }
+  bool IsNullOrMarkedHeapReference(mirror::HeapReference<mirror::Object>* obj,
+                                   bool do_atomic_update ATTRIBUTE_UNUSED) OVERRIDE
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    mirror::Object* ref = obj->AsMirrorPtr();
+    return ref == nullptr || IsMarked(ref) != nullptr;
+  }
+  void ProcessMarkStack() OVERRIDE {
+    UNIMPLEMENTED(FATAL);
+  }
+  mirror::Object* MarkObject(mirror::Object* obj ATTRIBUTE_UNUSED) OVERRIDE {
+    UNIMPLEMENTED(FATAL);
+    UNREACHABLE();
+  }
+  void MarkHeapReference(mirror::HeapReference<mirror::Object>* obj ATTRIBUTE_UNUSED,
+                         bool do_atomic_update ATTRIBUTE_UNUSED) OVERRIDE {
+    UNIMPLEMENTED(FATAL);
+  }
+  void DelayReferenceReferent(ObjPtr<mirror::Class> klass ATTRIBUTE_UNUSED,
+                              ObjPtr<mirror::Reference> reference ATTRIBUTE_UNUSED) OVERRIDE {
+    UNIMPLEMENTED(FATAL);
+  }
+  void VisitRoots(mirror::Object*** roots ATTRIBUTE_UNUSED,
+                  size_t count ATTRIBUTE_UNUSED,
+                  const RootInfo& info ATTRIBUTE_UNUSED) OVERRIDE {
+    UNIMPLEMENTED(FATAL);
+  }
+  void VisitRoots(mirror::CompressedReference<mirror::Object>** roots ATTRIBUTE_UNUSED,
+                  size_t count ATTRIBUTE_UNUSED,
+                  const RootInfo& info ATTRIBUTE_UNUSED) OVERRIDE {
+    UNIMPLEMENTED(FATAL);
+  }
+
+ protected:
+  void RunPhases() OVERRIDE {
+    UNIMPLEMENTED(FATAL);
+  }
+  void RevokeAllThreadLocalBuffers() OVERRIDE {
+    UNIMPLEMENTED(FATAL);
+  }
+
+ private:
+  const std::set<mirror::Object*>& marked_;
+};
+
 TEST_F(ReferenceQueueTest, EnqueueDequeue) {
   Thread* self = Thread::Current();
   ScopedObjectAccess soa(self);
@@ -61,6 +125,124 @@ TEST_F(ReferenceQueueTest, EnqueueDequeue) {
   ASSERT_EQ(refs, dequeued);
 }
 
+TEST_F(ReferenceQueueTest, EnqueueAll) {
+  Thread* self = Thread::Current();
+  ScopedObjectAccess soa(self);
+  StackHandleScope<20> hs(self);
+  Mutex lock("Reference queue lock");
+  ReferenceQueue queue(&lock);
+  ReferenceQueue other(&lock);
+  auto ref_class = hs.NewHandle(
+      Runtime::Current()->GetClassLinker()->FindClass(self, "Ljava/lang/ref/WeakReference;",
+                                                      ScopedNullHandle<mirror::ClassLoader>()));
+  ASSERT_TRUE(ref_class != nullptr);
+  auto ref1(hs.NewHandle(ref_class->AllocObject(self)->AsReference()));
+  ASSERT_TRUE(ref1 != nullptr);
+  auto ref2(hs.NewHandle(ref_class->AllocObject(self)->AsReference()));
+  ASSERT_TRUE(ref2 != nullptr);
+  auto ref3(hs.NewHandle(ref_class->AllocObject(self)->AsReference()));
+  ASSERT_TRUE(ref3 != nullptr);
+
+  // Moving an empty queue is a no-op, moving into an empty queue takes over the list.
+  queue.EnqueueAll(&other);
+  ASSERT_TRUE(queue.IsEmpty());
+  other.EnqueueReference(ref1.Get());
+  queue.EnqueueAll(&other);
+  ASSERT_TRUE(other.IsEmpty());
+  ASSERT_EQ(queue.GetLength(), 1U);
+
+  other.EnqueueReference(ref2.Get());
+  other.EnqueueReference(ref3.Get());
+  queue.EnqueueAll(&other);
+  ASSERT_TRUE(other.IsEmpty());
+  ASSERT_EQ(queue.GetLength(), 3U);
+
+  std::set<mirror::Reference*> refs = {ref1.Get(), ref2.Get(), ref3.Get()};
+  std::set<mirror::Reference*> dequeued;
+  while (!queue.IsEmpty()) {
+    dequeued.insert(queue.DequeuePendingReference().Ptr());
+  }
+  ASSERT_EQ(refs, dequeued);
+}
+
+TEST_F(ReferenceQueueTest, ClearWhiteReferencesParallel) {
+  // Enough references for each of the four threads to get a shard.
+  static constexpr size_t kNumThreads = 4;
+  static constexpr int32_t kNumReferences = kNumThreads * 1024;
+  Thread* self = Thread::Current();
+  ThreadPool thread_pool("Reference queue test thread pool", kNumThreads - 1);
+  ScopedObjectAccess soa(self);
+  StackHandleScope<4> hs(self);
+  auto ref_class = hs.NewHandle(
+      Runtime::Current()->GetClassLinker()->FindClass(self, "Ljava/lang/ref/WeakReference;",
+                                                      ScopedNullHandle<mirror::ClassLoader>()));
+  ASSERT_TRUE(ref_class != nullptr);
+  auto object_class = hs.NewHandle(
+      Runtime::Current()->GetClassLinker()->FindClass(self, "Ljava/lang/Object;",
+                                                      ScopedNullHandle<mirror::ClassLoader>()));
+  ASSERT_TRUE(object_class != nullptr);
+  auto array_class = hs.NewHandle(
+      Runtime::Current()->GetClassLinker()->FindClass(self, "[Ljava/lang/Object;",
+                                                      ScopedNullHandle<mirror::ClassLoader>()));
+  ASSERT_TRUE(array_class != nullptr);
+  auto refs(hs.NewHandle(
+      mirror::ObjectArray<mirror::Object>::Alloc(self, array_class.Get(), kNumReferences)));
+  ASSERT_TRUE(refs != nullptr);
+  for (int32_t i = 0; i < kNumReferences; ++i) {
+    ObjPtr<mirror::Object> ref = ref_class->AllocObject(self);
+    ASSERT_TRUE(ref != nullptr);
+    refs->Set(i, ref);
+    // Every third reference has no referent, which counts as marked.
+    if (i % 3 != 0) {
+      ObjPtr<mirror::Object> referent = object_class->AllocObject(self);
+      ASSERT_TRUE(referent != nullptr);
+      refs->Get(i)->AsReference()->SetReferent<false>(referent);
+    }
+  }
+
+  // Keep the GC from moving or clearing the referents while the test collector looks at them.
+  ScopedThreadSuspension sts(self, kSuspended);
+  ScopedGCCriticalSection gcs(self, kGcCauseInstrumentation, kCollectorTypeInstrumentation);
+  ScopedObjectAccess soa2(self);
+
+  // Mark the referents of every other reference.
+  Mutex lock("Reference queue lock");
+  ReferenceQueue queue(&lock);
+  ReferenceQueue cleared_references(&lock);
+  std::set<mirror::Object*> marked;
+  std::set<mirror::Reference*> white;
+  for (int32_t i = 0; i < kNumReferences; ++i) {
+    mirror::Reference* ref = refs->Get(i)->AsReference();
+    mirror::Object* referent = ref->GetReferent();
+    if (referent != nullptr) {
+      if (i % 2 == 0) {
+        marked.insert(referent);
+      } else {
+        white.insert(ref);
+      }
+    }
+    queue.EnqueueReference(ref);
+  }
+  MarkedSetCollector collector(marked);
+  queue.ClearWhiteReferencesParallel(&cleared_references, &collector, &thread_pool, kNumThreads);
+  ASSERT_TRUE(queue.IsEmpty());
+
+  // Exactly the references with white referents are cleared and enqueued.
+  std::set<mirror::Reference*> cleared;
+  while (!cleared_references.IsEmpty()) {
+    cleared.insert(cleared_references.DequeuePendingReference().Ptr());
+  }
+  EXPECT_EQ(white, cleared);
+  for (int32_t i = 0; i < kNumReferences; ++i) {
+    mirror::Reference* ref = refs->Get(i)->AsReference();
+    if (white.find(ref) != white.end()) {
+      EXPECT_TRUE(ref->GetReferent() == nullptr) << i;
+    } else if (i % 3 != 0) {
+      EXPECT_TRUE(marked.find(ref->GetReferent()) != marked.end()) << i;
+    }
+  }
+}
+
 TEST_F(ReferenceQueueTest, Dump) {
   Thread* self = Thread::Current();
   ScopedObjectAccess soa(self);
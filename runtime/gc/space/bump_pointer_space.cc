@@ -26,16 +26,22 @@ namespace space {
 
 BumpPointerSpace* BumpPointerSpace::Create(const std::string& name, size_t capacity,
                                            uint8_t* requested_begin) {
-  capacity = RoundUp(capacity, kPageSize);
+  const size_t alignment = MemMap::GetHugePageAlignment();
+  capacity = RoundUp(capacity, alignment);
+  if (MemMap::UseHugePages()) {
+    requested_begin = AlignUp(requested_begin, alignment);
+  }
   std::string error_msg;
-  std::unique_ptr<MemMap> mem_map(MemMap::MapAnonymous(name.c_str(), requested_begin, capacity,
-                                                       PROT_READ | PROT_WRITE, true, false,
-                                                       &error_msg));
+  std::unique_ptr<MemMap> mem_map(MemMap::MapAnonymousAligned(name.c_str(), requested_begin,
+                                                              capacity, alignment,
+                                                              PROT_READ | PROT_WRITE, true,
+                                                              &error_msg));
   if (mem_map.get() == nullptr) {
     LOG(ERROR) << "Failed to allocate pages for alloc space (" << name << ") of size "
         << PrettySize(capacity) << " with message " << error_msg;
     return nullptr;
   }
+  mem_map->MadviseHugePages();
   return new BumpPointerSpace(name, mem_map.release());
 }
 
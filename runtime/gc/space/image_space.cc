@@ -31,6 +31,7 @@
 #include "base/callee_save_type.h"
 #include "base/enums.h"
 #include "base/file_utils.h"
+#include "base/length_prefixed_array.h"
 #include "base/macros.h"
 #include "base/os.h"
 #include "base/scoped_flock.h"
@@ -49,7 +50,9 @@
 #include "mirror/object-refvisitor-inl.h"
 #include "oat_file.h"
 #include "runtime.h"
+#include "scoped_thread_state_change-inl.h"
 #include "space-inl.h"
+#include "thread_pool.h"
 
 namespace art {
 namespace gc {
@@ -58,6 +61,17 @@ namespace space {
 using android::base::StringAppendF;
 using android::base::StringPrintf;
 
+// Compressed images at least this large are decompressed on several threads when possible.
+static constexpr size_t kMinParallelDecompressionSize = 1 * MB;
+// Maximum number of threads decompressing an image, including the loading thread.
+static constexpr size_t kMaxDecompressionThreads = 4;
+// App images at least this large are relocated on several threads when possible.
+static constexpr size_t kMinParallelRelocationSize = 1 * MB;
+// Maximum number of threads relocating an image, including the loading thread.
+static constexpr size_t kMaxRelocationThreads = 4;
+// Number of slices of the ArtMethod and ArtField sections per relocating thread, for balancing.
+static constexpr size_t kRelocationSlicesPerThread = 4;
+
 Atomic<uint32_t> ImageSpace::bitmap_index_(0);
 
 ImageSpace::ImageSpace(const std::string& image_filename,
@@ -802,7 +816,8 @@ class ImageSpaceLoader {
                                uint8_t* address,
                                int fd,
                                TimingLogger& logger,
-                               std::string* error_msg) {
+                               std::string* error_msg)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
     TimingLogger::ScopedTiming timing("MapImageFile", &logger);
     const ImageHeader::StorageMode storage_mode = image_header.GetStorageMode();
     if (storage_mode == ImageHeader::kStorageModeUncompressed) {
@@ -837,7 +852,6 @@ class ImageSpaceLoader {
                                                      error_msg));
     if (map != nullptr) {
       const size_t stored_size = image_header.GetDataSize();
-      const size_t decompress_offset = sizeof(ImageHeader);  // Skip the header.
       std::unique_ptr<MemMap> temp_map(MemMap::MapFile(sizeof(ImageHeader) + stored_size,
                                                        PROT_READ,
                                                        MAP_PRIVATE,
@@ -854,28 +868,137 @@ class ImageSpaceLoader {
       const uint64_t start = NanoTime();
       // LZ4HC and LZ4 have same internal format, both use LZ4_decompress.
       TimingLogger::ScopedTiming timing2("LZ4 decompress image", &logger);
-      const size_t decompressed_size = LZ4_decompress_safe(
-          reinterpret_cast<char*>(temp_map->Begin()) + sizeof(ImageHeader),
-          reinterpret_cast<char*>(map->Begin()) + decompress_offset,
-          stored_size,
-          map->Size() - decompress_offset);
+      if (!DecompressBlocks(image_header, temp_map->Begin(), map->Begin(), error_msg)) {
+        return nullptr;
+      }
       const uint64_t time = NanoTime() - start;
       // Add one 1 ns to prevent possible divide by 0.
       VLOG(image) << "Decompressing image took " << PrettyDuration(time) << " ("
                   << PrettySize(static_cast<uint64_t>(map->Size()) * MsToNs(1000) / (time + 1))
                   << "/s)";
-      if (decompressed_size + sizeof(ImageHeader) != image_header.GetImageSize()) {
+    }
+
+    return map.release();
+  }
+
+  static bool DecompressBlock(const ImageHeader::Block& block,
+                              const uint8_t* image_file_begin,
+                              uint8_t* image_begin) {
+    const int decompressed_size = LZ4_decompress_safe(
+        reinterpret_cast<const char*>(image_file_begin) + block.GetDataOffset(),
+        reinterpret_cast<char*>(image_begin) + block.GetImageOffset(),
+        block.GetDataSize(),
+        block.GetImageSize());
+    return decompressed_size >= 0 && static_cast<size_t>(decompressed_size) == block.GetImageSize();
+  }
+
+  class DecompressBlockTask FINAL : public Task {
+   public:
+    DecompressBlockTask(const ImageHeader::Block* block,
+                        const uint8_t* image_file_begin,
+                        uint8_t* image_begin,
+                        Atomic<bool>* failed)
+        : block_(block),
+          image_file_begin_(image_file_begin),
+          image_begin_(image_begin),
+          failed_(failed) {}
+
+    void Run(Thread* self ATTRIBUTE_UNUSED) OVERRIDE {
+      if (!DecompressBlock(*block_, image_file_begin_, image_begin_)) {
+        failed_->StoreRelaxed(true);
+      }
+    }
+
+    void Finalize() OVERRIDE {
+      delete this;
+    }
+
+   private:
+    const ImageHeader::Block* const block_;
+    const uint8_t* const image_file_begin_;
+    uint8_t* const image_begin_;
+    Atomic<bool>* const failed_;
+
+    DISALLOW_COPY_AND_ASSIGN(DecompressBlockTask);
+  };
+
+  // Decompress the blocks of the mapped image file into the image. Large images are decompressed
+  // on a thread pool once the runtime has started, as is the case for app images.
+  static bool DecompressBlocks(const ImageHeader& image_header,
+                               const uint8_t* image_file_begin,
+                               uint8_t* image_begin,
+                               std::string* error_msg) REQUIRES_SHARED(Locks::mutator_lock_) {
+    // Check that the block table and the blocks are in the stored data, and that the blocks
+    // cover the image after the header.
+    const size_t stored_end = sizeof(ImageHeader) + image_header.GetDataSize();
+    const size_t blocks_offset = image_header.GetBlocksOffset();
+    const size_t blocks_count = image_header.GetBlocksCount();
+    if (blocks_offset < sizeof(ImageHeader) ||
+        !IsAligned<alignof(ImageHeader::Block)>(blocks_offset) ||
+        blocks_offset > stored_end ||
+        blocks_count > (stored_end - blocks_offset) / sizeof(ImageHeader::Block)) {
+      if (error_msg != nullptr) {
+        *error_msg = StringPrintf("Invalid block table at %zu with %zu blocks",
+                                  blocks_offset,
+                                  blocks_count);
+      }
+      return false;
+    }
+    const ImageHeader::Block* blocks = image_header.GetBlocks(image_file_begin);
+    size_t image_offset = sizeof(ImageHeader);
+    for (size_t i = 0; i != blocks_count; ++i) {
+      const ImageHeader::Block& block = blocks[i];
+      if (block.GetImageOffset() != image_offset ||
+          block.GetImageSize() > image_header.GetImageSize() - image_offset ||
+          block.GetDataOffset() < sizeof(ImageHeader) ||
+          block.GetDataOffset() > blocks_offset ||
+          block.GetDataSize() > blocks_offset - block.GetDataOffset()) {
         if (error_msg != nullptr) {
-          *error_msg = StringPrintf(
-              "Decompressed size does not match expected image size %zu vs %zu",
-              decompressed_size + sizeof(ImageHeader),
-              image_header.GetImageSize());
+          *error_msg = StringPrintf("Invalid image block %zu", i);
         }
-        return nullptr;
+        return false;
       }
+      image_offset += block.GetImageSize();
+    }
+    if (image_offset != image_header.GetImageSize()) {
+      if (error_msg != nullptr) {
+        *error_msg = StringPrintf("Image blocks end at %zu, expected image size %zu",
+                                  image_offset,
+                                  image_header.GetImageSize());
+      }
+      return false;
     }
 
-    return map.release();
+    Thread* const self = Thread::Current();
+    Runtime* const runtime = Runtime::Current();
+    bool success = true;
+    if (blocks_count > 1u &&
+        image_header.GetImageSize() >= kMinParallelDecompressionSize &&
+        self != nullptr &&
+        runtime->IsStarted()) {
+      // The pool threads attach to and detach from the runtime, which waits for suspend-all
+      // requests to finish, so we must not hold the mutator lock while waiting for them.
+      ScopedThreadSuspension sts(self, kNative);
+      Atomic<bool> failed(false);
+      const size_t num_threads = std::min(kMaxDecompressionThreads, blocks_count) - 1u;
+      ThreadPool thread_pool("Image decompression thread pool", num_threads);
+      for (size_t i = 0; i != blocks_count; ++i) {
+        thread_pool.AddTask(
+            self, new DecompressBlockTask(&blocks[i], image_file_begin, image_begin, &failed));
+      }
+      thread_pool.StartWorkers(self);
+      // The calling thread decompresses blocks too.
+      thread_pool.Wait(self, /* do_work */ true, /* may_hold_locks */ false);
+      success = !failed.LoadRelaxed();
+    } else {
+      for (size_t i = 0; success && i != blocks_count; ++i) {
+        success = DecompressBlock(blocks[i], image_file_begin, image_begin);
+      }
+    }
+    if (!success && error_msg != nullptr) {
+      *error_msg = "Failed to decompress image";
+    }
+    return success;
   }
 
   class FixupVisitor : public ValueObject {
@@ -1182,6 +1305,229 @@ class ImageSpaceLoader {
     }
   };
 
+  // Fix up the native arrays of a dex cache of an image being relocated.
+  static void FixupDexCache(mirror::DexCache* dex_cache,
+                            const FixupObjectAdapter& fixup_adapter,
+                            PointerSize pointer_size) REQUIRES_SHARED(Locks::mutator_lock_) {
+    mirror::StringDexCacheType* strings = dex_cache->GetStrings();
+    if (strings != nullptr) {
+      mirror::StringDexCacheType* new_strings = fixup_adapter.ForwardObject(strings);
+      if (strings != new_strings) {
+        dex_cache->SetStrings(new_strings);
+      }
+      dex_cache->FixupStrings<kWithoutReadBarrier>(new_strings, fixup_adapter);
+    }
+    mirror::TypeDexCacheType* types = dex_cache->GetResolvedTypes();
+    if (types != nullptr) {
+      mirror::TypeDexCacheType* new_types = fixup_adapter.ForwardObject(types);
+      if (types != new_types) {
+        dex_cache->SetResolvedTypes(new_types);
+      }
+      dex_cache->FixupResolvedTypes<kWithoutReadBarrier>(new_types, fixup_adapter);
+    }
+    mirror::MethodDexCacheType* methods = dex_cache->GetResolvedMethods();
+    if (methods != nullptr) {
+      mirror::MethodDexCacheType* new_methods = fixup_adapter.ForwardObject(methods);
+      if (methods != new_methods) {
+        dex_cache->SetResolvedMethods(new_methods);
+      }
+      for (size_t j = 0, num = dex_cache->NumResolvedMethods(); j != num; ++j) {
+        auto pair = mirror::DexCache::GetNativePairPtrSize(new_methods, j, pointer_size);
+        ArtMethod* orig = pair.object;
+        ArtMethod* copy = fixup_adapter.ForwardObject(orig);
+        if (orig != copy) {
+          pair.object = copy;
+          mirror::DexCache::SetNativePairPtrSize(new_methods, j, pair, pointer_size);
+        }
+      }
+    }
+    mirror::FieldDexCacheType* fields = dex_cache->GetResolvedFields();
+    if (fields != nullptr) {
+      mirror::FieldDexCacheType* new_fields = fixup_adapter.ForwardObject(fields);
+      if (fields != new_fields) {
+        dex_cache->SetResolvedFields(new_fields);
+      }
+      for (size_t j = 0, num = dex_cache->NumResolvedFields(); j != num; ++j) {
+        mirror::FieldDexCachePair orig =
+            mirror::DexCache::GetNativePairPtrSize(new_fields, j, pointer_size);
+        mirror::FieldDexCachePair copy(fixup_adapter.ForwardObject(orig.object), orig.index);
+        if (orig.object != copy.object) {
+          mirror::DexCache::SetNativePairPtrSize(new_fields, j, copy, pointer_size);
+        }
+      }
+    }
+
+    mirror::MethodTypeDexCacheType* method_types = dex_cache->GetResolvedMethodTypes();
+    if (method_types != nullptr) {
+      mirror::MethodTypeDexCacheType* new_method_types =
+          fixup_adapter.ForwardObject(method_types);
+      if (method_types != new_method_types) {
+        dex_cache->SetResolvedMethodTypes(new_method_types);
+      }
+      dex_cache->FixupResolvedMethodTypes<kWithoutReadBarrier>(new_method_types, fixup_adapter);
+    }
+    GcRoot<mirror::CallSite>* call_sites = dex_cache->GetResolvedCallSites();
+    if (call_sites != nullptr) {
+      GcRoot<mirror::CallSite>* new_call_sites = fixup_adapter.ForwardObject(call_sites);
+      if (call_sites != new_call_sites) {
+        dex_cache->SetResolvedCallSites(new_call_sites);
+      }
+      dex_cache->FixupResolvedCallSites<kWithoutReadBarrier>(new_call_sites, fixup_adapter);
+    }
+  }
+
+  class FixupDexCacheTask FINAL : public Task {
+   public:
+    FixupDexCacheTask(mirror::DexCache* dex_cache,
+                      const FixupObjectAdapter* fixup_adapter,
+                      PointerSize pointer_size)
+        : dex_cache_(dex_cache),
+          fixup_adapter_(fixup_adapter),
+          pointer_size_(pointer_size) {}
+
+    void Run(Thread* self) OVERRIDE {
+      // The image is not yet added to the heap, so the GC does not move the dex cache.
+      ScopedObjectAccess soa(self);
+      FixupDexCache(dex_cache_, *fixup_adapter_, pointer_size_);
+    }
+
+    void Finalize() OVERRIDE {
+      delete this;
+    }
+
+   private:
+    mirror::DexCache* const dex_cache_;
+    const FixupObjectAdapter* const fixup_adapter_;
+    const PointerSize pointer_size_;
+
+    DISALLOW_COPY_AND_ASSIGN(FixupDexCacheTask);
+  };
+
+  template <typename T, typename Visitor>
+  static void VisitArrays(LengthPrefixedArray<T>* const* arrays,
+                          size_t num_arrays,
+                          size_t element_size,
+                          size_t alignment,
+                          Visitor* visitor) {
+    for (size_t i = 0; i != num_arrays; ++i) {
+      LengthPrefixedArray<T>* const array = arrays[i];
+      for (size_t j = 0, size = array->size(); j != size; ++j) {
+        visitor->Visit(&array->At(j, element_size, alignment));
+      }
+    }
+  }
+
+  // Visits a slice of the ArtMethod or ArtField arrays of an image being relocated.
+  template <typename T, typename Visitor>
+  class VisitArraysTask FINAL : public Task {
+   public:
+    VisitArraysTask(LengthPrefixedArray<T>* const* arrays,
+                    size_t num_arrays,
+                    size_t element_size,
+                    size_t alignment,
+                    Visitor* visitor)
+        : arrays_(arrays),
+          num_arrays_(num_arrays),
+          element_size_(element_size),
+          alignment_(alignment),
+          visitor_(visitor) {}
+
+    void Run(Thread* self ATTRIBUTE_UNUSED) OVERRIDE {
+      VisitArrays(arrays_, num_arrays_, element_size_, alignment_, visitor_);
+    }
+
+    void Finalize() OVERRIDE {
+      delete this;
+    }
+
+   private:
+    LengthPrefixedArray<T>* const* const arrays_;
+    const size_t num_arrays_;
+    const size_t element_size_;
+    const size_t alignment_;
+    Visitor* const visitor_;
+
+    DISALLOW_COPY_AND_ASSIGN(VisitArraysTask);
+  };
+
+  // Visit the elements of the length prefixed arrays packed in an ArtMethod or ArtField section.
+  // With a thread pool, the arrays are split into slices with similar numbers of elements that
+  // the pool threads and the calling thread visit in parallel.
+  template <typename T, typename Visitor>
+  static void VisitPackedArrays(const ImageSection& section,
+                                uint8_t* base,
+                                size_t element_size,
+                                size_t alignment,
+                                Visitor* visitor,
+                                ThreadPool* thread_pool) {
+    std::vector<LengthPrefixedArray<T>*> arrays;
+    size_t num_elements = 0u;
+    for (size_t pos = 0; pos < section.Size(); ) {
+      auto* array = reinterpret_cast<LengthPrefixedArray<T>*>(base + section.Offset() + pos);
+      arrays.push_back(array);
+      num_elements += array->size();
+      pos += array->ComputeSize(array->size(), element_size, alignment);
+    }
+    if (thread_pool == nullptr) {
+      VisitArrays(arrays.data(), arrays.size(), element_size, alignment, visitor);
+      return;
+    }
+    Thread* const self = Thread::Current();
+    const size_t num_slices = (thread_pool->GetThreadCount() + 1u) * kRelocationSlicesPerThread;
+    const size_t slice_elements = std::max<size_t>(RoundUp(num_elements, num_slices) / num_slices,
+                                                   1u);
+    size_t slice_begin = 0u;
+    size_t elements = 0u;
+    for (size_t i = 0; i != arrays.size(); ++i) {
+      elements += arrays[i]->size();
+      if (elements >= slice_elements || i + 1u == arrays.size()) {
+        thread_pool->AddTask(self, new VisitArraysTask<T, Visitor>(arrays.data() + slice_begin,
+                                                                   i + 1u - slice_begin,
+                                                                   element_size,
+                                                                   alignment,
+                                                                   visitor));
+        slice_begin = i + 1u;
+        elements = 0u;
+      }
+    }
+    // The calling thread visits slices too.
+    thread_pool->Wait(self, /* do_work */ true, /* may_hold_locks */ false);
+  }
+
+  // Thread pool for relocating an image, if requested. The pool threads attach to and detach from
+  // the runtime, which waits for suspend-all requests to finish, so the calling thread must not
+  // hold the mutator lock while the pool exists. It is moved to kNative for the lifetime of the
+  // pool and stays runnable when there is no pool.
+  class ScopedRelocationThreadPool {
+   public:
+    ScopedRelocationThreadPool(Thread* self, bool create_pool) NO_THREAD_SAFETY_ANALYSIS
+        : self_(self) {
+      if (create_pool) {
+        self_->TransitionFromRunnableToSuspended(kNative);
+        thread_pool_.reset(
+            new ThreadPool("Image relocation thread pool", kMaxRelocationThreads - 1u));
+        thread_pool_->StartWorkers(self_);
+      }
+    }
+
+    ~ScopedRelocationThreadPool() NO_THREAD_SAFETY_ANALYSIS {
+      if (thread_pool_ != nullptr) {
+        thread_pool_.reset();
+        self_->TransitionFromSuspendedToRunnable();
+      }
+    }
+
+    ThreadPool* Get() const {
+      return thread_pool_.get();
+    }
+
+   private:
+    Thread* const self_;
+    std::unique_ptr<ThreadPool> thread_pool_;
+
+    DISALLOW_COPY_AND_ASSIGN(ScopedRelocationThreadPool);
+  };
+
   // Relocate an image space mapped at target_base which possibly used to be at a different base
   // address. Only needs a single image space, not one for both source and destination.
   // In place means modifying a single ImageSpace in place rather than relocating from one ImageSpace
@@ -1190,7 +1536,7 @@ class ImageSpaceLoader {
                               uint8_t* target_base,
                               accounting::ContinuousSpaceBitmap* bitmap,
                               const OatFile* app_oat_file,
-                              std::string* error_msg) {
+                              std::string* error_msg) REQUIRES_SHARED(Locks::mutator_lock_) {
     DCHECK(error_msg != nullptr);
     if (!image_header.IsPic()) {
       if (image_header.GetImageBegin() == target_base) {
@@ -1260,7 +1606,13 @@ class ImageSpaceLoader {
       // Nothing to fix up.
       return true;
     }
-    ScopedDebugDisallowReadBarriers sddrb(Thread::Current());
+    Thread* const self = Thread::Current();
+    ScopedDebugDisallowReadBarriers sddrb(self);
+    ScopedRelocationThreadPool scoped_thread_pool(
+        self,
+        image_header.GetImageSize() >= kMinParallelRelocationSize &&
+            Runtime::Current()->IsStarted());
+    ThreadPool* const thread_pool = scoped_thread_pool.Get();
     // Need to update the image to be at the target base.
     const ImageSection& objects_section = image_header.GetObjectsSection();
     uintptr_t objects_begin = reinterpret_cast<uintptr_t>(target_base + objects_section.Offset());
@@ -1280,88 +1632,34 @@ class ImageSpaceLoader {
                                               app_image,
                                               app_oat);
       TimingLogger::ScopedTiming timing("Fixup classes", &logger);
-      // Fixup objects may read fields in the boot image, use the mutator lock here for sanity. Though
-      // its probably not required.
-      ScopedObjectAccess soa(Thread::Current());
-      timing.NewTiming("Fixup objects");
-      bitmap->VisitMarkedRange(objects_begin, objects_end, fixup_object_visitor);
-      // Fixup image roots.
-      CHECK(app_image.InSource(reinterpret_cast<uintptr_t>(
-          image_header.GetImageRoots<kWithoutReadBarrier>())));
-      image_header.RelocateImageObjects(app_image.Delta());
-      CHECK_EQ(image_header.GetImageBegin(), target_base);
-      // Fix up dex cache DexFile pointers.
-      auto* dex_caches = image_header.GetImageRoot<kWithoutReadBarrier>(ImageHeader::kDexCaches)->
-          AsObjectArray<mirror::DexCache, kVerifyNone, kWithoutReadBarrier>();
-      for (int32_t i = 0, count = dex_caches->GetLength(); i < count; ++i) {
-        mirror::DexCache* dex_cache = dex_caches->Get<kVerifyNone, kWithoutReadBarrier>(i);
-        // Fix up dex cache pointers.
-        mirror::StringDexCacheType* strings = dex_cache->GetStrings();
-        if (strings != nullptr) {
-          mirror::StringDexCacheType* new_strings = fixup_adapter.ForwardObject(strings);
-          if (strings != new_strings) {
-            dex_cache->SetStrings(new_strings);
-          }
-          dex_cache->FixupStrings<kWithoutReadBarrier>(new_strings, fixup_adapter);
-        }
-        mirror::TypeDexCacheType* types = dex_cache->GetResolvedTypes();
-        if (types != nullptr) {
-          mirror::TypeDexCacheType* new_types = fixup_adapter.ForwardObject(types);
-          if (types != new_types) {
-            dex_cache->SetResolvedTypes(new_types);
-          }
-          dex_cache->FixupResolvedTypes<kWithoutReadBarrier>(new_types, fixup_adapter);
-        }
-        mirror::MethodDexCacheType* methods = dex_cache->GetResolvedMethods();
-        if (methods != nullptr) {
-          mirror::MethodDexCacheType* new_methods = fixup_adapter.ForwardObject(methods);
-          if (methods != new_methods) {
-            dex_cache->SetResolvedMethods(new_methods);
-          }
-          for (size_t j = 0, num = dex_cache->NumResolvedMethods(); j != num; ++j) {
-            auto pair = mirror::DexCache::GetNativePairPtrSize(new_methods, j, pointer_size);
-            ArtMethod* orig = pair.object;
-            ArtMethod* copy = fixup_adapter.ForwardObject(orig);
-            if (orig != copy) {
-              pair.object = copy;
-              mirror::DexCache::SetNativePairPtrSize(new_methods, j, pair, pointer_size);
-            }
-          }
-        }
-        mirror::FieldDexCacheType* fields = dex_cache->GetResolvedFields();
-        if (fields != nullptr) {
-          mirror::FieldDexCacheType* new_fields = fixup_adapter.ForwardObject(fields);
-          if (fields != new_fields) {
-            dex_cache->SetResolvedFields(new_fields);
-          }
-          for (size_t j = 0, num = dex_cache->NumResolvedFields(); j != num; ++j) {
-            mirror::FieldDexCachePair orig =
-                mirror::DexCache::GetNativePairPtrSize(new_fields, j, pointer_size);
-            mirror::FieldDexCachePair copy(fixup_adapter.ForwardObject(orig.object), orig.index);
-            if (orig.object != copy.object) {
-              mirror::DexCache::SetNativePairPtrSize(new_fields, j, copy, pointer_size);
-            }
-          }
-        }
-
-        mirror::MethodTypeDexCacheType* method_types = dex_cache->GetResolvedMethodTypes();
-        if (method_types != nullptr) {
-          mirror::MethodTypeDexCacheType* new_method_types =
-              fixup_adapter.ForwardObject(method_types);
-          if (method_types != new_method_types) {
-            dex_cache->SetResolvedMethodTypes(new_method_types);
-          }
-          dex_cache->FixupResolvedMethodTypes<kWithoutReadBarrier>(new_method_types, fixup_adapter);
-        }
-        GcRoot<mirror::CallSite>* call_sites = dex_cache->GetResolvedCallSites();
-        if (call_sites != nullptr) {
-          GcRoot<mirror::CallSite>* new_call_sites = fixup_adapter.ForwardObject(call_sites);
-          if (call_sites != new_call_sites) {
-            dex_cache->SetResolvedCallSites(new_call_sites);
+      {
+        // Fixup objects may read fields in the boot image, use the mutator lock here for sanity.
+        // Though its probably not required.
+        ScopedObjectAccess soa(self);
+        timing.NewTiming("Fixup objects");
+        bitmap->VisitMarkedRange(objects_begin, objects_end, fixup_object_visitor);
+        // Fixup image roots.
+        CHECK(app_image.InSource(reinterpret_cast<uintptr_t>(
+            image_header.GetImageRoots<kWithoutReadBarrier>())));
+        image_header.RelocateImageObjects(app_image.Delta());
+        CHECK_EQ(image_header.GetImageBegin(), target_base);
+        // Fix up dex cache DexFile pointers.
+        timing.NewTiming("Fixup dex caches");
+        auto* dex_caches = image_header.GetImageRoot<kWithoutReadBarrier>(ImageHeader::kDexCaches)->
+            AsObjectArray<mirror::DexCache, kVerifyNone, kWithoutReadBarrier>();
+        for (int32_t i = 0, count = dex_caches->GetLength(); i < count; ++i) {
+          mirror::DexCache* dex_cache = dex_caches->Get<kVerifyNone, kWithoutReadBarrier>(i);
+          if (thread_pool != nullptr) {
+            thread_pool->AddTask(self,
+                                 new FixupDexCacheTask(dex_cache, &fixup_adapter, pointer_size));
+          } else {
+            FixupDexCache(dex_cache, fixup_adapter, pointer_size);
           }
-          dex_cache->FixupResolvedCallSites<kWithoutReadBarrier>(new_call_sites, fixup_adapter);
         }
       }
+      if (thread_pool != nullptr) {
+        thread_pool->Wait(self, /* do_work */ true, /* may_hold_locks */ false);
+      }
     }
     {
       // Only touches objects in the app image, no need for mutator lock.
@@ -1372,14 +1670,30 @@ class ImageSpaceLoader {
                                            boot_oat,
                                            app_image,
                                            app_oat);
-      image_header.VisitPackedArtMethods(&method_visitor, target_base, pointer_size);
+      VisitPackedArrays<ArtMethod>(image_header.GetMethodsSection(),
+                                   target_base,
+                                   ArtMethod::Size(pointer_size),
+                                   ArtMethod::Alignment(pointer_size),
+                                   &method_visitor,
+                                   thread_pool);
+      // There are only a few runtime methods, visit them on this thread.
+      const ImageSection& runtime_methods = image_header.GetRuntimeMethodsSection();
+      for (size_t pos = 0; pos < runtime_methods.Size(); pos += ArtMethod::Size(pointer_size)) {
+        method_visitor.Visit(
+            reinterpret_cast<ArtMethod*>(target_base + runtime_methods.Offset() + pos));
+      }
     }
     if (fixup_image) {
       {
         // Only touches objects in the app image, no need for mutator lock.
         TimingLogger::ScopedTiming timing("Fixup fields", &logger);
         FixupArtFieldVisitor field_visitor(boot_image, boot_oat, app_image, app_oat);
-        image_header.VisitPackedArtFields(&field_visitor, target_base);
+        VisitPackedArrays<ArtField>(image_header.GetFieldsSection(),
+                                    target_base,
+                                    sizeof(ArtField),
+                                    alignof(ArtField),
+                                    &field_visitor,
+                                    thread_pool);
       }
       {
         TimingLogger::ScopedTiming timing("Fixup imt", &logger);
@@ -1396,8 +1710,8 @@ class ImageSpaceLoader {
         // Note that we require that ReadFromMemory does not make an internal copy of the elements.
         // This also relies on visit roots not doing any verification which could fail after we update
         // the roots to be the image addresses.
-        ScopedObjectAccess soa(Thread::Current());
-        WriterMutexLock mu(Thread::Current(), *Locks::classlinker_classes_lock_);
+        ScopedObjectAccess soa(self);
+        WriterMutexLock mu(self, *Locks::classlinker_classes_lock_);
         ClassTable temp_table;
         temp_table.ReadFromMemory(target_base + class_table_section.Offset());
         FixupRootVisitor root_visitor(boot_image, boot_oat, app_image, app_oat);
@@ -27,6 +27,7 @@
 #include "base/mutex-inl.h"
 #include "base/os.h"
 #include "base/stl_util.h"
+#include "base/utils.h"
 #include "gc/accounting/heap_bitmap-inl.h"
 #include "gc/accounting/space_bitmap-inl.h"
 #include "gc/heap.h"
@@ -212,6 +213,12 @@ size_t LargeObjectMapSpace::AllocationSize(mirror::Object* obj, size_t* usable_s
   return alloc_size;
 }
 
+void LargeObjectSpace::DumpStats(std::ostream& os) {
+  os << GetName() << ": " << GetObjectsAllocated() << " objects using "
+     << PrettySize(GetBytesAllocated()) << ", " << GetTotalObjectsAllocated()
+     << " objects allocated in total\n";
+}
+
 size_t LargeObjectSpace::FreeList(Thread* self, size_t num_ptrs, mirror::Object** ptrs) {
   size_t total = 0;
   for (size_t i = 0; i < num_ptrs; ++i) {
@@ -358,7 +365,12 @@ FreeListSpace* FreeListSpace::Create(const std::string& name, uint8_t* requested
 FreeListSpace::FreeListSpace(const std::string& name, MemMap* mem_map, uint8_t* begin, uint8_t* end)
     : LargeObjectSpace(name, begin, end),
       mem_map_(mem_map),
-      lock_("free list space lock", kAllocSpaceLock) {
+      lock_("free list space lock", kAllocSpaceLock),
+      non_empty_free_bins_(0u),
+      bin_allocations_(0u),
+      best_fit_allocations_(0u),
+      end_allocations_(0u),
+      failed_allocations_(0u) {
   const size_t space_capacity = end - begin;
   free_end_ = space_capacity;
   CHECK_ALIGNED(space_capacity, kAlignment);
@@ -393,12 +405,64 @@ void FreeListSpace::Walk(DlMallocSpace::WalkCallback callback, void* arg) {
   CHECK_EQ(cur_info, end_info);
 }
 
+void FreeListSpace::AddFreePrev(AllocationInfo* info) {
+  const size_t free_pages = info->GetPrevFree();
+  DCHECK_GT(free_pages, 0U);
+  if (free_pages <= kNumFreeBins) {
+    const size_t bin = free_pages - 1u;
+    free_bins_[bin].insert(info);
+    non_empty_free_bins_ |= UINT64_C(1) << bin;
+  } else {
+    free_blocks_.insert(info);
+  }
+}
+
 void FreeListSpace::RemoveFreePrev(AllocationInfo* info) {
   CHECK_GT(info->GetPrevFree(), 0U);
-  auto it = free_blocks_.lower_bound(info);
-  CHECK(it != free_blocks_.end());
+  const size_t free_pages = info->GetPrevFree();
+  FreeBlocks* blocks =
+      (free_pages <= kNumFreeBins) ? &free_bins_[free_pages - 1u] : &free_blocks_;
+  auto it = blocks->lower_bound(info);
+  CHECK(it != blocks->end());
   CHECK_EQ(*it, info);
+  blocks->erase(it);
+  if (free_pages <= kNumFreeBins && blocks->empty()) {
+    non_empty_free_bins_ &= ~(UINT64_C(1) << (free_pages - 1u));
+  }
+}
+
+AllocationInfo* FreeListSpace::TakeFreeBlock(size_t num_pages) {
+  if (num_pages <= kNumFreeBins) {
+    // The lowest non-empty bin that fits is the best fit, no need to search the block sets.
+    const size_t min_bin = (num_pages != 0u) ? num_pages - 1u : 0u;
+    const uint64_t candidates = non_empty_free_bins_ & (~UINT64_C(0) << min_bin);
+    if (candidates != 0u) {
+      const size_t bin = CTZ(candidates);
+      FreeBlocks& blocks = free_bins_[bin];
+      DCHECK(!blocks.empty());
+      // Use the lowest address to keep the space compact.
+      auto it = blocks.begin();
+      AllocationInfo* info = *it;
+      blocks.erase(it);
+      if (blocks.empty()) {
+        non_empty_free_bins_ &= ~(UINT64_C(1) << bin);
+      }
+      ++bin_allocations_;
+      return info;
+    }
+  }
+  AllocationInfo temp_info;
+  temp_info.SetPrevFreeBytes(num_pages * kAlignment);
+  temp_info.SetByteSize(0, false);
+  // Find the smallest chunk at least num_pages in size.
+  auto it = free_blocks_.lower_bound(&temp_info);
+  if (it == free_blocks_.end()) {
+    return nullptr;
+  }
+  AllocationInfo* info = *it;
   free_blocks_.erase(it);
+  ++best_fit_allocations_;
+  return info;
 }
 
 size_t FreeListSpace::Free(Thread* self, mirror::Object* obj) {
@@ -445,7 +509,7 @@ size_t FreeListSpace::Free(Thread* self, mirror::Object* obj) {
       new_free_info = next_info;
     }
     new_free_info->SetPrevFreeBytes(new_free_size);
-    free_blocks_.insert(new_free_info);
+    AddFreePrev(new_free_info);
     info->SetByteSize(new_free_size, true);
     DCHECK_EQ(info->GetNextInfo(), new_free_info);
   }
@@ -475,15 +539,10 @@ mirror::Object* FreeListSpace::Alloc(Thread* self, size_t num_bytes, size_t* byt
                                      size_t* usable_size, size_t* bytes_tl_bulk_allocated) {
   MutexLock mu(self, lock_);
   const size_t allocation_size = RoundUp(num_bytes, kAlignment);
-  AllocationInfo temp_info;
-  temp_info.SetPrevFreeBytes(allocation_size);
-  temp_info.SetByteSize(0, false);
   AllocationInfo* new_info;
   // Find the smallest chunk at least num_bytes in size.
-  auto it = free_blocks_.lower_bound(&temp_info);
-  if (it != free_blocks_.end()) {
-    AllocationInfo* info = *it;
-    free_blocks_.erase(it);
+  AllocationInfo* info = TakeFreeBlock(allocation_size / kAlignment);
+  if (info != nullptr) {
     // Fit our object in the previous allocation info free space.
     new_info = info->GetPrevFreeInfo();
     // Remove the newly allocated block from the info and update the prev_free_.
@@ -493,7 +552,7 @@ mirror::Object* FreeListSpace::Alloc(Thread* self, size_t num_bytes, size_t* byt
       new_free->SetPrevFreeBytes(0);
       new_free->SetByteSize(info->GetPrevFreeBytes(), true);
       // If there is remaining space, insert back into the free set.
-      free_blocks_.insert(info);
+      AddFreePrev(info);
     }
   } else {
     // Try to steal some memory from the free space at the end of the space.
@@ -501,7 +560,9 @@ mirror::Object* FreeListSpace::Alloc(Thread* self, size_t num_bytes, size_t* byt
       // Fit our object at the start of the end free block.
       new_info = GetAllocationInfoForAddress(reinterpret_cast<uintptr_t>(End()) - free_end_);
       free_end_ -= allocation_size;
+      ++end_allocations_;
     } else {
+      ++failed_allocations_;
       return nullptr;
     }
   }
@@ -555,6 +616,58 @@ void FreeListSpace::Dump(std::ostream& os) const {
   }
 }
 
+void FreeListSpace::GetFreeBlockInfo(size_t* num_free_blocks,
+                                     size_t* free_bytes,
+                                     size_t* largest_free_bytes) const {
+  size_t count = 0u;
+  size_t bytes = 0u;
+  size_t largest = 0u;
+  for (size_t bin = 0; bin < kNumFreeBins; ++bin) {
+    const size_t bin_size = free_bins_[bin].size();
+    if (bin_size != 0u) {
+      const size_t block_bytes = (bin + 1u) * kAlignment;
+      count += bin_size;
+      bytes += bin_size * block_bytes;
+      largest = block_bytes;
+    }
+  }
+  for (const AllocationInfo* info : free_blocks_) {
+    ++count;
+    bytes += info->GetPrevFreeBytes();
+  }
+  if (!free_blocks_.empty()) {
+    // The set is sorted by free size first.
+    largest = (*free_blocks_.rbegin())->GetPrevFreeBytes();
+  }
+  *num_free_blocks = count;
+  *free_bytes = bytes;
+  *largest_free_bytes = largest;
+}
+
+void FreeListSpace::DumpStats(std::ostream& os) {
+  LargeObjectSpace::DumpStats(os);
+  MutexLock mu(Thread::Current(), lock_);
+  size_t num_free_blocks;
+  size_t free_bytes;
+  size_t largest_free_bytes;
+  GetFreeBlockInfo(&num_free_blocks, &free_bytes, &largest_free_bytes);
+  // Fragmentation is the fraction of free memory which is not usable for the largest possible
+  // allocation.
+  const size_t total_free_bytes = free_bytes + free_end_;
+  const size_t largest_contiguous_bytes = std::max(largest_free_bytes, free_end_);
+  const double fragmentation = (total_free_bytes != 0u)
+      ? 1.0 - static_cast<double>(largest_contiguous_bytes) / total_free_bytes
+      : 0.0;
+  os << GetName() << ": " << num_free_blocks << " free blocks using " << PrettySize(free_bytes)
+     << ", largest free block " << PrettySize(largest_free_bytes)
+     << ", free at end " << PrettySize(free_end_)
+     << ", fragmentation " << static_cast<int>(fragmentation * 100.0) << "%\n";
+  os << GetName() << ": allocations from size bins " << bin_allocations_
+     << ", from best fit " << best_fit_allocations_
+     << ", from end " << end_allocations_
+     << ", failed " << failed_allocations_ << "\n";
+}
+
 bool FreeListSpace::IsZygoteLargeObject(Thread* self ATTRIBUTE_UNUSED, mirror::Object* obj) const {
   const AllocationInfo* info = GetAllocationInfoForAddress(reinterpret_cast<uintptr_t>(obj));
   DCHECK(info != nullptr);
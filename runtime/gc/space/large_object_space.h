@@ -18,6 +18,7 @@
 #define ART_RUNTIME_GC_SPACE_LARGE_OBJECT_SPACE_H_
 
 #include "base/allocator.h"
+#include "base/bit_utils.h"
 #include "base/safe_map.h"
 #include "base/tracking_safe_map.h"
 #include "dlmalloc_space.h"
@@ -109,6 +110,9 @@ class LargeObjectSpace : public DiscontinuousSpace, public AllocSpace {
   // End() from different allocations.
   virtual std::pair<uint8_t*, uint8_t*> GetBeginEndAtomic() const = 0;
 
+  // Dump allocation and fragmentation statistics, used for the GC performance info.
+  virtual void DumpStats(std::ostream& os);
+
  protected:
   explicit LargeObjectSpace(const std::string& name, uint8_t* begin, uint8_t* end);
   static void SweepCallback(size_t num_ptrs, mirror::Object** ptrs, void* arg);
@@ -163,10 +167,13 @@ class LargeObjectMapSpace : public LargeObjectSpace {
       GUARDED_BY(lock_);
 };
 
-// A continuous large object space with a free-list to handle holes.
+// A continuous large object space with a free-list to handle holes. Free blocks of up to
+// kNumFreeBins pages are kept in exact size bins, larger ones in a single best-fit set.
 class FreeListSpace FINAL : public LargeObjectSpace {
  public:
   static constexpr size_t kAlignment = kPageSize;
+  // Number of segregated free block bins, bin `i` holds free blocks of `i + 1` pages.
+  static constexpr size_t kNumFreeBins = 64;
 
   virtual ~FreeListSpace();
   static FreeListSpace* Create(const std::string& name, uint8_t* requested_begin, size_t capacity);
@@ -178,6 +185,7 @@ class FreeListSpace FINAL : public LargeObjectSpace {
   size_t Free(Thread* self, mirror::Object* obj) OVERRIDE REQUIRES(!lock_);
   void Walk(DlMallocSpace::WalkCallback callback, void* arg) OVERRIDE REQUIRES(!lock_);
   void Dump(std::ostream& os) const REQUIRES(!lock_);
+  void DumpStats(std::ostream& os) OVERRIDE REQUIRES(!lock_);
 
   std::pair<uint8_t*, uint8_t*> GetBeginEndAtomic() const OVERRIDE REQUIRES(!lock_);
 
@@ -196,8 +204,16 @@ class FreeListSpace FINAL : public LargeObjectSpace {
   uintptr_t GetAddressForAllocationInfo(const AllocationInfo* info) const {
     return GetAllocationAddressForSlot(GetSlotIndexForAllocationInfo(info));
   }
+  // Adds the free block preceding `info` to its bin or to the free blocks set.
+  void AddFreePrev(AllocationInfo* info) REQUIRES(lock_);
   // Removes header from the free blocks set by finding the corresponding iterator and erasing it.
   void RemoveFreePrev(AllocationInfo* info) REQUIRES(lock_);
+  // Removes and returns the allocation info following the smallest free block of at least
+  // `num_pages` pages, or null if there is no such block.
+  AllocationInfo* TakeFreeBlock(size_t num_pages) REQUIRES(lock_);
+  // Count the free blocks before the free region at the end of the space.
+  void GetFreeBlockInfo(size_t* num_free_blocks, size_t* free_bytes, size_t* largest_free_bytes)
+      const REQUIRES(lock_);
   bool IsZygoteLargeObject(Thread* self, mirror::Object* obj) const OVERRIDE;
   void SetAllLargeObjectsAsZygoteObjects(Thread* self) OVERRIDE REQUIRES(!lock_);
 
@@ -218,7 +234,21 @@ class FreeListSpace FINAL : public LargeObjectSpace {
   mutable Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
   // Free bytes at the end of the space.
   size_t free_end_ GUARDED_BY(lock_);
+  // Free blocks larger than kNumFreeBins pages, used for best fit allocation.
   FreeBlocks free_blocks_ GUARDED_BY(lock_);
+  // Segregated free blocks of up to kNumFreeBins pages, sorted by address within a bin.
+  FreeBlocks free_bins_[kNumFreeBins] GUARDED_BY(lock_);
+  // Bit `i` is set iff free_bins_[i] is not empty.
+  uint64_t non_empty_free_bins_ GUARDED_BY(lock_);
+  static_assert(kNumFreeBins <= BitSizeOf<uint64_t>(), "Too many free bins for the bin mask");
+
+  // Allocation statistics, see DumpStats().
+  uint64_t bin_allocations_ GUARDED_BY(lock_);
+  uint64_t best_fit_allocations_ GUARDED_BY(lock_);
+  uint64_t end_allocations_ GUARDED_BY(lock_);
+  uint64_t failed_allocations_ GUARDED_BY(lock_);
+
+  friend class LargeObjectSpaceTest;  // For checking the free block bins and statistics.
 };
 
 }  // namespace space
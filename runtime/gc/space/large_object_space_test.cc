@@ -30,6 +30,41 @@ class LargeObjectSpaceTest : public SpaceTest<CommonRuntimeTest> {
   static constexpr size_t kNumThreads = 10;
   static constexpr size_t kNumIterations = 1000;
   void RaceTest();
+
+  void FreeListBinsTest();
+
+ private:
+  // Returns the number of free blocks in the bin for blocks of `num_pages` pages.
+  static size_t NumFreeBlocksInBin(FreeListSpace* los, size_t num_pages) {
+    CHECK_GE(num_pages, 1u);
+    CHECK_LE(num_pages, FreeListSpace::kNumFreeBins);
+    MutexLock mu(Thread::Current(), los->lock_);
+    const size_t bin = num_pages - 1u;
+    const bool bin_is_empty = (los->non_empty_free_bins_ & (UINT64_C(1) << bin)) == 0u;
+    CHECK_EQ(los->free_bins_[bin].empty(), bin_is_empty);
+    return los->free_bins_[bin].size();
+  }
+
+  // Returns the number of free blocks larger than the largest bin.
+  static size_t NumBestFitFreeBlocks(FreeListSpace* los) {
+    MutexLock mu(Thread::Current(), los->lock_);
+    return los->free_blocks_.size();
+  }
+
+  static uint64_t NumBinAllocations(FreeListSpace* los) {
+    MutexLock mu(Thread::Current(), los->lock_);
+    return los->bin_allocations_;
+  }
+
+  static uint64_t NumBestFitAllocations(FreeListSpace* los) {
+    MutexLock mu(Thread::Current(), los->lock_);
+    return los->best_fit_allocations_;
+  }
+
+  static uint64_t NumEndAllocations(FreeListSpace* los) {
+    MutexLock mu(Thread::Current(), los->lock_);
+    return los->end_allocations_;
+  }
 };
 
 
@@ -174,6 +209,70 @@ void LargeObjectSpaceTest::RaceTest() {
   }
 }
 
+void LargeObjectSpaceTest::FreeListBinsTest() {
+  Thread* const self = Thread::Current();
+  std::unique_ptr<FreeListSpace> los(
+      space::FreeListSpace::Create("large object space", nullptr, 128 * MB));
+  const size_t kPage = FreeListSpace::kAlignment;
+  auto alloc = [&](size_t bytes) {
+    size_t bytes_allocated = 0, bytes_tl_bulk_allocated;
+    mirror::Object* obj =
+        los->Alloc(self, bytes, &bytes_allocated, nullptr, &bytes_tl_bulk_allocated);
+    EXPECT_TRUE(obj != nullptr);
+    EXPECT_EQ(RoundUp(bytes, kPage), bytes_allocated);
+    return obj;
+  };
+
+  // Create holes of 1, 3 and (kNumFreeBins + 2) pages separated by live objects.
+  const size_t kHugeHolePages = FreeListSpace::kNumFreeBins + 2;
+  mirror::Object* hole1 = alloc(kPage);
+  mirror::Object* live1 = alloc(kPage);
+  mirror::Object* hole3 = alloc(3 * kPage);
+  mirror::Object* live2 = alloc(kPage);
+  mirror::Object* huge_hole = alloc(kHugeHolePages * kPage);
+  mirror::Object* live3 = alloc(kPage);
+  EXPECT_EQ(6u, NumEndAllocations(los.get()));
+  los->Free(self, hole1);
+  los->Free(self, hole3);
+  los->Free(self, huge_hole);
+  EXPECT_EQ(1u, NumFreeBlocksInBin(los.get(), 1));
+  EXPECT_EQ(0u, NumFreeBlocksInBin(los.get(), 2));
+  EXPECT_EQ(1u, NumFreeBlocksInBin(los.get(), 3));
+  EXPECT_EQ(1u, NumBestFitFreeBlocks(los.get()));
+
+  // Requests are served from the smallest hole that fits, and the remainder of a split hole goes
+  // back to the bin of its size.
+  EXPECT_EQ(hole3, alloc(2 * kPage));
+  EXPECT_EQ(2u, NumFreeBlocksInBin(los.get(), 1));
+  EXPECT_EQ(0u, NumFreeBlocksInBin(los.get(), 3));
+  // Within a bin, the lowest address is used first.
+  EXPECT_EQ(hole1, alloc(kPage));
+  mirror::Object* remainder = alloc(kPage);
+  EXPECT_EQ(reinterpret_cast<uint8_t*>(hole3) + 2 * kPage,
+            reinterpret_cast<uint8_t*>(remainder));
+  EXPECT_EQ(0u, NumFreeBlocksInBin(los.get(), 1));
+  EXPECT_EQ(3u, NumBinAllocations(los.get()));
+  EXPECT_EQ(0u, NumBestFitAllocations(los.get()));
+
+  // Blocks bigger than the largest bin come from the best fit set.
+  EXPECT_EQ(huge_hole, alloc((kHugeHolePages - 1) * kPage));
+  EXPECT_EQ(0u, NumBestFitFreeBlocks(los.get()));
+  EXPECT_EQ(1u, NumFreeBlocksInBin(los.get(), 1));
+  EXPECT_EQ(1u, NumBestFitAllocations(los.get()));
+
+  // A freed block is reused by the next allocation of the same size.
+  los->Free(self, live1);
+  EXPECT_EQ(2u, NumFreeBlocksInBin(los.get(), 1));
+  EXPECT_EQ(live1, alloc(kPage));
+  EXPECT_EQ(1u, NumFreeBlocksInBin(los.get(), 1));
+  EXPECT_EQ(4u, NumBinAllocations(los.get()));
+  EXPECT_EQ(6u, NumEndAllocations(los.get()));
+
+  los->Free(self, live1);
+  los->Free(self, live2);
+  los->Free(self, live3);
+}
+
 TEST_F(LargeObjectSpaceTest, LargeObjectTest) {
   LargeObjectTest();
 }
@@ -182,6 +281,10 @@ TEST_F(LargeObjectSpaceTest, RaceTest) {
   RaceTest();
 }
 
+TEST_F(LargeObjectSpaceTest, FreeListBinsTest) {
+  FreeListBinsTest();
+}
+
 }  // namespace space
 }  // namespace gc
 }  // namespace art
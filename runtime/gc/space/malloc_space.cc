@@ -26,6 +26,7 @@
 #include "gc/space/space-inl.h"
 #include "gc/space/zygote_space.h"
 #include "handle_scope-inl.h"
+#include "mem_map.h"
 #include "mirror/class-inl.h"
 #include "mirror/object-inl.h"
 #include "runtime.h"
@@ -47,7 +48,7 @@ MallocSpace::MallocSpace(const std::string& name, MemMap* mem_map,
     : ContinuousMemMapAllocSpace(name, mem_map, begin, end, limit, kGcRetentionPolicyAlwaysCollect),
       recent_free_pos_(0), lock_("allocation space lock", kAllocSpaceLock),
       growth_limit_(growth_limit), can_move_objects_(can_move_objects),
-      starting_size_(starting_size), initial_size_(initial_size) {
+      starting_size_(starting_size), initial_size_(initial_size), last_trim_step_bytes_(0u) {
   if (create_bitmaps) {
     size_t bitmap_index = bitmap_index_++;
     static const uintptr_t kGcCardSize = static_cast<uintptr_t>(accounting::CardTable::kCardSize);
@@ -99,6 +100,8 @@ MemMap* MallocSpace::CreateMemMap(const std::string& name, size_t starting_size,
   if (mem_map == nullptr) {
     LOG(ERROR) << "Failed to allocate pages for alloc space (" << name << ") of size "
                << PrettySize(*capacity) << ": " << error_msg;
+  } else {
+    mem_map->MadviseHugePages();
   }
   return mem_map;
 }
@@ -253,6 +256,36 @@ void MallocSpace::SweepCallback(size_t num_ptrs, mirror::Object** ptrs, void* ar
   context->freed.bytes += space->FreeList(self, num_ptrs, ptrs);
 }
 
+size_t MallocSpace::NextTrimStepBytes(size_t max_bytes,
+                                      size_t last_step_bytes,
+                                      size_t refaulted_bytes) {
+  // Steps are made of whole huge pages in huge page mode, anything less could not release any.
+  const size_t release_unit = MemMap::GetHugePageAlignment();
+  DCHECK_GE(max_bytes, release_unit);
+  // Every released page which is allocated again costs a page fault, so release less while the
+  // pages released by the previous step keep coming back.
+  size_t step_bytes = max_bytes;
+  if (last_step_bytes != 0u) {
+    const double refault_rate =
+        std::min(1.0, static_cast<double>(refaulted_bytes) / last_step_bytes);
+    step_bytes = RoundUp(static_cast<size_t>(max_bytes * (1.0 - refault_rate)), release_unit);
+  }
+  return std::max(step_bytes, release_unit);
+}
+
+size_t MallocSpace::TrimStep(size_t max_bytes, bool first_step, bool* done) {
+  // Refaults of pages released by an earlier trim say nothing about this one.
+  const size_t refaulted_bytes = GetAndResetRefaultedBytes();
+  if (first_step) {
+    last_trim_step_bytes_ = 0u;
+  }
+  const size_t step_bytes = NextTrimStepBytes(max_bytes, last_trim_step_bytes_, refaulted_bytes);
+  last_trim_step_bytes_ = TrimIncremental(step_bytes, first_step, done);
+  VLOG(heap) << "Trim step of " << GetName() << " released " << PrettySize(last_trim_step_bytes_)
+             << " of " << PrettySize(step_bytes) << ", refaulted " << PrettySize(refaulted_bytes);
+  return last_trim_step_bytes_;
+}
+
 void MallocSpace::ClampGrowthLimit() {
   size_t new_capacity = Capacity();
   CHECK_LE(new_capacity, NonGrowthLimitCapacity());
@@ -73,6 +73,18 @@ class MallocSpace : public ContinuousMemMapAllocSpace {
   // Hands unused pages back to the system.
   virtual size_t Trim() = 0;
 
+  // Hands unused pages back to the system in steps of at most `max_bytes`, continuing where the
+  // previous step stopped unless `first_step` is set. Sets `done` once the whole space has been
+  // visited. The step gets smaller while the pages released by the previous step are being
+  // allocated again.
+  size_t TrimStep(size_t max_bytes, bool first_step, bool* done);
+
+  // Returns the size of the next trim step given the bytes released by the previous step and how
+  // many of those have been allocated again since.
+  static size_t NextTrimStepBytes(size_t max_bytes,
+                                  size_t last_step_bytes,
+                                  size_t refaulted_bytes);
+
   // Perform a mspace_inspect_all which calls back for each allocation chunk. The chunk may not be
   // in use, indicated by num_bytes equaling zero.
   virtual void Walk(WalkCallback callback, void* arg) = 0;
@@ -157,6 +169,18 @@ class MallocSpace : public ContinuousMemMapAllocSpace {
     return &SweepCallback;
   }
 
+  // Releases at most `max_bytes`, see TrimStep(). Spaces that cannot trim incrementally do
+  // a full Trim() in the first step of a trim and nothing in the later ones.
+  virtual size_t TrimIncremental(size_t max_bytes ATTRIBUTE_UNUSED, bool first_step, bool* done) {
+    *done = true;
+    return first_step ? Trim() : 0u;
+  }
+
+  // Returns the number of released bytes that have been allocated again since the last call.
+  virtual size_t GetAndResetRefaultedBytes() {
+    return 0u;
+  }
+
   // Recent allocation buffer.
   static constexpr size_t kRecentFreeCount = kDebugSpaces ? (1 << 16) : 0;
   static constexpr size_t kRecentFreeMask = kRecentFreeCount - 1;
@@ -184,6 +208,9 @@ class MallocSpace : public ContinuousMemMapAllocSpace {
   const size_t starting_size_;
   const size_t initial_size_;
 
+  // Bytes released by the last TrimStep(), used to compute the refault rate.
+  size_t last_trim_step_bytes_;
+
  private:
   static void SweepCallback(size_t num_ptrs, mirror::Object** ptrs, void* arg)
       REQUIRES_SHARED(Locks::mutator_lock_);
@@ -37,17 +37,26 @@ MemMap* RegionSpace::CreateMemMap(const std::string& name, size_t capacity,
                                   uint8_t* requested_begin) {
   CHECK_ALIGNED(capacity, kRegionSize);
   std::string error_msg;
-  // Ask for the capacity of an additional kRegionSize so that we can align the map by kRegionSize
-  // even if we get unaligned base address. This is necessary for the ReadBarrierTable to work.
+  // The map must be aligned by kRegionSize for the ReadBarrierTable to work. In huge page mode,
+  // align by huge pages if the capacity allows it so that no region straddles a partial huge page.
+  size_t alignment = kRegionSize;
+  if (MemMap::UseHugePages() && IsAlignedParam(capacity, MemMap::kHugePageSize)) {
+    alignment = std::max(alignment, MemMap::kHugePageSize);
+    // Ask for an aligned address right away, so that the map does not lose up to a huge page at
+    // its start to the alignment.
+    if (requested_begin != nullptr) {
+      requested_begin = AlignUp(requested_begin, alignment);
+    }
+  }
   std::unique_ptr<MemMap> mem_map;
   while (true) {
-    mem_map.reset(MemMap::MapAnonymous(name.c_str(),
-                                       requested_begin,
-                                       capacity + kRegionSize,
-                                       PROT_READ | PROT_WRITE,
-                                       true,
-                                       false,
-                                       &error_msg));
+    mem_map.reset(MemMap::MapAnonymousAligned(name.c_str(),
+                                              requested_begin,
+                                              capacity,
+                                              alignment,
+                                              PROT_READ | PROT_WRITE,
+                                              true,
+                                              &error_msg));
     if (mem_map.get() != nullptr || requested_begin == nullptr) {
       break;
     }
@@ -60,17 +69,7 @@ MemMap* RegionSpace::CreateMemMap(const std::string& name, size_t capacity,
     MemMap::DumpMaps(LOG_STREAM(ERROR));
     return nullptr;
   }
-  CHECK_EQ(mem_map->Size(), capacity + kRegionSize);
-  CHECK_EQ(mem_map->Begin(), mem_map->BaseBegin());
-  CHECK_EQ(mem_map->Size(), mem_map->BaseSize());
-  if (IsAlignedParam(mem_map->Begin(), kRegionSize)) {
-    // Got an aligned map. Since we requested a map that's kRegionSize larger. Shrink by
-    // kRegionSize at the end.
-    mem_map->SetSize(capacity);
-  } else {
-    // Got an unaligned map. Align the both ends.
-    mem_map->AlignBy(kRegionSize);
-  }
+  mem_map->MadviseHugePages();
   CHECK_ALIGNED(mem_map->Begin(), kRegionSize);
   CHECK_ALIGNED(mem_map->End(), kRegionSize);
   CHECK_EQ(mem_map->Size(), capacity);
@@ -263,7 +262,7 @@ void RegionSpace::SetFromSpace(accounting::ReadBarrierTable* rb_table, bool forc
 }
 
 static void ZeroAndProtectRegion(uint8_t* begin, uint8_t* end) {
-  ZeroAndReleasePages(begin, end - begin);
+  ZeroAndReleaseHugePages(begin, end - begin);
   if (kProtectClearedRegions) {
     CheckedCall(mprotect, __FUNCTION__, begin, end - begin, PROT_NONE);
   }
@@ -385,7 +384,7 @@ void RegionSpace::ClearFromSpace(/* out */ uint64_t* cleared_bytes,
     }
   }
   // Clear pages for the last block since clearing happens when a new block opens.
-  ZeroAndReleasePages(clear_block_begin, clear_block_end - clear_block_begin);
+  ZeroAndReleaseHugePages(clear_block_begin, clear_block_end - clear_block_begin);
   // Update non_free_region_index_limit_.
   SetNonFreeRegionLimit(new_non_free_region_index_limit);
   evac_region_ = nullptr;
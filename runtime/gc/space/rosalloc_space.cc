@@ -50,7 +50,7 @@ RosAllocSpace::RosAllocSpace(MemMap* mem_map, size_t initial_size, const std::st
                              size_t starting_size, bool low_memory_mode)
     : MallocSpace(name, mem_map, begin, end, limit, growth_limit, true, can_move_objects,
                   starting_size, initial_size),
-      rosalloc_(rosalloc), low_memory_mode_(low_memory_mode) {
+      rosalloc_(rosalloc), low_memory_mode_(low_memory_mode), trim_page_idx_(0u) {
   CHECK(rosalloc != nullptr);
 }
 
@@ -251,16 +251,18 @@ size_t RosAllocSpace::FreeList(Thread* self, size_t num_ptrs, mirror::Object** p
   return bytes_freed;
 }
 
+void RosAllocSpace::TrimEnd() {
+  Thread* const self = Thread::Current();
+  // SOA required for Rosalloc::Trim() -> ArtRosAllocMoreCore() -> Heap::GetRosAllocSpace.
+  ScopedObjectAccess soa(self);
+  MutexLock mu(self, lock_);
+  // Trim to release memory at the end of the space.
+  rosalloc_->Trim();
+}
+
 size_t RosAllocSpace::Trim() {
   VLOG(heap) << "RosAllocSpace::Trim() ";
-  {
-    Thread* const self = Thread::Current();
-    // SOA required for Rosalloc::Trim() -> ArtRosAllocMoreCore() -> Heap::GetRosAllocSpace.
-    ScopedObjectAccess soa(self);
-    MutexLock mu(self, lock_);
-    // Trim to release memory at the end of the space.
-    rosalloc_->Trim();
-  }
+  TrimEnd();
   // Attempt to release pages if it does not release all empty pages.
   if (!rosalloc_->DoesReleaseAllPages()) {
     return rosalloc_->ReleasePages();
@@ -268,6 +270,29 @@ size_t RosAllocSpace::Trim() {
   return 0;
 }
 
+size_t RosAllocSpace::TrimIncremental(size_t max_bytes, bool first_step, bool* done) {
+  if (first_step) {
+    // Starting a new pass over the space.
+    trim_page_idx_ = 0u;
+    TrimEnd();
+  } else if (trim_page_idx_ == 0u) {
+    // The pass finished in an earlier step, other spaces still have more to release.
+    *done = true;
+    return 0;
+  }
+  if (rosalloc_->DoesReleaseAllPages()) {
+    *done = true;
+    return 0;
+  }
+  size_t reclaimed = rosalloc_->ReleasePages(max_bytes, &trim_page_idx_);
+  *done = (trim_page_idx_ == 0u);
+  return reclaimed;
+}
+
+size_t RosAllocSpace::GetAndResetRefaultedBytes() {
+  return rosalloc_->GetAndResetRefaultedBytes();
+}
+
 void RosAllocSpace::Walk(void(*callback)(void *start, void *end, size_t num_bytes, void* callback_arg),
                          void* arg) {
   InspectAllRosAlloc(callback, arg, true);
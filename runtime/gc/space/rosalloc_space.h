@@ -161,6 +161,9 @@ class RosAllocSpace : public MallocSpace {
                 size_t growth_limit, bool can_move_objects, size_t starting_size,
                 bool low_memory_mode);
 
+  size_t TrimIncremental(size_t max_bytes, bool first_step, bool* done) OVERRIDE;
+  size_t GetAndResetRefaultedBytes() OVERRIDE;
+
  private:
   template<bool kThreadSafe = true>
   mirror::Object* AllocCommon(Thread* self, size_t num_bytes, size_t* bytes_allocated,
@@ -183,11 +186,17 @@ class RosAllocSpace : public MallocSpace {
       void* arg, bool do_null_callback_at_end)
       REQUIRES(!Locks::runtime_shutdown_lock_, !Locks::thread_list_lock_);
 
+  // Release the free memory at the end of the space.
+  void TrimEnd();
+
   // Underlying rosalloc.
   allocator::RosAlloc* rosalloc_;
 
   const bool low_memory_mode_;
 
+  // Page map index where the next TrimIncremental() resumes.
+  size_t trim_page_idx_;
+
   friend class collector::MarkSweep;
 
   DISALLOW_COPY_AND_ASSIGN(RosAllocSpace);
@@ -352,6 +352,91 @@ TEST_P(SpaceCreateTest, AllocAndFreeListTestBody) {
   space->FreeList(self, arraysize(lots_of_objects), lots_of_objects);
 }
 
+TEST_P(SpaceCreateTest, TrimStepTestBody) {
+  MallocSpace* space(CreateSpace("test", 4 * MB, 16 * MB, 16 * MB, nullptr));
+  ASSERT_TRUE(space != nullptr);
+
+  // Make space findable to the heap, will also delete space when runtime is cleaned up
+  AddSpace(space);
+  Thread* self = Thread::Current();
+  ScopedObjectAccess soa(self);
+
+  // Leave free page runs separated by live objects, so that each step releases one of them.
+  static constexpr size_t kNumRuns = 4;
+  static constexpr size_t kRunBytes = 64 * kPageSize;
+  size_t dummy = 0;
+  mirror::Object* garbage[kNumRuns];
+  mirror::Object* live[kNumRuns];
+  for (size_t i = 0; i < kNumRuns; ++i) {
+    garbage[i] = Alloc(space, self, kRunBytes, &dummy, nullptr, &dummy);
+    ASSERT_TRUE(garbage[i] != nullptr);
+    live[i] = Alloc(space, self, kRunBytes, &dummy, nullptr, &dummy);
+    ASSERT_TRUE(live[i] != nullptr);
+  }
+  space->FreeList(self, kNumRuns, garbage);
+
+  bool done = false;
+  if (GetParam() == kMallocSpaceDlMalloc) {
+    // dlmalloc cannot trim incrementally, it trims everything in the first step only.
+    space->TrimStep(kPageSize, /* first_step */ true, &done);
+    EXPECT_TRUE(done);
+    EXPECT_EQ(0u, space->TrimStep(kPageSize, /* first_step */ false, &done));
+    EXPECT_TRUE(done);
+    space->FreeList(self, kNumRuns, live);
+    return;
+  }
+
+  allocator::RosAlloc* rosalloc = space->AsRosAllocSpace()->GetRosAlloc();
+  // Pages which were never used before are not refaults.
+  EXPECT_EQ(0u, rosalloc->GetAndResetRefaultedBytes());
+
+  // Each step stays within its budget, stopping and resuming in the middle of free page runs.
+  static constexpr size_t kStepBytes = 4 * kPageSize;
+  size_t released = space->TrimStep(kStepBytes, /* first_step */ true, &done);
+  EXPECT_LT(0u, released);
+  EXPECT_LE(released, kStepBytes);
+  EXPECT_FALSE(done);
+  size_t steps = 1u;
+  while (!done) {
+    size_t step_released = space->TrimStep(kStepBytes, /* first_step */ false, &done);
+    EXPECT_LE(step_released, kStepBytes);
+    released += step_released;
+    ++steps;
+    ASSERT_LE(steps, 2 * kNumRuns * kRunBytes / kStepBytes);
+  }
+  // Every free page run is released, except for the magic page at its start in debug builds.
+  const size_t released_per_run = kIsDebugBuild ? kRunBytes - kPageSize : kRunBytes;
+  EXPECT_LE(kNumRuns * released_per_run, released);
+  EXPECT_LE(kNumRuns * released_per_run / kStepBytes, steps);
+  // Once the pass is done, later steps do not start over.
+  EXPECT_EQ(0u, space->TrimStep(kPageSize, /* first_step */ false, &done));
+  EXPECT_TRUE(done);
+
+  // Allocating the released pages again counts them as refaulted, exactly once.
+  for (size_t i = 0; i < kNumRuns; ++i) {
+    garbage[i] = Alloc(space, self, kRunBytes, &dummy, nullptr, &dummy);
+    ASSERT_TRUE(garbage[i] != nullptr);
+  }
+  EXPECT_EQ(released, rosalloc->GetAndResetRefaultedBytes());
+  EXPECT_EQ(0u, rosalloc->GetAndResetRefaultedBytes());
+
+  space->FreeList(self, kNumRuns, garbage);
+  space->FreeList(self, kNumRuns, live);
+}
+
+TEST_P(SpaceCreateTest, TrimStepBytesTestBody) {
+  // Without refaults, or at the start of a trim, the step is not reduced.
+  EXPECT_EQ(4 * MB, MallocSpace::NextTrimStepBytes(4 * MB, 0u, 0u));
+  EXPECT_EQ(4 * MB, MallocSpace::NextTrimStepBytes(4 * MB, 1 * MB, 0u));
+  // The step shrinks with the share of the previous step that was allocated again.
+  EXPECT_EQ(3 * MB, MallocSpace::NextTrimStepBytes(4 * MB, 1 * MB, 256 * KB));
+  EXPECT_EQ(2 * MB, MallocSpace::NextTrimStepBytes(4 * MB, 1 * MB, 512 * KB));
+  // But it never drops below a page.
+  const size_t page_size = kPageSize;
+  EXPECT_EQ(page_size, MallocSpace::NextTrimStepBytes(4 * MB, 1 * MB, 1 * MB));
+  EXPECT_EQ(page_size, MallocSpace::NextTrimStepBytes(4 * MB, 1 * MB, 2 * MB));
+}
+
 INSTANTIATE_TEST_CASE_P(CreateRosAllocSpace,
                         SpaceCreateTest,
                         testing::Values(kMallocSpaceRosAlloc));
@@ -15,11 +15,13 @@
  */
 
 /*
- * Preparation and completion of hprof data generation.  The output is
- * written into two files and then combined.  This is necessary because
- * we generate some of the data (strings and classes) while we dump the
- * heap, and some analysis tools require that the class and string data
- * appear first.
+ * Preparation and completion of hprof data generation.  The heap body is
+ * compressed into memory as it is written while all threads are suspended,
+ * and the header is generated afterwards.  This is necessary because we
+ * generate some of the data (strings and classes) while we dump the heap, and
+ * some analysis tools require that the class and string data appear first.
+ * The output file is only written, gzip-compressed if its name ends in ".gz",
+ * once the mutators are running again.
  */
 
 #include "hprof.h"
@@ -27,17 +29,24 @@
 #include <cutils/open_memstream.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/time.h>
 #include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
+#include <zlib.h>
 
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <mutex>
 #include <set>
 
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 
 #include "art_field-inl.h"
 #include "art_method-inl.h"
@@ -80,6 +89,17 @@ static constexpr uint32_t kHprofNullThread = 0;
 static constexpr size_t kMaxObjectsPerSegment = 128;
 static constexpr size_t kMaxBytesPerSegment = 4096;
 
+// Size of the segments the heap dump body is handed to the compressor thread in.
+static constexpr size_t kBodySegmentSize = 1 * MB;
+
+// Number of segments that may wait for the compressor thread. The heap walk blocks when the
+// compressor falls behind, so the uncompressed body held in memory stays bounded.
+static constexpr size_t kMaxPendingBodySegments = 4;
+
+// Size of the chunks the compressed heap dump is stored in, and of the buffers used to compress
+// and decompress it when it is written out.
+static constexpr size_t kCompressionChunkSize = 64 * KB;
+
 // The static field-name for the synthetic object generated to account for class static overhead.
 static constexpr const char* kClassOverheadName = "$classOverhead";
 
@@ -388,46 +408,318 @@ class EndianOutputBuffered : public EndianOutput {
   std::vector<uint8_t> buffer_;
 };
 
-class FileEndianOutput FINAL : public EndianOutputBuffered {
+class VectorEndianOuputput FINAL : public EndianOutputBuffered {
  public:
-  FileEndianOutput(File* fp, size_t reserved_size)
-      : EndianOutputBuffered(reserved_size), fp_(fp), errors_(false) {
-    DCHECK(fp != nullptr);
+  VectorEndianOuputput(std::vector<uint8_t>& data, size_t reserved_size)
+      : EndianOutputBuffered(reserved_size), full_data_(data) {}
+  ~VectorEndianOuputput() {}
+
+ protected:
+  void HandleFlush(const uint8_t* buf, size_t length) OVERRIDE {
+    size_t old_size = full_data_.size();
+    full_data_.resize(old_size + length);
+    memcpy(full_data_.data() + old_size, buf, length);
+  }
+
+ private:
+  std::vector<uint8_t>& full_data_;
+};
+
+// This compresses the record stream into memory as it is written. The heap walk only copies
+// the records into fixed-size segments and a separate thread deflates them, so the compression
+// overlaps with the walk. That thread is not attached to the runtime, so it keeps running while
+// all threads are suspended.
+class DeflateEndianOutput FINAL : public EndianOutputBuffered {
+ public:
+  explicit DeflateEndianOutput(size_t reserved_size)
+      : EndianOutputBuffered(reserved_size),
+        used_in_segment_(0u),
+        used_in_last_chunk_(kCompressionChunkSize),
+        failed_(false),
+        finishing_(false),
+        finished_(false) {
+    memset(&stream_, 0, sizeof(stream_));
+    // Adding 16 to the window bits selects the gzip header and trailer.
+    stream_initialized_ = deflateInit2(&stream_,
+                                       Z_BEST_SPEED,
+                                       Z_DEFLATED,
+                                       MAX_WBITS + 16,
+                                       /* memLevel */ 8,
+                                       Z_DEFAULT_STRATEGY) == Z_OK;
+    CHECK_PTHREAD_CALL(pthread_create, (&pthread_, nullptr, &Run, this), "hprof compressor");
+  }
+  ~DeflateEndianOutput() {
+    Finish();
+    if (stream_initialized_) {
+      deflateEnd(&stream_);
+    }
   }
-  ~FileEndianOutput() {
+
+  // Compress the rest of the data and stop the compressor thread. Nothing may be written
+  // afterwards. Returns false if the compression failed.
+  bool Finish() {
+    if (finished_) {
+      return !failed_;
+    }
+    if (used_in_segment_ != 0u) {
+      SubmitSegment();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      finishing_ = true;
+    }
+    cond_.notify_all();
+    CHECK_PTHREAD_CALL(pthread_join, (pthread_, nullptr), "hprof compressor shutdown");
+    finished_ = true;
+    if (!failed_ && !Deflate(nullptr, 0u, Z_FINISH)) {
+      failed_ = true;
+    }
+    free_segments_.clear();
+    return !failed_;
+  }
+
+  // The size of the gzip stream produced by Finish().
+  size_t CompressedSize() const {
+    DCHECK(finished_);
+    return chunks_.empty() ? 0u : (chunks_.size() - 1u) * kCompressionChunkSize +
+                                      used_in_last_chunk_;
+  }
+
+  // Call `visitor(data, size)` for each chunk of the gzip stream in order, stopping when it
+  // returns false.
+  template <typename Visitor>
+  bool VisitCompressedChunks(const Visitor& visitor) const {
+    DCHECK(finished_);
+    for (size_t i = 0; i != chunks_.size(); ++i) {
+      size_t size = (i + 1u == chunks_.size()) ? used_in_last_chunk_ : kCompressionChunkSize;
+      if (!visitor(chunks_[i].get(), size)) {
+        return false;
+      }
+    }
+    return true;
   }
 
-  bool Errors() {
-    return errors_;
+  // Call `visitor(data, size)` for the uncompressed data in order, stopping when it returns
+  // false.
+  template <typename Visitor>
+  bool VisitUncompressed(const Visitor& visitor) const {
+    DCHECK(finished_);
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, MAX_WBITS + 16) != Z_OK) {
+      return false;
+    }
+    std::vector<uint8_t> buffer(kCompressionChunkSize);
+    int result = Z_OK;
+    bool okay = VisitCompressedChunks([&](const uint8_t* data, size_t size) {
+      stream.next_in = const_cast<uint8_t*>(data);
+      stream.avail_in = static_cast<uInt>(size);
+      do {
+        stream.next_out = buffer.data();
+        stream.avail_out = static_cast<uInt>(buffer.size());
+        result = inflate(&stream, Z_NO_FLUSH);
+        // Z_BUF_ERROR only means that no progress was possible, there is no more output yet.
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+          return false;
+        }
+        if (!visitor(buffer.data(), buffer.size() - stream.avail_out)) {
+          return false;
+        }
+      } while (stream.avail_out == 0u);
+      return true;
+    });
+    inflateEnd(&stream);
+    return okay && result == Z_STREAM_END;
   }
 
  protected:
   void HandleFlush(const uint8_t* buffer, size_t length) OVERRIDE {
-    if (!errors_) {
-      errors_ = !fp_->WriteFully(buffer, length);
+    while (length != 0u) {
+      if (segment_ == nullptr) {
+        segment_.reset(new uint8_t[kBodySegmentSize]);
+      }
+      size_t size = std::min(length, kBodySegmentSize - used_in_segment_);
+      memcpy(segment_.get() + used_in_segment_, buffer, size);
+      used_in_segment_ += size;
+      buffer += size;
+      length -= size;
+      if (used_in_segment_ == kBodySegmentSize) {
+        SubmitSegment();
+      }
     }
   }
 
  private:
-  File* fp_;
-  bool errors_;
+  // Hand the current segment to the compressor thread, waiting while too many are pending.
+  void SubmitSegment() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this]() { return pending_.size() < kMaxPendingBodySegments; });
+      pending_.emplace_back(std::move(segment_), used_in_segment_);
+      if (!free_segments_.empty()) {
+        segment_ = std::move(free_segments_.back());
+        free_segments_.pop_back();
+      }
+    }
+    cond_.notify_all();
+    used_in_segment_ = 0u;
+  }
+
+  static void* Run(void* arg) {
+    reinterpret_cast<DeflateEndianOutput*>(arg)->CompressSegments();
+    return nullptr;
+  }
+
+  void CompressSegments() {
+    while (true) {
+      std::pair<std::unique_ptr<uint8_t[]>, size_t> segment;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this]() { return !pending_.empty() || finishing_; });
+        if (pending_.empty()) {
+          return;
+        }
+        segment = std::move(pending_.front());
+        pending_.pop_front();
+      }
+      // After a failure, the rest of the data is only drained so that the walk does not block.
+      if (!failed_ && !Deflate(segment.first.get(), segment.second, Z_NO_FLUSH)) {
+        failed_ = true;
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_segments_.push_back(std::move(segment.first));
+      }
+      cond_.notify_all();
+    }
+  }
+
+  bool Deflate(const uint8_t* data, size_t length, int flush) {
+    if (!stream_initialized_) {
+      return false;
+    }
+    stream_.next_in = const_cast<uint8_t*>(data);
+    stream_.avail_in = static_cast<uInt>(length);
+    int result;
+    do {
+      if (used_in_last_chunk_ == kCompressionChunkSize) {
+        chunks_.emplace_back(new uint8_t[kCompressionChunkSize]);
+        used_in_last_chunk_ = 0u;
+      }
+      stream_.next_out = chunks_.back().get() + used_in_last_chunk_;
+      stream_.avail_out = static_cast<uInt>(kCompressionChunkSize - used_in_last_chunk_);
+      result = deflate(&stream_, flush);
+      if (result == Z_STREAM_ERROR) {
+        return false;
+      }
+      used_in_last_chunk_ = kCompressionChunkSize - stream_.avail_out;
+    } while (stream_.avail_out == 0u || (flush == Z_FINISH && result != Z_STREAM_END));
+    DCHECK_EQ(stream_.avail_in, 0u);
+    return true;
+  }
+
+  // The segment being filled by the heap walk.
+  std::unique_ptr<uint8_t[]> segment_;
+  size_t used_in_segment_;
+
+  // The compressor state and its output, only used by the compressor thread until it is joined.
+  z_stream stream_;
+  bool stream_initialized_;
+  std::vector<std::unique_ptr<uint8_t[]>> chunks_;
+  size_t used_in_last_chunk_;
+  bool failed_;
+
+  pthread_t pthread_;
+  // Guards the fields below. The compressor thread is not attached, so it cannot use art::Mutex.
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  // Filled segments and their sizes, in order.
+  std::deque<std::pair<std::unique_ptr<uint8_t[]>, size_t>> pending_;
+  // Segments which have been compressed and can be filled again.
+  std::vector<std::unique_ptr<uint8_t[]>> free_segments_;
+  bool finishing_;
+
+  // Whether Finish() has been called, only used by the thread writing the records.
+  bool finished_;
+
+  DISALLOW_COPY_AND_ASSIGN(DeflateEndianOutput);
 };
 
-class VectorEndianOuputput FINAL : public EndianOutputBuffered {
+// Writes a gzip stream to a file. This is used for the header once the threads are running
+// again.
+class GzipFileWriter {
  public:
-  VectorEndianOuputput(std::vector<uint8_t>& data, size_t reserved_size)
-      : EndianOutputBuffered(reserved_size), full_data_(data) {}
-  ~VectorEndianOuputput() {}
+  explicit GzipFileWriter(File* fp)
+      : fp_(fp), chunk_(kCompressionChunkSize), compressed_size_(0u) {
+    DCHECK(fp != nullptr);
+    memset(&stream_, 0, sizeof(stream_));
+    // Adding 16 to the window bits selects the gzip header and trailer.
+    initialized_ = deflateInit2(&stream_,
+                                Z_BEST_SPEED,
+                                Z_DEFLATED,
+                                MAX_WBITS + 16,
+                                /* memLevel */ 8,
+                                Z_DEFAULT_STRATEGY) == Z_OK;
+  }
+  ~GzipFileWriter() {
+    if (initialized_) {
+      deflateEnd(&stream_);
+    }
+  }
 
- protected:
-  void HandleFlush(const uint8_t* buf, size_t length) OVERRIDE {
-    size_t old_size = full_data_.size();
-    full_data_.resize(old_size + length);
-    memcpy(full_data_.data() + old_size, buf, length);
+  bool Write(const uint8_t* data, size_t length) {
+    while (length != 0u) {
+      size_t size = std::min<size_t>(length, std::numeric_limits<uInt>::max());
+      if (!Deflate(data, size, Z_NO_FLUSH)) {
+        return false;
+      }
+      data += size;
+      length -= size;
+    }
+    return true;
+  }
+
+  // Flush the data still pending in the compressor. Nothing may be written afterwards.
+  bool Finish() {
+    return Deflate(nullptr, 0u, Z_FINISH);
+  }
+
+  size_t CompressedSize() const {
+    return compressed_size_;
   }
 
  private:
-  std::vector<uint8_t>& full_data_;
+  bool Deflate(const uint8_t* data, size_t length, int flush) {
+    if (!initialized_) {
+      return false;
+    }
+    stream_.next_in = const_cast<uint8_t*>(data);
+    stream_.avail_in = static_cast<uInt>(length);
+    int result;
+    do {
+      stream_.next_out = chunk_.data();
+      stream_.avail_out = static_cast<uInt>(chunk_.size());
+      result = deflate(&stream_, flush);
+      if (result == Z_STREAM_ERROR) {
+        return false;
+      }
+      size_t size = chunk_.size() - stream_.avail_out;
+      if (!fp_->WriteFully(chunk_.data(), size)) {
+        return false;
+      }
+      compressed_size_ += size;
+    } while (stream_.avail_out == 0u || (flush == Z_FINISH && result != Z_STREAM_END));
+    DCHECK_EQ(stream_.avail_in, 0u);
+    return true;
+  }
+
+  File* fp_;
+  z_stream stream_;
+  bool initialized_;
+  std::vector<uint8_t> chunk_;
+  size_t compressed_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(GzipFileWriter);
 };
 
 #define __ output_->
@@ -437,10 +729,14 @@ class Hprof : public SingleRootVisitor {
   Hprof(const char* output_filename, int fd, bool direct_to_ddms)
       : filename_(output_filename),
         fd_(fd),
-        direct_to_ddms_(direct_to_ddms) {
+        direct_to_ddms_(direct_to_ddms),
+        compress_(!direct_to_ddms && android::base::EndsWith(filename_, ".gz")) {
     LOG(INFO) << "hprof: heap dump \"" << filename_ << "\" starting...";
   }
 
+  // Walk the heap. This is called with all threads suspended. For DDMS the dump is sent right
+  // away, otherwise only the in-memory header and body are produced and WriteToFile()
+  // has to be called once the threads are resumed.
   void Dump()
     REQUIRES(Locks::mutator_lock_)
     REQUIRES(!Locks::heap_bitmap_lock_, !Locks::alloc_tracker_lock_) {
@@ -451,6 +747,11 @@ class Hprof : public SingleRootVisitor {
       }
     }
 
+    if (!direct_to_ddms_) {
+      DumpToMemory();
+      return;
+    }
+
     // First pass to measure the size of the dump.
     size_t overall_size;
     size_t max_length;
@@ -465,23 +766,82 @@ class Hprof : public SingleRootVisitor {
 
     bool okay;
     visited_objects_.clear();
-    if (direct_to_ddms_) {
-      if (kDirectStream) {
-        okay = DumpToDdmsDirect(overall_size, max_length, CHUNK_TYPE("HPDS"));
-      } else {
-        okay = DumpToDdmsBuffered(overall_size, max_length);
+    if (kDirectStream) {
+      okay = DumpToDdmsDirect(overall_size, max_length, CHUNK_TYPE("HPDS"));
+    } else {
+      okay = DumpToDdmsBuffered(overall_size, max_length);
+    }
+
+    if (okay) {
+      LogCompletion(overall_size);
+    }
+  }
+
+  // Write the dump produced by Dump() to the output file. This does not access the heap, so it
+  // is done without holding the mutator lock. On failure, returns false and sets `error_msg`.
+  bool WriteToFile(std::string* error_msg) REQUIRES(!Locks::mutator_lock_) {
+    CHECK(!direct_to_ddms_);
+    CHECK(body_output_ != nullptr);
+
+    // Where exactly are we writing to?
+    int out_fd;
+    if (fd_ >= 0) {
+      out_fd = dup(fd_);
+      if (out_fd < 0) {
+        *error_msg = android::base::StringPrintf("Couldn't dump heap; dup(%d) failed: %s",
+                                                 fd_,
+                                                 strerror(errno));
+        return false;
       }
     } else {
-      okay = DumpToFile(overall_size, max_length);
+      out_fd = open(filename_.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+      if (out_fd < 0) {
+        *error_msg = android::base::StringPrintf("Couldn't dump heap; open(\"%s\") failed: %s",
+                                                 filename_.c_str(),
+                                                 strerror(errno));
+        return false;
+      }
     }
 
+    std::unique_ptr<File> file(new File(out_fd, filename_, true));
+    // The compressor may still be working on the end of the body.
+    bool okay = body_output_->Finish();
+    if (!okay) {
+      file->Erase();
+      *error_msg = android::base::StringPrintf("Couldn't dump heap; compressing \"%s\" failed",
+                                               filename_.c_str());
+      return false;
+    }
+    auto write_chunk = [&file](const uint8_t* data, size_t size) {
+      return file->WriteFully(data, size);
+    };
+    if (compress_) {
+      // A gzip file may consist of several gzip streams, so the compressed body is written as
+      // it is, after the header.
+      GzipFileWriter gzip(file.get());
+      okay = gzip.Write(header_data_.data(), header_data_.size()) &&
+             gzip.Finish() &&
+             body_output_->VisitCompressedChunks(write_chunk);
+      compressed_size_ = gzip.CompressedSize() + body_output_->CompressedSize();
+    } else {
+      okay = file->WriteFully(header_data_.data(), header_data_.size()) &&
+             body_output_->VisitUncompressed(write_chunk);
+    }
     if (okay) {
-      const uint64_t duration = NanoTime() - start_ns_;
-      LOG(INFO) << "hprof: heap dump completed (" << PrettySize(RoundUp(overall_size, KB))
-                << ") in " << PrettyDuration(duration)
-                << " objects " << total_objects_
-                << " objects with stack traces " << total_objects_with_stack_trace_;
+      okay = file->FlushCloseOrErase() == 0;
+    } else {
+      file->Erase();
+    }
+    if (!okay) {
+      *error_msg = android::base::StringPrintf("Couldn't dump heap; writing \"%s\" failed: %s",
+                                               filename_.c_str(),
+                                               strerror(errno));
+      return false;
     }
+
+    LogCompletion(header_data_.size() + body_output_->SumLength());
+    body_output_.reset();
+    return true;
   }
 
  private:
@@ -756,55 +1116,41 @@ class Hprof : public SingleRootVisitor {
     //        Dbg::DdmSendChunkV(CHUNK_TYPE("HPDS"), iov, 2);
   }
 
-  bool DumpToFile(size_t overall_size, size_t max_length)
-      REQUIRES(Locks::mutator_lock_) {
-    // Where exactly are we writing to?
-    int out_fd;
-    if (fd_ >= 0) {
-      out_fd = dup(fd_);
-      if (out_fd < 0) {
-        ThrowRuntimeException("Couldn't dump heap; dup(%d) failed: %s", fd_, strerror(errno));
-        return false;
-      }
-    } else {
-      out_fd = open(filename_.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
-      if (out_fd < 0) {
-        ThrowRuntimeException("Couldn't dump heap; open(\"%s\") failed: %s", filename_.c_str(),
-                              strerror(errno));
-        return false;
-      }
-    }
+  // Single pass over the heap for file output. The body only refers to strings and classes that
+  // are discovered while it is being written, so it is compressed into memory first and the
+  // header is generated afterwards. WriteToFile() waits for the compression to finish.
+  void DumpToMemory() REQUIRES(Locks::mutator_lock_) {
+    current_heap_ = HPROF_HEAP_DEFAULT;
+    objects_in_segment_ = 0;
+    body_output_.reset(new DeflateEndianOutput(kMaxBytesPerSegment));
+    output_ = body_output_.get();
+    ProcessBody();
 
-    std::unique_ptr<File> file(new File(out_fd, filename_, true));
-    bool okay;
+    // The class table and the stack traces add the strings they use, so collect those before
+    // the string table is written at the start of the header.
     {
-      FileEndianOutput file_output(file.get(), max_length);
-      output_ = &file_output;
-      ProcessHeap(true);
-      okay = !file_output.Errors();
-
-      if (okay) {
-        // Check for expected size. Output is expected to be less-or-equal than first phase, see
-        // b/23521263.
-        DCHECK_LE(file_output.SumLength(), overall_size);
-      }
-      output_ = nullptr;
+      EndianOutput count_output;
+      output_ = &count_output;
+      ProcessHeader(false);
     }
+    VectorEndianOuputput header_output(header_data_, kMaxBytesPerSegment);
+    output_ = &header_output;
+    ProcessHeader(true);
+    output_ = nullptr;
 
-    if (okay) {
-      okay = file->FlushCloseOrErase() == 0;
-    } else {
-      file->Erase();
-    }
-    if (!okay) {
-      std::string msg(android::base::StringPrintf("Couldn't dump heap; writing \"%s\" failed: %s",
-                                                  filename_.c_str(),
-                                                  strerror(errno)));
-      ThrowRuntimeException("%s", msg.c_str());
-      LOG(ERROR) << msg;
-    }
+    walk_ns_ = NanoTime() - start_ns_;
+    visited_objects_.clear();
+    simple_roots_.clear();
+  }
 
-    return okay;
+  void LogCompletion(size_t overall_size) {
+    const uint64_t duration = NanoTime() - start_ns_;
+    LOG(INFO) << "hprof: heap dump completed (" << PrettySize(RoundUp(overall_size, KB))
+              << ") in " << PrettyDuration(duration)
+              << (body_output_ != nullptr ? " (heap walk " + PrettyDuration(walk_ns_) + ")" : "")
+              << (compress_ ? " compressed to " + PrettySize(RoundUp(compressed_size_, KB)) : "")
+              << " objects " << total_objects_
+              << " objects with stack traces " << total_objects_with_stack_trace_;
   }
 
   bool DumpToDdmsDirect(size_t overall_size, size_t max_length, uint32_t chunk_type)
@@ -876,11 +1222,23 @@ class Hprof : public SingleRootVisitor {
   std::string filename_;
   int fd_;
   bool direct_to_ddms_;
+  // Whether WriteToFile() writes a gzip stream rather than the plain hprof data.
+  bool compress_;
 
   uint64_t start_ns_ = NanoTime();
 
+  // Time spent walking the heap with all threads suspended, for file output.
+  uint64_t walk_ns_ = 0u;
+
   EndianOutput* output_ = nullptr;
 
+  // Header and body produced by DumpToMemory().
+  std::vector<uint8_t> header_data_;
+  std::unique_ptr<DeflateEndianOutput> body_output_;
+
+  // Size of the file written by WriteToFile() when compressing.
+  size_t compressed_size_ = 0u;
+
   HprofHeapId current_heap_ = HPROF_HEAP_DEFAULT;  // Which heap we're currently dumping.
   size_t objects_in_segment_ = 0;
 
@@ -1601,14 +1959,25 @@ void Hprof::VisitRoot(mirror::Object* obj, const RootInfo& info) {
 void DumpHeap(const char* filename, int fd, bool direct_to_ddms) {
   CHECK(filename != nullptr);
   Thread* self = Thread::Current();
-  // Need to take a heap dump while GC isn't running. See the comment in Heap::VisitObjects().
-  // Also we need the critical section to avoid visiting the same object twice. See b/34967844
-  gc::ScopedGCCriticalSection gcs(self,
-                                  gc::kGcCauseHprof,
-                                  gc::kCollectorTypeHprof);
-  ScopedSuspendAll ssa(__FUNCTION__, true /* long suspend */);
   Hprof hprof(filename, fd, direct_to_ddms);
-  hprof.Dump();
+  {
+    // Need to take a heap dump while GC isn't running. See the comment in Heap::VisitObjects().
+    // Also we need the critical section to avoid visiting the same object twice. See b/34967844
+    gc::ScopedGCCriticalSection gcs(self,
+                                    gc::kGcCauseHprof,
+                                    gc::kCollectorTypeHprof);
+    ScopedSuspendAll ssa(__FUNCTION__, true /* long suspend */);
+    hprof.Dump();
+  }
+  if (!direct_to_ddms) {
+    // The heap dump is in memory now, write it out without holding up the other threads.
+    std::string error_msg;
+    if (!hprof.WriteToFile(&error_msg)) {
+      ScopedObjectAccess soa(self);
+      ThrowRuntimeException("%s", error_msg.c_str());
+      LOG(ERROR) << error_msg;
+    }
+  }
 }
 
 }  // namespace hprof
@@ -26,7 +26,7 @@
 namespace art {
 
 const uint8_t ImageHeader::kImageMagic[] = { 'a', 'r', 't', '\n' };
-const uint8_t ImageHeader::kImageVersion[] = { '0', '5', '6', '\0' };  // ReachabilityFence.
+const uint8_t ImageHeader::kImageVersion[] = { '0', '5', '7', '\0' };  // Compressed blocks.
 
 ImageHeader::ImageHeader(uint32_t image_begin,
                          uint32_t image_size,
@@ -63,7 +63,9 @@ ImageHeader::ImageHeader(uint32_t image_begin,
     compile_pic_(compile_pic),
     is_pic_(is_pic),
     storage_mode_(storage_mode),
-    data_size_(data_size) {
+    data_size_(data_size),
+    blocks_offset_(0U),
+    blocks_count_(0U) {
   CHECK_EQ(image_begin, RoundUp(image_begin, kPageSize));
   CHECK_EQ(oat_file_begin, RoundUp(oat_file_begin, kPageSize));
   CHECK_EQ(oat_data_begin, RoundUp(oat_data_begin, kPageSize));
@@ -111,7 +111,9 @@ class PACKED(4) ImageHeader {
         compile_pic_(0),
         is_pic_(0),
         storage_mode_(kDefaultStorageMode),
-        data_size_(0) {}
+        data_size_(0),
+        blocks_offset_(0U),
+        blocks_count_(0U) {}
 
   ImageHeader(uint32_t image_begin,
               uint32_t image_size,
@@ -321,6 +323,55 @@ class PACKED(4) ImageHeader {
     return data_size_;
   }
 
+  // A range of the image that is compressed independently of the rest, so that the blocks of a
+  // compressed image can be decompressed in parallel.
+  class Block {
+   public:
+    Block(uint32_t data_offset, uint32_t data_size, uint32_t image_offset, uint32_t image_size)
+        : data_offset_(data_offset),
+          data_size_(data_size),
+          image_offset_(image_offset),
+          image_size_(image_size) {}
+
+    uint32_t GetDataOffset() const {
+      return data_offset_;
+    }
+
+    uint32_t GetDataSize() const {
+      return data_size_;
+    }
+
+    uint32_t GetImageOffset() const {
+      return image_offset_;
+    }
+
+    uint32_t GetImageSize() const {
+      return image_size_;
+    }
+
+   private:
+    // Offset and size of the compressed data in the file.
+    uint32_t data_offset_;
+    uint32_t data_size_;
+    // Offset and size of the decompressed data in the image. Offsets include the header.
+    uint32_t image_offset_;
+    uint32_t image_size_;
+  };
+
+  // Offset of the block table in the file. The table is part of the stored data.
+  uint32_t GetBlocksOffset() const {
+    return blocks_offset_;
+  }
+
+  uint32_t GetBlocksCount() const {
+    return blocks_count_;
+  }
+
+  // Return the block table, given the beginning of the mapped image file.
+  const Block* GetBlocks(const uint8_t* image_file_begin) const {
+    return reinterpret_cast<const Block*>(image_file_begin + blocks_offset_);
+  }
+
   bool IsAppImage() const {
     // App images currently require a boot image, if the size is non zero then it is an app image
     // header.
@@ -447,9 +498,13 @@ class PACKED(4) ImageHeader {
   StorageMode storage_mode_;
 
   // Data size for the image data excluding the bitmap and the header. For compressed images, this
-  // is the compressed size in the file.
+  // is the compressed size in the file, including the block table.
   uint32_t data_size_;
 
+  // Table of the compressed blocks of the image data. Both are zero for uncompressed images.
+  uint32_t blocks_offset_;
+  uint32_t blocks_count_;
+
   friend class linker::ImageWriter;
 };
 
@@ -238,6 +238,37 @@ enum InterpreterImplKind {
 
 static constexpr InterpreterImplKind kInterpreterImplKind = kMterpImplKind;
 
+// Runs `shadow_frame` with mterp, single-stepping the instructions mterp does not handle
+// with the switch interpreter.
+static inline JValue ExecuteMterp(Thread* self,
+                                  const CodeItemDataAccessor& accessor,
+                                  ShadowFrame& shadow_frame,
+                                  JValue result_register)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  while (true) {
+    // Mterp does not support all instrumentation/debugging.
+    if (MterpShouldSwitchInterpreters() != 0) {
+      return ExecuteSwitchImpl<false, false>(self, accessor, shadow_frame, result_register,
+                                             false);
+    }
+    bool returned = ExecuteMterpImpl(self,
+                                     accessor.Insns(),
+                                     &shadow_frame,
+                                     &result_register);
+    if (returned) {
+      return result_register;
+    } else {
+      // Mterp didn't like that instruction.  Single-step it with the reference interpreter.
+      result_register = ExecuteSwitchImpl<false, false>(self, accessor, shadow_frame,
+                                                        result_register, true);
+      if (shadow_frame.GetDexPC() == dex::kDexNoIndex) {
+        // Single-stepped a return or an exception not handled locally.  Return to caller.
+        return result_register;
+      }
+    }
+  }
+}
+
 static inline JValue Execute(
     Thread* self,
     const CodeItemDataAccessor& accessor,
@@ -310,28 +341,7 @@ static inline JValue Execute(
         return ExecuteSwitchImpl<false, false>(self, accessor, shadow_frame, result_register,
                                                false);
       } else {
-        while (true) {
-          // Mterp does not support all instrumentation/debugging.
-          if (MterpShouldSwitchInterpreters() != 0) {
-            return ExecuteSwitchImpl<false, false>(self, accessor, shadow_frame, result_register,
-                                                   false);
-          }
-          bool returned = ExecuteMterpImpl(self,
-                                           accessor.Insns(),
-                                           &shadow_frame,
-                                           &result_register);
-          if (returned) {
-            return result_register;
-          } else {
-            // Mterp didn't like that instruction.  Single-step it with the reference interpreter.
-            result_register = ExecuteSwitchImpl<false, false>(self, accessor, shadow_frame,
-                                                              result_register, true);
-            if (shadow_frame.GetDexPC() == dex::kDexNoIndex) {
-              // Single-stepped a return or an exception not handled locally.  Return to caller.
-              return result_register;
-            }
-          }
-        }
+        return ExecuteMterp(self, accessor, shadow_frame, result_register);
       }
     } else {
       DCHECK_EQ(kInterpreterImplKind, kSwitchImplKind);
@@ -641,6 +651,31 @@ void ArtInterpreterToInterpreterBridge(Thread* self,
   self->PopShadowFrame();
 }
 
+void ArtInterpreterToMterpBridge(Thread* self,
+                                 const CodeItemDataAccessor& accessor,
+                                 ShadowFrame* shadow_frame,
+                                 JValue* result) {
+  DCHECK_EQ(kInterpreterImplKind, kMterpImplKind);
+  DCHECK(Runtime::Current()->IsStarted());
+  DCHECK(!Runtime::Current()->IsActiveTransaction());
+  bool implicit_check = !Runtime::Current()->ExplicitStackOverflowChecks();
+  if (UNLIKELY(__builtin_frame_address(0) < self->GetStackEndForInterpreter(implicit_check))) {
+    ThrowStackOverflowError(self);
+    return;
+  }
+
+  self->PushShadowFrame(shadow_frame);
+  ArtMethod* method = shadow_frame->GetMethod();
+  DCHECK(method->SkipAccessChecks());
+  DCheckStaticState(self, method);
+  jit::Jit* jit = Runtime::Current()->GetJit();
+  if (jit != nullptr) {
+    jit->AddSamples(self, method, 1, /* with_backedges */ false);
+  }
+  result->SetJ(ExecuteMterp(self, accessor, *shadow_frame, JValue()).GetJ());
+  self->PopShadowFrame();
+}
+
 void CheckInterpreterAsmConstants() {
   CheckMterpAsmConstants();
 }
@@ -64,6 +64,14 @@ void ArtInterpreterToInterpreterBridge(Thread* self,
                                        JValue* result)
     REQUIRES_SHARED(Locks::mutator_lock_);
 
+// Like ArtInterpreterToInterpreterBridge, for calls from mterp to a method that mterp can run
+// right away: the caller must have checked UseFastInterpreterToInterpreterInvoke.
+void ArtInterpreterToMterpBridge(Thread* self,
+                                 const CodeItemDataAccessor& accessor,
+                                 ShadowFrame* shadow_frame,
+                                 JValue* result)
+    REQUIRES_SHARED(Locks::mutator_lock_);
+
 // One-time sanity check.
 void CheckInterpreterAsmConstants();
 
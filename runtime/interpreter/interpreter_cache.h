@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ART_RUNTIME_INTERPRETER_INTERPRETER_CACHE_H_
+#define ART_RUNTIME_INTERPRETER_INTERPRETER_CACHE_H_
+
+#include <array>
+
+#include "base/atomic.h"
+#include "base/bit_utils.h"
+#include "base/macros.h"
+
+namespace art {
+
+class DexFile;
+
+// Small direct-mapped cache owned by a thread, mapping the address of a dex instruction to
+// what the interpreter resolved for it. The meaning of the value depends on the instruction:
+//   iget/iput: the ArtField*.
+//   invoke-*: the ArtMethod* referenced by the instruction, before virtual or interface dispatch.
+// Only instructions executed without access checks are cached, as resolving them again would
+// give the same result.
+//
+// Compact dex files sharing a data section may share code items, so the same instruction can
+// belong to several dex files and its indices then refer to different fields and methods.
+// Entries therefore also record the dex file of the method the instruction was executed for.
+//
+// Unloading a class loader frees its ArtFields and ArtMethods, and a dex file loaded later may
+// reuse the address of an unloaded one. Unloading therefore calls InvalidateAll, and a cache
+// clears itself on the next lookup when it is older than the last invalidation.
+class InterpreterCache {
+ public:
+  // Number of entries. Must be a power of two.
+  static constexpr size_t kSize = 256;
+
+  InterpreterCache();
+
+  ALWAYS_INLINE bool Get(const void* key, const DexFile* dex_file, /* out */ size_t* value) {
+    if (UNLIKELY(generation_ != global_generation_.LoadAcquire())) {
+      Clear();
+      return false;
+    }
+    const Entry& entry = data_[IndexOf(key)];
+    if (LIKELY(entry.key == key && entry.dex_file == dex_file)) {
+      *value = entry.value;
+      return true;
+    }
+    return false;
+  }
+
+  // Must follow a Get of the same key and dex file that returned false.
+  ALWAYS_INLINE void Set(const void* key, const DexFile* dex_file, size_t value) {
+    Entry& entry = data_[IndexOf(key)];
+    entry.key = key;
+    entry.dex_file = dex_file;
+    entry.value = value;
+  }
+
+  // Invalidate the caches of all threads.
+  static void InvalidateAll() {
+    global_generation_.FetchAndAddSequentiallyConsistent(1u);
+  }
+
+ private:
+  struct Entry {
+    const void* key;
+    const DexFile* dex_file;
+    size_t value;
+  };
+
+  void Clear();
+
+  static ALWAYS_INLINE size_t IndexOf(const void* key) {
+    static_assert(IsPowerOfTwo(kSize), "Size must be a power of two");
+    // Dex instructions are 2-byte aligned.
+    return (reinterpret_cast<uintptr_t>(key) >> 1) & (kSize - 1);
+  }
+
+  static Atomic<uint32_t> global_generation_;
+
+  uint32_t generation_;
+  std::array<Entry, kSize> data_;
+
+  DISALLOW_COPY_AND_ASSIGN(InterpreterCache);
+};
+
+}  // namespace art
+
+#endif  // ART_RUNTIME_INTERPRETER_INTERPRETER_CACHE_H_
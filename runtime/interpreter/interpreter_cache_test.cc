@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "interpreter_cache.h"
+
+#include <memory>
+
+#include "art_method-inl.h"
+#include "class_linker.h"
+#include "common_runtime_test.h"
+#include "dex/art_dex_file_loader.h"
+#include "dex/dex_instruction-inl.h"
+#include "gtest/gtest.h"
+#include "handle_scope-inl.h"
+#include "interpreter_common.h"
+#include "mirror/class-inl.h"
+#include "mirror/class_loader.h"
+#include "scoped_thread_state_change-inl.h"
+
+namespace art {
+
+// The cache only compares dex file pointers, so fake ones are enough here.
+static const DexFile* const kDexFileA = reinterpret_cast<const DexFile*>(0x1000);
+static const DexFile* const kDexFileB = reinterpret_cast<const DexFile*>(0x2000);
+
+TEST(InterpreterCache, GetAndSet) {
+  std::unique_ptr<InterpreterCache> cache(new InterpreterCache());
+  uint16_t insns[2 * InterpreterCache::kSize];
+  size_t value = 0;
+  EXPECT_FALSE(cache->Get(&insns[0], kDexFileA, &value));
+  cache->Set(&insns[0], kDexFileA, 42u);
+  EXPECT_TRUE(cache->Get(&insns[0], kDexFileA, &value));
+  EXPECT_EQ(42u, value);
+  EXPECT_FALSE(cache->Get(&insns[1], kDexFileA, &value));
+
+  // The same instruction in another dex file misses.
+  EXPECT_FALSE(cache->Get(&insns[0], kDexFileB, &value));
+
+  // An instruction mapping to the same entry evicts the previous one.
+  cache->Set(&insns[InterpreterCache::kSize], kDexFileA, 43u);
+  EXPECT_FALSE(cache->Get(&insns[0], kDexFileA, &value));
+  EXPECT_TRUE(cache->Get(&insns[InterpreterCache::kSize], kDexFileA, &value));
+  EXPECT_EQ(43u, value);
+}
+
+TEST(InterpreterCache, InvalidateAll) {
+  std::unique_ptr<InterpreterCache> cache(new InterpreterCache());
+  uint16_t insn = 0;
+  size_t value = 0;
+  cache->Set(&insn, kDexFileA, 42u);
+  InterpreterCache::InvalidateAll();
+  EXPECT_FALSE(cache->Get(&insn, kDexFileA, &value));
+  // The cache is usable again after being cleared.
+  cache->Set(&insn, kDexFileA, 43u);
+  EXPECT_TRUE(cache->Get(&insn, kDexFileA, &value));
+  EXPECT_EQ(43u, value);
+}
+
+class InterpreterCacheTest : public CommonRuntimeTest {};
+
+// Compact dex files in a vdex share one data section, so two dex files of a multidex app can
+// share a code item. Open the same dex file twice over the same memory to get such a pair, and
+// load each in its own class loader, so that the shared invoke refers to a different method in
+// each of them.
+TEST_F(InterpreterCacheTest, SharedCodeItem) {
+  std::unique_ptr<const DexFile> original = OpenTestDexFile("CallChains");
+  ASSERT_TRUE(original != nullptr);
+  const ArtDexFileLoader dex_file_loader;
+  std::vector<const DexFile*> dex_files;
+  for (size_t i = 0; i != 2u; ++i) {
+    std::string error_msg;
+    std::unique_ptr<const DexFile> dex_file = dex_file_loader.Open(
+        original->Begin(),
+        original->Size(),
+        DexFileLoader::GetMultiDexLocation(i, original->GetLocation().c_str()),
+        original->GetLocationChecksum(),
+        /* oat_dex_file */ nullptr,
+        /* verify */ false,
+        /* verify_checksum */ false,
+        &error_msg);
+    ASSERT_TRUE(dex_file != nullptr) << error_msg;
+    dex_files.push_back(dex_file.get());
+    loaded_dex_files_.push_back(std::move(dex_file));
+  }
+  loaded_dex_files_.push_back(std::move(original));
+
+  ScopedObjectAccess soa(Thread::Current());
+  Thread* self = soa.Self();
+  std::vector<ArtMethod*> callers;
+  std::vector<ArtMethod*> callees;
+  for (const DexFile* dex_file : dex_files) {
+    jobject jclass_loader = class_linker_->CreatePathClassLoader(self, { dex_file });
+    StackHandleScope<1> hs(self);
+    Handle<mirror::ClassLoader> class_loader(
+        hs.NewHandle(soa.Decode<mirror::ClassLoader>(jclass_loader)));
+    ObjPtr<mirror::Class> klass = class_linker_->FindClass(self, "LCallChains;", class_loader);
+    ASSERT_TRUE(klass != nullptr);
+    callers.push_back(
+        klass->FindClassMethod("caller", "(Z)Ljava/lang/String;", kRuntimePointerSize));
+    callees.push_back(
+        klass->FindClassMethod("callee", "()Ljava/lang/String;", kRuntimePointerSize));
+    ASSERT_TRUE(callers.back() != nullptr);
+    ASSERT_TRUE(callees.back() != nullptr);
+  }
+  ASSERT_EQ(callers[0]->GetCodeItem(), callers[1]->GetCodeItem());
+  ASSERT_NE(callers[0]->GetDexFile(), callers[1]->GetDexFile());
+  ASSERT_NE(callees[0], callees[1]);
+
+  const Instruction* inst = Instruction::At(callers[0]->DexInstructions().Insns());
+  ASSERT_EQ(Instruction::INVOKE_STATIC, inst->Opcode());
+  const uint32_t method_idx = inst->VRegB_35c();
+  InterpreterCache* cache = self->GetInterpreterCache();
+  // Alternate between the dex files, so that each lookup finds the entry of the other one,
+  // and look up the same one twice in a row, so that the second lookup hits.
+  for (size_t i : { 0u, 1u, 1u, 0u }) {
+    ObjPtr<mirror::Object> receiver = nullptr;
+    EXPECT_EQ(callees[i],
+              (interpreter::FindMethodFromCodeCached<kStatic, /* do_access_check */ false>(
+                  inst, method_idx, &receiver, callers[i], self)));
+    size_t value = 0u;
+    EXPECT_TRUE(cache->Get(inst, dex_files[i], &value));
+    EXPECT_EQ(callees[i], reinterpret_cast<ArtMethod*>(value));
+    EXPECT_FALSE(cache->Get(inst, dex_files[1u - i], &value));
+  }
+}
+
+}  // namespace art
@@ -24,6 +24,7 @@
 #include "entrypoints/runtime_asm_entrypoints.h"
 #include "intrinsics_enum.h"
 #include "jit/jit.h"
+#include "jit/profiling_info.h"
 #include "jvalue.h"
 #include "method_handles-inl.h"
 #include "method_handles.h"
@@ -46,6 +47,37 @@ void ThrowNullPointerExceptionFromInterpreter() {
   ThrowNullPointerExceptionFromDexPC();
 }
 
+// Same as FindFieldFromCode, except that instance fields accessed without access checks are
+// looked up in the interpreter cache of `self` before resolving them.
+template<FindFieldType find_type, bool do_access_check>
+static ALWAYS_INLINE ArtField* FindFieldFromCodeCached(const Instruction* inst,
+                                                       uint32_t field_idx,
+                                                       ArtMethod* referrer,
+                                                       Thread* self,
+                                                       size_t expected_size)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  // Static fields also need their class to be initialized, which resolution takes care of.
+  constexpr bool is_static = (find_type == StaticObjectRead) ||
+                             (find_type == StaticObjectWrite) ||
+                             (find_type == StaticPrimitiveRead) ||
+                             (find_type == StaticPrimitiveWrite);
+  if (do_access_check || is_static) {
+    return FindFieldFromCode<find_type, do_access_check>(field_idx, referrer, self, expected_size);
+  }
+  InterpreterCache* cache = self->GetInterpreterCache();
+  const DexFile* dex_file = referrer->GetDexFile();
+  size_t value;
+  if (LIKELY(cache->Get(inst, dex_file, &value))) {
+    return reinterpret_cast<ArtField*>(value);
+  }
+  ArtField* field =
+      FindFieldFromCode<find_type, do_access_check>(field_idx, referrer, self, expected_size);
+  if (field != nullptr) {
+    cache->Set(inst, dex_file, reinterpret_cast<size_t>(field));
+  }
+  return field;
+}
+
 template<FindFieldType find_type, Primitive::Type field_type, bool do_access_check,
          bool transaction_active>
 bool DoFieldGet(Thread* self, ShadowFrame& shadow_frame, const Instruction* inst,
@@ -53,8 +85,9 @@ bool DoFieldGet(Thread* self, ShadowFrame& shadow_frame, const Instruction* inst
   const bool is_static = (find_type == StaticObjectRead) || (find_type == StaticPrimitiveRead);
   const uint32_t field_idx = is_static ? inst->VRegB_21c() : inst->VRegC_22c();
   ArtField* f =
-      FindFieldFromCode<find_type, do_access_check>(field_idx, shadow_frame.GetMethod(), self,
-                                                    Primitive::ComponentSize(field_type));
+      FindFieldFromCodeCached<find_type, do_access_check>(inst, field_idx, shadow_frame.GetMethod(),
+                                                          self,
+                                                          Primitive::ComponentSize(field_type));
   if (UNLIKELY(f == nullptr)) {
     CHECK(self->IsExceptionPending());
     return false;
@@ -266,8 +299,9 @@ bool DoFieldPut(Thread* self, const ShadowFrame& shadow_frame, const Instruction
   bool is_static = (find_type == StaticObjectWrite) || (find_type == StaticPrimitiveWrite);
   uint32_t field_idx = is_static ? inst->VRegB_21c() : inst->VRegC_22c();
   ArtField* f =
-      FindFieldFromCode<find_type, do_access_check>(field_idx, shadow_frame.GetMethod(), self,
-                                                    Primitive::ComponentSize(field_type));
+      FindFieldFromCodeCached<find_type, do_access_check>(inst, field_idx, shadow_frame.GetMethod(),
+                                                          self,
+                                                          Primitive::ComponentSize(field_type));
   if (UNLIKELY(f == nullptr)) {
     CHECK(self->IsExceptionPending());
     return false;
@@ -1422,6 +1456,78 @@ bool DoCall(ArtMethod* called_method, Thread* self, ShadowFrame& shadow_frame,
       result, number_of_inputs, arg, vregC);
 }
 
+bool UseFastInterpreterToInterpreterInvoke(ArtMethod* called_method) {
+  Runtime* runtime = Runtime::Current();
+  if (!runtime->GetClassLinker()->IsQuickToInterpreterBridge(
+          called_method->GetEntryPointFromQuickCompiledCode())) {
+    return false;
+  }
+  // Mterp runs neither access checks nor native methods, and proxy methods have no code item.
+  if (!called_method->SkipAccessChecks() ||
+      called_method->IsNative() ||
+      called_method->IsProxyMethod()) {
+    return false;
+  }
+  ObjPtr<mirror::Class> declaring_class = called_method->GetDeclaringClass();
+  // String.<init> is rewritten to a StringFactory call by DoCallCommon.
+  if (UNLIKELY(declaring_class->IsStringClass() && called_method->IsConstructor())) {
+    return false;
+  }
+  if (called_method->IsStatic() && !declaring_class->IsInitialized()) {
+    return false;
+  }
+  if (UNLIKELY(runtime->GetInstrumentation()->HasMethodEntryListeners())) {
+    return false;
+  }
+  // Execute may install or synchronously compile the code of the callee.
+  jit::Jit* jit = runtime->GetJit();
+  if (jit != nullptr) {
+    if (jit->JitAtFirstUse()) {
+      return false;
+    }
+    ProfilingInfo* profiling_info = called_method->GetProfilingInfo(kRuntimePointerSize);
+    if (profiling_info != nullptr && profiling_info->GetSavedEntryPoint() != nullptr) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DoFastInterpreterToInterpreterInvoke(ArtMethod* called_method,
+                                          Thread* self,
+                                          ShadowFrame& shadow_frame,
+                                          const Instruction* inst,
+                                          uint16_t inst_data,
+                                          JValue* result) {
+  DCHECK(UseFastInterpreterToInterpreterInvoke(called_method));
+  const uint16_t number_of_inputs = inst->VRegA_35c(inst_data);
+  uint32_t arg[Instruction::kMaxVarArgRegs];
+  inst->GetVarArgs(arg, inst_data);
+
+  CodeItemDataAccessor accessor(called_method->DexInstructionData());
+  const uint16_t num_regs = accessor.RegistersSize();
+  DCHECK_EQ(number_of_inputs, accessor.InsSize());
+  // Parameter registers go at the end of the shadow frame.
+  const size_t first_dest_reg = num_regs - number_of_inputs;
+
+  // Allocate shadow frame on the stack.
+  const char* old_cause =
+      self->StartAssertNoThreadSuspension("DoFastInterpreterToInterpreterInvoke");
+  ShadowFrameAllocaUniquePtr shadow_frame_unique_ptr =
+      CREATE_SHADOW_FRAME(num_regs, &shadow_frame, called_method, /* dex pc */ 0);
+  ShadowFrame* new_shadow_frame = shadow_frame_unique_ptr.get();
+  CopyRegisters<false>(shadow_frame,
+                       new_shadow_frame,
+                       arg,
+                       /* first_src_reg */ 0u,
+                       first_dest_reg,
+                       number_of_inputs);
+  self->EndAssertNoThreadSuspension(old_cause);
+
+  interpreter::ArtInterpreterToMterpBridge(self, accessor, new_shadow_frame, result);
+  return !self->IsExceptionPending();
+}
+
 template <bool is_range, bool do_access_check, bool transaction_active>
 bool DoFilledNewArray(const Instruction* inst,
                       const ShadowFrame& shadow_frame,
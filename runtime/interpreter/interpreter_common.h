@@ -120,6 +120,56 @@ template<bool is_range, bool do_assignability_check>
 bool DoCall(ArtMethod* called_method, Thread* self, ShadowFrame& shadow_frame,
             const Instruction* inst, uint16_t inst_data, JValue* result);
 
+// Same as FindMethodFromCode, except that without access checks the method referenced by
+// `inst` is looked up in the interpreter cache of `self` before resolving it.
+template<InvokeType type, bool do_access_check>
+static ALWAYS_INLINE ArtMethod* FindMethodFromCodeCached(const Instruction* inst,
+                                                         uint32_t method_idx,
+                                                         ObjPtr<mirror::Object>* receiver,
+                                                         ArtMethod* referrer,
+                                                         Thread* self)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  if (do_access_check) {
+    return FindMethodFromCode<type, do_access_check>(method_idx, receiver, referrer, self);
+  }
+  InterpreterCache* cache = self->GetInterpreterCache();
+  const DexFile* dex_file = referrer->GetDexFile();
+  size_t value;
+  ArtMethod* resolved_method;
+  if (LIKELY(cache->Get(inst, dex_file, &value))) {
+    resolved_method = reinterpret_cast<ArtMethod*>(value);
+  } else {
+    ClassLinker* const class_linker = Runtime::Current()->GetClassLinker();
+    StackHandleScope<1> hs(self);
+    HandleWrapperObjPtr<mirror::Object> h_this(hs.NewHandleWrapper(receiver));
+    resolved_method = class_linker->ResolveMethod<ClassLinker::ResolveMode::kNoChecks>(
+        self, method_idx, referrer, type);
+    if (UNLIKELY(resolved_method == nullptr)) {
+      DCHECK(self->IsExceptionPending());
+      return nullptr;
+    }
+    cache->Set(inst, dex_file, reinterpret_cast<size_t>(resolved_method));
+  }
+  return FindMethodToCall<type, false>(method_idx, resolved_method, receiver, referrer, self);
+}
+
+// Returns whether a call from mterp to `called_method` can skip the generic call path and run
+// the callee with mterp right away. This holds for methods without compiled code that mterp
+// can interpret without access checks or class initialization.
+bool UseFastInterpreterToInterpreterInvoke(ArtMethod* called_method)
+    REQUIRES_SHARED(Locks::mutator_lock_);
+
+// Invokes `called_method`, for which UseFastInterpreterToInterpreterInvoke holds, from a
+// non-range invoke instruction in mterp.
+// Returns true on success, otherwise throws an exception and returns false.
+bool DoFastInterpreterToInterpreterInvoke(ArtMethod* called_method,
+                                          Thread* self,
+                                          ShadowFrame& shadow_frame,
+                                          const Instruction* inst,
+                                          uint16_t inst_data,
+                                          JValue* result)
+    REQUIRES_SHARED(Locks::mutator_lock_);
+
 // Handles streamlined non-range invoke static, direct and virtual instructions originating in
 // mterp. Access checks and instrumentation other than jit profiling are not supported, but does
 // support interpreter intrinsics if applicable.
@@ -136,8 +186,8 @@ static inline bool DoFastInvoke(Thread* self,
       ? nullptr
       : shadow_frame.GetVRegReference(vregC);
   ArtMethod* sf_method = shadow_frame.GetMethod();
-  ArtMethod* const called_method = FindMethodFromCode<type, false>(
-      method_idx, &receiver, sf_method, self);
+  ArtMethod* const called_method = FindMethodFromCodeCached<type, false>(
+      inst, method_idx, &receiver, sf_method, self);
   // The shadow frame should already be pushed, so we don't need to update it.
   if (UNLIKELY(called_method == nullptr)) {
     CHECK(self->IsExceptionPending());
@@ -158,6 +208,10 @@ static inline bool DoFastInvoke(Thread* self,
         return !self->IsExceptionPending();
       }
     }
+    if (UseFastInterpreterToInterpreterInvoke(called_method)) {
+      return DoFastInterpreterToInterpreterInvoke(
+          called_method, self, shadow_frame, inst, inst_data, result);
+    }
     return DoCall<false, false>(called_method, self, shadow_frame, inst, inst_data, result);
   }
 }
@@ -179,8 +233,8 @@ static inline bool DoInvoke(Thread* self,
   ObjPtr<mirror::Object> receiver =
       (type == kStatic) ? nullptr : shadow_frame.GetVRegReference(vregC);
   ArtMethod* sf_method = shadow_frame.GetMethod();
-  ArtMethod* const called_method = FindMethodFromCode<type, do_access_check>(
-      method_idx, &receiver, sf_method, self);
+  ArtMethod* const called_method = FindMethodFromCodeCached<type, do_access_check>(
+      inst, method_idx, &receiver, sf_method, self);
   // The shadow frame should already be pushed, so we don't need to update it.
   if (UNLIKELY(called_method == nullptr)) {
     CHECK(self->IsExceptionPending());
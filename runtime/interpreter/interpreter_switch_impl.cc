@@ -109,6 +109,13 @@ namespace interpreter {
     }                                                                                          \
   } while (false)
 
+#define PROFILE_BRANCH(taken)                                                                  \
+  do {                                                                                         \
+    if (jit != nullptr) {                                                                      \
+      jit::Jit::ConditionalBranch(shadow_frame.GetMethod(), dex_pc, taken);                    \
+    }                                                                                          \
+  } while (false)
+
 #define HANDLE_ASYNC_EXCEPTION()                                                               \
   if (UNLIKELY(self->ObserveAsyncException())) {                                               \
     HANDLE_PENDING_EXCEPTION();                                                                \
@@ -891,10 +898,12 @@ void ExecuteSwitchImplCpp(SwitchImplContext* ctx) {
         if (shadow_frame.GetVReg(inst->VRegA_22t(inst_data)) ==
             shadow_frame.GetVReg(inst->VRegB_22t(inst_data))) {
           int16_t offset = inst->VRegC_22t();
+          PROFILE_BRANCH(true);
           BRANCH_INSTRUMENTATION(offset);
           inst = inst->RelativeAt(offset);
           HANDLE_BACKWARD_BRANCH(offset);
         } else {
+          PROFILE_BRANCH(false);
           BRANCH_INSTRUMENTATION(2);
           inst = inst->Next_2xx();
         }
@@ -905,10 +914,12 @@ void ExecuteSwitchImplCpp(SwitchImplContext* ctx) {
         if (shadow_frame.GetVReg(inst->VRegA_22t(inst_data)) !=
             shadow_frame.GetVReg(inst->VRegB_22t(inst_data))) {
           int16_t offset = inst->VRegC_22t();
+          PROFILE_BRANCH(true);
           BRANCH_INSTRUMENTATION(offset);
           inst = inst->RelativeAt(offset);
           HANDLE_BACKWARD_BRANCH(offset);
         } else {
+          PROFILE_BRANCH(false);
           BRANCH_INSTRUMENTATION(2);
           inst = inst->Next_2xx();
         }
@@ -919,10 +930,12 @@ void ExecuteSwitchImplCpp(SwitchImplContext* ctx) {
         if (shadow_frame.GetVReg(inst->VRegA_22t(inst_data)) <
             shadow_frame.GetVReg(inst->VRegB_22t(inst_data))) {
           int16_t offset = inst->VRegC_22t();
+          PROFILE_BRANCH(true);
           BRANCH_INSTRUMENTATION(offset);
           inst = inst->RelativeAt(offset);
           HANDLE_BACKWARD_BRANCH(offset);
         } else {
+          PROFILE_BRANCH(false);
           BRANCH_INSTRUMENTATION(2);
           inst = inst->Next_2xx();
         }
@@ -933,10 +946,12 @@ void ExecuteSwitchImplCpp(SwitchImplContext* ctx) {
         if (shadow_frame.GetVReg(inst->VRegA_22t(inst_data)) >=
             shadow_frame.GetVReg(inst->VRegB_22t(inst_data))) {
           int16_t offset = inst->VRegC_22t();
+          PROFILE_BRANCH(true);
           BRANCH_INSTRUMENTATION(offset);
           inst = inst->RelativeAt(offset);
           HANDLE_BACKWARD_BRANCH(offset);
         } else {
+          PROFILE_BRANCH(false);
           BRANCH_INSTRUMENTATION(2);
           inst = inst->Next_2xx();
         }
@@ -947,10 +962,12 @@ void ExecuteSwitchImplCpp(SwitchImplContext* ctx) {
         if (shadow_frame.GetVReg(inst->VRegA_22t(inst_data)) >
         shadow_frame.GetVReg(inst->VRegB_22t(inst_data))) {
           int16_t offset = inst->VRegC_22t();
+          PROFILE_BRANCH(true);
           BRANCH_INSTRUMENTATION(offset);
           inst = inst->RelativeAt(offset);
           HANDLE_BACKWARD_BRANCH(offset);
         } else {
+          PROFILE_BRANCH(false);
           BRANCH_INSTRUMENTATION(2);
           inst = inst->Next_2xx();
         }
@@ -961,10 +978,12 @@ void ExecuteSwitchImplCpp(SwitchImplContext* ctx) {
         if (shadow_frame.GetVReg(inst->VRegA_22t(inst_data)) <=
             shadow_frame.GetVReg(inst->VRegB_22t(inst_data))) {
           int16_t offset = inst->VRegC_22t();
+          PROFILE_BRANCH(true);
           BRANCH_INSTRUMENTATION(offset);
           inst = inst->RelativeAt(offset);
           HANDLE_BACKWARD_BRANCH(offset);
         } else {
+          PROFILE_BRANCH(false);
           BRANCH_INSTRUMENTATION(2);
           inst = inst->Next_2xx();
         }
@@ -974,10 +993,12 @@ void ExecuteSwitchImplCpp(SwitchImplContext* ctx) {
         PREAMBLE();
         if (shadow_frame.GetVReg(inst->VRegA_21t(inst_data)) == 0) {
           int16_t offset = inst->VRegB_21t();
+          PROFILE_BRANCH(true);
           BRANCH_INSTRUMENTATION(offset);
           inst = inst->RelativeAt(offset);
           HANDLE_BACKWARD_BRANCH(offset);
         } else {
+          PROFILE_BRANCH(false);
           BRANCH_INSTRUMENTATION(2);
           inst = inst->Next_2xx();
         }
@@ -987,10 +1008,12 @@ void ExecuteSwitchImplCpp(SwitchImplContext* ctx) {
         PREAMBLE();
         if (shadow_frame.GetVReg(inst->VRegA_21t(inst_data)) != 0) {
           int16_t offset = inst->VRegB_21t();
+          PROFILE_BRANCH(true);
           BRANCH_INSTRUMENTATION(offset);
           inst = inst->RelativeAt(offset);
           HANDLE_BACKWARD_BRANCH(offset);
         } else {
+          PROFILE_BRANCH(false);
           BRANCH_INSTRUMENTATION(2);
           inst = inst->Next_2xx();
         }
@@ -1000,10 +1023,12 @@ void ExecuteSwitchImplCpp(SwitchImplContext* ctx) {
         PREAMBLE();
         if (shadow_frame.GetVReg(inst->VRegA_21t(inst_data)) < 0) {
           int16_t offset = inst->VRegB_21t();
+          PROFILE_BRANCH(true);
           BRANCH_INSTRUMENTATION(offset);
           inst = inst->RelativeAt(offset);
           HANDLE_BACKWARD_BRANCH(offset);
         } else {
+          PROFILE_BRANCH(false);
           BRANCH_INSTRUMENTATION(2);
           inst = inst->Next_2xx();
         }
@@ -1013,10 +1038,12 @@ void ExecuteSwitchImplCpp(SwitchImplContext* ctx) {
         PREAMBLE();
         if (shadow_frame.GetVReg(inst->VRegA_21t(inst_data)) >= 0) {
           int16_t offset = inst->VRegB_21t();
+          PROFILE_BRANCH(true);
           BRANCH_INSTRUMENTATION(offset);
           inst = inst->RelativeAt(offset);
           HANDLE_BACKWARD_BRANCH(offset);
         } else {
+          PROFILE_BRANCH(false);
           BRANCH_INSTRUMENTATION(2);
           inst = inst->Next_2xx();
         }
@@ -1026,10 +1053,12 @@ void ExecuteSwitchImplCpp(SwitchImplContext* ctx) {
         PREAMBLE();
         if (shadow_frame.GetVReg(inst->VRegA_21t(inst_data)) > 0) {
           int16_t offset = inst->VRegB_21t();
+          PROFILE_BRANCH(true);
           BRANCH_INSTRUMENTATION(offset);
           inst = inst->RelativeAt(offset);
           HANDLE_BACKWARD_BRANCH(offset);
         } else {
+          PROFILE_BRANCH(false);
           BRANCH_INSTRUMENTATION(2);
           inst = inst->Next_2xx();
         }
@@ -1039,10 +1068,12 @@ void ExecuteSwitchImplCpp(SwitchImplContext* ctx) {
         PREAMBLE();
         if (shadow_frame.GetVReg(inst->VRegA_21t(inst_data)) <= 0) {
           int16_t offset = inst->VRegB_21t();
+          PROFILE_BRANCH(true);
           BRANCH_INSTRUMENTATION(offset);
           inst = inst->RelativeAt(offset);
           HANDLE_BACKWARD_BRANCH(offset);
         } else {
+          PROFILE_BRANCH(false);
           BRANCH_INSTRUMENTATION(2);
           inst = inst->Next_2xx();
         }
@@ -1022,6 +1022,11 @@ extern "C" ssize_t MterpAddHotnessBatch(ArtMethod* method,
   return MterpSetUpHotnessCountdown(method, shadow_frame, self);
 }
 
+extern "C" void MterpProfileBranch(ShadowFrame* shadow_frame, int32_t taken)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  jit::Jit::ConditionalBranch(shadow_frame->GetMethod(), shadow_frame->GetDexPC(), taken != 0);
+}
+
 extern "C" size_t MterpMaybeDoOnStackReplacement(Thread* self,
                                                  ShadowFrame* shadow_frame,
                                                  int32_t offset)
@@ -296,6 +296,10 @@ void RemoveNativeDebugInfoForJit(const void* handle) {
   }
 }
 
+bool HasNativeDebugInfoForJit(const void* handle) {
+  return __jit_debug_entries.find(handle) != __jit_debug_entries.end();
+}
+
 size_t GetJitNativeDebugInfoMemUsage() {
   return __jit_debug_mem_usage + __jit_debug_entries.size() * 2 * sizeof(void*);
 }
@@ -44,6 +44,10 @@ void AddNativeDebugInfoForJit(const void* handle, const std::vector<uint8_t>& sy
 void RemoveNativeDebugInfoForJit(const void* handle)
     REQUIRES(Locks::native_debug_interface_lock_);
 
+// Returns whether native debug info was added for the JITed code with the given handle.
+bool HasNativeDebugInfoForJit(const void* handle)
+    REQUIRES(Locks::native_debug_interface_lock_);
+
 // Returns approximate memory used by all JITCodeEntries.
 size_t GetJitNativeDebugInfoMemUsage()
     REQUIRES(Locks::native_debug_interface_lock_);
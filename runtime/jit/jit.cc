@@ -57,7 +57,7 @@ void* Jit::jit_library_handle_ = nullptr;
 void* Jit::jit_compiler_handle_ = nullptr;
 void* (*Jit::jit_load_)(bool*) = nullptr;
 void (*Jit::jit_unload_)(void*) = nullptr;
-bool (*Jit::jit_compile_method_)(void*, ArtMethod*, Thread*, bool) = nullptr;
+bool (*Jit::jit_compile_method_)(void*, ArtMethod*, Thread*, bool, bool) = nullptr;
 void (*Jit::jit_types_loaded_)(void*, mirror::Class**, size_t count) = nullptr;
 bool Jit::generate_debug_info_ = false;
 
@@ -142,6 +142,26 @@ JitOptions* JitOptions::CreateFromRuntimeArguments(const RuntimeArgumentMap& opt
         static_cast<size_t>(1));
   }
 
+  jit_options->use_tiered_jit_compilation_ =
+      options.GetOrDefault(RuntimeArgumentMap::UseTieredJitCompilation);
+  if (jit_options->use_tiered_jit_compilation_ && kRuntimeISA != InstructionSet::kX86_64) {
+    // Only the x86-64 code generator emits the hotness check of baseline code.
+    LOG(WARNING) << "Tiered JIT compilation is not supported on " << kRuntimeISA;
+    jit_options->use_tiered_jit_compilation_ = false;
+  }
+
+  if (options.Exists(RuntimeArgumentMap::JITOptimizeThreshold)) {
+    jit_options->optimize_threshold_ = *options.Get(RuntimeArgumentMap::JITOptimizeThreshold);
+    if (jit_options->optimize_threshold_ > std::numeric_limits<uint16_t>::max()) {
+      LOG(FATAL) << "Method optimize threshold is above its internal limit.";
+    } else if (jit_options->optimize_threshold_ == 0) {
+      LOG(FATAL) << "Method optimize threshold cannot be 0.";
+    }
+  } else {
+    jit_options->optimize_threshold_ = std::max(jit_options->compile_threshold_,
+                                                static_cast<size_t>(1));
+  }
+
   return jit_options;
 }
 
@@ -152,6 +172,11 @@ bool Jit::ShouldUsePriorityThreadWeight(Thread* self) {
 void Jit::DumpInfo(std::ostream& os) {
   code_cache_->Dump(os);
   cumulative_timings_.Dump(os);
+  for (size_t i = 0; i <= static_cast<size_t>(DeoptimizationKind::kLast); ++i) {
+    os << "Number of deoptimizations from "
+       << GetDeoptimizationKindName(static_cast<DeoptimizationKind>(i)) << ": "
+       << deoptimizations_[i].LoadRelaxed() << "\n";
+  }
   MutexLock mu(Thread::Current(), lock_);
   memory_use_.PrintMemoryUse(os);
 }
@@ -174,7 +199,9 @@ Jit::Jit() : dump_info_on_shutdown_(false),
              warm_method_threshold_(0),
              osr_method_threshold_(0),
              priority_thread_weight_(0),
-             invoke_transition_weight_(0) {}
+             invoke_transition_weight_(0),
+             use_tiered_jit_compilation_(false),
+             optimize_method_threshold_(0) {}
 
 Jit* Jit::Create(JitOptions* options, std::string* error_msg) {
   DCHECK(options->UseJitCompilation() || options->GetProfileSaverOptions().IsEnabled());
@@ -199,6 +226,7 @@ Jit* Jit::Create(JitOptions* options, std::string* error_msg) {
       << PrettySize(options->GetCodeCacheInitialCapacity())
       << ", max_capacity=" << PrettySize(options->GetCodeCacheMaxCapacity())
       << ", compile_threshold=" << options->GetCompileThreshold()
+      << ", tiered=" << std::boolalpha << options->UseTieredJitCompilation()
       << ", profile_saver_options=" << options->GetProfileSaverOptions();
 
 
@@ -207,6 +235,8 @@ Jit* Jit::Create(JitOptions* options, std::string* error_msg) {
   jit->osr_method_threshold_ = options->GetOsrThreshold();
   jit->priority_thread_weight_ = options->GetPriorityThreadWeight();
   jit->invoke_transition_weight_ = options->GetInvokeTransitionWeight();
+  jit->use_tiered_jit_compilation_ = options->UseTieredJitCompilation();
+  jit->optimize_method_threshold_ = options->GetOptimizeThreshold();
 
   jit->CreateThreadPool();
 
@@ -237,7 +267,7 @@ bool Jit::LoadCompilerLibrary(std::string* error_msg) {
     *error_msg = "JIT couldn't find jit_unload entry point";
     return false;
   }
-  jit_compile_method_ = reinterpret_cast<bool (*)(void*, ArtMethod*, Thread*, bool)>(
+  jit_compile_method_ = reinterpret_cast<bool (*)(void*, ArtMethod*, Thread*, bool, bool)>(
       dlsym(jit_library_handle_, "jit_compile_method"));
   if (jit_compile_method_ == nullptr) {
     dlclose(jit_library_handle_);
@@ -271,9 +301,10 @@ bool Jit::LoadCompiler(std::string* error_msg) {
   return true;
 }
 
-bool Jit::CompileMethod(ArtMethod* method, Thread* self, bool osr) {
+bool Jit::CompileMethod(ArtMethod* method, Thread* self, bool osr, bool baseline) {
   DCHECK(Runtime::Current()->UseJitCompilation());
   DCHECK(!method->IsRuntimeMethod());
+  DCHECK(!baseline || (!osr && !method->IsNative()));
 
   RuntimeCallbacks* cb = Runtime::Current()->GetRuntimeCallbacks();
   // Don't compile the method if it has breakpoints.
@@ -294,14 +325,33 @@ bool Jit::CompileMethod(ArtMethod* method, Thread* self, bool osr) {
   // If we get a request to compile a proxy method, we pass the actual Java method
   // of that proxy method, as the compiler does not expect a proxy method.
   ArtMethod* method_to_compile = method->GetInterfaceMethodIfProxy(kRuntimePointerSize);
-  if (!code_cache_->NotifyCompilationOf(method_to_compile, self, osr)) {
+  if (!code_cache_->NotifyCompilationOf(method_to_compile, self, osr, baseline)) {
     return false;
   }
 
+  ProfilingInfo* info = method_to_compile->GetProfilingInfo(kRuntimePointerSize);
+  if (baseline) {
+    // Set up the state baseline code relies on before it can run. The code counts
+    // its entries down from the optimize threshold.
+    info->SetBaselineHotnessCount(optimize_method_threshold_);
+    info->SetHasBaselineCode(true);
+  }
+
   VLOG(jit) << "Compiling method "
             << ArtMethod::PrettyMethod(method_to_compile)
-            << " osr=" << std::boolalpha << osr;
-  bool success = jit_compile_method_(jit_compiler_handle_, method_to_compile, self, osr);
+            << " osr=" << std::boolalpha << osr
+            << " baseline=" << std::boolalpha << baseline;
+  bool success =
+      jit_compile_method_(jit_compiler_handle_, method_to_compile, self, osr, baseline);
+  if (!osr && info != nullptr) {
+    if (success && !baseline) {
+      // The optimized code replaced the baseline code.
+      info->SetHasBaselineCode(false);
+    } else if (!success && baseline) {
+      // No baseline code was installed, so nothing can ask for an optimized compilation.
+      info->SetHasBaselineCode(false);
+    }
+  }
   code_cache_->DoneCompiling(method_to_compile, self, osr);
   if (!success) {
     VLOG(jit) << "Failed to compile method "
@@ -598,7 +648,9 @@ class JitCompileTask FINAL : public Task {
   enum TaskKind {
     kAllocateProfile,
     kCompile,
-    kCompileOsr
+    kCompileBaseline,
+    kCompileOsr,
+    kCompileFromProfile
   };
 
   JitCompileTask(ArtMethod* method, TaskKind kind) : method_(method), kind_(kind) {
@@ -616,9 +668,21 @@ class JitCompileTask FINAL : public Task {
   void Run(Thread* self) OVERRIDE {
     ScopedObjectAccess soa(self);
     if (kind_ == kCompile) {
-      Runtime::Current()->GetJit()->CompileMethod(method_, self, /* osr */ false);
+      Runtime::Current()->GetJit()->CompileMethod(
+          method_, self, /* osr */ false, /* baseline */ false);
+    } else if (kind_ == kCompileBaseline) {
+      Runtime::Current()->GetJit()->CompileMethod(
+          method_, self, /* osr */ false, /* baseline */ true);
     } else if (kind_ == kCompileOsr) {
-      Runtime::Current()->GetJit()->CompileMethod(method_, self, /* osr */ true);
+      Runtime::Current()->GetJit()->CompileMethod(
+          method_, self, /* osr */ true, /* baseline */ false);
+    } else if (kind_ == kCompileFromProfile) {
+      // The method may not have been warm in this run, but the compiler needs a ProfilingInfo.
+      if (method_->GetProfilingInfo(kRuntimePointerSize) != nullptr ||
+          ProfilingInfo::Create(self, method_, /* retry_allocation */ true)) {
+        Runtime::Current()->GetJit()->CompileMethod(
+            method_, self, /* osr */ false, /* baseline */ false);
+      }
     } else {
       DCHECK(kind_ == kAllocateProfile);
       if (ProfilingInfo::Create(self, method_, /* retry_allocation */ true)) {
@@ -696,7 +760,12 @@ void Jit::AddSamples(Thread* self, ArtMethod* method, uint16_t count, bool with_
       if ((new_count >= hot_method_threshold_) &&
           !code_cache_->ContainsPc(method->GetEntryPointFromQuickCompiledCode())) {
         DCHECK(thread_pool_ != nullptr);
-        thread_pool_->AddTask(self, new JitCompileTask(method, JitCompileTask::kCompile));
+        // With tiered compilation, hot methods first get baseline code, which asks for
+        // the optimized compilation itself once it has been entered often enough.
+        JitCompileTask::TaskKind kind = (use_tiered_jit_compilation_ && !method->IsNative())
+            ? JitCompileTask::kCompileBaseline
+            : JitCompileTask::kCompile;
+        thread_pool_->AddTask(self, new JitCompileTask(method, kind));
       }
       // Avoid jumping more than one state at a time.
       new_count = std::min(new_count, osr_method_threshold_ - 1);
@@ -739,6 +808,48 @@ void Jit::MethodEntered(Thread* thread, ArtMethod* method) {
   }
 }
 
+void Jit::EnqueueOptimizedCompilation(ArtMethod* method, Thread* self) {
+  if (thread_pool_ == nullptr) {
+    // Should only see this when shutting down.
+    DCHECK(Runtime::Current()->IsShuttingDown(self));
+    return;
+  }
+  ProfilingInfo* info = method->GetProfilingInfo(kRuntimePointerSize);
+  if (info == nullptr || !info->HasBaselineCode() || info->IsMethodBeingCompiled(/* osr */ false)) {
+    return;
+  }
+  VLOG(jit) << "Baseline code of " << method->PrettyMethod() << " asks for optimized code";
+  thread_pool_->AddTask(self, new JitCompileTask(method, JitCompileTask::kCompile));
+}
+
+bool Jit::EnqueueCompilationFromProfile(ArtMethod* method, Thread* self) {
+  if (thread_pool_ == nullptr) {
+    // Should only see this when shutting down.
+    DCHECK(Runtime::Current()->IsShuttingDown(self));
+    return false;
+  }
+  if (!use_jit_compilation_ ||
+      hot_method_threshold_ == 0 ||
+      method->IsNative() ||
+      method->IsClassInitializer() ||
+      !method->IsCompilable()) {
+    return false;
+  }
+  // Methods past the hot threshold have already been queued by AddSamples.
+  if (method->GetCounter() >= hot_method_threshold_ ||
+      code_cache_->ContainsPc(method->GetEntryPointFromQuickCompiledCode()) ||
+      method->GetOatMethodQuickCode(kRuntimePointerSize) != nullptr) {
+    return false;
+  }
+  // Make the method look hot, so that AddSamples does not queue it a second time and
+  // moves on towards OSR.
+  method->SetCounter(hot_method_threshold_);
+  VLOG(jit) << "Queueing " << method->PrettyMethod() << " from the profile";
+  thread_pool_->AddLowPriorityTask(
+      self, new JitCompileTask(method, JitCompileTask::kCompileFromProfile));
+  return true;
+}
+
 bool Jit::AddJniTask(Thread* self, JniTask* task) {
   if (thread_pool_ == nullptr) {
     return false;
@@ -759,6 +870,36 @@ void Jit::InvokeVirtualOrInterface(ObjPtr<mirror::Object> this_object,
   }
 }
 
+void Jit::ConditionalBranch(ArtMethod* method, uint32_t dex_pc, bool taken) {
+  ScopedAssertNoThreadSuspension ants(__FUNCTION__);
+  ProfilingInfo* info = method->GetProfilingInfo(kRuntimePointerSize);
+  if (info != nullptr) {
+    info->AddBranchInfo(dex_pc, taken);
+  }
+}
+
+void Jit::AddDeoptimization(ArtMethod* method, uint32_t dex_pc, DeoptimizationKind kind) {
+  deoptimizations_[static_cast<size_t>(kind)].FetchAndAddRelaxed(1u);
+  if (kind == DeoptimizationKind::kUntakenBranch) {
+    // The OSR code that pruned the branch has been invalidated. Let back edges trigger a new
+    // OSR compilation, which will see the branch taken in the profile and keep it.
+    if (method->GetCounter() > hot_method_threshold_) {
+      method->SetCounter(hot_method_threshold_);
+    }
+    return;
+  }
+  if (kind != DeoptimizationKind::kJitInlineCache &&
+      kind != DeoptimizationKind::kJitSameTarget &&
+      kind != DeoptimizationKind::kAotInlineCache) {
+    return;
+  }
+  ScopedAssertNoThreadSuspension ants(__FUNCTION__);
+  ProfilingInfo* info = method->GetProfilingInfo(kRuntimePointerSize);
+  if (info != nullptr) {
+    info->AddDeoptimizationInfo(dex_pc);
+  }
+}
+
 void Jit::WaitForCompilationToFinish(Thread* self) {
   if (thread_pool_ != nullptr) {
     thread_pool_->Wait(self, false, false);
@@ -21,6 +21,7 @@
 #include "base/macros.h"
 #include "base/mutex.h"
 #include "base/timing_logger.h"
+#include "deoptimization_kind.h"
 #include "jit/profile_saver_options.h"
 #include "obj_ptr.h"
 #include "thread_pool.h"
@@ -55,7 +56,9 @@ class Jit {
 
   virtual ~Jit();
   static Jit* Create(JitOptions* options, std::string* error_msg);
-  bool CompileMethod(ArtMethod* method, Thread* self, bool osr)
+  // Compile `method`. With `baseline`, the compiler produces quickly compiled code
+  // that requests an optimized compilation of the method once it is hot enough.
+  bool CompileMethod(ArtMethod* method, Thread* self, bool osr, bool baseline)
       REQUIRES_SHARED(Locks::mutator_lock_);
   void CreateThreadPool();
 
@@ -94,6 +97,16 @@ class Jit {
     return priority_thread_weight_;
   }
 
+  bool UseTieredJitCompilation() const {
+    return use_tiered_jit_compilation_;
+  }
+
+  // Number of entries into baseline compiled code before it asks for an optimized
+  // compilation of the method.
+  uint16_t OptimizeMethodThreshold() const {
+    return optimize_method_threshold_;
+  }
+
   // Returns false if we only need to save profile information and not compile methods.
   bool UseJitCompilation() const {
     return use_jit_compilation_;
@@ -119,6 +132,32 @@ class Jit {
                                 ArtMethod* callee)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Record the outcome of the conditional branch at `dex_pc` of `method`.
+  static void ConditionalBranch(ArtMethod* method, uint32_t dex_pc, bool taken)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // Record that compiled code deoptimized with `kind` at `dex_pc` of `method`, the
+  // innermost method of the deoptimized frame. Speculations on an inline cache that
+  // led to a deoptimization are not attempted again.
+  void AddDeoptimization(ArtMethod* method, uint32_t dex_pc, DeoptimizationKind kind)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // Returns how many deoptimizations of `kind` AddDeoptimization() recorded.
+  uint32_t GetNumberOfDeoptimizations(DeoptimizationKind kind) const {
+    return deoptimizations_[static_cast<size_t>(kind)].LoadRelaxed();
+  }
+
+  // Called by baseline compiled code of `method` once it reached the optimize threshold.
+  void EnqueueOptimizedCompilation(ArtMethod* method, Thread* self)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // Called by the profile saver for a loaded `method` that a profile from a previous run
+  // recorded as hot. Compiles the method at low priority if it has neither AOT nor JIT code,
+  // instead of waiting for it to reach the hotness threshold again. Returns whether a
+  // compilation was queued.
+  bool EnqueueCompilationFromProfile(ArtMethod* method, Thread* self)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   void NotifyInterpreterToCompiledCodeTransition(Thread* self, ArtMethod* caller)
       REQUIRES_SHARED(Locks::mutator_lock_) {
     AddSamples(self, caller, invoke_transition_weight_, false);
@@ -188,7 +227,7 @@ class Jit {
   static void* jit_compiler_handle_;
   static void* (*jit_load_)(bool*);
   static void (*jit_unload_)(void*);
-  static bool (*jit_compile_method_)(void*, ArtMethod*, Thread*, bool);
+  static bool (*jit_compile_method_)(void*, ArtMethod*, Thread*, bool, bool);
   static void (*jit_types_loaded_)(void*, mirror::Class**, size_t count);
 
   // Performance monitoring.
@@ -196,6 +235,7 @@ class Jit {
   CumulativeLogger cumulative_timings_;
   Histogram<uint64_t> memory_use_ GUARDED_BY(lock_);
   Mutex lock_ DEFAULT_MUTEX_ACQUIRED_AFTER;
+  Atomic<uint32_t> deoptimizations_[static_cast<size_t>(DeoptimizationKind::kLast) + 1];
 
   std::unique_ptr<jit::JitCodeCache> code_cache_;
 
@@ -207,6 +247,8 @@ class Jit {
   uint16_t osr_method_threshold_;
   uint16_t priority_thread_weight_;
   uint16_t invoke_transition_weight_;
+  bool use_tiered_jit_compilation_;
+  uint16_t optimize_method_threshold_;
   std::unique_ptr<ThreadPool> thread_pool_;
 
   DISALLOW_COPY_AND_ASSIGN(Jit);
@@ -230,6 +272,12 @@ class JitOptions {
   size_t GetInvokeTransitionWeight() const {
     return invoke_transition_weight_;
   }
+  bool UseTieredJitCompilation() const {
+    return use_tiered_jit_compilation_;
+  }
+  size_t GetOptimizeThreshold() const {
+    return optimize_threshold_;
+  }
   size_t GetCodeCacheInitialCapacity() const {
     return code_cache_initial_capacity_;
   }
@@ -275,6 +323,8 @@ class JitOptions {
   size_t osr_threshold_;
   uint16_t priority_thread_weight_;
   size_t invoke_transition_weight_;
+  bool use_tiered_jit_compilation_;
+  size_t optimize_threshold_;
   bool dump_info_on_shutdown_;
   ProfileSaverOptions profile_saver_options_;
 
@@ -287,6 +337,8 @@ class JitOptions {
         osr_threshold_(0),
         priority_thread_weight_(0),
         invoke_transition_weight_(0),
+        use_tiered_jit_compilation_(false),
+        optimize_threshold_(0),
         dump_info_on_shutdown_(false) {}
 
   DISALLOW_COPY_AND_ASSIGN(JitOptions);
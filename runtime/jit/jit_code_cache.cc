@@ -199,12 +199,17 @@ JitCodeCache* JitCodeCache::Create(size_t initial_capacity,
   // We could do PC-relative addressing to avoid this problem, but that
   // would require reserving code and data area before submitting, which
   // means more windows for the code memory to be RWX.
-  std::unique_ptr<MemMap> data_map(MemMap::MapAnonymous(
+  // In huge page mode, align the map and its data/code divider on huge pages.
+  const size_t alignment = MemMap::GetHugePageAlignment();
+  if (MemMap::UseHugePages()) {
+    max_capacity = RoundUp(max_capacity, 2 * alignment);
+  }
+  std::unique_ptr<MemMap> data_map(MemMap::MapAnonymousAligned(
       "data-code-cache", nullptr,
       max_capacity,
+      alignment,
       kProtData,
       /* low_4gb */ true,
-      /* reuse */ false,
       &error_str,
       use_ashmem));
   if (data_map == nullptr) {
@@ -237,6 +242,8 @@ JitCodeCache* JitCodeCache::Create(size_t initial_capacity,
     return nullptr;
   }
   DCHECK_EQ(code_map->Begin(), divider);
+  data_map->MadviseHugePages();
+  code_map->MadviseHugePages();
   data_size = initial_capacity / 2;
   code_size = initial_capacity - data_size;
   DCHECK_EQ(code_size + data_size, initial_capacity);
@@ -274,6 +281,10 @@ JitCodeCache::JitCodeCache(MemMap* code_map,
       number_of_compilations_(0),
       number_of_osr_compilations_(0),
       number_of_collections_(0),
+      number_of_fragmented_allocation_failures_(0),
+      compact_code_on_next_collection_(false),
+      number_of_compactions_(0),
+      number_of_relocated_methods_(0),
       histogram_stack_map_memory_use_("Memory used for stack maps", 16),
       histogram_code_memory_use_("Memory used for compiled code", 16),
       histogram_profiling_info_memory_use_("Memory used for profiling info", 16),
@@ -533,6 +544,11 @@ static inline void ProcessWeakClass(GcRoot<mirror::Class>* root_ptr,
 void JitCodeCache::SweepRootTables(IsMarkedVisitor* visitor) {
   MutexLock mu(Thread::Current(), lock_);
   for (const auto& entry : method_code_map_) {
+    auto relocated_it = relocated_code_.find(entry.first);
+    if (relocated_it != relocated_code_.end() && relocated_it->second < entry.first) {
+      // The roots are shared with the lower copy of the code, which sweeps them.
+      continue;
+    }
     uint32_t number_of_roots = 0;
     uint8_t* roots_data = GetRootTable(entry.first, &number_of_roots);
     GcRoot<mirror::Object>* roots = reinterpret_cast<GcRoot<mirror::Object>*>(roots_data);
@@ -576,7 +592,12 @@ void JitCodeCache::FreeCode(const void* code_ptr) {
   // It does nothing if we are not using native debugger.
   MutexLock mu(Thread::Current(), *Locks::native_debug_interface_lock_);
   RemoveNativeDebugInfoForJit(code_ptr);
-  if (OatQuickMethodHeader::FromCodePointer(code_ptr)->IsOptimized()) {
+  auto relocated_it = relocated_code_.find(code_ptr);
+  if (relocated_it != relocated_code_.end()) {
+    // The other copy of the code still uses the data, and frees it when it is freed.
+    relocated_code_.erase(relocated_it->second);
+    relocated_code_.erase(relocated_it);
+  } else if (OatQuickMethodHeader::FromCodePointer(code_ptr)->IsOptimized()) {
     FreeData(GetRootTable(code_ptr));
   }  // else this is a JNI stub without any data.
   FreeCode(reinterpret_cast<uint8_t*>(allocation));
@@ -1348,6 +1369,13 @@ void JitCodeCache::DoCollection(Thread* self, bool collect_profiling_info) {
       // Also remove the saved entry point from the ProfilingInfo objects.
       for (ProfilingInfo* info : profiling_infos_) {
         const void* ptr = info->GetMethod()->GetEntryPointFromQuickCompiledCode();
+        if (!ContainsPc(ptr) && !info->IsMethodBeingCompiled(/* osr */ false)) {
+          // The method is back in the interpreter and its code is about to be freed.
+          info->SetHasBaselineCode(false);
+        }
+        // Baseline code still running on a thread stack loads the info through the
+        // ArtMethod, so clearing the pointer here, before the checkpoint below, keeps
+        // that code from touching the info once it is freed.
         if (!ContainsPc(ptr) && !info->IsInUseByCompiler()) {
           info->GetMethod()->SetProfilingInfo(nullptr);
         }
@@ -1390,6 +1418,12 @@ void JitCodeCache::DoCollection(Thread* self, bool collect_profiling_info) {
       }
     }
 
+    // Move the live code down to fill the holes left by previous collections. The old
+    // copies are not marked, so the collection frees them unless they are on a thread stack.
+    if (ShouldCompactCode()) {
+      CompactCode();
+    }
+
     // Empty osr method map, as osr compiled code will be deleted (except the ones
     // on thread stacks).
     osr_code_map_.clear();
@@ -1533,6 +1567,7 @@ OatQuickMethodHeader* JitCodeCache::LookupOsrMethodHeader(ArtMethod* method) {
 ProfilingInfo* JitCodeCache::AddProfilingInfo(Thread* self,
                                               ArtMethod* method,
                                               const std::vector<uint32_t>& entries,
+                                              const std::vector<uint32_t>& branch_entries,
                                               bool retry_allocation)
     // No thread safety analysis as we are using TryLock/Unlock explicitly.
     NO_THREAD_SAFETY_ANALYSIS {
@@ -1541,19 +1576,19 @@ ProfilingInfo* JitCodeCache::AddProfilingInfo(Thread* self,
     // If we are allocating for the interpreter, just try to lock, to avoid
     // lock contention with the JIT.
     if (lock_.ExclusiveTryLock(self)) {
-      info = AddProfilingInfoInternal(self, method, entries);
+      info = AddProfilingInfoInternal(self, method, entries, branch_entries);
       lock_.ExclusiveUnlock(self);
     }
   } else {
     {
       MutexLock mu(self, lock_);
-      info = AddProfilingInfoInternal(self, method, entries);
+      info = AddProfilingInfoInternal(self, method, entries, branch_entries);
     }
 
     if (info == nullptr) {
       GarbageCollectCache(self);
       MutexLock mu(self, lock_);
-      info = AddProfilingInfoInternal(self, method, entries);
+      info = AddProfilingInfoInternal(self, method, entries, branch_entries);
     }
   }
   return info;
@@ -1561,9 +1596,10 @@ ProfilingInfo* JitCodeCache::AddProfilingInfo(Thread* self,
 
 ProfilingInfo* JitCodeCache::AddProfilingInfoInternal(Thread* self ATTRIBUTE_UNUSED,
                                                       ArtMethod* method,
-                                                      const std::vector<uint32_t>& entries) {
+                                                      const std::vector<uint32_t>& entries,
+                                                      const std::vector<uint32_t>& branch_entries) {
   size_t profile_info_size = RoundUp(
-      sizeof(ProfilingInfo) + sizeof(InlineCache) * entries.size(),
+      ProfilingInfo::ComputeSize(entries.size(), branch_entries.size()),
       sizeof(void*));
 
   // Check whether some other thread has concurrently created it.
@@ -1576,7 +1612,7 @@ ProfilingInfo* JitCodeCache::AddProfilingInfoInternal(Thread* self ATTRIBUTE_UNU
   if (data == nullptr) {
     return nullptr;
   }
-  info = new (data) ProfilingInfo(method, entries);
+  info = new (data) ProfilingInfo(method, entries, branch_entries);
 
   // Make sure other threads see the data in the profiling info object before the
   // store in the ArtMethod's ProfilingInfo pointer.
@@ -1694,9 +1730,15 @@ bool JitCodeCache::IsOsrCompiled(ArtMethod* method) {
   return osr_code_map_.find(method) != osr_code_map_.end();
 }
 
-bool JitCodeCache::NotifyCompilationOf(ArtMethod* method, Thread* self, bool osr) {
+bool JitCodeCache::NotifyCompilationOf(ArtMethod* method,
+                                       Thread* self,
+                                       bool osr,
+                                       bool baseline) {
   if (!osr && ContainsPc(method->GetEntryPointFromQuickCompiledCode())) {
-    return false;
+    ProfilingInfo* info = method->GetProfilingInfo(kRuntimePointerSize);
+    if (baseline || info == nullptr || !info->HasBaselineCode()) {
+      return false;
+    }
   }
 
   MutexLock mu(self, lock_);
@@ -1812,6 +1854,9 @@ void JitCodeCache::InvalidateCompiledCodeFor(ArtMethod* method,
     Runtime::Current()->GetInstrumentation()->UpdateMethodsCode(
         method, GetQuickToInterpreterBridge());
     ClearMethodCounter(method, /*was_warm*/ profiling_info != nullptr);
+    if (profiling_info != nullptr) {
+      profiling_info->SetHasBaselineCode(false);
+    }
   } else {
     MutexLock mu(Thread::Current(), lock_);
     auto it = osr_code_map_.find(method);
@@ -1826,6 +1871,10 @@ uint8_t* JitCodeCache::AllocateCode(size_t code_size) {
   size_t alignment = GetInstructionSetAlignment(kRuntimeISA);
   uint8_t* result = reinterpret_cast<uint8_t*>(
       mspace_memalign(code_mspace_, alignment, code_size));
+  if (result == nullptr) {
+    RecordAllocationFailure(code_mspace_, code_size);
+    return nullptr;
+  }
   size_t header_size = RoundUp(sizeof(OatQuickMethodHeader), alignment);
   // Ensure the header ends up at expected instruction alignment.
   DCHECK_ALIGNED_PARAM(reinterpret_cast<uintptr_t>(result + header_size), alignment);
@@ -1840,6 +1889,10 @@ void JitCodeCache::FreeCode(uint8_t* code) {
 
 uint8_t* JitCodeCache::AllocateData(size_t data_size) {
   void* result = mspace_malloc(data_mspace_, data_size);
+  if (result == nullptr) {
+    RecordAllocationFailure(data_mspace_, data_size);
+    return nullptr;
+  }
   used_memory_for_data_ += mspace_usable_size(result);
   return reinterpret_cast<uint8_t*>(result);
 }
@@ -1849,6 +1902,154 @@ void JitCodeCache::FreeData(uint8_t* data) {
   mspace_free(data_mspace_, data);
 }
 
+// Free memory of a code cache space, gathered to measure its fragmentation.
+struct FreeChunkStats {
+  size_t free_bytes = 0u;
+  size_t number_of_free_chunks = 0u;
+  size_t largest_free_chunk = 0u;
+
+  void AddFreeChunk(size_t size) {
+    free_bytes += size;
+    ++number_of_free_chunks;
+    largest_free_chunk = std::max(largest_free_chunk, size);
+  }
+};
+
+static void FreeChunkStatsCallback(void* start, void* end, size_t used_bytes, void* arg) {
+  if (used_bytes != 0) {
+    return;
+  }
+  FreeChunkStats* stats = reinterpret_cast<FreeChunkStats*>(arg);
+  stats->AddFreeChunk(reinterpret_cast<uint8_t*>(end) - reinterpret_cast<uint8_t*>(start));
+}
+
+static FreeChunkStats GetFreeChunkStats(void* mspace) {
+  FreeChunkStats stats;
+  mspace_inspect_all(mspace, FreeChunkStatsCallback, &stats);
+  // The space can still grow up to its footprint limit. Count that as one more chunk, which
+  // is only an approximation as it may extend the free chunk at the end of the space.
+  size_t footprint = mspace_footprint(mspace);
+  size_t footprint_limit = mspace_footprint_limit(mspace);
+  if (footprint_limit > footprint) {
+    stats.AddFreeChunk(footprint_limit - footprint);
+  }
+  return stats;
+}
+
+void JitCodeCache::RecordAllocationFailure(void* mspace, size_t size) {
+  FreeChunkStats stats = GetFreeChunkStats(mspace);
+  if (stats.free_bytes >= size) {
+    ++number_of_fragmented_allocation_failures_;
+    if (mspace == code_mspace_) {
+      compact_code_on_next_collection_ = true;
+    }
+    VLOG(jit) << "Failed to allocate " << PrettySize(size) << " in the "
+              << ((mspace == code_mspace_) ? "code" : "data") << " cache with "
+              << PrettySize(stats.free_bytes) << " free in " << stats.number_of_free_chunks
+              << " chunks, the largest being " << PrettySize(stats.largest_free_chunk);
+  }
+}
+
+void JitCodeCache::DumpFragmentation(std::ostream& os, const char* name, void* mspace) {
+  FreeChunkStats stats = GetFreeChunkStats(mspace);
+  // Share of the free memory that an allocation can not get in one piece.
+  size_t fragmentation_percent = (stats.free_bytes == 0u)
+      ? 0u
+      : 100u - (stats.largest_free_chunk * 100u) / stats.free_bytes;
+  os << "Current JIT " << name << " cache free: " << PrettySize(stats.free_bytes)
+     << " in " << stats.number_of_free_chunks << " chunks"
+     << ", largest free chunk: " << PrettySize(stats.largest_free_chunk)
+     << ", fragmentation: " << fragmentation_percent << "%\n";
+}
+
+// Do not bother compacting a code space with less free memory than this.
+static constexpr size_t kMinFreeBytesForCompaction = 64 * KB;
+// Compact the code space when an allocation can not get that share of the free memory.
+static constexpr size_t kMinFragmentationPercentForCompaction = 50u;
+
+bool JitCodeCache::ShouldCompactCode() {
+  if (compact_code_on_next_collection_) {
+    return true;
+  }
+  FreeChunkStats stats = GetFreeChunkStats(code_mspace_);
+  if (stats.free_bytes < kMinFreeBytesForCompaction) {
+    return false;
+  }
+  size_t fragmentation_percent = 100u - (stats.largest_free_chunk * 100u) / stats.free_bytes;
+  return fragmentation_percent >= kMinFragmentationPercentForCompaction;
+}
+
+size_t JitCodeCache::CompactCode() {
+  ScopedTrace trace(__FUNCTION__);
+  DCHECK(collection_in_progress_);
+  ++number_of_compactions_;
+  size_t alignment = GetInstructionSetAlignment(kRuntimeISA);
+  size_t header_size = RoundUp(sizeof(OatQuickMethodHeader), alignment);
+  size_t number_of_relocated_methods = 0u;
+  {
+    MutexLock mu(Thread::Current(), *Locks::native_debug_interface_lock_);
+    ScopedCodeCacheWrite scc(this);
+    // Move the code at the highest addresses first, so that the top of the space frees up.
+    std::vector<std::pair<const void*, ArtMethod*>> entries(method_code_map_.begin(),
+                                                            method_code_map_.end());
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+      const uint8_t* old_code = reinterpret_cast<const uint8_t*>(it->first);
+      ArtMethod* method = it->second;
+      const OatQuickMethodHeader* old_header = OatQuickMethodHeader::FromCodePointer(old_code);
+      // Only move code the method is running from. Code with CHA dependencies is registered
+      // with its header, and code the native debugger knows about is identified by its
+      // address, so leave them in place. Code already moved once stays where it is until
+      // its old copy is gone.
+      if (old_header->GetEntryPoint() != method->GetEntryPointFromQuickCompiledCode() ||
+          old_header->HasShouldDeoptimizeFlag() ||
+          HasNativeDebugInfoForJit(old_code) ||
+          relocated_code_.find(old_code) != relocated_code_.end()) {
+        continue;
+      }
+      size_t code_size = old_header->GetCodeSize();
+      uint8_t* memory = AllocateCode(header_size + code_size);
+      if (memory == nullptr) {
+        break;
+      }
+      uint8_t* new_code = memory + header_size;
+      if (new_code > old_code) {
+        // No free chunk below this code is large enough; the remaining code is lower still.
+        FreeCode(memory);
+        break;
+      }
+      std::copy(old_code - header_size, old_code + code_size, memory);
+      // The stack maps and method info are referenced relative to the code. JIT code does
+      // not reference anything else relative to its own address: roots and callees are
+      // loaded from absolute addresses, so the copied code needs no patching.
+      OatQuickMethodHeader* new_header = OatQuickMethodHeader::FromCodePointer(new_code);
+      uint32_t delta = dchecked_integral_cast<uint32_t>(old_code - new_code);
+      if (old_header->GetVmapTableOffset() != 0u) {
+        new_header->SetVmapTableOffset(old_header->GetVmapTableOffset() - delta);
+      }
+      if (old_header->GetMethodInfoOffset() != 0u) {
+        new_header->SetMethodInfoOffset(old_header->GetMethodInfoOffset() - delta);
+      }
+      FlushInstructionCache(reinterpret_cast<char*>(new_code),
+                            reinterpret_cast<char*>(new_code + code_size));
+      method_code_map_.Put(new_code, method);
+      relocated_code_.Put(old_code, new_code);
+      relocated_code_.Put(new_code, old_code);
+      GetLiveBitmap()->Clear(FromCodeToAllocation(old_code));
+      GetLiveBitmap()->Set(FromCodeToAllocation(new_code));
+      // Don't call Instrumentation::UpdateMethodsCode(), same as when the collection moves
+      // methods back to the interpreter: the method keeps running the same compiled code.
+      method->SetEntryPointFromQuickCompiledCode(new_header->GetEntryPoint());
+      ++number_of_relocated_methods;
+    }
+  }
+  // Allocations that failed above do not need another compaction.
+  compact_code_on_next_collection_ = false;
+  number_of_relocated_methods_ += number_of_relocated_methods;
+  VLOG(jit) << "Compacted the JIT code cache, moved " << number_of_relocated_methods
+            << " methods";
+  return number_of_relocated_methods;
+}
+
 void JitCodeCache::Dump(std::ostream& os) {
   MutexLock mu(Thread::Current(), lock_);
   MutexLock mu2(Thread::Current(), *Locks::native_debug_interface_lock_);
@@ -1861,7 +2062,14 @@ void JitCodeCache::Dump(std::ostream& os) {
      << "Total number of JIT compilations: " << number_of_compilations_ << "\n"
      << "Total number of JIT compilations for on stack replacement: "
         << number_of_osr_compilations_ << "\n"
-     << "Total number of JIT code cache collections: " << number_of_collections_ << std::endl;
+     << "Total number of JIT code cache collections: " << number_of_collections_ << "\n"
+     << "Total number of JIT allocations failed from fragmentation: "
+        << number_of_fragmented_allocation_failures_ << "\n"
+     << "Total number of JIT code cache compactions: " << number_of_compactions_ << "\n"
+     << "Total number of methods moved by JIT code cache compactions: "
+        << number_of_relocated_methods_ << "\n";
+  DumpFragmentation(os, "code", code_mspace_);
+  DumpFragmentation(os, "data", data_mspace_);
   histogram_stack_map_memory_use_.PrintMemoryUse(os);
   histogram_code_memory_use_.PrintMemoryUse(os);
   histogram_profiling_info_memory_use_.PrintMemoryUse(os);
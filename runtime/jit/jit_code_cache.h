@@ -35,6 +35,8 @@ template<class T> class Handle;
 class LinearAlloc;
 class InlineCache;
 class IsMarkedVisitor;
+class JitBaselineTieringTestHelper;
+class JitCodeCacheCompactionTestHelper;
 class JitJniStubTestHelper;
 class OatQuickMethodHeader;
 struct ProfileMethodInfo;
@@ -99,7 +101,9 @@ class JitCodeCache {
   // Number of bytes allocated in the data cache.
   size_t DataCacheSize() REQUIRES(!lock_);
 
-  bool NotifyCompilationOf(ArtMethod* method, Thread* self, bool osr)
+  // Returns whether `method` should be compiled. Non-osr code already in the cache is
+  // only replaced when it is baseline code and `baseline` is false.
+  bool NotifyCompilationOf(ArtMethod* method, Thread* self, bool osr, bool baseline)
       REQUIRES_SHARED(Locks::mutator_lock_)
       REQUIRES(!lock_);
 
@@ -216,6 +220,7 @@ class JitCodeCache {
   ProfilingInfo* AddProfilingInfo(Thread* self,
                                   ArtMethod* method,
                                   const std::vector<uint32_t>& entries,
+                                  const std::vector<uint32_t>& branch_entries,
                                   bool retry_allocation)
       REQUIRES(!lock_)
       REQUIRES_SHARED(Locks::mutator_lock_);
@@ -297,7 +302,8 @@ class JitCodeCache {
 
   ProfilingInfo* AddProfilingInfoInternal(Thread* self,
                                           ArtMethod* method,
-                                          const std::vector<uint32_t>& entries)
+                                          const std::vector<uint32_t>& entries,
+                                          const std::vector<uint32_t>& branch_entries)
       REQUIRES(lock_)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
@@ -362,6 +368,24 @@ class JitCodeCache {
   void FreeData(uint8_t* data) REQUIRES(lock_);
   uint8_t* AllocateData(size_t data_size) REQUIRES(lock_);
 
+  // Called when allocating `size` bytes from `mspace` failed. Counts the failures where the
+  // space had enough free memory, but no free chunk large enough.
+  void RecordAllocationFailure(void* mspace, size_t size) REQUIRES(lock_);
+
+  // Print how fragmented the free memory of `mspace` is.
+  void DumpFragmentation(std::ostream& os, const char* name, void* mspace) REQUIRES(lock_);
+
+  // Return whether the collection in progress should compact the code space.
+  bool ShouldCompactCode() REQUIRES(lock_);
+
+  // Move compiled code that is the entrypoint of its method to lower free chunks of the
+  // code space, and update the entrypoint. The old copies are left in `method_code_map_`
+  // and freed by the collection unless a thread is still executing them. Returns the
+  // number of methods moved.
+  size_t CompactCode()
+      REQUIRES(lock_)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   bool IsWeakAccessEnabled(Thread* self) const;
   void WaitUntilInlineCacheAccessible(Thread* self)
       REQUIRES(!lock_)
@@ -432,6 +456,21 @@ class JitCodeCache {
   // Number of code cache collections done throughout the lifetime of the JIT.
   size_t number_of_collections_ GUARDED_BY(lock_);
 
+  // Number of failed code and data allocations for which the space had enough free memory.
+  size_t number_of_fragmented_allocation_failures_ GUARDED_BY(lock_);
+
+  // Whether a code allocation failed from fragmentation since the last compaction.
+  bool compact_code_on_next_collection_ GUARDED_BY(lock_);
+
+  // Number of code space compactions, and of methods they moved.
+  size_t number_of_compactions_ GUARDED_BY(lock_);
+  size_t number_of_relocated_methods_ GUARDED_BY(lock_);
+
+  // Compiled code moved by a compaction shares its stack maps, method info and roots with
+  // the copy it was moved from. Maps each of the two copies to the other one, so that the
+  // data is freed only with the last of them.
+  SafeMap<const void*, const void*> relocated_code_ GUARDED_BY(lock_);
+
   // Histograms for keeping track of stack map size statistics.
   Histogram<uint64_t> histogram_stack_map_memory_use_ GUARDED_BY(lock_);
 
@@ -452,6 +491,8 @@ class JitCodeCache {
   // Mapping flags for the code section.
   const int memmap_flags_prot_code_;
 
+  friend class art::JitBaselineTieringTestHelper;
+  friend class art::JitCodeCacheCompactionTestHelper;
   friend class art::JitJniStubTestHelper;
   friend class ScopedCodeCacheWrite;
 
@@ -20,6 +20,7 @@
 #include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "android-base/strings.h"
 
@@ -30,6 +31,8 @@
 #include "base/stl_util.h"
 #include "base/systrace.h"
 #include "base/time_utils.h"
+#include "class_linker.h"
+#include "class_loader_utils.h"
 #include "class_table-inl.h"
 #include "compiler_filter.h"
 #include "dex/dex_file_loader.h"
@@ -37,15 +40,24 @@
 #include "gc/collector_type.h"
 #include "gc/gc_cause.h"
 #include "gc/scoped_gc_critical_section.h"
+#include "handle_scope-inl.h"
+#include "java_vm_ext.h"
+#include "jit/jit.h"
 #include "jit/profile_compilation_info.h"
 #include "oat_file_manager.h"
 #include "scoped_thread_state_change-inl.h"
+#include "thread_pool.h"
 
 namespace art {
 
 ProfileSaver* ProfileSaver::instance_ = nullptr;
 pthread_t ProfileSaver::profiler_pthread_ = 0U;
 
+// Number of classes verified by one task when verifying startup classes in parallel.
+static constexpr size_t kPreverifyBatchSize = 16;
+// Maximum number of threads verifying startup classes.
+static constexpr size_t kMaxPreverifyThreads = 4;
+
 // At what priority to schedule the saver threads. 9 is the lowest foreground priority on device.
 static constexpr int kProfileSaverPthreadPriority = 9;
 
@@ -93,6 +105,8 @@ ProfileSaver::ProfileSaver(const ProfileSaverOptions& options,
       max_number_of_profile_entries_cached_(0),
       total_number_of_hot_spikes_(0),
       total_number_of_wake_ups_(0),
+      total_number_of_profiled_methods_queued_(0),
+      total_number_of_preverified_classes_(0),
       options_(options) {
   DCHECK(options_.IsEnabled());
   AddTrackedLocations(output_filename, code_paths);
@@ -107,6 +121,10 @@ ProfileSaver::~ProfileSaver() {
 void ProfileSaver::Run() {
   Thread* self = Thread::Current();
 
+  if (options_.GetPreverifyStartupClasses()) {
+    PreverifyStartupClasses();
+  }
+
   // Fetch the resolved classes for the app images after sleeping for
   // options_.GetSaveResolvedClassesDelayMs().
   // TODO(calin) This only considers the case of the primary profile file.
@@ -125,7 +143,9 @@ void ProfileSaver::Run() {
     total_ms_of_sleep_ += options_.GetSaveResolvedClassesDelayMs();
   }
   FetchAndCacheResolvedClassesAndMethods(/*startup*/ true);
-
+  if (options_.GetCompileProfiledMethods()) {
+    CompileProfiledMethods();
+  }
 
   // When we save without waiting for JIT notifications we use a simple
   // exponential back off policy bounded by max_wait_without_jit.
@@ -291,18 +311,12 @@ using MethodReferenceCollection = DexReferenceCollection<uint16_t, ScopedArenaAl
 using TypeReferenceCollection = DexReferenceCollection<dex::TypeIndex,
                                                        ScopedArenaAllocatorAdapter>;
 
-// Iterate over all of the loaded classes and visit each one. For each class, add it to the
-// resolved_classes out argument if startup is true.
-// Add methods to the hot_methods out argument if the number of samples is greater or equal to
-// hot_method_sample_threshold, add it to sampled_methods if it has at least one sample.
-static void SampleClassesAndExecutedMethods(pthread_t profiler_pthread,
-                                            bool profile_boot_class_path,
-                                            ScopedArenaAllocator* allocator,
-                                            uint32_t hot_method_sample_threshold,
-                                            bool startup,
-                                            TypeReferenceCollection* resolved_classes,
-                                            MethodReferenceCollection* hot_methods,
-                                            MethodReferenceCollection* sampled_methods) {
+// Iterate over all of the loaded classes and call `visitor` on each one.
+template <typename Visitor>
+static void VisitLoadedClasses(pthread_t profiler_pthread,
+                               bool profile_boot_class_path,
+                               ScopedArenaAllocator* allocator,
+                               const Visitor& visitor) {
   Thread* const self = Thread::Current();
   ClassLinker* const class_linker = Runtime::Current()->GetClassLinker();
   // Restore profile saver thread priority during the GC critical section. This helps prevent
@@ -351,34 +365,52 @@ static void SampleClassesAndExecutedMethods(pthread_t profiler_pthread,
       table->Visit(get_classes_visitor);
     }
     for (ObjPtr<mirror::Class> klass : classes) {
-      if (startup) {
-        // We only record classes for the startup case. This may change in the future.
-        resolved_classes->AddReference(&klass->GetDexFile(), klass->GetDexTypeIndex());
-      }
-      // Visit all of the methods in the class to see which ones were executed.
-      for (ArtMethod& method : klass->GetMethods(kRuntimePointerSize)) {
-        if (!method.IsNative()) {
-          DCHECK(!method.IsProxyMethod());
-          const uint16_t counter = method.GetCounter();
-          // Mark startup methods as hot if they have more than hot_method_sample_threshold
-          // samples. This means they will get compiled by the compiler driver.
-          if (method.GetProfilingInfo(kRuntimePointerSize) != nullptr ||
-              method.PreviouslyWarm() ||
-              counter >= hot_method_sample_threshold) {
-            hot_methods->AddReference(method.GetDexFile(), method.GetDexMethodIndex());
-          } else if (counter != 0) {
-            sampled_methods->AddReference(method.GetDexFile(), method.GetDexMethodIndex());
-          }
-        } else {
-          // We do not record native methods. Once we AOT-compile the app, all native
-          // methods shall have their thunks compiled.
-        }
-      }
+      visitor(klass);
     }
     classes.clear();
   }
 }
 
+// Iterate over all of the loaded classes and visit each one. For each class, add it to the
+// resolved_classes out argument if startup is true.
+// Add methods to the hot_methods out argument if the number of samples is greater or equal to
+// hot_method_sample_threshold, add it to sampled_methods if it has at least one sample.
+static void SampleClassesAndExecutedMethods(pthread_t profiler_pthread,
+                                            bool profile_boot_class_path,
+                                            ScopedArenaAllocator* allocator,
+                                            uint32_t hot_method_sample_threshold,
+                                            bool startup,
+                                            TypeReferenceCollection* resolved_classes,
+                                            MethodReferenceCollection* hot_methods,
+                                            MethodReferenceCollection* sampled_methods) {
+  auto visitor = [&](ObjPtr<mirror::Class> klass) REQUIRES_SHARED(Locks::mutator_lock_) {
+    if (startup) {
+      // We only record classes for the startup case. This may change in the future.
+      resolved_classes->AddReference(&klass->GetDexFile(), klass->GetDexTypeIndex());
+    }
+    // Visit all of the methods in the class to see which ones were executed.
+    for (ArtMethod& method : klass->GetMethods(kRuntimePointerSize)) {
+      if (!method.IsNative()) {
+        DCHECK(!method.IsProxyMethod());
+        const uint16_t counter = method.GetCounter();
+        // Mark startup methods as hot if they have more than hot_method_sample_threshold
+        // samples. This means they will get compiled by the compiler driver.
+        if (method.GetProfilingInfo(kRuntimePointerSize) != nullptr ||
+            method.PreviouslyWarm() ||
+            counter >= hot_method_sample_threshold) {
+          hot_methods->AddReference(method.GetDexFile(), method.GetDexMethodIndex());
+        } else if (counter != 0) {
+          sampled_methods->AddReference(method.GetDexFile(), method.GetDexMethodIndex());
+        }
+      } else {
+        // We do not record native methods. Once we AOT-compile the app, all native
+        // methods shall have their thunks compiled.
+      }
+    }
+  };
+  VisitLoadedClasses(profiler_pthread, profile_boot_class_path, allocator, visitor);
+}
+
 void ProfileSaver::FetchAndCacheResolvedClassesAndMethods(bool startup) {
   ScopedTrace trace(__PRETTY_FUNCTION__);
   const uint64_t start_time = NanoTime();
@@ -476,6 +508,248 @@ void ProfileSaver::FetchAndCacheResolvedClassesAndMethods(bool startup) {
                  << PrettyDuration(NanoTime() - start_time);
 }
 
+// Load the profiles of the given tracked locations from disk, and map each dex base location to
+// the profile that holds its data.
+static void LoadProfiles(
+    const SafeMap<std::string, std::set<std::string>>& tracked_locations,
+    /*out*/ std::vector<std::unique_ptr<ProfileCompilationInfo>>* profiles,
+    /*out*/ SafeMap<std::string, const ProfileCompilationInfo*>* profile_for_location) {
+  for (const auto& it : tracked_locations) {
+    std::unique_ptr<ProfileCompilationInfo> info(
+        new ProfileCompilationInfo(Runtime::Current()->GetArenaPool()));
+    if (!info->Load(it.first, /*clear_if_invalid*/ false)) {
+      VLOG(profiler) << "Could not load profile " << it.first;
+      continue;
+    }
+    for (const std::string& location : it.second) {
+      profile_for_location->Put(location, info.get());
+    }
+    profiles->push_back(std::move(info));
+  }
+}
+
+void ProfileSaver::CompileProfiledMethods() {
+  ScopedTrace trace(__PRETTY_FUNCTION__);
+  const uint64_t start_time = NanoTime();
+  Thread* const self = Thread::Current();
+  Runtime* const runtime = Runtime::Current();
+  jit::Jit* const jit = runtime->GetJit();
+  if (jit == nullptr || !jit->UseJitCompilation()) {
+    return;
+  }
+
+  ResolveTrackedLocations();
+  SafeMap<std::string, std::set<std::string>> tracked_locations;
+  pthread_t profiler_pthread;
+  {
+    MutexLock mu(self, *Locks::profiler_lock_);
+    tracked_locations = tracked_dex_base_locations_;
+    profiler_pthread = profiler_pthread_;
+  }
+
+  // The profiles on disk only hold what previous runs saved, as this run has not saved yet.
+  std::vector<std::unique_ptr<ProfileCompilationInfo>> profiles;
+  SafeMap<std::string, const ProfileCompilationInfo*> profile_for_location;
+  LoadProfiles(tracked_locations, &profiles, &profile_for_location);
+  if (profile_for_location.empty()) {
+    return;
+  }
+
+  ArenaStack stack(runtime->GetArenaPool());
+  ScopedArenaAllocator allocator(&stack);
+  const DexFile* last_dex_file = nullptr;
+  const ProfileCompilationInfo* last_profile = nullptr;
+  uint32_t number_of_queued_methods = 0;
+  auto visitor = [&](ObjPtr<mirror::Class> klass) REQUIRES_SHARED(Locks::mutator_lock_) {
+    const DexFile& dex_file = klass->GetDexFile();
+    if (&dex_file != last_dex_file) {
+      auto it = profile_for_location.find(DexFileLoader::GetBaseLocation(dex_file.GetLocation()));
+      last_dex_file = &dex_file;
+      last_profile = (it != profile_for_location.end()) ? it->second : nullptr;
+    }
+    if (last_profile == nullptr) {
+      return;
+    }
+    for (ArtMethod& method : klass->GetDeclaredMethods(kRuntimePointerSize)) {
+      MethodReference ref(&dex_file, method.GetDexMethodIndex());
+      if (last_profile->GetMethodHotness(ref).IsHot() &&
+          jit->EnqueueCompilationFromProfile(&method, self)) {
+        ++number_of_queued_methods;
+      }
+    }
+  };
+  VisitLoadedClasses(profiler_pthread, options_.GetProfileBootClassPath(), &allocator, visitor);
+  total_number_of_profiled_methods_queued_ += number_of_queued_methods;
+  VLOG(profiler) << "Profile saver queued " << number_of_queued_methods
+                 << " profiled methods for compilation in "
+                 << PrettyDuration(NanoTime() - start_time);
+}
+
+// Loads and verifies a batch of classes of a dex file. Classes are not initialized, so the
+// order in which class initializers run is unchanged.
+class PreverifyClassesTask FINAL : public Task {
+ public:
+  PreverifyClassesTask(ProfileSaver* saver,
+                       jobject class_loader,
+                       const DexFile* dex_file,
+                       std::vector<dex::TypeIndex>&& classes,
+                       Atomic<uint32_t>* number_of_verified_classes)
+      : saver_(saver),
+        class_loader_(class_loader),
+        dex_file_(dex_file),
+        classes_(std::move(classes)),
+        number_of_verified_classes_(number_of_verified_classes) {}
+
+  void Run(Thread* self) OVERRIDE {
+    if (saver_->ShuttingDown(self)) {
+      return;
+    }
+    ScopedObjectAccess soa(self);
+    ClassLinker* const class_linker = Runtime::Current()->GetClassLinker();
+    StackHandleScope<2> hs(self);
+    Handle<mirror::ClassLoader> class_loader(
+        hs.NewHandle(soa.Decode<mirror::ClassLoader>(class_loader_)));
+    MutableHandle<mirror::Class> klass(hs.NewHandle<mirror::Class>(nullptr));
+    for (dex::TypeIndex type_idx : classes_) {
+      const char* descriptor = dex_file_->StringByTypeIdx(type_idx);
+      klass.Assign(class_linker->FindClass(self, descriptor, class_loader));
+      if (klass == nullptr) {
+        // The class may be missing, or need the class loader to run Java code.
+        self->ClearException();
+        continue;
+      }
+      if (klass->IsVerified() || klass->IsErroneous()) {
+        continue;
+      }
+      // Another thread may be verifying the class, in which case we wait for it.
+      class_linker->VerifyClass(self, klass);
+      if (self->IsExceptionPending()) {
+        // The failure is recorded in the class and reported again on its first use.
+        self->ClearException();
+      } else if (klass->IsVerified()) {
+        number_of_verified_classes_->FetchAndAddRelaxed(1u);
+      }
+    }
+  }
+
+  void Finalize() OVERRIDE {
+    delete this;
+  }
+
+ private:
+  ProfileSaver* const saver_;
+  const jobject class_loader_;
+  const DexFile* const dex_file_;
+  const std::vector<dex::TypeIndex> classes_;
+  Atomic<uint32_t>* const number_of_verified_classes_;
+
+  DISALLOW_COPY_AND_ASSIGN(PreverifyClassesTask);
+};
+
+void ProfileSaver::PreverifyStartupClasses() {
+  ScopedTrace trace(__PRETTY_FUNCTION__);
+  const uint64_t start_time = NanoTime();
+  Thread* const self = Thread::Current();
+  Runtime* const runtime = Runtime::Current();
+  if (!runtime->IsVerificationEnabled()) {
+    return;
+  }
+
+  ResolveTrackedLocations();
+  SafeMap<std::string, std::set<std::string>> tracked_locations;
+  {
+    MutexLock mu(self, *Locks::profiler_lock_);
+    tracked_locations = tracked_dex_base_locations_;
+  }
+  std::vector<std::unique_ptr<ProfileCompilationInfo>> profiles;
+  SafeMap<std::string, const ProfileCompilationInfo*> profile_for_location;
+  LoadProfiles(tracked_locations, &profiles, &profile_for_location);
+  if (profile_for_location.empty()) {
+    return;
+  }
+
+  // Split the startup classes of the dex files in the app class loaders into batches. Classes
+  // that the vdex already verified are loaded verified, and only cost the lookup.
+  JavaVMExt* const vm = runtime->GetJavaVM();
+  std::vector<jobject> class_loaders;
+  std::vector<PreverifyClassesTask*> tasks;
+  Atomic<uint32_t> number_of_verified_classes(0u);
+  {
+    ScopedObjectAccess soa(self);
+    VariableSizedHandleScope hs(self);
+    std::vector<Handle<mirror::ClassLoader>> loaders;
+    GetClassLoadersVisitor class_loader_visitor(&hs, &loaders);
+    {
+      ReaderMutexLock mu(self, *Locks::classlinker_classes_lock_);
+      runtime->GetClassLinker()->VisitClassLoaders(&class_loader_visitor);
+    }
+    for (Handle<mirror::ClassLoader> loader : loaders) {
+      if (!IsPathOrDexClassLoader(soa, loader)) {
+        continue;
+      }
+      jobject class_loader = nullptr;
+      auto visit_dex_file = [&](const DexFile* dex_file) REQUIRES_SHARED(Locks::mutator_lock_) {
+        const std::string base_location = DexFileLoader::GetBaseLocation(dex_file->GetLocation());
+        auto it = profile_for_location.find(base_location);
+        std::set<dex::TypeIndex> classes;
+        std::set<uint16_t> hot_methods;
+        std::set<uint16_t> startup_methods;
+        std::set<uint16_t> post_startup_methods;
+        if (it == profile_for_location.end() ||
+            !it->second->GetClassesAndMethods(*dex_file,
+                                              &classes,
+                                              &hot_methods,
+                                              &startup_methods,
+                                              &post_startup_methods) ||
+            classes.empty()) {
+          return true;
+        }
+        if (class_loader == nullptr) {
+          class_loader = vm->AddGlobalRef(self, loader.Get());
+          class_loaders.push_back(class_loader);
+        }
+        std::vector<dex::TypeIndex> batch;
+        for (dex::TypeIndex type_idx : classes) {
+          batch.push_back(type_idx);
+          if (batch.size() == kPreverifyBatchSize) {
+            tasks.push_back(new PreverifyClassesTask(
+                this, class_loader, dex_file, std::move(batch), &number_of_verified_classes));
+            batch.clear();
+          }
+        }
+        if (!batch.empty()) {
+          tasks.push_back(new PreverifyClassesTask(
+              this, class_loader, dex_file, std::move(batch), &number_of_verified_classes));
+        }
+        return true;
+      };
+      VisitClassLoaderDexFiles(soa, loader, visit_dex_file);
+    }
+  }
+
+  if (!tasks.empty()) {
+    const size_t num_threads = std::min(
+        kMaxPreverifyThreads,
+        std::max<size_t>(1u, static_cast<size_t>(sysconf(_SC_NPROCESSORS_CONF)) - 1u));
+    ThreadPool thread_pool("Profile saver verification thread pool", num_threads);
+    for (PreverifyClassesTask* task : tasks) {
+      thread_pool.AddTask(self, task);
+    }
+    thread_pool.StartWorkers(self);
+    // Only the pool's threads load the classes. They cannot call into Java, so classes that need
+    // a Java class loader are skipped. The saver thread has a peer and could run such code.
+    thread_pool.Wait(self, /* do_work */ false, /* may_hold_locks */ false);
+  }
+  for (jobject class_loader : class_loaders) {
+    vm->DeleteGlobalRef(self, class_loader);
+  }
+
+  const uint32_t verified = number_of_verified_classes.LoadRelaxed();
+  total_number_of_preverified_classes_ += verified;
+  VLOG(profiler) << "Profile saver verified " << verified << " startup classes in "
+                 << PrettyDuration(NanoTime() - start_time);
+}
+
 bool ProfileSaver::ProcessProfilingInfo(bool force_save, /*out*/uint16_t* number_of_new_methods) {
   ScopedTrace trace(__PRETTY_FUNCTION__);
 
@@ -819,7 +1093,11 @@ void ProfileSaver::DumpInfo(std::ostream& os) {
      << "ProfileSaver max_number_profile_entries_cached="
      << max_number_of_profile_entries_cached_ << '\n'
      << "ProfileSaver total_number_of_hot_spikes=" << total_number_of_hot_spikes_ << '\n'
-     << "ProfileSaver total_number_of_wake_ups=" << total_number_of_wake_ups_ << '\n';
+     << "ProfileSaver total_number_of_wake_ups=" << total_number_of_wake_ups_ << '\n'
+     << "ProfileSaver total_number_of_profiled_methods_queued="
+     << total_number_of_profiled_methods_queued_ << '\n'
+     << "ProfileSaver total_number_of_preverified_classes="
+     << total_number_of_preverified_classes_ << '\n';
 }
 
 
@@ -837,6 +1115,18 @@ void ProfileSaver::ForceProcessProfiles() {
   }
 }
 
+void ProfileSaver::ForcePreverifyStartupClasses() {
+  ProfileSaver* saver = nullptr;
+  {
+    MutexLock mu(Thread::Current(), *Locks::profiler_lock_);
+    saver = instance_;
+  }
+  // Same caveat as ForceProcessProfiles() about the instance being deleted.
+  if (saver != nullptr) {
+    saver->PreverifyStartupClasses();
+  }
+}
+
 bool ProfileSaver::HasSeenMethod(const std::string& profile, bool hot, MethodReference ref) {
   MutexLock mu(Thread::Current(), *Locks::profiler_lock_);
   if (instance_ != nullptr) {
@@ -56,6 +56,10 @@ class ProfileSaver {
   // For testing or manual purposes (SIGUSR1).
   static void ForceProcessProfiles();
 
+  // Just for testing purposes. Verifies the classes of the saved profiles, as the saver thread
+  // does on start with -Xps-preverify-startup-classes.
+  static void ForcePreverifyStartupClasses();
+
   // Just for testing purposes.
   static bool HasSeenMethod(const std::string& profile, bool hot, MethodReference ref);
 
@@ -98,6 +102,14 @@ class ProfileSaver {
   // profile_cache_ for later save.
   void FetchAndCacheResolvedClassesAndMethods(bool startup);
 
+  // Loads the profiles of the tracked locations as saved by previous runs, and queues JIT
+  // compilation of the loaded methods they mark as hot.
+  void CompileProfiledMethods();
+
+  // Loads the profiles of the tracked locations as saved by previous runs, and verifies the
+  // startup classes they list on a thread pool, so that the threads using them later do not.
+  void PreverifyStartupClasses();
+
   void DumpInfo(std::ostream& os);
 
   // Resolve the realpath of the locations stored in tracked_dex_base_locations_to_be_resolved_
@@ -148,8 +160,12 @@ class ProfileSaver {
   uint64_t max_number_of_profile_entries_cached_;
   uint64_t total_number_of_hot_spikes_;
   uint64_t total_number_of_wake_ups_;
+  uint64_t total_number_of_profiled_methods_queued_;
+  uint64_t total_number_of_preverified_classes_;
 
   const ProfileSaverOptions options_;
+
+  friend class PreverifyClassesTask;
   DISALLOW_COPY_AND_ASSIGN(ProfileSaver);
 };
 
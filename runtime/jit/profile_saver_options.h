@@ -43,7 +43,9 @@ struct ProfileSaverOptions {
     profile_path_(""),
     profile_boot_class_path_(false),
     profile_aot_code_(false),
-    wait_for_jit_notifications_to_save_(true) {}
+    wait_for_jit_notifications_to_save_(true),
+    compile_profiled_methods_(false),
+    preverify_startup_classes_(false) {}
 
   ProfileSaverOptions(
       bool enabled,
@@ -57,7 +59,9 @@ struct ProfileSaverOptions {
       const std::string& profile_path,
       bool profile_boot_class_path,
       bool profile_aot_code = false,
-      bool wait_for_jit_notifications_to_save = true)
+      bool wait_for_jit_notifications_to_save = true,
+      bool compile_profiled_methods = false,
+      bool preverify_startup_classes = false)
   : enabled_(enabled),
     min_save_period_ms_(min_save_period_ms),
     save_resolved_classes_delay_ms_(save_resolved_classes_delay_ms),
@@ -69,7 +73,9 @@ struct ProfileSaverOptions {
     profile_path_(profile_path),
     profile_boot_class_path_(profile_boot_class_path),
     profile_aot_code_(profile_aot_code),
-    wait_for_jit_notifications_to_save_(wait_for_jit_notifications_to_save) {}
+    wait_for_jit_notifications_to_save_(wait_for_jit_notifications_to_save),
+    compile_profiled_methods_(compile_profiled_methods),
+    preverify_startup_classes_(preverify_startup_classes) {}
 
   bool IsEnabled() const {
     return enabled_;
@@ -121,6 +127,12 @@ struct ProfileSaverOptions {
   void SetWaitForJitNotificationsToSave(bool value) {
     wait_for_jit_notifications_to_save_ = value;
   }
+  bool GetCompileProfiledMethods() const {
+    return compile_profiled_methods_;
+  }
+  bool GetPreverifyStartupClasses() const {
+    return preverify_startup_classes_;
+  }
 
   friend std::ostream & operator<<(std::ostream &os, const ProfileSaverOptions& pso) {
     os << "enabled_" << pso.enabled_
@@ -133,7 +145,9 @@ struct ProfileSaverOptions {
         << ", max_notification_before_wake_" << pso.max_notification_before_wake_
         << ", profile_boot_class_path_" << pso.profile_boot_class_path_
         << ", profile_aot_code_" << pso.profile_aot_code_
-        << ", wait_for_jit_notifications_to_save_" << pso.wait_for_jit_notifications_to_save_;
+        << ", wait_for_jit_notifications_to_save_" << pso.wait_for_jit_notifications_to_save_
+        << ", compile_profiled_methods_" << pso.compile_profiled_methods_
+        << ", preverify_startup_classes_" << pso.preverify_startup_classes_;
     return os;
   }
 
@@ -151,6 +165,11 @@ struct ProfileSaverOptions {
   bool profile_boot_class_path_;
   bool profile_aot_code_;
   bool wait_for_jit_notifications_to_save_;
+  // JIT compile the methods that the existing profile marks as hot once they are loaded.
+  bool compile_profiled_methods_;
+  // Verify the classes that the existing profile lists as used during startup, in parallel,
+  // as soon as the saver starts.
+  bool preverify_startup_classes_;
 };
 
 }  // namespace art
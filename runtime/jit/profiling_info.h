@@ -17,10 +17,12 @@
 #ifndef ART_RUNTIME_JIT_PROFILING_INFO_H_
 #define ART_RUNTIME_JIT_PROFILING_INFO_H_
 
+#include <limits>
 #include <vector>
 
 #include "base/macros.h"
 #include "gc_root.h"
+#include "offsets.h"
 
 namespace art {
 
@@ -41,8 +43,22 @@ class InlineCache {
  public:
   static constexpr uint8_t kIndividualCacheSize = 5;
 
+  // Number of times the INVOKE was executed while being profiled. Saturates
+  // instead of wrapping around.
+  uint32_t GetInvokeCount() const {
+    return invoke_count_;
+  }
+
+  // Number of times compiled code deoptimized because a speculation based on this
+  // inline cache failed. Saturates instead of wrapping around.
+  uint32_t GetDeoptimizationCount() const {
+    return deoptimization_count_;
+  }
+
  private:
   uint32_t dex_pc_;
+  uint32_t invoke_count_;
+  uint32_t deoptimization_count_;
   GcRoot<mirror::Class> classes_[kIndividualCacheSize];
 
   friend class jit::JitCodeCache;
@@ -51,6 +67,33 @@ class InlineCache {
   DISALLOW_COPY_AND_ASSIGN(InlineCache);
 };
 
+// Structure to store how often a conditional branch was taken and not taken.
+// Counters saturate instead of wrapping around.
+class BranchCache {
+ public:
+  uint32_t GetDexPc() const {
+    return dex_pc_;
+  }
+
+  uint32_t GetTaken() const {
+    return taken_;
+  }
+
+  uint32_t GetNotTaken() const {
+    return not_taken_;
+  }
+
+ private:
+  uint32_t dex_pc_;
+  uint32_t taken_;
+  uint32_t not_taken_;
+
+  friend class jit::JitCodeCache;
+  friend class ProfilingInfo;
+
+  DISALLOW_COPY_AND_ASSIGN(BranchCache);
+};
+
 /**
  * Profiling info for a method, created and filled by the interpreter once the
  * method is warm, and used by the compiler to drive optimizations.
@@ -73,10 +116,34 @@ class ProfilingInfo {
     return method_;
   }
 
+  // Add the outcome of an executed conditional branch to the profile.
+  void AddBranchInfo(uint32_t dex_pc, bool taken)
+      REQUIRES(Roles::uninterruptible_)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
+  // Record that compiled code deoptimized at the INVOKE at `dex_pc` because a
+  // speculation on its receiver type failed.
+  void AddDeoptimizationInfo(uint32_t dex_pc)
+      REQUIRES(Roles::uninterruptible_)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   // Mutator lock only required for debugging output.
   InlineCache* GetInlineCache(uint32_t dex_pc)
       REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Returns the inline cache of the INVOKE at `dex_pc`, or null if there is none.
+  InlineCache* FindInlineCache(uint32_t dex_pc);
+
+  // Returns the branch cache of the conditional branch at `dex_pc`, or null if there is none.
+  BranchCache* GetBranchCache(uint32_t dex_pc);
+
+  // Size of a ProfilingInfo with the given number of inline and branch caches.
+  static size_t ComputeSize(size_t number_of_inline_caches, size_t number_of_branch_caches) {
+    return sizeof(ProfilingInfo) +
+        sizeof(InlineCache) * number_of_inline_caches +
+        sizeof(BranchCache) * number_of_branch_caches;
+  }
+
   bool IsMethodBeingCompiled(bool osr) const {
     return osr
         ? is_osr_method_being_compiled_
@@ -124,17 +191,49 @@ class ProfilingInfo {
     current_inline_uses_--;
   }
 
+  // Whether the code the JIT installed last for the method is baseline code,
+  // which an optimized compilation may replace.
+  bool HasBaselineCode() const {
+    return has_baseline_code_;
+  }
+
+  void SetHasBaselineCode(bool value) {
+    has_baseline_code_ = value;
+  }
+
+  uint16_t GetBaselineHotnessCount() const {
+    return baseline_hotness_count_;
+  }
+
+  void SetBaselineHotnessCount(uint16_t count) {
+    baseline_hotness_count_ = count;
+  }
+
+  static MemberOffset BaselineHotnessCountOffset() {
+    return MemberOffset(OFFSETOF_MEMBER(ProfilingInfo, baseline_hotness_count_));
+  }
+
   bool IsInUseByCompiler() const {
     return IsMethodBeingCompiled(/*osr*/ true) || IsMethodBeingCompiled(/*osr*/ false) ||
         (current_inline_uses_ > 0);
   }
 
  private:
-  ProfilingInfo(ArtMethod* method, const std::vector<uint32_t>& entries);
+  ProfilingInfo(ArtMethod* method,
+                const std::vector<uint32_t>& entries,
+                const std::vector<uint32_t>& branch_entries);
+
+  // The branch caches are allocated right after the inline caches.
+  BranchCache* GetBranchCaches() {
+    return reinterpret_cast<BranchCache*>(&cache_[number_of_inline_caches_]);
+  }
 
   // Number of instructions we are profiling in the ArtMethod.
   const uint32_t number_of_inline_caches_;
 
+  // Number of conditional branches we are profiling in the ArtMethod.
+  const uint32_t number_of_branch_caches_;
+
   // Method this profiling info is for.
   // Not 'const' as JVMTI introduces obsolete methods that we implement by creating new ArtMethods.
   // See JitCodeCache::MoveObsoleteMethod.
@@ -150,11 +249,21 @@ class ProfilingInfo {
   // it updates this counter so that the GC does not try to clear the inline caches.
   uint16_t current_inline_uses_;
 
+  // Number of entries into the baseline compiled code of the method left before
+  // that code asks for an optimized compilation. Decremented by the baseline code.
+  uint16_t baseline_hotness_count_;
+
+  // See HasBaselineCode(). Set by the JIT thread, and cleared when the baseline code stops being
+  // the entry point: by a failed or optimized compilation, a code cache collection, or
+  // invalidation of the code. A stale read at worst skips or queues one optimized compilation.
+  bool has_baseline_code_;
+
   // Entry point of the corresponding ArtMethod, while the JIT code cache
   // is poking for the liveness of compiled code.
   const void* saved_entry_point_;
 
-  // Dynamically allocated array of size `number_of_inline_caches_`.
+  // Dynamically allocated array of size `number_of_inline_caches_`, followed by
+  // `number_of_branch_caches_` branch caches.
   InlineCache cache_[0];
 
   friend class jit::JitCodeCache;
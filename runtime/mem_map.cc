@@ -86,6 +86,8 @@ std::ostream& operator<<(std::ostream& os, const Maps& mem_maps) {
 
 std::mutex* MemMap::mem_maps_lock_ = nullptr;
 
+bool MemMap::use_huge_pages_ = false;
+
 #if USE_ART_LOW_4G_ALLOCATOR
 // Handling mem_map in 32b address range for 64b architectures that do not support MAP_32BIT.
 
@@ -388,6 +390,44 @@ MemMap* MemMap::MapAnonymous(const char* name,
                     page_aligned_byte_count, prot, reuse);
 }
 
+MemMap* MemMap::MapAnonymousAligned(const char* name,
+                                    uint8_t* addr,
+                                    size_t byte_count,
+                                    size_t alignment,
+                                    int prot,
+                                    bool low_4gb,
+                                    std::string* error_msg,
+                                    bool use_ashmem) {
+  if (alignment <= kPageSize) {
+    return MapAnonymous(name, addr, byte_count, prot, low_4gb, /* reuse */ false, error_msg,
+                        use_ashmem);
+  }
+  CHECK_ALIGNED_PARAM(byte_count, alignment);
+  // Ask for an additional `alignment` so that the map can be aligned even if we get, or ask for,
+  // an unaligned base address.
+  std::unique_ptr<MemMap> map(MapAnonymous(name,
+                                           addr,
+                                           byte_count + alignment,
+                                           prot,
+                                           low_4gb,
+                                           /* reuse */ false,
+                                           error_msg,
+                                           use_ashmem));
+  if (map == nullptr) {
+    return nullptr;
+  }
+  if (IsAlignedParam(map->Begin(), alignment)) {
+    // Got an aligned map, drop the extra space at the end.
+    map->SetSize(byte_count);
+  } else {
+    // Got an unaligned map, unmap the unaligned parts at both ends.
+    map->AlignBy(alignment);
+  }
+  DCHECK_ALIGNED_PARAM(map->Begin(), alignment);
+  DCHECK_EQ(map->Size(), byte_count);
+  return map.release();
+}
+
 MemMap* MemMap::MapDummy(const char* name, uint8_t* addr, size_t byte_count) {
   if (byte_count == 0) {
     return new MemMap(name, nullptr, 0, nullptr, 0, 0, false);
@@ -710,6 +750,16 @@ void MemMap::MadviseDontNeedAndZero() {
   }
 }
 
+void MemMap::MadviseHugePages() {
+#ifdef MADV_HUGEPAGE
+  if (UseHugePages() && base_size_ != 0) {
+    if (madvise(base_begin_, base_size_, MADV_HUGEPAGE) == -1) {
+      PLOG(WARNING) << "madvise(MADV_HUGEPAGE) failed for " << name_;
+    }
+  }
+#endif
+}
+
 bool MemMap::Sync() {
   bool result;
   if (redzone_size_ != 0) {
@@ -1107,6 +1157,31 @@ void ZeroAndReleasePages(void* address, size_t length) {
   }
 }
 
+bool MemMap::AlignToHugePages(uint8_t** begin, uint8_t** end) {
+  *begin = AlignUp(*begin, kHugePageSize);
+  *end = AlignDown(*end, kHugePageSize);
+  return *begin < *end;
+}
+
+void ZeroAndReleaseHugePages(void* address, size_t length) {
+  if (!MemMap::UseHugePages()) {
+    ZeroAndReleasePages(address, length);
+    return;
+  }
+  uint8_t* const mem_begin = reinterpret_cast<uint8_t*>(address);
+  uint8_t* const mem_end = mem_begin + length;
+  uint8_t* huge_page_begin = mem_begin;
+  uint8_t* huge_page_end = mem_end;
+  if (!MemMap::AlignToHugePages(&huge_page_begin, &huge_page_end)) {
+    // No whole huge page in the range, zero it in place.
+    std::fill(mem_begin, mem_end, 0);
+  } else {
+    std::fill(mem_begin, huge_page_begin, 0);
+    ZeroAndReleasePages(huge_page_begin, huge_page_end - huge_page_begin);
+    std::fill(huge_page_end, mem_end, 0);
+  }
+}
+
 void MemMap::AlignBy(size_t size) {
   CHECK_EQ(begin_, base_begin_) << "Unsupported";
   CHECK_EQ(size_, base_size_) << "Unsupported";
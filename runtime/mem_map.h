@@ -25,6 +25,7 @@
 #include <string>
 
 #include "android-base/thread_annotations.h"
+#include "base/globals.h"
 
 namespace art {
 
@@ -58,6 +59,9 @@ class MemMap {
  public:
   static constexpr bool kCanReplaceMapping = HAVE_MREMAP_SYSCALL;
 
+  // Size of a transparent huge page (PMD mapping) on the supported architectures.
+  static constexpr size_t kHugePageSize = 2 * MB;
+
   // Replace the data in this memmmap with the data in the memmap pointed to by source. The caller
   // relinquishes ownership of the source mmap.
   //
@@ -100,6 +104,19 @@ class MemMap {
                               std::string* error_msg,
                               bool use_ashmem = true);
 
+  // Request an anonymous region like MapAnonymous, with a base address aligned to `alignment`.
+  // 'byte_count' must be a multiple of `alignment`. An alignment up to kPageSize is the same as
+  // MapAnonymous. If `addr` is not aligned, the map begins at the next aligned address if it can
+  // be placed at `addr` at all. Reuse is not supported.
+  static MemMap* MapAnonymousAligned(const char* name,
+                                     uint8_t* addr,
+                                     size_t byte_count,
+                                     size_t alignment,
+                                     int prot,
+                                     bool low_4gb,
+                                     std::string* error_msg,
+                                     bool use_ashmem = true);
+
   // Create placeholder for a region allocated by direct call to mmap.
   // This is useful when we do not have control over the code calling mmap,
   // but when we still want to keep track of it in the list.
@@ -162,6 +179,10 @@ class MemMap {
 
   void MadviseDontNeedAndZero();
 
+  // In huge page mode, ask the kernel to back the map with transparent huge pages. This is only a
+  // hint; kernels without THP support or with THP disabled ignore it.
+  void MadviseHugePages();
+
   int GetProtect() const {
     return prot_;
   }
@@ -215,6 +236,24 @@ class MemMap {
   static void Init() REQUIRES(!MemMap::mem_maps_lock_);
   static void Shutdown() REQUIRES(!MemMap::mem_maps_lock_);
 
+  // Opt-in huge page mode, used for the large heap and code maps. Must be set before the maps are
+  // created, it is not retroactive.
+  static void SetUseHugePages(bool use_huge_pages) {
+    use_huge_pages_ = use_huge_pages;
+  }
+
+  static bool UseHugePages() {
+    return use_huge_pages_;
+  }
+
+  // Shrinks [*begin, *end) to the whole huge pages it contains. Returns false if there are none.
+  static bool AlignToHugePages(uint8_t** begin, uint8_t** end);
+
+  // The alignment to use for maps which should be backed by huge pages in huge page mode.
+  static size_t GetHugePageAlignment() {
+    return UseHugePages() ? kHugePageSize : kPageSize;
+  }
+
   // If the map is PROT_READ, try to read each page of the map to check it is in fact readable (not
   // faulting). This is used to diagnose a bug b/19894268 where mprotect doesn't seem to be working
   // intermittently.
@@ -287,6 +326,8 @@ class MemMap {
 
   static std::mutex* mem_maps_lock_;
 
+  static bool use_huge_pages_;
+
   friend class MemMapTest;  // To allow access to base_begin_ and base_size_.
 };
 
@@ -295,6 +336,10 @@ std::ostream& operator<<(std::ostream& os, const MemMap& mem_map);
 // Zero and release pages if possible, no requirements on alignments.
 void ZeroAndReleasePages(void* address, size_t length);
 
+// Same as ZeroAndReleasePages, but in huge page mode only whole huge pages are released and the
+// partial huge pages at the ends are zeroed instead, so that releasing does not split them.
+void ZeroAndReleaseHugePages(void* address, size_t length);
+
 }  // namespace art
 
 #endif  // ART_RUNTIME_MEM_MAP_H_
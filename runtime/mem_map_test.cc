@@ -18,8 +18,10 @@
 
 #include <sys/mman.h>
 
+#include <algorithm>
 #include <memory>
 #include <random>
+#include <vector>
 
 #include "base/memory_tool.h"
 #include "base/unix_file/fd_file.h"
@@ -737,4 +739,78 @@ TEST_F(MemMapTest, AlignBy) {
   }
 }
 
+TEST_F(MemMapTest, MapAnonymousAligned) {
+  CommonInit();
+  std::string error_msg;
+  const size_t alignment = MemMap::kHugePageSize;
+  std::unique_ptr<MemMap> map(MemMap::MapAnonymousAligned("MapAnonymousAligned",
+                                                          nullptr,
+                                                          2 * alignment,
+                                                          alignment,
+                                                          PROT_READ | PROT_WRITE,
+                                                          false,
+                                                          &error_msg));
+  ASSERT_NE(nullptr, map.get()) << error_msg;
+  EXPECT_TRUE(IsAlignedParam(map->Begin(), alignment));
+  EXPECT_EQ(map->Begin(), map->BaseBegin());
+  EXPECT_EQ(map->Size(), 2 * alignment);
+  EXPECT_EQ(map->Size(), map->BaseSize());
+  // Advising is a hint and must not fail, whether or not huge pages are enabled.
+  MemMap::SetUseHugePages(true);
+  map->MadviseHugePages();
+  // Fault in every page, then release all but the first one. Only the second huge page is
+  // released as a whole; the rest of the first one is zeroed in place and stays resident.
+  memset(map->Begin(), 0xff, map->Size());
+  ZeroAndReleaseHugePages(map->Begin() + kPageSize, map->Size() - kPageSize);
+  MemMap::SetUseHugePages(false);
+  std::vector<unsigned char> residency(map->Size() / kPageSize);
+  ASSERT_EQ(0, mincore(map->Begin(), map->Size(), residency.data()));
+  for (size_t i = 0; i != residency.size(); ++i) {
+    bool released = (i >= alignment / kPageSize);
+    EXPECT_EQ(!released, (residency[i] & 1u) != 0u) << "page " << i;
+  }
+  EXPECT_EQ(0xffu, map->Begin()[kPageSize - 1]);
+  EXPECT_TRUE(std::all_of(map->Begin() + kPageSize, map->End(), [](uint8_t b) { return b == 0u; }));
+
+  // An unaligned request is placed at the next aligned address.
+  map.reset();
+  uint8_t* valid_address = GetValidMapAddress(4 * alignment, /*low_4gb*/false);
+  uint8_t* unaligned_address = AlignUp(valid_address, alignment) + kPageSize;
+  map.reset(MemMap::MapAnonymousAligned("MapAnonymousAligned",
+                                        unaligned_address,
+                                        2 * alignment,
+                                        alignment,
+                                        PROT_READ | PROT_WRITE,
+                                        false,
+                                        &error_msg));
+  ASSERT_NE(nullptr, map.get()) << error_msg;
+  EXPECT_EQ(AlignUp(unaligned_address, alignment), map->Begin());
+  EXPECT_EQ(map->Size(), 2 * alignment);
+}
+
+TEST_F(MemMapTest, AlignToHugePages) {
+  const size_t huge_page_size = MemMap::kHugePageSize;
+  uint8_t* const base = reinterpret_cast<uint8_t*>(16 * huge_page_size);
+
+  // A free page run starting at a huge page, without its first page, as RosAlloc releases it in
+  // debug builds. Only the second huge page can be released.
+  uint8_t* begin = base + kPageSize;
+  uint8_t* end = base + 2 * huge_page_size;
+  ASSERT_TRUE(MemMap::AlignToHugePages(&begin, &end));
+  EXPECT_EQ(base + huge_page_size, begin);
+  EXPECT_EQ(base + 2 * huge_page_size, end);
+
+  // An aligned range is kept as is.
+  begin = base;
+  end = base + 3 * huge_page_size;
+  ASSERT_TRUE(MemMap::AlignToHugePages(&begin, &end));
+  EXPECT_EQ(base, begin);
+  EXPECT_EQ(base + 3 * huge_page_size, end);
+
+  // A range which straddles a huge page boundary without covering a whole huge page.
+  begin = base + huge_page_size - kPageSize;
+  end = base + 2 * huge_page_size - kPageSize;
+  EXPECT_FALSE(MemMap::AlignToHugePages(&begin, &end));
+}
+
 }  // namespace art
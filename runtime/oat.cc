@@ -81,6 +81,8 @@ OatHeader::OatHeader(InstructionSet instruction_set,
       quick_imt_conflict_trampoline_offset_(0),
       quick_resolution_trampoline_offset_(0),
       quick_to_interpreter_bridge_offset_(0),
+      hot_code_offset_(0),
+      hot_code_size_(0),
       image_patch_delta_(0),
       image_file_location_oat_checksum_(0),
       image_file_location_oat_data_begin_(0) {
@@ -183,6 +185,8 @@ void OatHeader::UpdateChecksumWithHeaderData() {
                  sizeof(quick_resolution_trampoline_offset_));
   UpdateChecksum(&quick_to_interpreter_bridge_offset_,
                  sizeof(quick_to_interpreter_bridge_offset_));
+  UpdateChecksum(&hot_code_offset_, sizeof(hot_code_offset_));
+  UpdateChecksum(&hot_code_size_, sizeof(hot_code_size_));
 }
 
 void OatHeader::UpdateChecksum(const void* data, size_t length) {
@@ -362,6 +366,24 @@ void OatHeader::SetQuickToInterpreterBridgeOffset(uint32_t offset) {
   quick_to_interpreter_bridge_offset_ = offset;
 }
 
+uint32_t OatHeader::GetHotCodeOffset() const {
+  DCHECK(IsValid());
+  return hot_code_offset_;
+}
+
+uint32_t OatHeader::GetHotCodeSize() const {
+  DCHECK(IsValid());
+  return hot_code_size_;
+}
+
+void OatHeader::SetHotCode(uint32_t offset, uint32_t size) {
+  CHECK(size == 0 || offset >= executable_offset_);
+  DCHECK(IsValid());
+
+  hot_code_offset_ = offset;
+  hot_code_size_ = size;
+}
+
 int32_t OatHeader::GetImagePatchDelta() const {
   CHECK(IsValid());
   return image_patch_delta_;
@@ -32,8 +32,8 @@ class InstructionSetFeatures;
 class PACKED(4) OatHeader {
  public:
   static constexpr uint8_t kOatMagic[] = { 'o', 'a', 't', '\n' };
-  // Last oat version changed reason: Math.pow() intrinsic.
-  static constexpr uint8_t kOatVersion[] = { '1', '3', '8', '\0' };
+  // Last oat version changed reason: Hot code region.
+  static constexpr uint8_t kOatVersion[] = { '1', '4', '0', '\0' };
 
   static constexpr const char* kImageLocationKey = "image-location";
   static constexpr const char* kDex2OatCmdLineKey = "dex2oat-cmdline";
@@ -46,6 +46,12 @@ class PACKED(4) OatHeader {
   static constexpr const char* kBootClassPathKey = "bootclasspath";
   static constexpr const char* kConcurrentCopying = "concurrent-copying";
   static constexpr const char* kCompilationReasonKey = "compilation-reason";
+  // The dex2oat arguments that can change the generated code.
+  static constexpr const char* kCompilationArgsKey = "compilation-args";
+  // The GNU build IDs of dex2oat and the ART libraries it used.
+  static constexpr const char* kCompilerBuildIdKey = "compiler-build-id";
+  // The SHA-256 of the profile the oat file was compiled with, if any.
+  static constexpr const char* kProfileChecksumKey = "profile-sha256";
 
   static constexpr const char kTrueValue[] = "true";
   static constexpr const char kFalseValue[] = "false";
@@ -95,6 +101,12 @@ class PACKED(4) OatHeader {
   uint32_t GetQuickToInterpreterBridgeOffset() const;
   void SetQuickToInterpreterBridgeOffset(uint32_t offset);
 
+  // The code of the methods in the profile is laid out first, in the hot code region.
+  // The size is 0 if there is no profiled code.
+  uint32_t GetHotCodeOffset() const;
+  uint32_t GetHotCodeSize() const;
+  void SetHotCode(uint32_t offset, uint32_t size);
+
   int32_t GetImagePatchDelta() const;
   void RelocateOat(off_t delta);
   void SetImagePatchDelta(int32_t off);
@@ -148,6 +160,8 @@ class PACKED(4) OatHeader {
   uint32_t quick_imt_conflict_trampoline_offset_;
   uint32_t quick_resolution_trampoline_offset_;
   uint32_t quick_to_interpreter_bridge_offset_;
+  uint32_t hot_code_offset_;
+  uint32_t hot_code_size_;
 
   // The amount that the image this oat is associated with has been patched.
   int32_t image_patch_delta_;
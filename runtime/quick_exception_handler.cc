@@ -297,6 +297,8 @@ class DeoptimizeStackVisitor FINAL : public StackVisitor {
         single_frame_done_(false),
         single_frame_deopt_method_(nullptr),
         single_frame_deopt_quick_method_header_(nullptr),
+        innermost_method_(nullptr),
+        innermost_dex_pc_(dex::kDexNoIndex),
         callee_method_(nullptr) {
   }
 
@@ -304,6 +306,15 @@ class DeoptimizeStackVisitor FINAL : public StackVisitor {
     return single_frame_deopt_method_;
   }
 
+  // The method and dex pc of the first deoptimized frame, which can be an inlined frame.
+  ArtMethod* GetInnermostMethod() const {
+    return innermost_method_;
+  }
+
+  uint32_t GetInnermostDexPc() const {
+    return innermost_dex_pc_;
+  }
+
   const OatQuickMethodHeader* GetSingleFrameDeoptQuickMethodHeader() const {
     return single_frame_deopt_quick_method_header_;
   }
@@ -380,6 +391,8 @@ class DeoptimizeStackVisitor FINAL : public StackVisitor {
       if (prev_shadow_frame_ != nullptr) {
         prev_shadow_frame_->SetLink(new_frame);
       } else {
+        innermost_method_ = method;
+        innermost_dex_pc_ = GetDexPc();
         // Will be popped after the long jump after DeoptimizeStack(),
         // right before interpreter::EnterInterpreterFromDeoptimize().
         stacked_shadow_frame_pushed_ = true;
@@ -526,6 +539,8 @@ class DeoptimizeStackVisitor FINAL : public StackVisitor {
   bool single_frame_done_;
   ArtMethod* single_frame_deopt_method_;
   const OatQuickMethodHeader* single_frame_deopt_quick_method_header_;
+  ArtMethod* innermost_method_;
+  uint32_t innermost_dex_pc_;
   ArtMethod* callee_method_;
 
   DISALLOW_COPY_AND_ASSIGN(DeoptimizeStackVisitor);
@@ -573,6 +588,10 @@ void QuickExceptionHandler::DeoptimizeSingleFrame(DeoptimizationKind kind) {
               << GetDeoptimizationKindName(kind);
     DumpFramesWithType(self_, /* details */ true);
   }
+  jit::Jit* jit = Runtime::Current()->GetJit();
+  if (jit != nullptr) {
+    jit->AddDeoptimization(visitor.GetInnermostMethod(), visitor.GetInnermostDexPc(), kind);
+  }
   if (Runtime::Current()->UseJitCompilation()) {
     Runtime::Current()->GetJit()->GetCodeCache()->InvalidateCompiledCodeFor(
         deopt_method, visitor.GetSingleFrameDeoptQuickMethodHeader());
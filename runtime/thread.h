@@ -37,6 +37,7 @@
 #include "globals.h"
 #include "handle_scope.h"
 #include "instrumentation.h"
+#include "interpreter/interpreter_cache.h"
 #include "jvalue.h"
 #include "managed_stack.h"
 #include "offsets.h"
@@ -985,6 +986,11 @@ class Thread {
     can_call_into_java_ = can_call_into_java;
   }
 
+  // Only to be used by the owning thread.
+  InterpreterCache* GetInterpreterCache() {
+    return &interpreter_cache_;
+  }
+
   // Activates single step control for debugging. The thread takes the
   // ownership of the given SingleStepControl*. It is deleted by a call
   // to DeactivateSingleStepControl or upon thread destruction.
@@ -1762,6 +1768,9 @@ class Thread {
   // By default this is true.
   bool can_call_into_java_;
 
+  // Resolved fields and methods of the instructions this thread recently interpreted.
+  InterpreterCache interpreter_cache_;
+
   friend class Dbg;  // For SetStateUnsafe.
   friend class gc::collector::SemiSpace;  // For getting stack traces.
   friend class Runtime;  // For CreatePeer.
@@ -115,9 +115,19 @@ void ThreadPool::AddTask(Thread* self, Task* task) {
   }
 }
 
+void ThreadPool::AddLowPriorityTask(Thread* self, Task* task) {
+  MutexLock mu(self, task_queue_lock_);
+  low_priority_tasks_.push_back(task);
+  // If we have any waiters, signal one.
+  if (started_ && waiting_count_ != 0) {
+    task_queue_condition_.Signal(self);
+  }
+}
+
 void ThreadPool::RemoveAllTasks(Thread* self) {
   MutexLock mu(self, task_queue_lock_);
   tasks_.clear();
+  low_priority_tasks_.clear();
 }
 
 ThreadPool::ThreadPool(const char* name, size_t num_threads, bool create_peers)
@@ -217,8 +227,9 @@ Task* ThreadPool::TryGetTask(Thread* self) {
 
 Task* ThreadPool::TryGetTaskLocked() {
   if (HasOutstandingTasks()) {
-    Task* task = tasks_.front();
-    tasks_.pop_front();
+    std::deque<Task*>* queue = tasks_.empty() ? &low_priority_tasks_ : &tasks_;
+    Task* task = queue->front();
+    queue->pop_front();
     return task;
   }
   return nullptr;
@@ -246,7 +257,7 @@ void ThreadPool::Wait(Thread* self, bool do_work, bool may_hold_locks) {
 
 size_t ThreadPool::GetTaskCount(Thread* self) {
   MutexLock mu(self, task_queue_lock_);
-  return tasks_.size();
+  return tasks_.size() + low_priority_tasks_.size();
 }
 
 void ThreadPool::SetPthreadPriority(int priority) {
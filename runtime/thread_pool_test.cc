@@ -17,6 +17,7 @@
 #include "thread_pool.h"
 
 #include <string>
+#include <vector>
 
 #include "base/atomic.h"
 #include "common_runtime_test.h"
@@ -122,6 +123,38 @@ TEST_F(ThreadPoolTest, StopWait) {
   thread_pool.Wait(self, /* do_work */ true, false);
 }
 
+class OrderTask : public Task {
+ public:
+  OrderTask(std::vector<int>* order, int id) : order_(order), id_(id) {}
+
+  void Run(Thread* self ATTRIBUTE_UNUSED) {
+    order_->push_back(id_);
+  }
+
+  void Finalize() {
+    delete this;
+  }
+
+ private:
+  std::vector<int>* const order_;
+  const int id_;
+};
+
+// Check that low priority tasks only run once no other task is waiting.
+TEST_F(ThreadPoolTest, LowPriority) {
+  Thread* self = Thread::Current();
+  ThreadPool thread_pool("Thread pool test thread pool", 1);
+  std::vector<int> order;
+  thread_pool.AddLowPriorityTask(self, new OrderTask(&order, 2));
+  thread_pool.AddTask(self, new OrderTask(&order, 0));
+  thread_pool.AddLowPriorityTask(self, new OrderTask(&order, 3));
+  thread_pool.AddTask(self, new OrderTask(&order, 1));
+  EXPECT_EQ(4u, thread_pool.GetTaskCount(self));
+  thread_pool.StartWorkers(self);
+  thread_pool.Wait(self, false, false);
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3}), order);
+}
+
 class TreeTask : public Task {
  public:
   TreeTask(ThreadPool* const thread_pool, AtomicInteger* count, int depth)
@@ -177,11 +177,14 @@ inline const RegType& RegTypeCache::JavaLangObject(bool precise) {
 template <class RegTypeType>
 inline RegTypeType& RegTypeCache::AddEntry(RegTypeType* new_entry) {
   DCHECK(new_entry != nullptr);
+  DCHECK_EQ(new_entry->GetId(), entries_.size());
   entries_.push_back(new_entry);
+  IndexLastEntry();
   if (new_entry->HasClass()) {
     mirror::Class* klass = new_entry->GetClass();
     DCHECK(!klass->IsPrimitive());
     klass_entries_.push_back(std::make_pair(GcRoot<mirror::Class>(klass), new_entry));
+    IndexLastClassEntry();
   }
   return *new_entry;
 }
@@ -181,9 +181,12 @@ const RegType& RegTypeCache::From(mirror::ClassLoader* loader,
   StringPiece sp_descriptor(descriptor);
   // Try looking up the class in the cache first. We use a StringPiece to avoid continual strlen
   // operations on the descriptor.
-  for (size_t i = primitive_count_; i < entries_.size(); i++) {
-    if (MatchDescriptor(i, sp_descriptor, precise)) {
-      return *(entries_[i]);
+  auto it = descriptor_index_.find(sp_descriptor);
+  if (it != descriptor_index_.end()) {
+    for (uint32_t i = it->second.first; i != kNoNextEntry; i = next_entry_[i]) {
+      if (MatchDescriptor(i, sp_descriptor, precise)) {
+        return *(entries_[i]);
+      }
     }
   }
   // Class not found in the cache, will create a new type for that.
@@ -241,18 +244,82 @@ const RegType* RegTypeCache::FindClass(mirror::Class* klass, bool precise) const
     // primitive classes are final.
     return &RegTypeFromPrimitiveType(klass->GetPrimitiveType());
   }
-  for (auto& pair : klass_entries_) {
-    mirror::Class* const reg_klass = pair.first.Read();
-    if (reg_klass == klass) {
-      const RegType* reg_type = pair.second;
-      if (MatchingPrecisionForClass(reg_type, precise)) {
-        return reg_type;
-      }
+  if (klass_index_stale_) {
+    RebuildClassIndex();
+  }
+  auto it = klass_index_.find(klass);
+  if (it == klass_index_.end()) {
+    return nullptr;
+  }
+  for (uint32_t i = it->second.first; i != kNoNextEntry; i = next_klass_entry_[i]) {
+    DCHECK_EQ(klass_entries_[i].first.Read(), klass);
+    const RegType* reg_type = klass_entries_[i].second;
+    if (MatchingPrecisionForClass(reg_type, precise)) {
+      return reg_type;
     }
   }
   return nullptr;
 }
 
+template <typename Map, typename Key>
+void RegTypeCache::AddToIndex(Map* map,
+                              const Key& key,
+                              uint32_t index,
+                              ScopedArenaVector<uint32_t>* next) {
+  DCHECK_EQ((*next)[index], kNoNextEntry);
+  auto it = map->find(key);
+  if (it == map->end()) {
+    map->emplace(key, IndexChain { index, index });
+  } else {
+    (*next)[it->second.last] = index;
+    it->second.last = index;
+  }
+}
+
+size_t RegTypeCache::HashUnresolvedMerge(const RegType& resolved_part,
+                                         const BitVector& unresolved_types) {
+  size_t hash = resolved_part.GetId();
+  for (uint32_t idx : unresolved_types.Indexes()) {
+    hash = hash * 31u + idx;
+  }
+  return hash;
+}
+
+void RegTypeCache::IndexLastEntry() {
+  const uint32_t index = entries_.size() - 1u;
+  const RegType* entry = entries_[index];
+  next_entry_.push_back(kNoNextEntry);
+  DCHECK_EQ(next_entry_.size(), entries_.size());
+  if (!entry->GetDescriptor().empty()) {
+    AddToIndex(&descriptor_index_, entry->GetDescriptor(), index, &next_entry_);
+  } else if (entry->IsUnresolvedMergedReference()) {
+    const UnresolvedMergedType* merge = down_cast<const UnresolvedMergedType*>(entry);
+    size_t hash = HashUnresolvedMerge(merge->GetResolvedPart(), merge->GetUnresolvedTypes());
+    AddToIndex(&unresolved_merge_index_, hash, index, &next_entry_);
+  }
+}
+
+void RegTypeCache::IndexLastClassEntry() {
+  next_klass_entry_.push_back(kNoNextEntry);
+  DCHECK_EQ(next_klass_entry_.size(), klass_entries_.size());
+  if (!klass_index_stale_) {
+    const uint32_t index = klass_entries_.size() - 1u;
+    mirror::Class* klass = klass_entries_[index].first.Read<kWithoutReadBarrier>();
+    AddToIndex(&klass_index_, klass, index, &next_klass_entry_);
+  }
+}
+
+void RegTypeCache::RebuildClassIndex() const {
+  klass_index_.clear();
+  next_klass_entry_.clear();
+  klass_index_stale_ = false;
+  for (size_t i = 0; i != klass_entries_.size(); ++i) {
+    next_klass_entry_.push_back(kNoNextEntry);
+    mirror::Class* klass = klass_entries_[i].first.Read<kWithoutReadBarrier>();
+    AddToIndex(&klass_index_, klass, i, &next_klass_entry_);
+  }
+}
+
 const RegType* RegTypeCache::InsertClass(const StringPiece& descriptor,
                                          mirror::Class* klass,
                                          bool precise) {
@@ -276,7 +343,13 @@ const RegType& RegTypeCache::FromClass(const char* descriptor, mirror::Class* kl
 
 RegTypeCache::RegTypeCache(bool can_load_classes, ScopedArenaAllocator& allocator, bool can_suspend)
     : entries_(allocator.Adapter(kArenaAllocVerifier)),
+      descriptor_index_(allocator.Adapter(kArenaAllocVerifier)),
+      unresolved_merge_index_(allocator.Adapter(kArenaAllocVerifier)),
+      next_entry_(allocator.Adapter(kArenaAllocVerifier)),
       klass_entries_(allocator.Adapter(kArenaAllocVerifier)),
+      klass_index_(allocator.Adapter(kArenaAllocVerifier)),
+      next_klass_entry_(allocator.Adapter(kArenaAllocVerifier)),
+      klass_index_stale_(false),
       can_load_classes_(can_load_classes),
       allocator_(allocator) {
   DCHECK(can_suspend || !can_load_classes) << "Cannot load classes if suspension is disabled!";
@@ -290,6 +363,10 @@ RegTypeCache::RegTypeCache(bool can_load_classes, ScopedArenaAllocator& allocato
   // constants.
   entries_.reserve(kNumReserveEntries + kNumPrimitivesAndSmallConstants);
   FillPrimitiveAndSmallConstantTypes();
+  // Primitives and small constants are looked up without the indices.
+  next_entry_.reserve(kNumReserveEntries + kNumPrimitivesAndSmallConstants);
+  next_entry_.resize(entries_.size(), kNoNextEntry);
+  next_klass_entry_.reserve(kNumReserveEntries);
 }
 
 RegTypeCache::~RegTypeCache() {
@@ -447,9 +524,11 @@ const RegType& RegTypeCache::FromUnresolvedMerge(const RegType& left,
   }
 
   // Check if entry already exists.
-  for (size_t i = primitive_count_; i < entries_.size(); i++) {
-    const RegType* cur_entry = entries_[i];
-    if (cur_entry->IsUnresolvedMergedReference()) {
+  auto it = unresolved_merge_index_.find(HashUnresolvedMerge(resolved_parts_merged, types));
+  if (it != unresolved_merge_index_.end()) {
+    for (uint32_t i = it->second.first; i != kNoNextEntry; i = next_entry_[i]) {
+      const RegType* cur_entry = entries_[i];
+      DCHECK(cur_entry->IsUnresolvedMergedReference());
       const UnresolvedMergedType* cmp_type = down_cast<const UnresolvedMergedType*>(cur_entry);
       const RegType& resolved_part = cmp_type->GetResolvedPart();
       const BitVector& unresolved_part = cmp_type->GetUnresolvedTypes();
@@ -708,7 +787,12 @@ void RegTypeCache::VisitRoots(RootVisitor* visitor, const RootInfo& root_info) {
   }
   for (auto& pair : klass_entries_) {
     GcRoot<mirror::Class>& root = pair.first;
+    mirror::Class* const old_klass = root.Read<kWithoutReadBarrier>();
     root.VisitRoot(visitor, root_info);
+    if (root.Read<kWithoutReadBarrier>() != old_klass) {
+      // The class moved, the class index is keyed by its old address.
+      klass_index_stale_ = true;
+    }
   }
 }
 
@@ -18,11 +18,13 @@
 #define ART_RUNTIME_VERIFIER_REG_TYPE_CACHE_H_
 
 #include <stdint.h>
+#include <limits>
 #include <vector>
 
 #include "base/casts.h"
 #include "base/macros.h"
 #include "base/scoped_arena_containers.h"
+#include "base/stringpiece.h"
 #include "dex/primitive.h"
 #include "gc_root.h"
 
@@ -31,8 +33,8 @@ namespace mirror {
 class Class;
 class ClassLoader;
 }  // namespace mirror
+class BitVector;
 class ScopedArenaAllocator;
-class StringPiece;
 
 namespace verifier {
 
@@ -169,6 +171,23 @@ class RegTypeCache {
   template <class RegTypeType>
   RegTypeType& AddEntry(RegTypeType* new_entry) REQUIRES_SHARED(Locks::mutator_lock_);
 
+  // Link `index` at the end of the chain of `key` in `map`.
+  template <typename Map, typename Key>
+  static void AddToIndex(Map* map,
+                         const Key& key,
+                         uint32_t index,
+                         ScopedArenaVector<uint32_t>* next);
+  // Add the last entry of entries_ to the descriptor or unresolved merge index.
+  void IndexLastEntry() REQUIRES_SHARED(Locks::mutator_lock_);
+  // Add the last entry of klass_entries_ to the class index.
+  void IndexLastClassEntry() REQUIRES_SHARED(Locks::mutator_lock_);
+  // Re-create the class index after a moving GC updated the classes in klass_entries_.
+  void RebuildClassIndex() const REQUIRES_SHARED(Locks::mutator_lock_);
+
+  static size_t HashUnresolvedMerge(const RegType& resolved_part,
+                                    const BitVector& unresolved_types)
+      REQUIRES_SHARED(Locks::mutator_lock_);
+
   // Add a string piece to the arena allocator so that it stays live for the lifetime of the
   // verifier.
   StringPiece AddString(const StringPiece& string_piece);
@@ -190,12 +209,43 @@ class RegTypeCache {
   // Number of well known primitives that will be copied into a RegTypeCache upon construction.
   static uint16_t primitive_count_;
 
+  // First and last of the entries that share a key of an index. The entries are linked in
+  // insertion order, so that a lookup finds the same entry as a scan of all entries would.
+  struct IndexChain {
+    uint32_t first;
+    uint32_t last;
+  };
+
+  struct DescriptorHash {
+    size_t operator()(const StringPiece& descriptor) const {
+      size_t hash = 0u;
+      for (char c : descriptor) {
+        hash = hash * 31u + static_cast<uint8_t>(c);
+      }
+      return hash;
+    }
+  };
+
+  static constexpr uint32_t kNoNextEntry = std::numeric_limits<uint32_t>::max();
+
   // The actual storage for the RegTypes.
   ScopedArenaVector<const RegType*> entries_;
 
+  // Index of the entries with a descriptor, and of the unresolved merged types by
+  // HashUnresolvedMerge. Chains are linked through next_entry_, indexed by entry id.
+  ScopedArenaUnorderedMap<StringPiece, IndexChain, DescriptorHash> descriptor_index_;
+  ScopedArenaUnorderedMap<size_t, IndexChain> unresolved_merge_index_;
+  ScopedArenaVector<uint32_t> next_entry_;
+
   // Fast lookup for quickly finding entries that have a matching class.
   ScopedArenaVector<std::pair<GcRoot<mirror::Class>, const RegType*>> klass_entries_;
 
+  // Index of klass_entries_ by class, linked through next_klass_entry_. A moving GC updates the
+  // roots in klass_entries_ and marks the index stale, and the next lookup rebuilds it.
+  mutable ScopedArenaUnorderedMap<mirror::Class*, IndexChain> klass_index_;
+  mutable ScopedArenaVector<uint32_t> next_klass_entry_;
+  mutable bool klass_index_stale_;
+
   // Whether or not we're allowed to load classes.
   const bool can_load_classes_;
 
@@ -17,6 +17,8 @@
 #include "reg_type.h"
 
 #include <set>
+#include <string>
+#include <vector>
 
 #include "base/bit_vector.h"
 #include "base/casts.h"
@@ -417,6 +419,45 @@ TEST_F(RegTypeReferenceTest, UnresolvedUnintializedType) {
   EXPECT_TRUE(unresolved_unintialised.Equals(unresolved_unintialised_2));
 }
 
+TEST_F(RegTypeReferenceTest, RepeatedLookups) {
+  // Tests that looking up many types a second time hits the cache.
+  ArenaStack stack(Runtime::Current()->GetArenaPool());
+  ScopedArenaAllocator allocator(&stack);
+  ScopedObjectAccess soa(Thread::Current());
+  // The cache is not registered with the thread, so its class roots would not be updated.
+  Runtime::Current()->GetHeap()->IncrementDisableMovingGC(soa.Self());
+  RegTypeCache cache(true, allocator);
+  static constexpr size_t kNumTypes = 100;
+  std::vector<std::string> descriptors;
+  std::vector<const RegType*> types;
+  for (size_t i = 0; i != kNumTypes; ++i) {
+    descriptors.push_back("Ldoes/not/Exist" + std::to_string(i) + ";");
+    types.push_back(&cache.FromDescriptor(nullptr, descriptors.back().c_str(), false));
+    EXPECT_TRUE(types.back()->IsUnresolvedReference());
+  }
+  const RegType& obj = cache.JavaLangObject(false);
+  const RegType& string = cache.JavaLangString();
+  std::vector<const RegType*> merges;
+  for (size_t i = 1; i != kNumTypes; ++i) {
+    merges.push_back(&cache.FromUnresolvedMerge(*types[i - 1], *types[i], nullptr));
+    EXPECT_TRUE(merges.back()->IsUnresolvedMergedReference());
+  }
+  const size_t size = cache.GetCacheSize();
+
+  for (size_t i = 0; i != kNumTypes; ++i) {
+    EXPECT_EQ(types[i], &cache.FromDescriptor(nullptr, descriptors[i].c_str(), false));
+  }
+  EXPECT_EQ(&obj, &cache.FromDescriptor(nullptr, "Ljava/lang/Object;", false));
+  EXPECT_EQ(&string, &cache.FromDescriptor(nullptr, "Ljava/lang/String;", false));
+  EXPECT_EQ(&obj, cache.FindClass(obj.GetClass(), false));
+  EXPECT_EQ(&string, cache.FindClass(string.GetClass(), true));
+  for (size_t i = 1; i != kNumTypes; ++i) {
+    EXPECT_EQ(merges[i - 1], &cache.FromUnresolvedMerge(*types[i], *types[i - 1], nullptr));
+  }
+  EXPECT_EQ(size, cache.GetCacheSize());
+  Runtime::Current()->GetHeap()->DecrementDisableMovingGC(soa.Self());
+}
+
 TEST_F(RegTypeReferenceTest, Dump) {
   // Tests types for proper Dump messages.
   ArenaStack stack(Runtime::Current()->GetArenaPool());
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <jni.h>
+
+#include "art_method-inl.h"
+#include "gc/accounting/bitmap-inl.h"
+#include "jit/jit.h"
+#include "jit/jit_code_cache.h"
+#include "mirror/class-inl.h"
+#include "nativehelper/ScopedUtfChars.h"
+#include "runtime.h"
+#include "scoped_thread_state_change-inl.h"
+#include "thread_list.h"
+
+namespace art {
+
+// Local class declared as a friend of JitCodeCache so that we can access its internals.
+class JitCodeCacheCompactionTestHelper {
+ public:
+  // Runs a partial code cache collection that compacts the code space. Unlike
+  // JitCodeCache::GarbageCollectCache(), this does not schedule a full collection
+  // afterwards, so the compiled methods keep their JIT entrypoints.
+  static size_t Compact(Thread* self) REQUIRES_SHARED(Locks::mutator_lock_) {
+    CHECK(Runtime::Current()->GetJit() != nullptr);
+    jit::JitCodeCache* cache = Runtime::Current()->GetJit()->GetCodeCache();
+    size_t relocated_methods_before = 0u;
+    {
+      ScopedThreadSuspension sts(self, kSuspended);
+      MutexLock mu(self, cache->lock_);
+      cache->WaitForPotentialCollectionToComplete(self);
+      cache->live_bitmap_.reset(jit::CodeCacheBitmap::Create(
+          "code-cache-bitmap",
+          reinterpret_cast<uintptr_t>(cache->code_map_->Begin()),
+          reinterpret_cast<uintptr_t>(cache->code_map_->Begin() + cache->current_capacity_ / 2)));
+      cache->collection_in_progress_ = true;
+      cache->compact_code_on_next_collection_ = true;
+      relocated_methods_before = cache->number_of_relocated_methods_;
+    }
+    cache->DoCollection(self, /* collect_profiling_info */ false);
+    MutexLock mu(self, cache->lock_);
+    cache->live_bitmap_.reset(nullptr);
+    cache->NotifyCollectionDone(self);
+    return cache->number_of_relocated_methods_ - relocated_methods_before;
+  }
+};
+
+static ArtMethod* GetMethod(ScopedObjectAccess& soa, JNIEnv* env, jclass cls, jstring name)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  ScopedUtfChars chars(env, name);
+  CHECK(chars.c_str() != nullptr);
+  ArtMethod* method = soa.Decode<mirror::Class>(cls)->FindDeclaredDirectMethodByName(
+      chars.c_str(), kRuntimePointerSize);
+  CHECK(method != nullptr) << chars.c_str();
+  return method;
+}
+
+extern "C" JNIEXPORT
+jint Java_Main_compactJitCodeCache(JNIEnv*, jclass) {
+  ScopedObjectAccess soa(Thread::Current());
+  return static_cast<jint>(JitCodeCacheCompactionTestHelper::Compact(soa.Self()));
+}
+
+extern "C" JNIEXPORT
+jlong Java_Main_getEntrypoint(JNIEnv* env, jclass, jclass cls, jstring name) {
+  ScopedObjectAccess soa(Thread::Current());
+  ArtMethod* method = GetMethod(soa, env, cls, name);
+  return static_cast<jlong>(
+      reinterpret_cast<uintptr_t>(method->GetEntryPointFromQuickCompiledCode()));
+}
+
+// Removes the JIT-compiled code of a method and frees its memory, leaving a hole
+// in the code space.
+extern "C" JNIEXPORT
+void Java_Main_removeJitCompiledCode(JNIEnv* env, jclass, jclass cls, jstring name) {
+  jit::Jit* jit = Runtime::Current()->GetJit();
+  CHECK(jit != nullptr);
+  jit->WaitForCompilationToFinish(Thread::Current());
+  ScopedObjectAccess soa(Thread::Current());
+  ArtMethod* method = GetMethod(soa, env, cls, name);
+  ScopedThreadSuspension sts(soa.Self(), kNative);
+  ScopedSuspendAll ssa("Removing JIT compiled method", /* long_suspend */ true);
+  CHECK(jit->GetCodeCache()->RemoveMethod(method, /* release_memory */ true));
+}
+
+}  // namespace art
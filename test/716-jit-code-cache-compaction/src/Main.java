@@ -0,0 +1,134 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+public class Main {
+  static final String[] fillers = { "filler0", "filler1", "filler2", "filler3" };
+  static final String[] keepers = { "keeper0", "keeper1", "keeper2", "keeper3" };
+
+  public static void main(String[] args) throws Exception {
+    System.loadLibrary(args[0]);
+    if (isAotCompiled(Main.class, "hasJit")) {
+      throw new Error("This test must be run with --no-prebuild --no-dex2oat!");
+    }
+    if (!hasJit()) {
+      return;
+    }
+
+    // Compile the fillers first so that the keepers are allocated above them, then
+    // remove the fillers to leave holes below the keepers.
+    for (String name : fillers) {
+      ensureJitCompiled(Main.class, name);
+    }
+    for (String name : keepers) {
+      ensureJitCompiled(Main.class, name);
+    }
+    ensureJitCompiled(Main.class, "compactWhileRunning");
+    for (String name : fillers) {
+      removeJitCompiledCode(Main.class, name);
+    }
+
+    long[] entrypoints = new long[keepers.length];
+    for (int i = 0; i < keepers.length; ++i) {
+      entrypoints[i] = getEntrypoint(Main.class, keepers[i]);
+    }
+
+    // The compaction runs while compactWhileRunning() is on the stack, so its old copy
+    // must survive the collection for the method to return.
+    assertEquals(expectedCompactWhileRunning(5), compactWhileRunning(5));
+
+    boolean moved = false;
+    for (int i = 0; i < keepers.length; ++i) {
+      assertTrue(hasJitCompiledEntrypoint(Main.class, keepers[i]));
+      long entrypoint = getEntrypoint(Main.class, keepers[i]);
+      if (entrypoint != entrypoints[i]) {
+        // Compaction only ever moves code to lower addresses.
+        assertTrue(Long.compareUnsigned(entrypoint, entrypoints[i]) < 0);
+        moved = true;
+      }
+    }
+    assertTrue(moved);
+
+    // The moved code still runs correctly.
+    assertEquals(10, keeper0(3));
+    assertEquals(21, keeper1(3));
+    assertEquals(32, keeper2(3));
+    assertEquals(43, keeper3(3));
+
+    // Once compactWhileRunning() is no longer on the stack, the next collection frees
+    // its old copy, and the method keeps running from the moved one.
+    compactJitCodeCache();
+    assertTrue(hasJitCompiledEntrypoint(Main.class, "compactWhileRunning"));
+    assertEquals(expectedCompactWhileRunning(7), compactWhileRunning(7));
+  }
+
+  public static int compactWhileRunning(int x) {
+    int before = x * 3;
+    assertTrue(compactJitCodeCache() > 0);
+    return before + x * 11;
+  }
+
+  public static int expectedCompactWhileRunning(int x) {
+    return x * 14;
+  }
+
+  public static int keeper0(int x) { return x * 3 + 1; }
+  public static int keeper1(int x) { return x * 6 + 3; }
+  public static int keeper2(int x) { return x * 9 + 5; }
+  public static int keeper3(int x) { return x * 12 + 7; }
+
+  // The fillers are larger than the keepers, so that a keeper fits in the hole a filler leaves.
+  public static int filler0(int x) { return fill(x, 1); }
+  public static int filler1(int x) { return fill(x, 2); }
+  public static int filler2(int x) { return fill(x, 3); }
+  public static int filler3(int x) { return fill(x, 4); }
+
+  private static int fill(int x, int y) {
+    int result = 0;
+    for (int i = 0; i < x; ++i) {
+      switch ((i + y) & 7) {
+        case 0: result += i * 3; break;
+        case 1: result ^= i << 2; break;
+        case 2: result -= i / (y + 1); break;
+        case 3: result |= i * 7; break;
+        case 4: result += y * i * i; break;
+        case 5: result &= ~i; break;
+        case 6: result = result * 31 + i; break;
+        default: result >>>= 1; break;
+      }
+    }
+    return result;
+  }
+
+  public static void assertEquals(int expected, int actual) {
+    if (expected != actual) {
+      throw new AssertionError("Expected " + expected + " got " + actual);
+    }
+  }
+
+  public static void assertTrue(boolean value) {
+    if (!value) {
+      throw new AssertionError("Expected true");
+    }
+  }
+
+  public static native boolean isAotCompiled(Class<?> cls, String methodName);
+  public static native boolean hasJit();
+  public static native void ensureJitCompiled(Class<?> cls, String methodName);
+  public static native boolean hasJitCompiledEntrypoint(Class<?> cls, String methodName);
+  public static native void removeJitCompiledCode(Class<?> cls, String methodName);
+  public static native long getEntrypoint(Class<?> cls, String methodName);
+  public static native int compactJitCodeCache();
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "dex/dex_file.h"
+
+#include "class_linker.h"
+#include "dex/type_reference.h"
+#include "jit/profile_compilation_info.h"
+#include "jit/profile_saver.h"
+#include "jni.h"
+#include "mirror/class-inl.h"
+#include "mirror/class_loader.h"
+#include "nativehelper/ScopedUtfChars.h"
+#include "runtime.h"
+#include "scoped_thread_state_change-inl.h"
+#include "thread.h"
+
+namespace art {
+namespace {
+
+// Saves a profile for the dex file of `cls` which lists the class with the given descriptor.
+extern "C" JNIEXPORT void JNICALL Java_Main_saveProfileWithClass(JNIEnv* env,
+                                                                 jclass cls,
+                                                                 jstring filename,
+                                                                 jstring descriptor) {
+  ScopedUtfChars filename_chars(env, filename);
+  CHECK(filename_chars.c_str() != nullptr);
+  ScopedUtfChars descriptor_chars(env, descriptor);
+  CHECK(descriptor_chars.c_str() != nullptr);
+  ScopedObjectAccess soa(env);
+  const DexFile& dex_file = soa.Decode<mirror::Class>(cls)->GetDexFile();
+  const DexFile::TypeId* type_id = dex_file.FindTypeId(descriptor_chars.c_str());
+  CHECK(type_id != nullptr) << descriptor_chars.c_str();
+  ProfileCompilationInfo info;
+  CHECK(info.AddClassForDex(TypeReference(&dex_file, dex_file.GetIndexForTypeId(*type_id))));
+  CHECK(info.Save(filename_chars.c_str(), /* bytes_written */ nullptr));
+}
+
+extern "C" JNIEXPORT void JNICALL Java_Main_preverifyStartupClasses(JNIEnv*, jclass) {
+  ProfileSaver::ForcePreverifyStartupClasses();
+}
+
+// Returns whether the class with the given descriptor is loaded by the class loader of `cls`
+// and verified, without loading it.
+extern "C" JNIEXPORT jboolean JNICALL Java_Main_isLoadedAndVerified(JNIEnv* env,
+                                                                    jclass cls,
+                                                                    jstring descriptor) {
+  ScopedUtfChars descriptor_chars(env, descriptor);
+  CHECK(descriptor_chars.c_str() != nullptr);
+  ScopedObjectAccess soa(env);
+  ObjPtr<mirror::Class> klass = Runtime::Current()->GetClassLinker()->LookupClass(
+      soa.Self(),
+      descriptor_chars.c_str(),
+      soa.Decode<mirror::Class>(cls)->GetClassLoader());
+  return (klass != nullptr && klass->IsVerified()) ? JNI_TRUE : JNI_FALSE;
+}
+
+}  // namespace
+}  // namespace art
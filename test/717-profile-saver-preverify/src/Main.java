@@ -0,0 +1,94 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import java.io.File;
+import java.io.IOException;
+import java.lang.reflect.Method;
+
+public class Main {
+  static final String STARTUP_CLASS = "LStartupClass;";
+
+  public static void main(String[] args) throws Exception {
+    System.loadLibrary(args[0]);
+
+    File file = null;
+    try {
+      file = createTempFile();
+      String codePath = System.getenv("DEX_LOCATION") + "/717-profile-saver-preverify.jar";
+      // A profile saved by a previous run lists StartupClass.
+      saveProfileWithClass(file.getPath(), STARTUP_CLASS);
+      VMRuntime.registerAppInfo(file.getPath(), new String[] {codePath});
+
+      if (isLoadedAndVerified(STARTUP_CLASS)) {
+        throw new Error("StartupClass is verified before the profile saver runs");
+      }
+      preverifyStartupClasses();
+      if (!isLoadedAndVerified(STARTUP_CLASS)) {
+        throw new Error("StartupClass is not verified by the profile saver");
+      }
+      // The profile saver does not initialize the class, that still happens on first use.
+      if (StartupClass.getValue() != 42) {
+        throw new Error("Unexpected value");
+      }
+    } finally {
+      if (file != null) {
+        file.delete();
+      }
+    }
+  }
+
+  // Saves a profile for this dex file with the class of the given descriptor.
+  public static native void saveProfileWithClass(String profile, String descriptor);
+  // Verifies the classes of the saved profiles, as the profile saver does when it starts.
+  public static native void preverifyStartupClasses();
+  // Checks if a class is loaded and verified, without loading it.
+  public static native boolean isLoadedAndVerified(String descriptor);
+
+  private static final String TEMP_FILE_NAME_PREFIX = "dummy";
+  private static final String TEMP_FILE_NAME_SUFFIX = "-file";
+
+  private static File createTempFile() throws Exception {
+    try {
+      return File.createTempFile(TEMP_FILE_NAME_PREFIX, TEMP_FILE_NAME_SUFFIX);
+    } catch (IOException e) {
+      System.setProperty("java.io.tmpdir", "/data/local/tmp");
+      try {
+        return File.createTempFile(TEMP_FILE_NAME_PREFIX, TEMP_FILE_NAME_SUFFIX);
+      } catch (IOException e2) {
+        System.setProperty("java.io.tmpdir", "/sdcard");
+        return File.createTempFile(TEMP_FILE_NAME_PREFIX, TEMP_FILE_NAME_SUFFIX);
+      }
+    }
+  }
+
+  private static class VMRuntime {
+    private static final Method registerAppInfoMethod;
+    static {
+      try {
+        Class<? extends Object> c = Class.forName("dalvik.system.VMRuntime");
+        registerAppInfoMethod = c.getDeclaredMethod("registerAppInfo",
+            String.class, String[].class);
+      } catch (Exception e) {
+        throw new RuntimeException(e);
+      }
+    }
+
+    public static void registerAppInfo(String profile, String[] codePaths)
+        throws Exception {
+      registerAppInfoMethod.invoke(null, profile, codePaths);
+    }
+  }
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <jni.h>
+
+#include "art_method-inl.h"
+#include "entrypoints/runtime_asm_entrypoints.h"
+#include "gc/accounting/bitmap-inl.h"
+#include "jit/jit.h"
+#include "jit/jit_code_cache.h"
+#include "jit/profiling_info.h"
+#include "mirror/class-inl.h"
+#include "nativehelper/ScopedUtfChars.h"
+#include "runtime.h"
+#include "scoped_thread_state_change-inl.h"
+
+namespace art {
+
+// Local class declared as a friend of JitCodeCache so that we can access its internals.
+class JitBaselineTieringTestHelper {
+ public:
+  // Sends the method back to the interpreter, like the liveness polling before a full
+  // collection does, and runs a full code cache collection. The collection frees the
+  // ProfilingInfo of the method even if its compiled code is on the stack.
+  static void CollectFromInterpreter(Thread* self, ArtMethod* method)
+      REQUIRES_SHARED(Locks::mutator_lock_) {
+    CHECK(Runtime::Current()->GetJit() != nullptr);
+    jit::JitCodeCache* cache = Runtime::Current()->GetJit()->GetCodeCache();
+    method->SetEntryPointFromQuickCompiledCode(GetQuickToInterpreterBridge());
+    {
+      ScopedThreadSuspension sts(self, kSuspended);
+      MutexLock mu(self, cache->lock_);
+      cache->WaitForPotentialCollectionToComplete(self);
+      cache->live_bitmap_.reset(jit::CodeCacheBitmap::Create(
+          "code-cache-bitmap",
+          reinterpret_cast<uintptr_t>(cache->code_map_->Begin()),
+          reinterpret_cast<uintptr_t>(cache->code_map_->Begin() + cache->current_capacity_ / 2)));
+      cache->collection_in_progress_ = true;
+    }
+    cache->DoCollection(self, /* collect_profiling_info */ true);
+    MutexLock mu(self, cache->lock_);
+    cache->live_bitmap_.reset(nullptr);
+    cache->NotifyCollectionDone(self);
+  }
+};
+
+static ArtMethod* GetMethod(ScopedObjectAccess& soa, JNIEnv* env, jclass cls, jstring name)
+    REQUIRES_SHARED(Locks::mutator_lock_) {
+  ScopedUtfChars chars(env, name);
+  CHECK(chars.c_str() != nullptr);
+  ArtMethod* method = soa.Decode<mirror::Class>(cls)->FindDeclaredDirectMethodByName(
+      chars.c_str(), kRuntimePointerSize);
+  CHECK(method != nullptr) << chars.c_str();
+  return method;
+}
+
+extern "C" JNIEXPORT
+jboolean Java_Main_usesTieredJit(JNIEnv*, jclass) {
+  jit::Jit* jit = Runtime::Current()->GetJit();
+  return jit != nullptr && jit->UseTieredJitCompilation();
+}
+
+// Compiles the method in baseline mode on the calling thread, like the JIT thread pool does
+// once the method gets hot.
+extern "C" JNIEXPORT
+void Java_Main_compileBaseline(JNIEnv* env, jclass, jclass cls, jstring name) {
+  jit::Jit* jit = Runtime::Current()->GetJit();
+  CHECK(jit != nullptr);
+  Thread* self = Thread::Current();
+  ScopedObjectAccess soa(self);
+  ArtMethod* method = GetMethod(soa, env, cls, name);
+  // The baseline code counts down in the profiling info.
+  ProfilingInfo::Create(self, method, /* retry_allocation */ true);
+  CHECK(jit->CompileMethod(method, self, /* osr */ false, /* baseline */ true));
+  CHECK(jit->GetCodeCache()->ContainsPc(method->GetEntryPointFromQuickCompiledCode()));
+}
+
+extern "C" JNIEXPORT
+jboolean Java_Main_hasBaselineCode(JNIEnv* env, jclass, jclass cls, jstring name) {
+  ScopedObjectAccess soa(Thread::Current());
+  ArtMethod* method = GetMethod(soa, env, cls, name);
+  ProfilingInfo* info = method->GetProfilingInfo(kRuntimePointerSize);
+  return info != nullptr && info->HasBaselineCode();
+}
+
+// Frees the ProfilingInfo of the method `name` while its baseline code is on the stack, then
+// allocates one for `other_name`, which is likely to reuse the freed memory.
+extern "C" JNIEXPORT
+void Java_Main_collectCodeCache(JNIEnv* env, jclass, jclass cls, jstring name, jstring other_name) {
+  Thread* self = Thread::Current();
+  ScopedObjectAccess soa(self);
+  ArtMethod* method = GetMethod(soa, env, cls, name);
+  JitBaselineTieringTestHelper::CollectFromInterpreter(self, method);
+  CHECK(method->GetProfilingInfo(kRuntimePointerSize) == nullptr);
+  ArtMethod* other = GetMethod(soa, env, cls, other_name);
+  CHECK(ProfilingInfo::Create(self, other, /* retry_allocation */ true));
+}
+
+extern "C" JNIEXPORT
+jint Java_Main_baselineHotnessCount(JNIEnv* env, jclass, jclass cls, jstring name) {
+  ScopedObjectAccess soa(Thread::Current());
+  ArtMethod* method = GetMethod(soa, env, cls, name);
+  ProfilingInfo* info = method->GetProfilingInfo(kRuntimePointerSize);
+  CHECK(info != nullptr);
+  return info->GetBaselineHotnessCount();
+}
+
+}  // namespace art
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+public class Main {
+  // Keep in sync with the run script.
+  static final int OPTIMIZE_THRESHOLD = 1000;
+
+  public static void main(String[] args) throws Exception {
+    System.loadLibrary(args[0]);
+    if (isAotCompiled(Main.class, "hasJit")) {
+      throw new Error("This test must be run with --no-prebuild --no-dex2oat!");
+    }
+    if (!hasJit() || !usesTieredJit()) {
+      // Tiered compilation is only supported on some instruction sets.
+      return;
+    }
+
+    compileBaseline(Main.class, "$noinline$hot");
+    assertTrue(hasJitCompiledEntrypoint(Main.class, "$noinline$hot"));
+    assertTrue(hasBaselineCode(Main.class, "$noinline$hot"));
+
+    // Every entry into the baseline code counts down from the optimize threshold. Just before
+    // reaching it, the baseline code is still installed.
+    for (int i = 0; i < OPTIMIZE_THRESHOLD - 1; ++i) {
+      assertEquals(expectedHot(i), $noinline$hot(i));
+    }
+    waitForCompilation();
+    assertTrue(hasBaselineCode(Main.class, "$noinline$hot"));
+
+    // The next entries reach the threshold and queue an optimized compilation, which replaces
+    // the baseline code.
+    for (int i = 0; i < 10 && hasBaselineCode(Main.class, "$noinline$hot"); ++i) {
+      assertEquals(expectedHot(i), $noinline$hot(i));
+      waitForCompilation();
+    }
+    assertTrue(hasJitCompiledEntrypoint(Main.class, "$noinline$hot"));
+    assertFalse(hasBaselineCode(Main.class, "$noinline$hot"));
+    assertEquals(expectedHot(42), $noinline$hot(42));
+
+    // A full code cache collection frees the profiling info of a method that went back to
+    // the interpreter, even while its baseline code is still on the stack. Re-entering that
+    // code through its direct recursive call must not count down in the freed info.
+    compileBaseline(Main.class, "$noinline$recurse");
+    assertEquals(expectedRecurse(10), $noinline$recurse(10, true));
+    assertEquals(0, baselineHotnessCount(Main.class, "$noinline$untouched"));
+  }
+
+  public static int $noinline$recurse(int n, boolean collect) {
+    if (collect) {
+      collectCodeCache(Main.class, "$noinline$recurse", "$noinline$untouched");
+      return $noinline$recurse(n, false);
+    }
+    if (n == 0) {
+      return 0;
+    }
+    return n + $noinline$recurse(n - 1, false);
+  }
+
+  public static int expectedRecurse(int n) {
+    return n * (n + 1) / 2;
+  }
+
+  // Has no inline caches, like $noinline$recurse(), so that its profiling info has the
+  // same size.
+  public static int $noinline$untouched(int x) {
+    return x + 1;
+  }
+
+  public static int $noinline$hot(int x) {
+    int result = 0;
+    for (int i = 0; i < 4; ++i) {
+      result += x * i + 1;
+    }
+    return result;
+  }
+
+  public static int expectedHot(int x) {
+    return x * 6 + 4;
+  }
+
+  public static void assertEquals(int expected, int actual) {
+    if (expected != actual) {
+      throw new AssertionError("Expected " + expected + " got " + actual);
+    }
+  }
+
+  public static void assertTrue(boolean value) {
+    if (!value) {
+      throw new AssertionError("Expected true");
+    }
+  }
+
+  public static void assertFalse(boolean value) {
+    if (value) {
+      throw new AssertionError("Expected false");
+    }
+  }
+
+  public static native boolean isAotCompiled(Class<?> cls, String methodName);
+  public static native boolean hasJit();
+  public static native boolean hasJitCompiledEntrypoint(Class<?> cls, String methodName);
+  public static native void waitForCompilation();
+  public static native boolean usesTieredJit();
+  public static native void compileBaseline(Class<?> cls, String methodName);
+  public static native boolean hasBaselineCode(Class<?> cls, String methodName);
+  public static native void collectCodeCache(Class<?> cls, String methodName, String otherName);
+  public static native int baselineHotnessCount(Class<?> cls, String methodName);
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <jni.h>
+
+#include "deoptimization_kind.h"
+#include "jit/jit.h"
+#include "runtime.h"
+
+namespace art {
+
+extern "C" JNIEXPORT
+jint Java_Main_numberOfUntakenBranchDeoptimizations(JNIEnv*, jclass) {
+  jit::Jit* jit = Runtime::Current()->GetJit();
+  CHECK(jit != nullptr);
+  return static_cast<jint>(jit->GetNumberOfDeoptimizations(DeoptimizationKind::kUntakenBranch));
+}
+
+}  // namespace art
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+public class Main {
+  // Must match the -Xjitthreshold in the run script.
+  static final int JIT_THRESHOLD = 1000;
+
+  public static void main(String[] args) {
+    System.loadLibrary(args[0]);
+    if (!hasJit()) {
+      return;
+    }
+    int deoptimizations = numberOfUntakenBranchDeoptimizations();
+    assertEquals(7 * 820, $noinline$hugeLoop(7));
+    // Leaving the loop deoptimized the OSR code, and the interpreter finished the method.
+    assertEquals(deoptimizations + 1, numberOfUntakenBranchDeoptimizations());
+    // The counter is back below the OSR threshold, so that back edges can request a new OSR
+    // compilation, which keeps the branch now that it has been taken.
+    assertTrue(getHotnessCounter(Main.class, "$noinline$hugeLoop") <= JIT_THRESHOLD);
+  }
+
+  // The interpreter never takes the loop exit before the OSR compilation, so the OSR code
+  // deoptimizes instead of going there, and the code after the loop is not compiled.
+
+  /// CHECK-START: int Main.$noinline$hugeLoop(int) dead_code_elimination$initial (after)
+  /// CHECK:       Deoptimize kind:untaken branch
+  /// CHECK-NOT:   Return
+
+  public static int $noinline$hugeLoop(int x) {
+    while (!isInOsrCode("$noinline$hugeLoop")) {}
+    int result = 0;
+    result += x * 1;
+    result += x * 2;
+    result += x * 3;
+    result += x * 4;
+    result += x * 5;
+    result += x * 6;
+    result += x * 7;
+    result += x * 8;
+    result += x * 9;
+    result += x * 10;
+    result += x * 11;
+    result += x * 12;
+    result += x * 13;
+    result += x * 14;
+    result += x * 15;
+    result += x * 16;
+    result += x * 17;
+    result += x * 18;
+    result += x * 19;
+    result += x * 20;
+    result += x * 21;
+    result += x * 22;
+    result += x * 23;
+    result += x * 24;
+    result += x * 25;
+    result += x * 26;
+    result += x * 27;
+    result += x * 28;
+    result += x * 29;
+    result += x * 30;
+    result += x * 31;
+    result += x * 32;
+    result += x * 33;
+    result += x * 34;
+    result += x * 35;
+    result += x * 36;
+    result += x * 37;
+    result += x * 38;
+    result += x * 39;
+    result += x * 40;
+    return result;
+  }
+
+  public static void assertEquals(int expected, int actual) {
+    if (expected != actual) {
+      throw new AssertionError("Expected " + expected + " got " + actual);
+    }
+  }
+
+  public static void assertTrue(boolean value) {
+    if (!value) {
+      throw new AssertionError("Expected true");
+    }
+  }
+
+  public static native boolean hasJit();
+  public static native boolean isInOsrCode(String methodName);
+  public static native int getHotnessCounter(Class<?> cls, String methodName);
+  public static native int numberOfUntakenBranchDeoptimizations();
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+public class Main {
+
+  // The call to unknownCallee() comes first in the method, but hotCallee() is hot in the
+  // profile, so its call sites are inlined first. Together they use up the instruction
+  // budget, and the earlier call site is no longer inlined.
+
+  /// CHECK-START: int Main.$noinline$test(int) inliner (before)
+  /// CHECK:     InvokeStaticOrDirect method_name:Main.unknownCallee
+  /// CHECK:     InvokeStaticOrDirect method_name:Main.hotCallee
+
+  /// CHECK-START: int Main.$noinline$test(int) inliner (after)
+  /// CHECK-NOT: InvokeStaticOrDirect method_name:Main.hotCallee
+
+  /// CHECK-START: int Main.$noinline$test(int) inliner (after)
+  /// CHECK:     InvokeStaticOrDirect method_name:Main.unknownCallee
+  public static int $noinline$test(int x) {
+    int result = unknownCallee(x);
+    result += hotCallee(result + 1);
+    result += hotCallee(result + 2);
+    result += hotCallee(result + 3);
+    result += hotCallee(result + 4);
+    result += hotCallee(result + 5);
+    result += hotCallee(result + 6);
+    result += hotCallee(result + 7);
+    result += hotCallee(result + 8);
+    result += hotCallee(result + 9);
+    result += hotCallee(result + 10);
+    return result;
+  }
+
+  // About 110 instructions, so that ten of them use up the budget of a method
+  // that is not hot.
+  public static int hotCallee(int x) {
+    x = ((x * 37) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 11) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 13) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 19) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 21) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 27) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 43) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 53) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 59) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 61) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 67) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 71) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 73) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 79) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 83) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    x = ((x * 89) ^ (x >>> 3)) + ((x << 5) | (x >> 2));
+    return x;
+  }
+
+  // Small enough to be inlined when the budget allows it, but not a small method
+  // that is always inlined.
+  public static int unknownCallee(int x) {
+    x = (x * 13) ^ (x >>> 7);
+    x = (x * 19) ^ (x >>> 7);
+    x = (x * 11) ^ (x >>> 7);
+    x = (x * 21) ^ (x >>> 7);
+    x = (x * 27) ^ (x >>> 7);
+    return x;
+  }
+
+  public static void main(String[] args) {
+    assertEquals(361790668, $noinline$test(5));
+    assertEquals(-1841429068, $noinline$test(-1234567));
+  }
+
+  public static void assertEquals(int expected, int actual) {
+    if (expected != actual) {
+      throw new AssertionError("Expected " + expected + " got " + actual);
+    }
+  }
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <jni.h>
+
+#include "art_method-inl.h"
+#include "deoptimization_kind.h"
+#include "jit/jit.h"
+#include "jit/jit_code_cache.h"
+#include "jit/profiling_info.h"
+#include "mirror/class-inl.h"
+#include "nativehelper/ScopedUtfChars.h"
+#include "runtime.h"
+#include "scoped_thread_state_change-inl.h"
+
+namespace art {
+
+// Creates the profiling info of a method, so that the interpreter records the receivers
+// of its calls before the method is warm.
+extern "C" JNIEXPORT
+void Java_Main_createProfilingInfo(JNIEnv* env, jclass, jclass cls, jstring name) {
+  jit::Jit* jit = Runtime::Current()->GetJit();
+  CHECK(jit != nullptr);
+  ScopedObjectAccess soa(Thread::Current());
+  ScopedUtfChars chars(env, name);
+  CHECK(chars.c_str() != nullptr);
+  ArtMethod* method = soa.Decode<mirror::Class>(cls)->FindDeclaredDirectMethodByName(
+      chars.c_str(), kRuntimePointerSize);
+  CHECK(method != nullptr) << chars.c_str();
+  // Keep the profiling info, collections could otherwise free it before the method is compiled.
+  jit->GetCodeCache()->SetGarbageCollectCode(false);
+  CHECK(ProfilingInfo::Create(soa.Self(), method, /* retry_allocation */ true));
+}
+
+extern "C" JNIEXPORT
+jint Java_Main_numberOfInlineCacheDeoptimizations(JNIEnv*, jclass) {
+  jit::Jit* jit = Runtime::Current()->GetJit();
+  CHECK(jit != nullptr);
+  return static_cast<jint>(jit->GetNumberOfDeoptimizations(DeoptimizationKind::kJitInlineCache));
+}
+
+}  // namespace art
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+abstract class Super {
+  public abstract int getValue();
+}
+
+class SubA extends Super {
+  public int getValue() { return 42; }
+}
+
+class SubB extends Super {
+  public int getValue() { return 38; }
+}
+
+class SubC extends Super {
+  public int getValue() { return 10; }
+}
+
+public class Main {
+  public static void main(String[] args) throws Exception {
+    System.loadLibrary(args[0]);
+    if (isAotCompiled(Main.class, "hasJit")) {
+      throw new Error("This test must be run with --no-prebuild --no-dex2oat!");
+    }
+    if (!hasJit()) {
+      return;
+    }
+
+    // Load all the subclasses up front, so that class hierarchy analysis cannot
+    // devirtualize the call in callGetValue().
+    Super a = new SubA();
+    Super b = new SubB();
+    Super c = new SubC();
+
+    // Only SubA reaches the call, so the compiled code guards on it with a deoptimization.
+    createProfilingInfo(Main.class, "callGetValue");
+    for (int i = 0; i < 10; ++i) {
+      assertEquals(42, callGetValue(a));
+    }
+    ensureJitCompiled(Main.class, "callGetValue");
+    assertTrue(hasJitCompiledEntrypoint(Main.class, "callGetValue"));
+
+    // A SubB receiver fails the guard, deoptimizes and invalidates the compiled code.
+    int deoptimizations = numberOfInlineCacheDeoptimizations();
+    assertEquals(38, callGetValue(b));
+    assertEquals(deoptimizations + 1, numberOfInlineCacheDeoptimizations());
+    assertTrue(!hasJitCompiledEntrypoint(Main.class, "callGetValue"));
+
+    // The recompiled code must not guard on the inline cache with a deoptimization again,
+    // so a receiver it has never seen takes the virtual call instead.
+    ensureJitCompiled(Main.class, "callGetValue");
+    assertEquals(42, callGetValue(a));
+    assertEquals(38, callGetValue(b));
+    assertEquals(10, callGetValue(c));
+    assertEquals(deoptimizations + 1, numberOfInlineCacheDeoptimizations());
+    assertTrue(hasJitCompiledEntrypoint(Main.class, "callGetValue"));
+  }
+
+  public static int callGetValue(Super s) {
+    return s.getValue();
+  }
+
+  public static void assertEquals(int expected, int actual) {
+    if (expected != actual) {
+      throw new AssertionError("Expected " + expected + " got " + actual);
+    }
+  }
+
+  public static void assertTrue(boolean value) {
+    if (!value) {
+      throw new AssertionError("Expected true");
+    }
+  }
+
+  public static native boolean isAotCompiled(Class<?> cls, String methodName);
+  public static native boolean hasJit();
+  public static native void ensureJitCompiled(Class<?> cls, String methodName);
+  public static native boolean hasJitCompiledEntrypoint(Class<?> cls, String methodName);
+  public static native void createProfilingInfo(Class<?> cls, String methodName);
+  public static native int numberOfInlineCacheDeoptimizations();
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+class CallChains {
+  // The callee has a lower method index than its caller, so it is only laid out after the
+  // caller if the call is taken into account.
+  static String callee() {
+    return "alpha";
+  }
+
+  static String caller(boolean b) {
+    String s = callee();
+    return b ? s : "zeta";
+  }
+
+  // The profile records Second as the receiver of the call, which has a higher method index
+  // than First.
+  static int dispatch(Base b) {
+    return b.value() + 1;
+  }
+}
+
+abstract class Base {
+  abstract int value();
+}
+
+class First extends Base {
+  int value() {
+    return 42;
+  }
+}
+
+class Second extends Base {
+  int value() {
+    return 7;
+  }
+}